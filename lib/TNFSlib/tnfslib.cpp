@@ -1,6 +1,7 @@
 
 #include "tnfslib.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <sys/stat.h>
 #include <errno.h>
@@ -144,7 +145,10 @@ int tnfs_umount(tnfsMountInfo *m_info)
     tnfsPacket packet;
     packet.command = TNFS_CMD_UNMOUNT;
 
-    if (_tnfs_transaction(m_info, packet, 0))
+    bool replied = _tnfs_transaction(m_info, packet, 0);
+    m_info->udp.stop();
+
+    if (replied)
     {
         if (packet.payload[0] == TNFS_RESULT_SUCCESS)
         {
@@ -361,6 +365,198 @@ int _tnfs_read_from_cache(tnfsFileHandleInfo *pFHI, uint8_t *dest, uint16_t dest
         return 0;
 }
 
+/*
+ Sends count READ calls of TNFS_READ_CHUNK bytes over UDP without waiting for
+ each reply, followed by an LSEEK to the current position, and copies the
+ replies into the cache by sequence number.
+ READ has no offset: the server hands out consecutive chunks in the order the
+ requests reach it. The chunks are only kept if every reply came back in the
+ order it was asked for and the LSEEK puts the server exactly past them; a
+ request that overtook another, or a duplicate the server read twice, shows up
+ as one or the other. Otherwise the server is seeked back to the start.
+ Returns: bytes loaded; 0: nothing usable, fall back to one READ at a time; -1: failed to seek back
+*/
+int _tnfs_fill_cache_window(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, uint8_t count)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_info->transaction_mutex);
+
+    // One slot per READ, and the LSEEK in the last one
+    bool replied[TNFS_READ_WINDOW + 1] = { false };
+    uint8_t arrival[TNFS_READ_WINDOW + 1];
+    uint8_t result[TNFS_READ_WINDOW + 1];
+    uint16_t bytes_read[TNFS_READ_WINDOW];
+    uint32_t server_position = 0;
+    bool position_reported = false;
+
+    tnfsPacket packet;
+    packet.session_idl = TNFS_LOBYTE_FROM_UINT16(m_info->session);
+    packet.session_idh = TNFS_HIBYTE_FROM_UINT16(m_info->session);
+    packet.payload[0] = pFHI->handle_id;
+
+    uint8_t first_sequence_num = m_info->current_sequence_num;
+    uint8_t sent = 0;
+    while (sent <= count)
+    {
+        uint16_t payload_size;
+        if (sent < count)
+        {
+            packet.command = TNFS_CMD_READ;
+            packet.payload[1] = TNFS_LOBYTE_FROM_UINT16(TNFS_READ_CHUNK);
+            packet.payload[2] = TNFS_HIBYTE_FROM_UINT16(TNFS_READ_CHUNK);
+            payload_size = 3;
+        }
+        else
+        {
+            packet.command = TNFS_CMD_LSEEK;
+            packet.payload[1] = SEEK_CUR;
+            TNFS_UINT32_TO_LOHI_BYTEPTR(0, packet.payload + 2);
+            payload_size = 6;
+        }
+        packet.sequence_num = m_info->current_sequence_num++;
+#ifdef DEBUG
+        _tnfs_debug_packet(packet, payload_size);
+#endif
+        if (!_tnfs_udp_send(&m_info->udp, m_info, packet, payload_size))
+            break;
+        sent++;
+    }
+
+    // Collect the replies until they're all in or we time out
+    uint8_t outstanding = sent;
+    uint8_t arrivals = 0;
+#ifdef ESP_PLATFORM
+    int ms_start = fnSystem.millis();
+    int ms_lseek = 0;
+#else
+    uint64_t ms_start = fnSystem.millis();
+    uint64_t ms_lseek = 0;
+#endif
+    while (outstanding > 0 && (fnSystem.millis() - ms_start) < m_info->timeout_ms)
+    {
+        if (SYSTEM_BUS.getShuttingDown())
+            return 0;
+
+        // The LSEEK went last, once it's answered whatever is still missing is lost or
+        // too late to keep; give stragglers a moment rather than the whole timeout
+        if (replied[count] && (fnSystem.millis() - ms_lseek) >= m_info->min_retry_ms)
+            break;
+
+        tnfsPacket reply;
+        int l = _tnfs_udp_recv(&m_info->udp, m_info, reply);
+        if (l < 0)
+        {
+#ifdef ESP_PLATFORM
+            fnSystem.yield();
+#else
+            fnSystem.delay_microseconds(2000);
+#endif
+            continue;
+        }
+
+        // Late replies to earlier transactions and duplicates still count as arrivals,
+        // the server may have moved the file position for them
+        uint8_t slot = reply.sequence_num - first_sequence_num;
+        if (slot >= sent || replied[slot])
+        {
+            Debug_printf("_tnfs_fill_cache_window unexpected reply seq=%x\r\n", reply.sequence_num);
+            arrivals++;
+            continue;
+        }
+
+        replied[slot] = true;
+        arrival[slot] = arrivals++;
+        outstanding--;
+        if (slot == count)
+            ms_lseek = fnSystem.millis();
+        result[slot] = reply.payload[0];
+        if (result[slot] != TNFS_RESULT_SUCCESS)
+            continue;
+
+        if (slot < count)
+        {
+            bytes_read[slot] = TNFS_UINT16_FROM_LOHI_BYTEPTR(reply.payload + 1);
+            if (bytes_read[slot] > TNFS_READ_CHUNK)
+                bytes_read[slot] = TNFS_READ_CHUNK;
+            memcpy(pFHI->cache + (slot * TNFS_READ_CHUNK), reply.payload + 3, bytes_read[slot]);
+        }
+        else if (l >= TNFS_HEADER_SIZE + 5)
+        {
+            server_position = TNFS_UINT32_FROM_LOHI_BYTEPTR(reply.payload + 1);
+            position_reported = true;
+        }
+    }
+
+    // Every reply in the order it was asked for, and the chunks run up to the end of the file
+    uint32_t loaded = 0;
+    bool in_order = (sent == count + 1);
+    bool eof = false;
+    for (uint8_t slot = 0; in_order && slot < count; slot++)
+    {
+        if (!replied[slot] || arrival[slot] != slot)
+            in_order = false;
+        else if (result[slot] == TNFS_RESULT_END_OF_FILE)
+            eof = true;
+        else if (result[slot] != TNFS_RESULT_SUCCESS || (eof && bytes_read[slot] > 0))
+            in_order = false;
+        else
+        {
+            loaded += bytes_read[slot];
+            eof = bytes_read[slot] < TNFS_READ_CHUNK;
+        }
+    }
+
+    if (in_order && replied[count] && arrival[count] == count && result[count] == TNFS_RESULT_SUCCESS && !position_reported)
+    {
+        Debug_print("_tnfs_fill_cache_window server doesn't report its position - no more read windows on this mount\r\n");
+        m_info->read_window = false;
+        in_order = false;
+    }
+
+    // Only the LSEEK went missing, by now anything still on its way has reached the server
+    if (in_order && !replied[count])
+    {
+        tnfsPacket probe;
+        probe.command = TNFS_CMD_LSEEK;
+        probe.payload[0] = pFHI->handle_id;
+        probe.payload[1] = SEEK_CUR;
+        TNFS_UINT32_TO_LOHI_BYTEPTR(0, probe.payload + 2);
+        if (_tnfs_transaction(m_info, probe, 6) && probe.payload[0] == TNFS_RESULT_SUCCESS)
+        {
+            server_position = TNFS_UINT32_FROM_LOHI_BYTEPTR(probe.payload + 1);
+            replied[count] = true;
+            arrival[count] = count;
+            result[count] = TNFS_RESULT_SUCCESS;
+        }
+    }
+
+    if (in_order && replied[count] && arrival[count] == count && result[count] == TNFS_RESULT_SUCCESS &&
+        server_position == pFHI->cache_start + loaded)
+    {
+        pFHI->file_position = server_position;
+        #ifdef VERBOSE_TNFS
+        Debug_printf("_tnfs_fill_cache_window got %u bytes from %u requests\r\n", loaded, count);
+        #endif
+        return loaded;
+    }
+
+    Debug_printf("_tnfs_fill_cache_window dropped %u requests, seeking back to %u\r\n", count, pFHI->cache_start);
+    pFHI->read_ahead = 1;
+
+    tnfsPacket seek;
+    seek.command = TNFS_CMD_LSEEK;
+    seek.payload[0] = pFHI->handle_id;
+    seek.payload[1] = SEEK_SET;
+    TNFS_UINT32_TO_LOHI_BYTEPTR(pFHI->cache_start, seek.payload + 2);
+    if (!_tnfs_transaction(m_info, seek, 6) || seek.payload[0] != TNFS_RESULT_SUCCESS)
+    {
+        Debug_print("_tnfs_fill_cache_window failed to seek back\r\n");
+        return -1;
+    }
+    pFHI->file_position = pFHI->cache_start;
+
+    return 0;
+}
+
 /*
  Executes as many READ calls as needed to populate our internal cache
  Returns: 0: success; -1: failed to deliver/receive packet; other: TNFS error result code
@@ -375,12 +571,32 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
 
     int error = 0;
 
+    // Read further ahead each time a fill carries on from where the last one ended,
+    // a seek or write empties the cache and starts again from one chunk
+    if (pFHI->cache_available > 0 && pFHI->file_position == pFHI->cache_start + pFHI->cache_available)
+        pFHI->read_ahead = std::min(pFHI->read_ahead * 2, TNFS_READ_WINDOW);
+    else
+        pFHI->read_ahead = 1;
+
     // Reset the current cache values so it's invalid if we fail below
     pFHI->cache_available = 0;
     pFHI->cache_start = pFHI->file_position;
 
     // How many bytes until we finish loading the cache
-    uint32_t bytes_remaining_to_load = sizeof(pFHI->cache);
+    uint32_t bytes_to_fill = pFHI->read_ahead * TNFS_READ_CHUNK;
+    uint32_t bytes_remaining_to_load = bytes_to_fill;
+
+    // Over UDP several READs can be in flight at once
+    if (m_info->protocol == TNFS_PROTOCOL_UDP && m_info->read_window && pFHI->read_ahead > 1)
+    {
+        int loaded = _tnfs_fill_cache_window(m_info, pFHI, pFHI->read_ahead);
+        if (loaded < 0)
+            return -1;
+
+        // Nothing came back in one piece, read a chunk the slow way with the usual retries
+        bytes_to_fill = loaded > 0 ? loaded : TNFS_READ_CHUNK;
+        bytes_remaining_to_load = bytes_to_fill - loaded;
+    }
 
     // Keep making TNFS READ calls as long as we still have bytes to read
     while (bytes_remaining_to_load > 0)
@@ -407,7 +623,7 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
                 // Copy the actual number of bytes returned to us into our cache
                 // (offset by how many bytes we've already put in the cache)
                 uint16_t bytes_read = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 1);
-                memcpy(pFHI->cache + (sizeof(pFHI->cache) - bytes_remaining_to_load),
+                memcpy(pFHI->cache + (bytes_to_fill - bytes_remaining_to_load),
                        packet.payload + 3, bytes_read);
 
                 // Keep track of our file position
@@ -450,12 +666,12 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
 #ifdef ESP_PLATFORM
     if (error == 0)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
+        pFHI->cache_available = bytes_to_fill - bytes_remaining_to_load;
 #else
 // TODO review EOF handling
     if (error == 0 || error == TNFS_RESULT_END_OF_FILE)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
+        pFHI->cache_available = bytes_to_fill - bytes_remaining_to_load;
         if (pFHI->cache_available > 0) error = 0; // neutralize EOF
 #endif
 #ifdef DEBUG
@@ -1381,7 +1597,7 @@ bool _tnfs_transaction(tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_
 {
     std::lock_guard<std::recursive_mutex> lock(m_info->transaction_mutex);
 
-    fnUDP udp;
+    fnUDP &udp = m_info->udp;
 
     // Set our session ID
     tnfsPacket reqPkt = pkt;
@@ -1510,7 +1726,8 @@ _tnfs_recv_result _tnfs_recv_and_validate(fnUDP &udp, tnfsMountInfo *m_info, tnf
     }
 
     // Delayed response for the previous request. We should just try to recv the next response.
-    if (res_pkt.sequence_num < req_pkt.sequence_num)
+    // The socket lives as long as the mount, so compare in a way that survives the wrap at 255
+    if ((int8_t)(res_pkt.sequence_num - req_pkt.sequence_num) < 0)
     {
         Debug_printf("Received delayed response! Rcvd: %x, Expected: %x\r\n", res_pkt.sequence_num, req_pkt.sequence_num);
         return NO_RESP;
@@ -6,6 +6,7 @@
 
 #include "fnDNS.h"
 #include "fnTcpClient.h"
+#include "fnUDP.h"
 
 
 #define TNFS_DEFAULT_PORT 16384
@@ -16,7 +17,9 @@
 #define TNFS_MAX_FILE_HANDLES 8 // Max number of file handles we'll open to the server
 #define TNFS_MAX_FILELEN 256
 
-#define TNFS_FILE_CACHE_SIZE 512 // 4 * 128 fits in a single packet when TNFS_MAX_READWRITE_PAYLOAD is 512
+#define TNFS_READ_CHUNK 512 // 4 * 128 fits in a single packet when TNFS_MAX_READWRITE_PAYLOAD is 512
+#define TNFS_READ_WINDOW 4 // Most READ requests we keep in flight over UDP while reading sequentially
+#define TNFS_FILE_CACHE_SIZE (TNFS_READ_CHUNK * TNFS_READ_WINDOW)
 
 #define TNFS_INVALID_HANDLE -1
 #define TNFS_INVALID_SESSION 0 // We're assuming a '0' is never a valid session ID
@@ -51,6 +54,7 @@ struct tnfsFileHandleInfo
     uint32_t cache_available = 0; // Number of valid bytes in the cache
 
     bool cache_modified = false; // Notes if we've written to the cache
+    uint8_t read_ahead = 0; // Chunks the last cache fill asked for, grows while reads are sequential
 
     uint8_t cache[TNFS_FILE_CACHE_SIZE];
     char filename[TNFS_MAX_FILELEN];
@@ -100,6 +104,7 @@ public:
 
     uint8_t protocol = TNFS_PROTOCOL_UNKNOWN;
     fnTcpClient tcp_client;
+    fnUDP udp; // Kept for the whole mount so late replies land here and not on a closed port
 
     // These char[] sizes are abitrary...
     char hostname[64] = { '\0' };
@@ -115,6 +120,7 @@ public:
     uint8_t max_retries = TNFS_RETRIES;
     int timeout_ms = TNFS_TIMEOUT;
     uint8_t current_sequence_num = 0; // Updated with each transaction to the server
+    bool read_window = true; // Cleared if the server can't be trusted with several READs in flight
 
     int16_t dir_handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIR
     uint16_t dir_entries = 0; // Stored from server's response to TNFS_OPENDIRX
@@ -239,6 +239,12 @@ protected:
      */
     device_state_t state;
 
+    /**
+     * @brief bus protocol of the fastloader uploaded to the device. Not
+     *        switched to yet, selectProtocol() has no handler for any of them.
+     */
+    bus_protocol_t device_protocol = PROTOCOL_SERIAL;
+
     /**
      * @brief response queue (e.g. INPUT)
      * @deprecated remove as soon as it's out of fuji.
@@ -50,14 +50,14 @@ static void cpmTask(void *arg)
 
 iecCpm::iecCpm()
 {
-    rxq = xQueueCreate(2048, sizeof(char));
-    txq = xQueueCreate(2048, sizeof(char));
+    rxq = xStreamBufferCreate(CPM_CONSOLE_RING, 1);
+    txq = xStreamBufferCreate(CPM_CONSOLE_RING, 1);
 }
 
 iecCpm::~iecCpm()
 {
-    vQueueDelete(rxq);
-    vQueueDelete(txq);
+    vStreamBufferDelete(rxq);
+    vStreamBufferDelete(txq);
 }
 
 void iecCpm::iec_open()
@@ -73,6 +73,14 @@ void iecCpm::iec_close()
     if (cpmTaskHandle != NULL)
         vTaskDelete(cpmTaskHandle);
 
+    // Write out what the task had buffered
+    _fc_closeall();
+
+    // Nothing is left to read or write the consoles
+    xStreamBufferReset(rxq);
+    xStreamBufferReset(txq);
+    talk_pos = talk_len = 0;
+
     commanddata.init();
     state = DEVICE_IDLE;
     Debug_printv("device init");
@@ -80,35 +88,46 @@ void iecCpm::iec_close()
 
 void iecCpm::poll_interrupt(unsigned char c)
 {    
-    if (uxQueueMessagesWaiting(rxq))
+    // The console is one stream, however many channels are polled
+    if (c != 0)
+        return;
+
+    if (talk_pos < talk_len || !xStreamBufferIsEmpty(rxq))
         IEC.assert_interrupt();
 }
 
 void iecCpm::iec_reopen_talk()
 {
-    bool set_eoi = false;
-    bool atn = true; // inverted
-
     if (cpmTaskHandle == NULL)
     {
         Debug_printf("iecCpm::iec_reopen_talk() - No CP/M task, ignoring.\r\n");
         return;
     }
 
-    while (atn)
+    // Send console output a run at a time, until there is none or ATN is pulled
+    while (true)
     {
-        char b;
-        atn = fnSystem.digital_read(PIN_IEC_ATN);
-
-        if (!uxQueueMessagesWaiting(rxq))
+        if (talk_pos == talk_len)
         {
-            IEC.senderTimeout();
-            break;
+            talk_pos = 0;
+            talk_len = xStreamBufferReceive(rxq, talk_buf, sizeof(talk_buf), 0);
+            if (!talk_len)
+            {
+                IEC.senderTimeout();
+                break;
+            }
         }
 
-        xQueueReceive(rxq,&b,portMAX_DELAY);
-        IEC.sendByte(b, set_eoi);
-        atn = fnSystem.digital_read(PIN_IEC_ATN);
+        while (talk_pos < talk_len)
+        {
+            if (!fnSystem.digital_read(PIN_IEC_ATN))
+                return;
+
+            // A byte the bus didn't take is sent again on the next talk
+            if (!IEC.sendByte(talk_buf[talk_pos], false))
+                return;
+            talk_pos++;
+        }
     }
 }
 
@@ -116,22 +135,16 @@ void iecCpm::iec_reopen_listen()
 {
     if (cpmTaskHandle == NULL)
     {
-        Debug_printf("iecCpm::iec_reopen_talk() - No CP/M task, ignoring.\r\n");
+        Debug_printf("iecCpm::iec_reopen_listen() - No CP/M task, ignoring.\r\n");
         return;
     }
 
-    while (!(IEC.flags & EOI_RECVD))
-    {
-        int16_t b = IEC.receiveByte();
+    // Everything up to EOI goes to the CP/M task in one run
+    std::string s = IEC.receiveBytes();
+    if (IEC.flags & ERROR)
+        Debug_printf("Error on receive.\r\n");
 
-        if (b<0)
-        {
-            Debug_printf("Error on receive.\r\n");
-            return;
-        }
-
-        xQueueSend(txq,&b,portMAX_DELAY);
-    }
+    xStreamBufferSend(txq, s.data(), s.size(), portMAX_DELAY);
 }
 
 void iecCpm::iec_reopen()
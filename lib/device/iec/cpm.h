@@ -5,6 +5,9 @@
 
 #define FOLDERCHAR '/'
 
+#define CPM_CONSOLE_RING 2048   // bytes in each console ring
+#define CPM_TALK_CHUNK 256      // console output taken from the ring at a time
+
 // Silly typedefs that runcpm uses
 typedef unsigned char   uint8;
 typedef unsigned short  uint16;
@@ -36,6 +39,11 @@ class iecCpm : public virtualDevice
 
     TaskHandle_t cpmTaskHandle = NULL;    
 
+    // Console output taken from the ring but not sent yet, when a talk was cut short
+    char talk_buf[CPM_TALK_CHUNK];
+    size_t talk_pos = 0;
+    size_t talk_len = 0;
+
     virtual void poll_interrupt(unsigned char c) override;
     
     void iec_open();
@@ -20,6 +20,7 @@
 
 #include "drive.h"
 
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 #include <unordered_map>
@@ -37,6 +38,20 @@
 #include "meat_media.h"
 
 
+// Bus protocol for a fastloader running in the drive. Only recorded for
+// now, the bus stays on standard serial until epyxfastload.cpp and the
+// others are IECProtocol implementations selectProtocol() can pick.
+static bus_protocol_t fastloader_protocol(fastloader_t loader)
+{
+    switch (loader)
+    {
+    case FL_EPYXCART:
+        return PROTOCOL_EPYXFASTLOAD;
+    default:
+        return PROTOCOL_SERIAL;
+    }
+}
+
 iecDrive::iecDrive()
 {
     // device_active = false;
@@ -239,10 +254,20 @@ void iecDrive::iec_open()
             payload = mstr::drop(payload, 1);
     }
 
+    listing_filter.clear();
     if ( payload.length() )
     {
         if ( payload[0] == '$' ) 
+        {
+            // "$[drive][:]pattern[=type]"
+            size_t i = 1;
+            while ( i < payload.size() && payload[i] >= '0' && payload[i] <= '9' )
+                i++;
+            if ( i < payload.size() && payload[i] == ':' )
+                i++;
+            listing_filter = payload.substr(i);
             payload.clear();
+        }
 
         payload = mstr::toUTF8(payload);
         auto n = _base->cd( payload );
@@ -356,6 +381,12 @@ void iecDrive::iec_talk_command()
     //Debug_printv("here");
     if (response_queue.empty())
         iec_talk_command_buffer_status();
+    else
+    {
+        // M-R result
+        IEC.sendBytes(response_queue.front(), true);
+        response_queue.pop();
+    }
 }
 
 void iecDrive::iec_talk_command_buffer_status()
@@ -378,6 +409,10 @@ void iecDrive::iec_command()
     // else if (pt[0] == "id")
     // 	set_device_id();
 
+    // Anything but memory commands ends a drive code upload
+    if ( payload[0] != 'M' )
+        memory.command();
+
     // Drive level commands
     // CBM DOS 2.5
     switch ( payload[0] )
@@ -395,13 +430,19 @@ void iecDrive::iec_command()
                     Debug_printv("payload[%s] channel[%d] position[%d]", payload.c_str(), pti[0], pti[1]);
 
                     auto stream = retrieveStream( pti[0] );
-                    if ( stream )
-                    {
+                    if ( stream && flushStreamBuffer( pti[0] ) )
                         stream->position( pti[1] );
-                    }
                 }
-                // B-A allocate bit in BAM not implemented
-                // B-F free bit in BAM not implemented
+                // B-A allocate bit in BAM
+                else if (payload[2] == 'A')
+                {
+                    blockCommand( true );
+                }
+                // B-F free bit in BAM
+                else if (payload[2] == 'F')
+                {
+                    blockCommand( false );
+                }
                 // B-E block execute impossible at this level of emulation!
             }
             //Error(ERROR_31_SYNTAX_ERROR);
@@ -419,27 +460,34 @@ void iecDrive::iec_command()
             //Error(ERROR_31_SYNTAX_ERROR);	// DI, DR, DW not implemented yet
         break;
         case 'I':
-            // Initialize
+            // Initialize, directories are read fresh
             Debug_printv( "initialize");
+            listings.clear();
         break;
         case 'M':
-            if ( payload[1] == '-' ) // Memory
+            if ( payload[1] == '-' && payload.size() >= 5 ) // Memory, address follows
             {
                 if (payload[2] == 'R') // M-R memory read
                 {
                     payload = mstr::drop(payload, 3);
                     std::string code = mstr::toHex(payload);
                     uint16_t address = (payload[0] | payload[1] << 8);
-                    uint8_t size = payload[2];
+                    uint8_t size = (payload.size() > 2) ? payload[2] : 1;
                     Debug_printv("Memory Read [%s]", code.c_str());
                     Debug_printv("address[%.4X] size[%d]", address, size);
+
+                    response_queue.push(memory.read(address, size));
                 }
                 else if (payload[2] == 'W') // M-W memory write
                 {
                     payload = mstr::drop(payload, 3);
                     std::string code = mstr::toHex(payload);
                     uint16_t address = (payload[0] | payload[1] << 8);
+                    uint8_t size = (payload.size() > 3) ? std::min((size_t)(uint8_t)payload[2], payload.size() - 3) : 0;
                     Debug_printv("Memory Write address[%.4X][%s]", address, code.c_str());
+
+                    if ( memory.write(address, (const uint8_t *)payload.data() + 3, size) )
+                        Debug_printv("Upload crc[%.4X] loader[%s]", memory.crc(), DriveMemory::name(memory.detected()));
                 }
                 else if (payload[2] == 'E') // M-E memory execute
                 {
@@ -447,6 +495,13 @@ void iecDrive::iec_command()
                     std::string code = mstr::toHex(payload);
                     uint16_t address = (payload[0] | payload[1] << 8);
                     Debug_printv("Memory Execute address[%.4X][%s]", address, code.c_str());
+
+                    fastloader_t loader = memory.execute(address);
+                    if ( loader != FL_NONE )
+                    {
+                        device_protocol = fastloader_protocol(loader);
+                        Debug_printv("Fastloader [%s] protocol[%d]", DriveMemory::name(loader), device_protocol);
+                    }
                 }
             }
         break;
@@ -480,12 +535,35 @@ void iecDrive::iec_command()
                 Debug_printv("payload[%s] channel[%d] media[%d] track[%d] sector[%d]", payload.c_str(), pti[0], pti[1], pti[2], pti[3]);
 
                 auto stream = retrieveStream( pti[0] );
-                if ( stream )
+                if ( stream && flushStreamBuffer( pti[0] ) )
+                    stream->blockRead( pti[2], pti[3] );
+            }
+            else if (payload[1] == '2') // User 2
+            {
+                payload = mstr::drop(payload, 3);
+                mstr::trim(payload);
+                mstr::replaceAll(payload, "  ", " ");
+                pti = util_tokenize_uint8(payload);
+                Debug_printv("payload[%s] channel[%d] media[%d] track[%d] sector[%d]", payload.c_str(), pti[0], pti[1], pti[2], pti[3]);
+
+                auto stream = retrieveStream( pti[0] );
+                if ( stream && flushStreamBuffer( pti[0] ) )
                 {
-                    stream->seekSector( pti[2], pti[3] );
-                    stream->reset();
+                    if ( stream->blockWrite( pti[2], pti[3] ) )
+                        direct_dirty = true;
+                    else if ( stream->isWriteProtected() )
+                    {
+                        iecStatus.error = 26;
+                        iecStatus.msg = "write protect on";
+                    }
                 }
             }
+            else if (payload[1] == 'J' || payload[1] == ':') // Reset
+            {
+                // Drive code is gone, back to standard serial
+                memory.reset();
+                device_protocol = PROTOCOL_SERIAL;
+            }
         break;
         case 'V':
             Debug_printv( "validate bam");
@@ -651,6 +729,42 @@ void iecDrive::set_prefix()
 
 
 
+// B-A/B-F "drive track sector", works on the BAM of the open direct access channel
+bool iecDrive::blockCommand( bool allocate )
+{
+    payload = mstr::drop(payload, 3);
+    mstr::replaceAll(payload, ":", " ");
+    mstr::trim(payload);
+    mstr::replaceAll(payload, "  ", " ");
+    pti = util_tokenize_uint8(payload);
+    if ( pti.size() < 3 )
+        return false;
+
+    Debug_printv("payload[%s] allocate[%d] media[%d] track[%d] sector[%d]", payload.c_str(), allocate, pti[0], pti[1], pti[2]);
+
+    auto stream = ( direct_channel < 0 ) ? nullptr : retrieveStream( direct_channel );
+    if ( stream == nullptr )
+        return false;
+
+    if ( !stream->hasBAM() )
+    {
+        iecStatus.error = 31;
+        iecStatus.msg = "syntax error";
+        return false;
+    }
+
+    bool ok = allocate ? stream->blockAllocate( pti[1], pti[2] ) : stream->blockFree( pti[1], pti[2] );
+    if ( !ok )
+    {
+        iecStatus.error = 65;
+        iecStatus.msg = "no block";
+        return false;
+    }
+
+    direct_dirty = true;
+    return true;
+}
+
 // used to start working with a stream, registering it as underlying stream of some
 // IEC channel on some IEC device
 bool iecDrive::registerStream ( uint8_t channel )
@@ -684,6 +798,12 @@ bool iecDrive::registerStream ( uint8_t channel )
         new_stream = std::shared_ptr<MStream>(_base->getSourceStream(std::ios::out));
         new_stream->open();
     }
+    else if ( mstr::endsWith(_base->url, "#") )
+    {
+        // Direct access, U2 writes sectors back to the image
+        Debug_printv("DIRECT \"%s\"", _base->url.c_str());
+        new_stream = std::shared_ptr<MStream>(_base->getSourceStream(std::ios_base::in | std::ios_base::out));
+    }
     else
     {
         Debug_printv("OTHER \"%s\"", _base->url.c_str());
@@ -722,6 +842,12 @@ bool iecDrive::registerStream ( uint8_t channel )
     auto newPair = std::make_pair ( channel, new_stream );
     streams.insert ( newPair );
 
+    if ( mstr::endsWith(_base->url, "#") )
+    {
+        direct_channel = channel;
+        direct_image = _base->streamFile->url;
+    }
+
     Debug_printv("Stream created. key[%d] count[%d]", channel, streams.bucket_count());
     return true;
 }
@@ -750,13 +876,80 @@ bool iecDrive::closeStream ( uint8_t channel, bool close_all )
     {
         Debug_printv("Stream closed. key[%d] count[%d]", channel, streams.bucket_count());
         auto closingStream = (*found).second;
-        closingStream->close();
+
+        // The prefetch task may still be in a read, it closes the stream
+        // itself when that returns
+        auto buffer = streamBuffers.find(channel);
+        if ( buffer != streamBuffers.end() )
+        {
+            buffer->second->stopPrefetch();
+            buffer->second->closeSource();
+            streamBuffers.erase ( buffer );
+        }
+        else
+        {
+            closingStream->close();
+        }
+
+        if ( channel == direct_channel )
+        {
+            // Sectors are written out on close, list the image fresh
+            if ( direct_dirty )
+            {
+                ImageBroker::invalidate( direct_image );
+                listings.clear();
+            }
+            direct_channel = -1;
+            direct_dirty = false;
+        }
         return streams.erase ( channel );
     }
 
     return false;
 }
 
+std::shared_ptr<MBlockBuffer> iecDrive::retrieveStreamBuffer ( uint8_t channel )
+{
+    auto found = streamBuffers.find(channel);
+    if ( found != streamBuffers.end() )
+        return found->second;
+
+    // The direct access channel is read in place, see sendDirect()
+    if ( channel == direct_channel )
+        return nullptr;
+
+    auto stream = retrieveStream( channel );
+    if ( stream == nullptr )
+        return nullptr;
+
+    // Read ahead in the background if the source can stall, so network
+    // stalls don't stall the bus
+    auto buffer = std::make_shared<MBlockBuffer>( stream, stream->block_size, BLOCK_BUFFER_PREFETCH_BLOCKS );
+    buffer->startPrefetch();
+    streamBuffers.insert ( std::make_pair ( channel, buffer ) );
+    return buffer;
+}
+
+// Call before repositioning the stream, drops what was read ahead and
+// stops the prefetch task. False while the task is still in a read, the
+// buffer is kept until it is done so nothing else touches the stream
+bool iecDrive::flushStreamBuffer ( uint8_t channel )
+{
+    auto found = streamBuffers.find(channel);
+    if ( found == streamBuffers.end() )
+        return true;
+
+    found->second->stopPrefetch();
+    if ( found->second->busy() )
+    {
+        Debug_printv("Prefetch task busy, stream not flushed. channel[%d]", channel);
+        return false;
+    }
+
+    streamBuffers.erase ( found );
+    return true;
+}
+
 uint16_t iecDrive::retrieveLastByte ( uint8_t channel )
 {
     if ( streamLastByte.find ( channel ) != streamLastByte.end() )
@@ -783,25 +976,15 @@ void iecDrive::flushLastByte( uint8_t channel )
 
 
 
-// send single basic line, including heading basic pointer and terminating zero.
+// add single basic line to the listing, including heading basic pointer and terminating zero.
 uint16_t iecDrive::sendLine(uint16_t blocks, const char *format, ...)
 {
-    // Debug_printv("bus[%d]", IEC.state);
-
-    // Exit if ATN is PULLED while sending
-    // Exit if there is an error while sending
-    if ( IEC.state == BUS_ERROR )
-    {
-        // Save file pointer position
-        //streamUpdate(basicPtr);
-        //setDeviceStatus(74);
-        return 0;
-    }
-
     // Format our string
-    va_list args;
+    va_list args, length_args;
     va_start(args, format);
-    char text[vsnprintf(NULL, 0, format, args) + 1];
+    va_copy(length_args, args);
+    char text[vsnprintf(NULL, 0, format, length_args) + 1];
+    va_end(length_args);
     vsnprintf(text, sizeof text, format, args);
     va_end(args);
 
@@ -810,42 +993,9 @@ uint16_t iecDrive::sendLine(uint16_t blocks, const char *format, ...)
 
 uint16_t iecDrive::sendLine(uint16_t blocks, char *text)
 {
-    Serial.printf("%d %s ", blocks, text);
-
-    // Exit if ATN is PULLED while sending
-    // Exit if there is an error while sending
-    if ( IEC.flags & ERROR ) {Debug_printv("line[%s]", text); return 0;};
-
-    // Get text length
-    uint8_t len = strlen(text);
-
-    // Send that pointer
-    // No basic line pointer is used in the directory listing set to 0x0101
-    IEC.sendByte(0x01);		// IEC.sendByte(basicPtr bitand 0xFF);
-    if ( IEC.flags & ERROR ) {Debug_printv("line[%s]", text); return 0;};
-    IEC.sendByte(0x01);		// IEC.sendByte(basicPtr >> 8);
-    if ( IEC.flags & ERROR ) {Debug_printv("line[%s]", text); return 0;};
-
-    // Send blocks
-    IEC.sendByte(blocks bitand 0xFF);
-    if ( IEC.flags & ERROR ) {Debug_printv("line[%s]", text); return 0;};
-    IEC.sendByte(blocks >> 8);
-    if ( IEC.flags & ERROR ) {Debug_printv("line[%s]", text); return 0;};
-
-    // Send line contents
-    for (uint8_t i = 0; i < len; i++)
-    {
-        IEC.sendByte(text[i]);
-        if ( IEC.flags & ERROR ) {Debug_printv("line[%s]", text); return 0;};
-    }
+    Serial.printf("%d %s\r\n", blocks, text);
 
-    // Finish line
-    IEC.sendByte(0);
-    if ( IEC.flags & ERROR ) {Debug_printv("line[%s]", text); return 0;};
-
-    Serial.println("");
-    
-    return len + 5;
+    return _listing->line(blocks, text, strlen(text));
 } // sendLine
 
 uint16_t iecDrive::sendHeader(std::string header, std::string id)
@@ -871,7 +1021,6 @@ uint16_t iecDrive::sendHeader(std::string header, std::string id)
     //Debug_printv("header[%s] id[%s] space_cnt[%d]", header.c_str(), id.c_str(), space_cnt);
 
     byte_count += sendLine(0, CBM_REVERSE_ON "\"%*s%s%*s\" %s", space_cnt, "", header.c_str(), space_cnt, "", id.c_str());
-    if ( IEC.flags & ERROR ) return 0;
 
     //byte_count += sendLine(basicPtr, 0, "\x12\"%*s%s%*s\" %.02d 2A", space_cnt, "", PRODUCT_ID, space_cnt, "", device_config.device());
     //byte_count += sendLine(basicPtr, 0, CBM_REVERSE_ON "%s", header.c_str());
@@ -880,46 +1029,36 @@ uint16_t iecDrive::sendHeader(std::string header, std::string id)
     if (url.size())
     {
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, "[URL]");
-        if ( IEC.flags & ERROR ) return 0;
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, url.c_str());
-        if ( IEC.flags & ERROR ) return 0;
         sent_info = true;
     }
     if (path.size() > 1)
     {
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, "[PATH]");
-        if ( IEC.flags & ERROR ) return 0;
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, path.c_str());
-        if ( IEC.flags & ERROR ) return 0;
         sent_info = true;
     }
     if (archive.size() > 1)
     {
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, "[ARCHIVE]");
-        if ( IEC.flags & ERROR ) return 0;
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, archive.c_str());
-        if ( IEC.flags & ERROR ) return 0;
         sent_info = true;
     }
     if (image.size())
     {
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, "[IMAGE]");
-        if ( IEC.flags & ERROR ) return 0;
         byte_count += sendLine(0, "%*s\"%-*s\" NFO", 0, "", 19, image.c_str());
-        if ( IEC.flags & ERROR ) return 0;
         sent_info = true;
     }
     if (sent_info)
     {
         byte_count += sendLine(0, "%*s\"-------------------\" NFO", 0, "");
-        if ( IEC.flags & ERROR ) return 0;
     }
 
     // If SD Card is available ad we are at the root path show it as a directory at the top
     if (fnSDFAT.running() && _base->url.size() < 2)
     {
         byte_count += sendLine(0, "%*s\"SD\"               DIR", 3, "");
-        if ( IEC.flags & ERROR ) return 0;
     }
 
     return byte_count;
@@ -947,106 +1086,76 @@ uint16_t iecDrive::sendFooter()
     return byte_count;
 }
 
-void iecDrive::sendListing()
+std::shared_ptr<MListing> iecDrive::renderListing()
 {
-    Serial.printf("sendListing: [%s]\r\n=================================\r\n", _base->url.c_str());
-
     uint16_t byte_count = 0;
-    std::string extension = "dir";
 
-    std::unique_ptr<MFile> entry = std::unique_ptr<MFile>( _base->getNextFileInDir() );
+    // One entry reused for the whole directory
+    MDirEntry entry;
+    bool more = _base->readEntry(entry);
 
-    if(entry == nullptr) {
-        closeStream( commanddata.channel );
-
-        bool isOpen = registerStream(commanddata.channel);
-        if(isOpen) 
-        {
-            sendFile();
-        }
-        else
-        {
-            sendFileNotFound();
-        }
-        
-        return;
-    }
-
-    //fnLedStrip.startRainbow(300);
+    if(!more)
+        return nullptr;
 
-    // Send load address
-    IEC.sendByte(CBM_BASIC_START & 0xff);
-    IEC.sendByte((CBM_BASIC_START >> 8) & 0xff);
+    _listing = std::make_shared<MListing>(CBM_BASIC_START);
     byte_count += 2;
 
-    // If there has been a error don't try to send any more bytes
-    if ( IEC.flags & ERROR )
-    {
-        Debug_printv(":(");
-        return;
-    }
-
-    Serial.println("");
-
-    // Send Listing Header
+    // Listing Header
     if (_base->media_header.size() == 0)
     {
-        // Send device default listing header
+        // Device default listing header
         char buf[7] = { '\0' };
         sprintf(buf, "%.02d 2A", IEC.data.device);
         byte_count += sendHeader(PRODUCT_ID, buf);
-        if ( IEC.flags & ERROR ) return;
     }
     else
     {
-        // Send listing header from media file
-        if ( !entry->isPETSCII )
+        // Listing header from media file
+        if ( !entry.isPETSCII() )
             _base->media_header = mstr::toPETSCII2( _base->media_header );
 
         byte_count += sendHeader(_base->media_header.c_str(), _base->media_id.c_str());
-        if ( IEC.flags & ERROR ) return;
     }
 
-    // Send Directory Items
-    while(entry != nullptr)
+    // Directory Items
+    _listing->beginEntries();
+    while(more)
     {
-        if (!entry->isDirectory())
+        if (!entry.isDirectory())
         {
             // Get extension
-            if (entry->extension.length())
+            if (entry.extension[0])
             {
-                extension = entry->extension;
-
                 // TODO: Compatibility mode file extension
                 // // Change extension to PRG if it is non-standard
                 // std::string valid_extensions = "delseqprgusrrelcbm";
-                // if ( !mstr::contains(valid_extensions, extension.c_str()) )
-                //     extension = "prg";
+                // if ( !mstr::contains(valid_extensions, entry.extension) )
+                //     entry.setExtension("prg", 3);
             }
             else
             {
-                extension = "prg";
+                entry.setExtension("prg", 3);
             }
         }
         else
         {
-            extension = "dir";
+            entry.setExtension("dir", 3);
         }
 
-        // Don't show hidden folders or files
-        //Debug_printv("size[%d] name[%s]", entry->size(), entry->name.c_str());
-        std::string name = entry->name;
-        if ( !entry->isPETSCII )
+        // Name and extension become PETSCII in place
+        if ( !entry.isPETSCII() )
         {
-            name = mstr::toPETSCII2( entry->name );
-            extension = mstr::toPETSCII2(extension);
+            entry.name_length = U8Char::utf8ToPetscii({ entry.name, entry.name_length }, entry.name);
+            entry.name[entry.name_length] = '\0';
+            entry.extension[U8Char::utf8ToPetscii(entry.extension, entry.extension)] = '\0';
         }
-        //mstr::rtrimA0(name);
-        mstr::replaceAll(name, "\\", "/");
 
-        //uint32_t s = entry->size();
+        // Don't show hidden folders or files
+        //Debug_printv("size[%d] name[%s]", entry.size, entry.name);
+
+        //uint32_t s = entry.size;
         //uint32_t block_cnt = s / _base->media_block_size;
-        uint32_t block_cnt = entry->blocks();
+        uint32_t block_cnt = entry.blocks;
         // Debug_printv( "size[%d] blocks[%d] blocksz[%d]", s, block_cnt, _base->media_block_size );
         //if ( s > 0 && s < _base->media_block_size )
         //    block_cnt = 1;
@@ -1059,43 +1168,80 @@ void iecDrive::sendListing()
         if (block_cnt > 999)
             block_spc--;
 
-        uint8_t space_cnt = 21 - (name.size() + 5);
+        uint8_t space_cnt = 21 - (entry.name_length + 5);
         if (space_cnt > 21)
             space_cnt = 0;
 
-        if (name[0]!='.')
+        if (entry.name[0]!='.')
+            byte_count += sendLine(block_cnt, "%*s\"%s\"%*s %s", block_spc, "", entry.name, space_cnt, "", entry.extension);
+
+        more = _base->readEntry(entry);
+
+        //fnLedManager.toggle(eLed::LED_BUS);
+    }
+
+    _listing->endEntries();
+
+    // Listing Footer
+    byte_count += sendFooter();
+
+    // End program with two zeros after last line
+    _listing->finish();
+    byte_count += 2;
+
+    Serial.printf("\r\n=================================\r\n%d bytes rendered\r\n\r\n", byte_count);
+
+    return std::move(_listing);
+} // renderListing
+
+void iecDrive::sendListing()
+{
+    Serial.printf("sendListing: [%s]\r\n=================================\r\n", _base->url.c_str());
+
+    // The same directory listed again is sent from the listing rendered
+    // then, unless it has changed since
+    time_t stamp = _base->getLastWrite();
+    auto listing = listings.find( _base->url, stamp, time(nullptr) );
+    if ( listing == nullptr )
+    {
+        listing = renderListing();
+        if ( listing == nullptr )
         {
-            // Exit if ATN is PULLED while sending
-            // Exit if there is an error while sending
-            if ( IEC.state == BUS_ERROR )
+            // Not a directory after all
+            closeStream( commanddata.channel );
+
+            bool isOpen = registerStream(commanddata.channel);
+            if(isOpen) 
             {
-                // Save file pointer position
-                // streamUpdate(byte_count);
-                //setDeviceStatus(74);
-                return;
+                sendFile();
+            }
+            else
+            {
+                sendFileNotFound();
             }
 
-            byte_count += sendLine(block_cnt, "%*s\"%s\"%*s %s", block_spc, "", name.c_str(), space_cnt, "", extension.c_str());
-            if ( IEC.flags & ERROR ) return;
+            return;
         }
 
-        entry.reset(_base->getNextFileInDir());
-
-        //fnLedManager.toggle(eLed::LED_BUS);
+        listings.store( _base->url, stamp, time(nullptr), listing );
+    }
+    else
+    {
+        Debug_printv("cached listing size[%d] hits[%d] misses[%d]", (int)listing->size(), listings.hits(), listings.misses());
     }
 
-    // Send Listing Footer
-    byte_count += sendFooter();
-    if ( IEC.flags & ERROR ) return;
-
-    // End program with two zeros after last line. Last zero goes out as EOI.
-    IEC.sendByte(0);
-    IEC.sendByte(0, true);
-    //closeStream();
+    if ( listing_filter.size() )
+        listing = listing->filter( listing_filter );
 
-    Serial.printf("\r\n=================================\r\n%d bytes sent\r\n\r\n", byte_count);
+    // Out through the channel's block buffer like any other file, the
+    // last zero goes out as EOI
+    closeStream( commanddata.channel );
+    auto stream = std::make_shared<MListingStream>( listing );
+    stream->url = _base->url;
+    streams.insert( std::make_pair( commanddata.channel, stream ) );
 
-    //fnLedManager.set(eLed::LED_BUS, false);
+    //fnLedStrip.startRainbow(300);
+    sendFile();
     //fnLedStrip.stopRainbow();
 } // sendListing
 
@@ -1107,7 +1253,6 @@ bool iecDrive::sendFile()
     bool success_tx = true;
 
     uint8_t b;  // byte
-//    uint8_t nb; // next byte
     uint8_t bi = 0;
     uint16_t load_address = 0;
     uint16_t sys_address = 0;
@@ -1119,13 +1264,17 @@ bool iecDrive::sendFile()
 
     // std::shared_ptr<MStream> istream = std::static_pointer_cast<MStream>(currentStream);
     auto istream = retrieveStream(commanddata.channel);
-    if ( istream == nullptr )
+    if ( istream != nullptr && commanddata.channel == direct_channel )
+        return sendDirect(istream);
+
+    auto ibuffer = retrieveStreamBuffer(commanddata.channel);
+    if ( istream == nullptr || ibuffer == nullptr )
     {
         sendFileNotFound();
         return false;
     }
 
-    Debug_printv("size[%d] avail[%d] pos[%d]", istream->size(), istream->available(), istream->position());
+    Debug_printv("size[%d] avail[%d] pos[%d] buffered[%d]", istream->size(), istream->available(), ibuffer->position(), ibuffer->buffered());
 
     if ( !_base->isDirectory() )
     {
@@ -1147,20 +1296,26 @@ bool iecDrive::sendFile()
     //_base->dump();
 
     bool eoi = false;
-    uint32_t size = istream->size();
-    uint32_t avail = istream->available();
+    uint32_t size = ibuffer->size();
 
     //fnLedStrip.startRainbow(300);
 
-    if( commanddata.channel == CHANNEL_LOAD && istream->position() == 0 )
+    if( commanddata.channel == CHANNEL_LOAD && ibuffer->position() == 0 )
     {
         // Get/Send file load address
-        istream->read(&b, 1);
-        success_tx = IEC.sendByte(b);
-        load_address = b & 0x00FF; // low byte
-        istream->read(&b, 1);
-        success_tx = IEC.sendByte(b);
-        load_address = load_address | b << 8;  // high byte
+        const uint8_t *data;
+        for ( uint8_t i = 0; i < 2 && success_tx; i++ )
+        {
+            while ( ibuffer->peek(&data) == 0 && !ibuffer->eos() && !ibuffer->error() && !(IEC.flags & ATN_PULLED) )
+                ibuffer->fill();
+            if ( ibuffer->peek(&data) == 0 )
+                break;
+
+            b = data[0];
+            success_tx = IEC.sendByte(b);
+            ibuffer->consume(1);
+            load_address = (i == 0) ? (b & 0x00FF) : (load_address | b << 8);
+        }
         sys_address = load_address;
         Serial.printf( "load_address[$%.4X] sys_address[%d]", load_address, sys_address );
 
@@ -1168,77 +1323,86 @@ bool iecDrive::sendFile()
     }
 
 
-    Serial.printf("\r\nsendFile: [$%.4X] pos[%d]\r\n=================================\r\n", load_address, istream->position());
-    while( success_rx && !istream->error() )
+    Serial.printf("\r\nsendFile: [$%.4X] pos[%d]\r\n=================================\r\n", load_address, ibuffer->position());
+    while( success_rx && success_tx && !eoi )
     {
-        //Debug_printv("b[%02X] nb[%02X] success_rx[%d] error[%d] count[%d] avail[%d]", b, nb, success_rx, istream->error(), count, avail);
-#ifdef DATA_STREAM
-        if (bi == 0)
-        {
-            Serial.printf(":%.4X ", load_address);
-            load_address += 8;
-        }
-#endif
-
-        // Read byte
-        success_rx = istream->read(&b, 1);
-        //Debug_printv("b[%02X] success[%d]", b, success_rx);
+        // Top up the ring, the source is only touched once per block
+        ibuffer->fill();
 
-        count = istream->position();
-        avail = istream->available();
-
-        if ( istream->error() )
-        {
-            Debug_printv("Error reading stream.");
-            break;
-        }
-        else if ( istream->eos() )
+        const uint8_t *data;
+        size_t len = ibuffer->peek(&data);
+        if ( len == 0 )
         {
-            eoi = true;
-        }
+            // No data available yet, keep asking unless ATN is pulled
+            if ( !ibuffer->eos() && !ibuffer->error() )
+            {
+                if ( IEC.flags & ATN_PULLED )
+                    break;
+                continue;
+            }
 
-        // Send Byte
-        success_tx = IEC.sendByte(b, eoi);
-        if ( !success_tx )
-        {
-            Debug_printv("Error sending byte.")
+            // Nothing left to send
+            success_rx = false;
             break;
         }
 
-        // Exit if ATN is PULLED while sending
-        if ( !eoi && IEC.flags & ATN_PULLED )
+        // Send contiguous run
+        size_t i = 0;
+        for ( ; i < len; i++ )
         {
-            //IEC.pull ( PIN_IEC_SRQ );
-            //Serial.println();
-            //Debug_printv("ATN pulled while sending. b[%.2X]", b);
+            b = data[i];
+            eoi = ibuffer->isLast(i);
+
+#ifdef DATA_STREAM
+            if (bi == 0)
+            {
+                Serial.printf(":%.4X ", load_address);
+                load_address += 8;
+            }
+#endif
+
+            // Send Byte
+            success_tx = IEC.sendByte(b, eoi);
+            if ( !success_tx )
+            {
+                Debug_printv("Error sending byte.")
+                break;
+            }
+
+            // Exit if ATN is PULLED while sending
+            if ( !eoi && IEC.flags & ATN_PULLED )
+            {
 #ifdef DATA_STREAM
-            Serial.printf("[atn]\r\n");
+                Serial.printf("[atn]\r\n");
 #endif
+                // Byte was not taken, it stays in the buffer for the next TALK
+                break;
+            }
 
-            // Save file pointer position
-            istream->seek( -1, SEEK_CUR);
-            //IEC.release ( PIN_IEC_SRQ );
-            break;
+#ifdef DATA_STREAM
+            // Show ASCII Data
+            if (b < 32 || b >= 127)
+                ba[bi++] = 46;
+            else
+                ba[bi++] = b;
+
+            if(bi == 8)
+            {
+                Serial.printf(" %s (%d)\r\n", ba, ibuffer->position() + i + 1);
+                bi = 0;
+            }
+#endif
         }
 
+        bool atn = ( i < len && success_tx );
+        ibuffer->consume( i );
+        count = ibuffer->position();
+
+#ifndef DATA_STREAM
         uint32_t t = 0;
         if ( size )
             t = (count * 100) / size;
-
-#ifdef DATA_STREAM
-        // Show ASCII Data
-        if (b < 32 || b >= 127)
-            ba[bi++] = 46;
-        else
-            ba[bi++] = b;
-
-        if(bi == 8)
-        {
-            Serial.printf(" %s (%d %d%%) [%d]\r\n", ba, count, t, avail);
-            bi = 0;
-        }
-#else
-        Serial.printf("\rTransferring %d%% [%d, %d]      ", t, count, avail);
+        Serial.printf("\rTransferring %d%% [%d, %d]      ", t, count, ibuffer->buffered());
 #endif
 
         // // Toggle LED
@@ -1247,21 +1411,18 @@ bool iecDrive::sendFile()
         // 	fnLedManager.toggle(eLed::LED_BUS);
         // }
 
-        if ( eoi )
-        {
+        if ( atn )
             break;
-        }
     }
 
 
-    Serial.printf("=================================\r\n%d bytes sent of %d [SYS%d]\r\n\r\n", count, size, sys_address);
-
-    //Debug_printv("len[%d] avail[%d] success_rx[%d]", len, avail, success_rx);
+    Serial.printf("=================================\r\n%d bytes sent of %d [SYS%d]\r\n", count, size, sys_address);
+    Serial.printf("prefetch depth[%d] level[%d] underruns[%d]\r\n\r\n", ibuffer->depth(), ibuffer->buffered(), ibuffer->underruns());
 
     //fnLedManager.set(eLed::LED_BUS, false);
     //fnLedStrip.stopRainbow();
 
-    if ( istream->error() || !success_tx )
+    if ( ibuffer->error() || !success_tx )
     {
         Serial.println("sendFile: Transfer aborted!");
         IEC.senderTimeout();
@@ -1271,6 +1432,45 @@ bool iecDrive::sendFile()
     return success_rx;
 } // sendFile
 
+// GET# on the direct access channel, a byte at a time from the sector
+// buffer so the position is where B-P and PRINT# expect it
+bool iecDrive::sendDirect( std::shared_ptr<MStream> istream )
+{
+    uint32_t count = 0;
+    bool success_tx = true;
+    bool eoi = false;
+
+    while ( success_tx && !eoi )
+    {
+        uint8_t b;
+        uint32_t pos = istream->position();
+        if ( istream->read(&b, 1) != 1 )
+            break;
+
+        eoi = ( istream->available() == 0 );
+        success_tx = IEC.sendByte(b, eoi);
+
+        // Exit if ATN is PULLED while sending
+        if ( success_tx && !eoi && IEC.flags & ATN_PULLED )
+        {
+            // Byte was not taken, it is sent again on the next TALK
+            istream->position(pos);
+            break;
+        }
+        count++;
+    }
+
+    Debug_printv("%d bytes sent pos[%d]", count, istream->position());
+
+    if ( count == 0 || !success_tx )
+    {
+        IEC.senderTimeout();
+        return false;
+    }
+
+    return true;
+} // sendDirect
+
 
 bool iecDrive::saveFile()
 {
@@ -1371,6 +1571,9 @@ bool iecDrive::saveFile()
 
     Serial.printf("=================================\r\n%d bytes saved\r\n", i);
 
+    // The new file has to show up in the next listing
+    listings.clear();
+
     // TODO: Handle errorFlag
 
     return success;
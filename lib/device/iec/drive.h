@@ -11,7 +11,11 @@
 #include "../meatloaf/meatloaf.h"
 #include "../meatloaf/meat_buffer.h"
 #include "../meatloaf/wrappers/iec_buffer.h"
+#include "../meatloaf/wrappers/block_buffer.h"
 #include "../meatloaf/wrappers/directory_stream.h"
+#include "../meatloaf/wrappers/listing_cache.h"
+
+#include "fastloader.h"
 
 #include "dos/_dos.h"
 #include "dos/cbmdos.2.5.h"
@@ -42,19 +46,35 @@ protected:
     bool registerStream (uint8_t channel);
     std::shared_ptr<MStream> retrieveStream ( uint8_t channel );
     bool closeStream ( uint8_t channel, bool close_all = false );
+    std::shared_ptr<MBlockBuffer> retrieveStreamBuffer ( uint8_t channel );
+    bool flushStreamBuffer ( uint8_t channel );
     uint16_t retrieveLastByte ( uint8_t channel );
     void storeLastByte( uint8_t channel, char last);
     void flushLastByte( uint8_t channel );
 
-    // Directory
+    // Direct access ("#") channel of the mounted image, for B-A/B-F
+    int16_t direct_channel = -1;
+    std::string direct_image;       // Image url, so listings can be refreshed
+    bool direct_dirty = false;      // U2/B-A/B-F changed the image
+    bool blockCommand( bool allocate );
+
+    // Drive RAM as M-W/M-E see it, to recognise uploaded fastloaders
+    DriveMemory memory;
+
+    // Directory, the lines go into _listing and the whole listing is sent with sendFile()
+    MListingCache listings;
+    std::shared_ptr<MListing> _listing;
+    std::string listing_filter;     // "pattern=type" from LOAD"$:pattern=type"
     uint16_t sendHeader(std::string header, std::string id);
     uint16_t sendLine(uint16_t blocks, char *text);
     uint16_t sendLine(uint16_t blocks, const char *format, ...);
     uint16_t sendFooter();
+    std::shared_ptr<MListing> renderListing();
     void sendListing();
 
     // File
     bool sendFile();
+    bool sendDirect( std::shared_ptr<MStream> istream );
     bool saveFile();
     void sendFileNotFound();
 
@@ -177,6 +197,7 @@ public:
     //mediatype_t disktype() { return _disk == nullptr ? MEDIATYPE_UNKNOWN : _disk->_mediatype; };
 
     std::unordered_map<uint16_t, std::shared_ptr<MStream>> streams;
+    std::unordered_map<uint16_t, std::shared_ptr<MBlockBuffer>> streamBuffers;
     std::unordered_map<uint16_t, uint16_t> streamLastByte;
 
     ~iecDrive();
@@ -0,0 +1,235 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "fastloader.h"
+
+#include <cstring>
+
+// CRC of the uploaded code, as sd2iec computes it (avr-libc _crc16_update)
+static uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (int i = 0; i < 8; i++)
+        crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    return crc;
+}
+
+struct fastloader_crc_t {
+    uint16_t crc;
+    fastloader_t loader;
+};
+
+// CRCs of the M-W uploads of known loaders, from sd2iec
+static const fastloader_crc_t fl_crc_table[] = {
+    { 0x9c9f, FL_TURBODISK },
+    { 0xdab0, FL_FC3_LOAD },            // Final Cartridge III
+    { 0x973b, FL_FC3_LOAD },            // Final Cartridge III variation
+    { 0x7e38, FL_FC3_LOAD },            // EXOS v3
+    { 0x1b30, FL_FC3_SAVE },            // really early CRC; lots of C64 code at the end
+    { 0x8b0e, FL_FC3_SAVE },            // variation
+    { 0x9930, FL_FC3_FREEZED },
+    { 0x2e69, FL_DREAMLOAD },
+    { 0xdd81, FL_ULOAD3 },
+    { 0x393e, FL_ELOAD1 },
+    { 0x5a01, FL_EPYXCART },
+    { 0x4d79, FL_GEOS_S23_1541 },       // GEOS 64 1541 stage 2
+    { 0xb2bc, FL_GEOS_S23_1541 },       // GEOS 128 1541 stage 2
+    { 0xb272, FL_GEOS_S23_1541 },       // GEOS 64/128 1541 stage 3 (Configure)
+    { 0xdaed, FL_GEOS_S23_1571 },       // GEOS 64/128 1571 stage 3 (Configure)
+    { 0x3f8d, FL_GEOS_S23_1581 },       // GEOS 64/128 1581 Configure 2.0
+    { 0xc947, FL_GEOS_S23_1581 },       // GEOS 64/128 1581 Configure 2.1
+    { 0xf140, FL_WHEELS_S1_64 },        // Wheels 64 stage 1
+    { 0x737e, FL_WHEELS_S1_128 },       // Wheels 128 stage 1
+    { 0x755a, FL_WHEELS_S2 },           // Wheels 64 1541 stage 2
+    { 0x2920, FL_WHEELS_S2 },           // Wheels 128 1541 stage 2
+    { 0x18e9, FL_WHEELS_S2 },           // Wheels 64 1571
+    { 0x9804, FL_WHEELS_S2 },           // Wheels 64 1581
+    { 0x48f5, FL_WHEELS_S2 },           // Wheels 64 FD native partition
+    { 0x1356, FL_WHEELS_S2 },           // Wheels 64 FD emulation partition
+    { 0xe885, FL_WHEELS_S2 },           // Wheels 64 HD native partition
+    { 0x4eca, FL_WHEELS_S2 },           // Wheels 64 HD emulation partition
+    { 0xdbf6, FL_WHEELS_S2 },           // Wheels 128 1571
+    { 0xe4ab, FL_WHEELS_S2 },           // Wheels 128 1581
+    { 0x6de5, FL_WHEELS_S2 },           // Wheels 128 FD native
+    { 0x30ff, FL_WHEELS_S2 },           // Wheels 128 FD emulation
+    { 0x46e7, FL_WHEELS_S2 },           // Wheels 128 HD native
+    { 0x2253, FL_WHEELS_S2 },           // Wheels 128 HD emulation
+    { 0xc26a, FL_WHEELS44_S2 },         // Wheels 64/128 4.4 1541
+    { 0x550c, FL_WHEELS44_S2 },         // Wheels 64/128 4.4 1571
+    { 0x825b, FL_WHEELS44_S2_1581 },    // Wheels 64/128 4.4 1581
+    { 0x245b, FL_WHEELS44_S2_1581 },
+    { 0x7021, FL_WHEELS44_S2_1581 },
+    { 0xd537, FL_WHEELS44_S2_1581 },
+    { 0xf635, FL_WHEELS44_S2_1581 },
+    { 0x43c1, FL_NIPPON },
+    { 0x4870, FL_AR6_1581_LOAD },
+    { 0x2925, FL_AR6_1581_SAVE },
+};
+
+struct fastloader_exec_t {
+    uint16_t address;
+    fastloader_t loader;
+};
+
+// Where each loader is started with M-E. An upload with a known CRC
+// started anywhere else is something else that happens to match.
+static const fastloader_exec_t fl_exec_table[] = {
+    { 0x0303, FL_TURBODISK },
+    { 0x059a, FL_FC3_LOAD },            // FC3
+    { 0x0400, FL_FC3_LOAD },            // EXOS
+    { 0x059c, FL_FC3_SAVE },
+    { 0x059a, FL_FC3_SAVE },            // variation
+    { 0x0403, FL_FC3_FREEZED },
+    { 0x0700, FL_DREAMLOAD },
+    { 0x0336, FL_ULOAD3 },
+    { 0x0300, FL_ELOAD1 },
+    { 0x0500, FL_GI_JOE },
+    { 0x01a9, FL_EPYXCART },
+    { 0x03e2, FL_GEOS_S23_1541 },
+    { 0x03dc, FL_GEOS_S23_1541 },
+    { 0x03ff, FL_GEOS_S23_1571 },
+    { 0x040f, FL_GEOS_S23_1581 },
+    { 0x0400, FL_WHEELS_S1_64 },
+    { 0x0400, FL_WHEELS_S1_128 },
+    { 0x0300, FL_WHEELS_S2 },
+    { 0x0400, FL_WHEELS44_S2 },
+    { 0x0300, FL_WHEELS44_S2_1581 },
+    { 0x0500, FL_WHEELS44_S2_1581 },
+    { 0x0300, FL_NIPPON },
+    { 0x0500, FL_AR6_1581_LOAD },
+    { 0x05f4, FL_AR6_1581_SAVE },
+};
+
+struct drive_magic_t {
+    uint16_t address;
+    uint8_t value[2];
+};
+
+// ROM bytes some programs read to check for a 1541
+static const drive_magic_t c1541_magics[] = {
+    { 0xfea0, { 0x0d, 0xed } },         // DreamLoad and ULoad Model 3
+    { 0xe5c6, { 0x34, 0xb1 } },         // DreamLoad and ULoad Model 3
+    { 0xfffe, { 0x00, 0x00 } },         // disables the AR6 fastloader
+};
+
+bool DriveMemory::write(uint16_t address, const uint8_t *data, uint8_t length)
+{
+    // Device address change, 1541 style, and attempts to speed up
+    // the VIA timer aren't code
+    if (address == 119 || address == 0x1c06 || address == 0x1c07)
+        return false;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        _crc = crc16_update(_crc, data[i]);
+
+        // Identical code, but lots of different upload variations
+        if (_crc == 0x38a2 && data[i] == 0x60)
+            _detected = FL_GI_JOE;
+
+        uint16_t a = address + i;
+        if (a < DRIVE_RAM_SIZE)
+            _ram[a] = data[i];
+    }
+
+    for (auto &entry : fl_crc_table)
+    {
+        if (entry.crc == _crc)
+        {
+            _detected = entry.loader;
+            break;
+        }
+    }
+
+    return true;
+}
+
+std::string DriveMemory::read(uint16_t address, uint8_t length)
+{
+    std::string data;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        uint16_t a = address + i;
+        uint8_t value = 0;
+
+        if (a < DRIVE_RAM_SIZE)
+            value = _ram[a];
+        else
+        {
+            for (auto &magic : c1541_magics)
+            {
+                if (a == magic.address || a == magic.address + 1)
+                    value = magic.value[a - magic.address];
+            }
+        }
+        data += (char)value;
+    }
+    return data;
+}
+
+fastloader_t DriveMemory::execute(uint16_t address)
+{
+    fastloader_t loader = FL_NONE;
+    for (auto &entry : fl_exec_table)
+    {
+        if (entry.address == address && entry.loader == _detected)
+        {
+            loader = entry.loader;
+            break;
+        }
+    }
+
+    // The next upload starts afresh
+    _crc = 0xFFFF;
+    _detected = FL_NONE;
+    return loader;
+}
+
+void DriveMemory::reset()
+{
+    memset(_ram, 0, sizeof(_ram));
+    _crc = 0xFFFF;
+    _detected = FL_NONE;
+}
+
+const char *DriveMemory::name(fastloader_t loader)
+{
+    switch (loader)
+    {
+    case FL_TURBODISK:        return "Turbodisk";
+    case FL_FC3_LOAD:         return "Final Cartridge III load";
+    case FL_FC3_SAVE:         return "Final Cartridge III save";
+    case FL_FC3_FREEZED:      return "Final Cartridge III freezed";
+    case FL_DREAMLOAD:        return "Dreamload";
+    case FL_ULOAD3:           return "ULoad Model 3";
+    case FL_ELOAD1:           return "ELoad";
+    case FL_GI_JOE:           return "GI Joe";
+    case FL_EPYXCART:         return "Epyx Fastload";
+    case FL_GEOS_S23_1541:    return "GEOS 1541";
+    case FL_GEOS_S23_1571:    return "GEOS 1571";
+    case FL_GEOS_S23_1581:    return "GEOS 1581";
+    case FL_WHEELS_S1_64:     return "Wheels 64 stage 1";
+    case FL_WHEELS_S1_128:    return "Wheels 128 stage 1";
+    case FL_WHEELS_S2:        return "Wheels stage 2";
+    case FL_WHEELS44_S2:      return "Wheels 4.4";
+    case FL_WHEELS44_S2_1581: return "Wheels 4.4 1581";
+    case FL_NIPPON:           return "Nippon";
+    case FL_AR6_1581_LOAD:    return "Action Replay 6 1581 load";
+    case FL_AR6_1581_SAVE:    return "Action Replay 6 1581 save";
+    default:                  return "none";
+    }
+}
@@ -0,0 +1,104 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// Fastloader detection, after sd2iec's doscmd.c
+// https://github.com/sd2iec/sd2iec
+
+#ifndef FASTLOADER_H
+#define FASTLOADER_H
+
+#include <cstdint>
+#include <string>
+
+#define DRIVE_RAM_SIZE 0x0800       // 1541 RAM, $0000-$07FF
+
+typedef enum {
+    FL_NONE,
+    FL_TURBODISK,
+    FL_FC3_LOAD,
+    FL_FC3_SAVE,
+    FL_FC3_FREEZED,
+    FL_DREAMLOAD,
+    FL_ULOAD3,
+    FL_ELOAD1,
+    FL_GI_JOE,
+    FL_EPYXCART,
+    FL_GEOS_S23_1541,
+    FL_GEOS_S23_1571,
+    FL_GEOS_S23_1581,
+    FL_WHEELS_S1_64,
+    FL_WHEELS_S1_128,
+    FL_WHEELS_S2,
+    FL_WHEELS44_S2,
+    FL_WHEELS44_S2_1581,
+    FL_NIPPON,
+    FL_AR6_1581_LOAD,
+    FL_AR6_1581_SAVE,
+} fastloader_t;
+
+/**
+ * @class DriveMemory
+ * @brief Shadow of the 1541's RAM as the computer sees it through
+ *        M-W, M-R and M-E.
+ *
+ * Drive code uploaded with M-W is kept, and a CRC-16 runs over it in
+ * the order it was sent. When M-E starts it, the CRC and the start
+ * address are looked up in the table of known fastloaders.
+ */
+class DriveMemory
+{
+public:
+    /**
+     * @brief M-W, returns false for writes that aren't uploaded code
+     *        (device address change, VIA timer)
+     */
+    bool write(uint16_t address, const uint8_t *data, uint8_t length);
+
+    /**
+     * @brief M-R, RAM from the shadow and the ROM bytes programs
+     *        check to see they are talking to a 1541
+     */
+    std::string read(uint16_t address, uint8_t length);
+
+    /**
+     * @brief M-E, the fastloader that starts at address, if the code
+     *        uploaded since the last M-E is one we know
+     */
+    fastloader_t execute(uint16_t address);
+
+    /**
+     * @brief Any other command ends an upload
+     */
+    void command() { _crc = 0xFFFF; }
+
+    /**
+     * @brief Drive reset
+     */
+    void reset();
+
+    uint16_t crc() { return _crc; }
+    fastloader_t detected() { return _detected; }
+
+    static const char *name(fastloader_t loader);
+
+private:
+    uint8_t _ram[DRIVE_RAM_SIZE] = { 0 };
+    uint16_t _crc = 0xFFFF;
+    fastloader_t _detected = FL_NONE;       // by CRC, confirmed by M-E
+};
+
+#endif // FASTLOADER_H
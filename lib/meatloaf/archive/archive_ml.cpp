@@ -2,9 +2,14 @@
 #include "archive_ml.h"
 
 #include <string.h>
+#include <algorithm>
 #include <archive.h>
 #include <archive_entry.h>
 
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
 #include "../meatloaf.h"
 
 /* Returns pointer and size of next block of data from archive. */
@@ -46,8 +51,13 @@ int64_t cb_skip(struct archive *a, void *userData, int64_t request)
 
     if (streamData->srcStream->isOpen())
     {
-        bool rc = streamData->srcStream->seek(request, SEEK_CUR);
-        return (rc) ? request : ARCHIVE_WARN;
+        // Never past the end
+        auto &src = streamData->srcStream;
+        if (request > src->size() - src->position())
+            request = src->size() - src->position();
+
+        bool rc = src->seek(src->position() + request);
+        return (rc) ? request : 0;
     }
     else
     {
@@ -63,8 +73,20 @@ int64_t cb_seek(struct archive *a, void *userData, int64_t offset, int whence)
 
     if (streamData->srcStream->isOpen())
     {
-        bool rc = streamData->srcStream->seek(offset, whence);
-        return (rc) ? offset : ARCHIVE_WARN;
+        // libarchive wants the new absolute position back, SEEK_END comes
+        // with a negative offset when it looks for the ZIP central directory
+        auto &src = streamData->srcStream;
+        int64_t target = offset;
+        if (whence == SEEK_CUR)
+            target += src->position();
+        else if (whence == SEEK_END)
+            target += src->size();
+
+        if (target < 0 || target > src->size())
+            return ARCHIVE_FATAL;
+
+        bool rc = src->seek(target);
+        return (rc) ? target : ARCHIVE_FATAL;
     }
     else
     {
@@ -90,6 +112,72 @@ int cb_open(struct a *arch, void *userData)
 }
 
 
+/********************************************************
+ * Member cache
+ ********************************************************/
+
+ArchiveMember::ArchiveMember(uint32_t size)
+{
+#ifdef ESP_PLATFORM
+    data = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (data == nullptr)
+#endif
+    data = (uint8_t *)malloc(size);
+
+    if (data != nullptr)
+        this->size = size;
+}
+
+ArchiveMember::~ArchiveMember()
+{
+    free(data);
+}
+
+std::list<ArchiveMemberCache::Member> ArchiveMemberCache::members;
+size_t ArchiveMemberCache::total = 0;
+std::mutex ArchiveMemberCache::mutex;
+
+std::shared_ptr<ArchiveMember> ArchiveMemberCache::obtain(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = members.begin(); it != members.end(); ++it)
+    {
+        if (it->first == key)
+        {
+            members.splice(members.begin(), members, it);
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+void ArchiveMemberCache::store(const std::string &key, std::shared_ptr<ArchiveMember> data)
+{
+    // Freed when this returns, outside the lock
+    std::list<Member> evicted;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    members.emplace_front(key, data);
+    total += data->size;
+
+    // Streams still reading an evicted member keep their own reference
+    while (total > ARCHIVE_MEMBER_CACHE_SIZE && members.size() > 1)
+    {
+        total -= members.back().second->size;
+        evicted.splice(evicted.begin(), members, std::prev(members.end()));
+    }
+}
+
+void ArchiveMemberCache::clear()
+{
+    std::list<Member> evicted;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    evicted.swap(members);
+    total = 0;
+}
+
+
 /********************************************************
  * Streams implementations
  ********************************************************/
@@ -99,9 +187,6 @@ ArchiveMStream::ArchiveMStream(std::shared_ptr<MStream> srcStr)
     // it should be possible to to pass a password parameter here and somehow
     // call archive_passphrase_callback(password) from here, right?
     streamData.srcStream = srcStr;
-    a = archive_read_new();
-    archive_read_support_filter_all(a);
-    archive_read_support_format_all(a);
     streamData.srcBuffer = new uint8_t[buffSize];
 
     open();
@@ -119,10 +204,15 @@ bool ArchiveMStream::open()
 {
     if (!is_open)
     {
-        // TODO enable seek only if the stream is random access
+        a = archive_read_new();
+        archive_read_support_filter_all(a);
+        archive_read_support_format_all(a);
+
+        // With a seek callback libarchive reads a ZIP through its central
+        // directory and seeks straight to a member instead of streaming up to it
         archive_read_set_read_callback(a, cb_read);
         archive_read_set_seek_callback(a, cb_seek);
-        //archive_read_set_skip_callback(a, cb_skip);
+        archive_read_set_skip_callback(a, cb_skip);
         archive_read_set_close_callback(a, cb_close);
         // archive_read_set_open_callback(mpa->arch, cb_open); - what does it do?
         archive_read_set_callback_data(a, &streamData);
@@ -133,6 +223,11 @@ bool ArchiveMStream::open()
         //int r = archive_read_open2(a, &streamData, NULL, myRead, myskip, myclose);
         if (r == ARCHIVE_OK)
             is_open = true;
+        else
+        {
+            archive_read_free(a);
+            a = nullptr;
+        }
     }
     return is_open;
 };
@@ -143,6 +238,7 @@ void ArchiveMStream::close()
     {
         archive_read_close(a);
         archive_read_free(a);
+        a = nullptr;
         is_open = false;
     }
     Debug_printv("Close called");
@@ -157,7 +253,16 @@ uint32_t ArchiveMStream::read(uint8_t *buf, uint32_t size)
 {
     Debug_printv("calling read, buff size=[%d]", size);
 
-    int r = archive_read_data(a, &buf, size);
+    if (member_data != nullptr)
+    {
+        if (size > available())
+            size = available();
+        memcpy(buf, member_data->data + _position, size);
+        _position += size;
+        return size;
+    }
+
+    int r = archive_read_data(a, buf, size);
 
     Debug_printv("archive returned [%d] unarchived bytes", r);
     if ( r >= 0 ) {
@@ -237,7 +342,12 @@ bool ArchiveMStream::seekEntry( std::string filename )
                 if ( found )
                 {
                     _size = archive_entry_size(entry);
-                    
+                    _position = 0;
+
+                    // Seeked in before? Then it is already decompressed
+                    member = archive_entry_pathname(entry);
+                    member_data = ArchiveMemberCache::obtain(streamData.srcStream->url + "/" + member);
+
                     return true;
                 }
             }
@@ -263,7 +373,106 @@ bool ArchiveMStream::seekEntry( std::string filename )
 
 bool ArchiveMStream::seek(uint32_t pos)
 {
-    return streamData.srcStream->seek(pos);
+    if (member.empty())
+        return streamData.srcStream->seek(pos);
+
+    if (pos > _size)
+        return false;
+
+    if (member_data != nullptr || pos == _position)
+    {
+        _position = pos;
+        return true;
+    }
+
+    // A member that gets seeked in is about to be read randomly (a disk
+    // image), decompress it once instead of once per backward seek
+    if (loadMember())
+    {
+        _position = pos;
+        return true;
+    }
+
+    return skipTo(pos);
+}
+
+// Start the archive over, at the same member
+bool ArchiveMStream::rewind()
+{
+    std::string path = member;
+
+    close();
+    if (!streamData.srcStream->seek(0) || !open())
+        return false;
+
+    while (archive_read_next_header(a, &entry) == ARCHIVE_OK)
+    {
+        if (path == archive_entry_pathname(entry))
+        {
+            _position = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ArchiveMStream::loadMember()
+{
+    if (_size > ARCHIVE_MEMBER_CACHE_SIZE)
+        return false;
+
+    // Not enough memory left is not an error, skipTo streams up to pos instead
+    auto data = std::make_shared<ArchiveMember>(_size);
+    if (!data->valid())
+    {
+        Debug_printv("Can't allocate member[%s] size[%d]", member.c_str(), _size);
+        return false;
+    }
+
+    if (_position > 0 && !rewind())
+        return false;
+
+    uint32_t count = 0;
+    while (count < _size)
+    {
+        int r = archive_read_data(a, data->data + count, _size - count);
+        if (r <= 0)
+            break;
+        count += r;
+    }
+
+    if (count != _size)
+    {
+        Debug_printv("Short member[%s] size[%d] read[%d]", member.c_str(), _size, count);
+        rewind();
+        return false;
+    }
+
+    Debug_printv("Decompressed member[%s] size[%d]", member.c_str(), _size);
+    ArchiveMemberCache::store(streamData.srcStream->url + "/" + member, data);
+    member_data = data;
+    return true;
+}
+
+// Too big to keep, decompress up to pos and throw that away
+bool ArchiveMStream::skipTo(uint32_t pos)
+{
+    if (pos < _position && !rewind())
+        return false;
+
+    // srcBuffer still belongs to libarchive
+    std::vector<uint8_t> scratch(std::min<uint32_t>(pos - _position, buffSize));
+    while (_position < pos)
+    {
+        uint32_t n = std::min<uint32_t>(pos - _position, scratch.size());
+        int r = archive_read_data(a, scratch.data(), n);
+        if (r <= 0)
+            return false;
+        _position += r;
+    }
+
+    return true;
 }
 
 /********************************************************
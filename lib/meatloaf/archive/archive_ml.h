@@ -9,11 +9,24 @@
 #include <archive.h>
 #include <archive_entry.h>
 
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "../meatloaf.h"
 
 #include "../../../include/debug.h"
 
-// TODO: check how we can use archive_seek_callback, archive_passphrase_callback etc. to our benefit!
+// TODO: check how we can use archive_passphrase_callback etc. to our benefit!
+
+#ifndef ARCHIVE_MEMBER_CACHE_SIZE
+#ifdef BOARD_HAS_PSRAM
+#define ARCHIVE_MEMBER_CACHE_SIZE (1024 * 1024) // decompressed members kept for random access, PSRAM boards
+#else
+#define ARCHIVE_MEMBER_CACHE_SIZE (48 * 1024)   // internal RAM only, a D64 is streamed instead
+#endif
+#endif
 
 /* Returns pointer and size of next block of data from archive. */
 // The read callback returns the number of bytes read, zero for end-of-file, or a negative failure code as above.
@@ -47,10 +60,60 @@ public:
     std::shared_ptr<MStream> srcStream = nullptr; // a stream that is able to serve bytes of this archive
 };
 
+/********************************************************
+ * ArchiveMember
+ *
+ * One decompressed member. Allocated with malloc rather
+ * than new, so running out of memory leaves data null
+ * instead of aborting, and the stream goes on without it.
+ ********************************************************/
+
+class ArchiveMember {
+public:
+    uint8_t *data = nullptr;
+    uint32_t size = 0;
+
+    ArchiveMember(uint32_t size);
+    ~ArchiveMember();
+
+    bool valid() { return data != nullptr; }
+};
+
+/********************************************************
+ * ArchiveMemberCache
+ *
+ * A member that gets seeked in (a D64 inside a ZIP) is
+ * decompressed once, then served from memory. Kept by
+ * archive url and member path, the least recently used
+ * goes once the total is over ARCHIVE_MEMBER_CACHE_SIZE.
+ * Shared by every task that opens archives, so it is
+ * locked; evicted members are freed after unlocking.
+ ********************************************************/
+
+class ArchiveMemberCache {
+    typedef std::pair<std::string, std::shared_ptr<ArchiveMember>> Member;
+    static std::list<Member> members;
+    static size_t total;
+    static std::mutex mutex;
+
+public:
+    static std::shared_ptr<ArchiveMember> obtain(const std::string &key);
+    static void store(const std::string &key, std::shared_ptr<ArchiveMember> data);
+    static void clear();
+};
+
 class ArchiveMStream : public MStream
 {
     bool is_open = false;
 
+    // Member found by seekPath
+    std::string member;
+    std::shared_ptr<ArchiveMember> member_data; // whole member once it has been seeked in
+
+    bool rewind();
+    bool loadMember();
+    bool skipTo(uint32_t pos);
+
 public:
     static const size_t buffSize = 4096;
     ArchiveMStreamData streamData;
@@ -63,6 +126,7 @@ public:
     bool open() override;
     void close() override;
     bool isOpen() override;
+    bool canBlock() override { return true; };
 
     uint32_t read(uint8_t *buf, uint32_t size) override;
     uint32_t write(const uint8_t *buf, uint32_t size) override;
@@ -205,6 +205,7 @@ bool LBRMFile::rewindDirectory()
     auto image = ImageBroker::obtain<LBRMStream>(streamFile->url);
     if (image == nullptr)
         Debug_printv("image pointer is null");
+    dir_image = image;
 
     image->resetEntryCounter();
 
@@ -230,8 +231,8 @@ MFile *LBRMFile::getNextFileInDir()
     if (!dirIsOpen)
         rewindDirectory();
 
-    // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<LBRMStream>(streamFile->url);
+    // Held since rewindDirectory(), so it isn't let go in the middle of the listing
+    auto image = dir_image;
 
     if (image->seekNextImageEntry())
     {
@@ -248,6 +249,7 @@ MFile *LBRMFile::getNextFileInDir()
     {
         // Debug_printv( "END OF DIRECTORY");
         dirIsOpen = false;
+        dir_image.reset();
         return nullptr;
     }
 }
@@ -24,6 +24,8 @@ public:
         loadEntries();
     };
 
+    size_t footprint() override { return sizeof(*this) + directory_index.bytes() + entries.capacity() * sizeof(Entry); }
+
 protected:
     struct Header {
         std::string disk_name;
@@ -102,6 +104,9 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+
+private:
+    std::shared_ptr<LBRMStream> dir_image;  // the image being listed, while dirIsOpen
 };
 
 
@@ -45,6 +45,7 @@ public:
         partitions.clear();
         partitions.push_back(p);
         sectorsPerTrack = { 136 };
+        cbm_bam = false;
 
         uint32_t size = containerStream->size();
         switch (size + media_header_size) 
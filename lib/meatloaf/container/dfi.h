@@ -135,6 +135,7 @@ public:
         partitions.clear();
         partitions.push_back(p);
         sectorsPerTrack = { 256 };
+        cbm_bam = false;
 
         // // The header's size is 256 bytes, that's exactly one sector. The header is
         // // always the first sector in the image (track 1, sector 0).
@@ -31,7 +31,8 @@ MFile* FlashMFileSystem::getFile(std::string path)
 
 bool FlashMFile::pathValid(std::string path) 
 {
-    auto apath = std::string(basepath + path).c_str();
+    std::string full_path = basepath + path;
+    auto apath = full_path.c_str();
     while (*apath) {
         const char *slash = strchr(apath, '/');
         if (!slash) {
@@ -79,7 +80,8 @@ MStream* FlashMFile::getDecodedStream(std::shared_ptr<MStream> is) {
 time_t FlashMFile::getLastWrite()
 {
     struct stat info;
-    stat( std::string(basepath + path).c_str(), &info);
+    if ( stat( std::string(basepath + path).c_str(), &info) != 0 )
+        return 0;
 
     time_t ftime = info.st_mtime; // Time of last modification
     return ftime;
@@ -88,7 +90,8 @@ time_t FlashMFile::getLastWrite()
 time_t FlashMFile::getCreationTime()
 {
     struct stat info;
-    stat( std::string(basepath + path).c_str(), &info);
+    if ( stat( std::string(basepath + path).c_str(), &info) != 0 )
+        return 0;
 
     time_t ftime = info.st_ctime; // Time of last status change
     return ftime;
@@ -193,6 +196,7 @@ void FlashMFile::closeDir()
 {
     if(dirOpened) {
         closedir( dir );
+        dir = nullptr;
         dirOpened = false;
     }
 }
@@ -201,7 +205,10 @@ void FlashMFile::closeDir()
 bool FlashMFile::rewindDirectory()
 {
     _valid = false;
-    rewinddir( dir );
+    if (dirOpened)
+        rewinddir( dir );
+    else
+        openDir(std::string(basepath + path).c_str());
 
     // // Skip the . and .. entries
     // struct dirent* dirent = NULL;
@@ -242,6 +249,63 @@ MFile* FlashMFile::getNextFileInDir()
 }
 
 
+bool FlashMFile::readEntry(MDirEntry &entry)
+{
+    if(!dirOpened)
+        openDir(std::string(basepath + path).c_str());
+
+    if(dir == nullptr)
+        return false;
+
+    struct dirent* dirent = NULL;
+    do
+    {
+        dirent = readdir( dir );
+    } while ( dirent != NULL && dirent->d_name[0] == '.' ); // Skip hidden files
+
+    if ( dirent == NULL )
+    {
+        closeDir();
+        return false;
+    }
+
+    size_t length = strlen(dirent->d_name);
+    entry.setName(dirent->d_name, length);
+
+    // Extension is whatever follows the last dot, as PeoplesUrlParser has it
+    const char *dot = strrchr(dirent->d_name, '.');
+    if (dot != nullptr)
+        entry.setExtension(dot + 1, length - (dot + 1 - dirent->d_name));
+    else
+        entry.setExtension("", 0);
+
+    // Only the path buffer's capacity is kept between entries
+    _entry_path = basepath;
+    _entry_path += path;
+    if (path != "/")
+        _entry_path += '/';
+    _entry_path += dirent->d_name;
+
+    struct stat info;
+    entry.flags = 0;
+    entry.size = 0;
+    if (stat(_entry_path.c_str(), &info) == 0)
+    {
+        if (S_ISDIR(info.st_mode))
+            entry.flags |= MDirEntry::DIRECTORY;
+        else
+            entry.size = info.st_size;
+    }
+
+    if (entry.size > 0 && entry.size < media_block_size)
+        entry.blocks = 1;
+    else
+        entry.blocks = entry.size / media_block_size;
+
+    return true;
+}
+
+
 bool FlashMFile::seekEntry( std::string filename )
 {
     std::string apath = (basepath + pathToFile()).c_str();
@@ -338,8 +402,8 @@ bool FlashMStream::open() {
         handle->obtain(localPath, "a+");
 
     // The below code will definitely destroy whatever open above does, because it will move the file pointer
-    // so I just wrapped it to be called only for in
-    if(isOpen() && mode == std::ios_base::in) {
+    // so I just wrapped it to be called only for in (and r+, which starts at 0 too)
+    if(isOpen() && (mode & std::ios_base::in) && !(mode & (std::ios_base::app | std::ios_base::trunc))) {
         //Debug_printv("IStream: past obtain");
         // Set file size
         fseek(handle->file_h, 0, SEEK_END);
@@ -1,4 +1,3 @@
-#ifndef TEST_NATIVE
 #ifndef MEATLOAF_DEVICE_FLASH
 #define MEATLOAF_DEVICE_FLASH
 
@@ -64,6 +63,7 @@ public:
 
     bool rewindDirectory() override;
     MFile* getNextFileInDir() override;
+    bool readEntry(MDirEntry &entry) override;
     bool mkDir() override;
     bool exists() override;
     bool remove() override;
@@ -76,7 +76,7 @@ public:
     bool seekEntry( std::string filename );
 
 protected:
-    DIR* dir;
+    DIR* dir = nullptr;
     bool dirOpened = false;
 
 private:
@@ -85,6 +85,7 @@ private:
 
     bool _valid;
     std::string _pattern;
+    std::string _entry_path;    // reused by readEntry() to stat each entry
 
     bool pathValid(std::string path);
 };
@@ -158,5 +159,4 @@ protected:
 
 
 
-#endif // MEATLOAF_DEVICE_FLASH
-#endif // TEST_NATIVE
\ No newline at end of file
+#endif // MEATLOAF_DEVICE_FLASH
\ No newline at end of file
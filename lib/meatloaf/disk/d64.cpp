@@ -8,44 +8,30 @@
 
 bool D64MStream::seekBlock(uint64_t index, uint8_t offset)
 {
-    uint16_t sectorOffset = 0;
-    uint8_t track = 0;
-
     // Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
 
     // Determine actual track & sector from index
-    do
-    {
-        track++;
-        uint8_t count = getSectorCount(track);
-        if (sectorOffset + count < index)
-            sectorOffset += count;
-        else
-            break;
-
-        // Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", track, speedZone(track), count, sectorOffset);
-    } while (true);
-    uint8_t sector = index - sectorOffset;
+    auto &map = trackMap();
+    uint8_t track = map.track(index);
+    uint8_t sector = index - map.block(track, 0);
 
     this->block = index;
     this->track = track;
     this->sector = sector;
 
-    // Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
+    // Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), map.block(track, 0));
 
     return containerStream->seek((index * block_size) + offset);
 }
 
 bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
 {
-    uint16_t sectorOffset = 0;
-
     //Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
 
     // Is this a valid track?
-    uint16_t c = partitions[partition].block_allocation_map.size() - 1;
+    auto &map = trackMap();
     uint8_t start_track = partitions[partition].block_allocation_map[0].start_track;
-    uint8_t end_track = partitions[partition].block_allocation_map[c].end_track;
+    uint8_t end_track = map.endTrack();
     if (track < start_track || track > end_track)
     {
         Debug_printv("Invalid Track: track[%d] start_track[%d] end_track[%d]", track, start_track, end_track);
@@ -53,21 +39,14 @@ bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
     }
 
     // Is this a valid sector?
-    c = getSectorCount(track);
+    uint16_t c = map.sectors(track);
     if (sector > c)
     {
         Debug_printv("Invalid Sector: sector[%d] sectorsPerTrack[%d]", sector, c);
         return false;
     }
 
-    track--;
-    for (uint8_t index = 0; index < track; ++index)
-    {
-        sectorOffset += getSectorCount(index + 1);
-        //Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", (index + 1), speedZone(index), getSectorCount(index + 1), sectorOffset);
-    }
-    track++;
-    sectorOffset += sector;
+    uint32_t sectorOffset = map.block(track, sector);
 
     this->block = sectorOffset;
     this->track = track;
@@ -83,117 +62,303 @@ bool D64MStream::seekSector(std::vector<uint8_t> trackSectorOffset)
     return seekSector(trackSectorOffset[0], trackSectorOffset[1], trackSectorOffset[2]);
 }
 
-std::string D64MStream::readBlock(uint8_t track, uint8_t sector)
+bool D64MStream::readBlock(uint8_t track, uint8_t sector, uint8_t *buf)
 {
-    return "";
+    auto &map = trackMap();
+    if (track < 1 || track > map.endTrack() || sector >= map.sectors(track))
+        return false;
+
+    // Changes that haven't been written out yet win
+    auto found = dirty_blocks.find(map.block(track, sector));
+    if (found != dirty_blocks.end())
+    {
+        memcpy(buf, found->second.data(), block_size);
+        return true;
+    }
+
+    if (!seekSector(track, sector))
+        return false;
+
+    return containerStream->read(buf, block_size) == block_size;
 }
 
-bool D64MStream::writeBlock(uint8_t track, uint8_t sector, std::string data)
+bool D64MStream::writeBlock(uint8_t track, uint8_t sector, const uint8_t *buf)
 {
+    auto &map = trackMap();
+    if (track < 1 || track > map.endTrack() || sector >= map.sectors(track))
+        return false;
+
+    dirty_blocks[map.block(track, sector)].assign(buf, buf + block_size);
+
+    // The directory or the BAM might have changed
+    directory_index.clear();
+    return true;
+}
+
+bool D64MStream::loadBAM()
+{
+    auto &p = partitions[partition];
+    if (!p.bam.empty())
+        return true;
+
+    // Other layouts are read by blocksFree() only, and CBM BAM sectors are 256 bytes
+    if (!cbm_bam || block_size != 256)
+    {
+        Debug_printv("BAM layout not supported");
+        return false;
+    }
+
+    auto &map = trackMap();
+    std::vector<std::bitset<256>> bam(map.endTrack() + 1);
+    uint8_t buf[256];
+
+    for (auto &b : p.block_allocation_map)
+    {
+        if (!readBlock(b.track, b.sector, buf))
+        {
+            Debug_printv("Can't read BAM track[%d] sector[%d]", b.track, b.sector);
+            return false;
+        }
+
+        // Bitmap follows the free count, one bit per sector, 1 is free
+        uint8_t skip = (b.byte_count > 3) ? 1 : 0;
+        for (uint16_t t = b.start_track; t <= b.end_track && t <= map.endTrack(); t++)
+        {
+            uint16_t offset = b.offset + ((t - b.start_track) * b.byte_count) + skip;
+            for (uint16_t s = 0; s < map.sectors(t) && (s >> 3) < (b.byte_count - skip); s++)
+                bam[t][s] = (buf[offset + (s >> 3)] >> (s & 7)) & 1;
+        }
+    }
+
+    p.bam = bam;
+    p.bam_dirty = false;
+    return true;
+}
+
+bool D64MStream::writeBAM()
+{
+    auto &p = partitions[partition];
+    if (!p.bam_dirty || !cbm_bam)
+        return true;
+
+    auto &map = trackMap();
+    uint8_t buf[256];
+    uint8_t counts[256];
+
+    for (auto &b : p.block_allocation_map)
+    {
+        if (!readBlock(b.track, b.sector, buf))
+            return false;
+
+        if (b.count_track && !readBlock(b.count_track, b.count_sector, counts))
+            return false;
+
+        uint8_t skip = (b.byte_count > 3) ? 1 : 0;
+        for (uint16_t t = b.start_track; t <= b.end_track && t <= map.endTrack(); t++)
+        {
+            uint16_t offset = b.offset + ((t - b.start_track) * b.byte_count);
+            uint8_t free_count = p.bam[t].count();
+
+            if (skip)
+                buf[offset] = free_count;
+            else if (b.count_track)
+                counts[b.count_offset + (t - b.start_track)] = free_count;
+
+            for (uint16_t s = 0; s < map.sectors(t) && (s >> 3) < (b.byte_count - skip); s++)
+            {
+                uint8_t bit = 1 << (s & 7);
+                if (p.bam[t][s])
+                    buf[offset + skip + (s >> 3)] |= bit;
+                else
+                    buf[offset + skip + (s >> 3)] &= ~bit;
+            }
+        }
+
+        writeBlock(b.track, b.sector, buf);
+        if (b.count_track)
+            writeBlock(b.count_track, b.count_sector, counts);
+    }
+
+    p.bam_dirty = false;
     return true;
 }
 
 bool D64MStream::allocateBlock(uint8_t track, uint8_t sector)
 {
-    // int offset;
-    // byte bitmask;
+    if (!isBlockFree(track, sector))
+        return false;
 
-    // offset = (track-1) * 4 + 4;							// offset to correct Track-Info
-    // if (bam->GetRawSector()[offset] > 0)
-    // {
-    // 	bam->GetRawSector()[offset] -= 1;				// reduce free Sectors
-    // }
-    // offset++;											// Move to Bitmask
-    // offset += (sector >> 3);							// move to the correct byte (sector div 8)
-    // bitmask = (byte)(1 << (sector % 8));				// generate Bitmask for Sector
-    // if ((bam->GetRawSector()[offset] & bitmask) == 0)	// was already set to 'used' ?
-    // {
-    // 	return false;
-    // }
-    // bitmask ^= 255;										// invert bitmask (0 means "Sector is used")
-    // bam->GetRawSector()[offset] &= bitmask;				// clear bit in BAM
-    // WriteSector(bam);									// Write back to Image
+    auto &p = partitions[partition];
+    p.bam[track][sector] = false;
+    p.bam_dirty = true;
+    directory_index.blocks_free = -1;
     return true;
 }
 
 bool D64MStream::deallocateBlock(uint8_t track, uint8_t sector)
 {
-    // int offset;
-    // byte bitmask;
+    auto &map = trackMap();
+    if (!loadBAM() || track < 1 || track > map.endTrack() || sector >= map.sectors(track))
+        return false;
 
-    // offset = (track - 1) * 4 + 4;						// offset to correct Track-Info
-    // bam->GetRawSector()[offset] += 1;					// increase free Sectors
-    // offset++;											// Move to Bitmask
-    // offset += (sector >> 3);							// move to the correct byte (sector div 8)
-    // bitmask = (byte)(1 << (sector % 8));				// generate Bitmask for Sector
-    // if ((bam->GetRawSector()[offset] & bitmask) == 1)	// Sector already free ?
-    // {
-    // 	return false;
-    // }
-    // bam->GetRawSector()[offset] |= bitmask;				// clear bit in BAM (1 means "Sector is free")
-    // WriteSector(bam);									// Write back to Image
+    auto &p = partitions[partition];
+    if (p.bam[track][sector])
+        return false; // already free
+
+    p.bam[track][sector] = true;
+    p.bam_dirty = true;
+    directory_index.blocks_free = -1;
     return true;
 }
 
-bool D64MStream::getNextFreeBlock(uint8_t startTrack, uint8_t startSector, uint8_t *foundTrack, uint8_t *foundSector)
+bool D64MStream::isBlockFree(uint8_t track, uint8_t sector)
 {
-    uint8_t track, sector;
-    bool found = false;
-    bool wrapped = false;
-    track = startTrack;
+    auto &map = trackMap();
+    if (!loadBAM() || track < 1 || track > map.endTrack() || sector >= map.sectors(track))
+        return false;
 
-    sector = startSector;
-    while (!found)
+    return partitions[partition].bam[track][sector];
+}
+
+size_t D64MStream::footprint()
+{
+    size_t total = sizeof(*this) + directory_index.bytes();
+    total += direct_buffer.capacity() + file_blocks.capacity() * sizeof(file_blocks[0]);
+    for (auto &p : partitions)
     {
-        if (!isBlockFree(track, sector))
+        total += sizeof(p) + p.bam.capacity() * sizeof(p.bam[0]);
+        total += p.block_allocation_map.capacity() * sizeof(p.block_allocation_map[0]);
+    }
+
+    // Writes held back, with a map node each
+    total += dirty_blocks.size() * (block_size + 4 * sizeof(void *));
+    return total;
+}
+
+bool D64MStream::flush()
+{
+    if (!writeBAM())
+        return false;
+
+    // One pass in disk order
+    bool ok = true;
+    for (auto it = dirty_blocks.begin(); it != dirty_blocks.end();)
+    {
+        if (!containerStream->seek(it->first * block_size) ||
+            containerStream->write(it->second.data(), block_size) != block_size)
         {
-            if (sector == startSector && track == startTrack)
-            {
-                sector++; // Skip StartSector
-                if (wrapped)
-                {
-                    break; // already wrapped, exit (no free sector found)
-                }
-            }
-            else
-            {
-                sector++;
-            }
+            Debug_printv("Error writing block[%d]", it->first);
+            ok = false;
+            ++it;
+            continue;
+        }
+        it = dirty_blocks.erase(it);
+    }
 
-            if (sector > getSectorCount(track))
-            {
-                track++;
-                sector = 0;
-                if (track > getTrackCount())
-                {
-                    track = 1; // Start from the beginning
-                    wrapped = true;
-                }
-            }
+    return ok;
+}
+
+void D64MStream::close()
+{
+    flush();
+    MMediaStream::close();
+}
+
+uint16_t D64MStream::readContainer(uint8_t *buf, uint16_t size)
+{
+    if (dirty_blocks.empty())
+        return MMediaStream::readContainer(buf, size);
+
+    // Read around sectors that have been written but not flushed
+    uint16_t count = 0;
+    while (count < size)
+    {
+        uint32_t position = containerStream->position();
+        uint32_t offset = position % block_size;
+        uint16_t length = std::min<uint32_t>(size - count, block_size - offset);
+
+        auto found = dirty_blocks.find(position / block_size);
+        if (found != dirty_blocks.end())
+        {
+            memcpy(buf + count, found->second.data() + offset, length);
+            containerStream->seek(position + length);
         }
         else
         {
-            found = true;
+            length = containerStream->read(buf + count, length);
+            if (!length)
+                break;
         }
+        count += length;
     }
-    *foundTrack = track;
-    *foundSector = sector;
-    return found;
+
+    return count;
 }
 
-bool D64MStream::isBlockFree(uint8_t track, uint8_t sector)
+/********************************************************
+ * Direct access
+ ********************************************************/
+
+uint32_t D64MStream::read(uint8_t *buf, uint32_t size)
+{
+    if (!direct_access)
+        return MMediaStream::read(buf, size);
+
+    // B-P moves _position around in the buffer
+    if (_position >= direct_buffer.size())
+        return 0;
+    if (size > direct_buffer.size() - _position)
+        size = direct_buffer.size() - _position;
+
+    memcpy(buf, direct_buffer.data() + _position, size);
+    _position += size;
+    return size;
+}
+
+uint32_t D64MStream::write(const uint8_t *buf, uint32_t size)
 {
-    // int offset;
-    // byte bitmask;
+    if (!direct_access)
+        return MMediaStream::write(buf, size);
 
-    // offset = (track-1) * 4 + 4;                 // offset to correct Track-Info
-    // offset++;									// Move to Bitmask
-    // offset += (sector >> 3);                    // move to the correct byte (sector div 8)
-    // bitmask = (byte)(1 << (sector % 8));        // generate Bitmask for Sector
-    // return (bam->GetRawSector()[offset] & bitmask) == bitmask;
+    if (_position >= direct_buffer.size())
+        return 0;
+    if (size > direct_buffer.size() - _position)
+        size = direct_buffer.size() - _position;
+
+    memcpy(direct_buffer.data() + _position, buf, size);
+    _position += size;
+    return size;
+}
+
+bool D64MStream::blockRead(uint8_t track, uint8_t sector)
+{
+    if (!readBlock(track, sector, direct_buffer.data()))
+        return false;
+
+    _position = 0;
+    _size = block_size;
     return true;
 }
 
+bool D64MStream::blockWrite(uint8_t track, uint8_t sector)
+{
+    // Would only be dropped at flush()
+    if (write_protected)
+        return false;
+
+    return writeBlock(track, sector, direct_buffer.data());
+}
+
+bool D64MStream::blockAllocate(uint8_t track, uint8_t sector)
+{
+    return allocateBlock(track, sector);
+}
+
+bool D64MStream::blockFree(uint8_t track, uint8_t sector)
+{
+    return deallocateBlock(track, sector);
+}
+
 bool D64MStream::seekEntry(std::string filename)
 {
     uint16_t index = 1;
@@ -203,39 +368,46 @@ bool D64MStream::seekEntry(std::string filename)
     // Read Directory Entries
     if (filename.size())
     {
-        while (seekEntry(index))
+        if (directory_index.complete && !wildcard)
+        {
+            // Whole directory is indexed, look the name up
+            auto found = directory_index.lookup.find(filename);
+            if (found != directory_index.lookup.end())
+                return seekEntry(found->second);
+        }
+        else
         {
-            std::string entryFilename = entry.filename;
-            uint8_t i = entryFilename.find_first_of(0xA0);
-            entryFilename = entryFilename.substr(0, i);
-            //mstr::rtrimA0(entryFilename);
-            entryFilename = mstr::toUTF8(entryFilename);
+            while (seekEntry(index))
+            {
+                // Names are decoded once, when the entry is indexed
+                std::string entryFilename = (index <= directory_index.count()) ? directory_index.names[index - 1] : entryName();
 
-            Debug_printv("index[%d] track[%d] sector[%d] filename[%s] entry.filename[%.16s]", index, track, sector, filename.c_str(), entryFilename.c_str());
+                Debug_printv("index[%d] track[%d] sector[%d] filename[%s] entry.filename[%.16s]", index, track, sector, filename.c_str(), entryFilename.c_str());
 
-            // Debug_printv("filename[%s] entry[%s]", filename.c_str(), entryFilename.c_str());
+                // Debug_printv("filename[%s] entry[%s]", filename.c_str(), entryFilename.c_str());
 
-            if (filename == entryFilename) // Match exact
-            {
-                return true;
-            }
-            else if (wildcard) // Wildcard Match
-            {
-                if (filename == "*") // Match first PRG
+                if (filename == entryFilename) // Match exact
+                {
+                    return true;
+                }
+                else if (wildcard) // Wildcard Match
                 {
-                    if (entry.file_type & 0b00000111)
+                    if (filename == "*") // Match first PRG
+                    {
+                        if (entry.file_type & 0b00000111)
+                        {
+                            filename = entryFilename;
+                            return true;
+                        }
+                    }
+                    else if (mstr::compare(filename, entryFilename)) // X?XX?X* Wildcard match
                     {
-                        filename = entryFilename;
                         return true;
                     }
                 }
-                else if (mstr::compare(filename, entryFilename)) // X?XX?X* Wildcard match
-                {
-                    return true;
-                }
-            }
 
-            index++;
+                index++;
+            }
         }
 
         Debug_printv("File not found!");
@@ -251,6 +423,17 @@ bool D64MStream::seekEntry(std::string filename)
 
 bool D64MStream::seekEntry(uint16_t index)
 {
+    // Once every directory sector has been read the index has it all
+    if (directory_index.complete)
+    {
+        if (index == 0 || index > directory_index.count())
+            return false;
+
+        memcpy(&entry, directory_index.entry(index), sizeof(entry));
+        entry_index = index;
+        return true;
+    }
+
     // Calculate Sector offset & Entry offset
     // 8 Entries Per Sector, 32 bytes Per Entry
     index--;
@@ -295,7 +478,12 @@ bool D64MStream::seekEntry(uint16_t index)
         if (entryOffset == 0)
         {
             if (next_track == 0)
+            {
+                // End of the chain, and we saw every entry on the way
+                if (index == directory_index.count())
+                    directory_index.complete = true;
                 return false;
+            }
 
             // Debug_printv("Follow link track[%d] sector[%d] entryOffset[%d]", next_track, next_sector, entryOffset);
             if (!seekSector(next_track, next_sector, entryOffset))
@@ -317,13 +505,38 @@ bool D64MStream::seekEntry(uint16_t index)
     // if ( next_track == 0 && next_sector == 0xFF )
     entry_index = index + 1;
 
+    if (entry_index == directory_index.count() + 1)
+        directory_index.add((uint8_t *)&entry, sizeof(entry), entryName(), entry.start_track, entry.start_sector);
+
     return true;
 }
 
+std::string D64MStream::entryName()
+{
+    std::string name(entry.filename, sizeof(entry.filename));
+    name = name.substr(0, name.find_first_of(std::string("\xA0\0", 2))); // padded or empty
+    return mstr::toUTF8(name);
+}
+
 uint16_t D64MStream::blocksFree()
 {
+    if (directory_index.blocks_free >= 0)
+        return directory_index.blocks_free;
+
     uint16_t free_count = 0;
 
+    // Count what has been allocated since the BAM was loaded
+    auto &p = partitions[partition];
+    if (!p.bam.empty())
+    {
+        for (uint16_t t = 1; t < p.bam.size(); t++)
+            if (t != p.directory_track)
+                free_count += p.bam[t].count();
+
+        directory_index.blocks_free = free_count;
+        return free_count;
+    }
+
     for (uint8_t x = 0; x < partitions[partition].block_allocation_map.size(); x++)
     {
         uint8_t bam[partitions[partition].block_allocation_map[x].byte_count];
@@ -360,6 +573,7 @@ uint16_t D64MStream::blocksFree()
         }
     }
 
+    directory_index.blocks_free = free_count;
     return free_count;
 }
 
@@ -380,6 +594,10 @@ uint16_t D64MStream::readFile(uint8_t *buf, uint16_t size)
     if (size > available())
         size = available();
 
+    // Stop at the end of this block, the next one starts with its own link
+    if (size > block_size - (sector_offset % block_size))
+        size = block_size - (sector_offset % block_size);
+
     if (size > 0)
     {
         bytesRead += readContainer(buf, size);
@@ -388,8 +606,8 @@ uint16_t D64MStream::readFile(uint8_t *buf, uint16_t size)
         if (sector_offset % block_size == 0)
         {
             // We are at the end of the block
-            // Follow track/sector link to move to next block
-            if (!seekSector(next_track, next_sector))
+            // Follow track/sector link to move to next block, unless this was the last one
+            if (next_track && !seekSector(next_track, next_sector))
             {
                 return 0;
             }
@@ -405,6 +623,45 @@ uint16_t D64MStream::readFile(uint8_t *buf, uint16_t size)
     return bytesRead;
 }
 
+bool D64MStream::seek(uint32_t pos)
+{
+    // Whole image
+    if (!seekCalled || direct_access)
+        return MMediaStream::seek(pos);
+
+    if (file_blocks.empty())
+        return false;
+
+    if (pos >= _size)
+    {
+        _position = _size;
+        return true;
+    }
+
+    // Follow the chain as far as this block, only the first time
+    uint16_t data_size = block_size - 2;
+    uint32_t index = pos / data_size;
+    uint8_t link[2];
+    while (file_blocks.size() <= index)
+    {
+        auto &last = file_blocks.back();
+        if (!seekSector(last.first, last.second) || readContainer(link, 2) != 2 || link[0] == 0)
+            return false;
+        file_blocks.push_back({ link[0], link[1] });
+    }
+
+    auto &b = file_blocks[index];
+    if (!seekSector(b.first, b.second) || readContainer(link, 2) != 2)
+        return false;
+
+    next_track = link[0];
+    next_sector = link[1];
+    sector_offset = 2 + (pos % data_size);
+    _position = pos;
+
+    return seekSector(b.first, b.second, sector_offset);
+}
+
 bool D64MStream::seekPath(std::string path)
 {
     // Implement this to skip a queue of file streams to start of file by name
@@ -423,7 +680,8 @@ bool D64MStream::seekPath(std::string path)
     {
         Debug_printv("Direct Access Mode track[1] sector[0] path[%s]", path.c_str());
         seekCalled = false;
-        return seekSector(1, 0);
+        direct_access = true;
+        return blockRead(1, 0);
     }
     else if (seekEntry(path))
     {
@@ -431,13 +689,27 @@ bool D64MStream::seekPath(std::string path)
         auto type = decodeType(entry.file_type).c_str();
         Debug_printv("filename[%.16s] type[%s] start_track[%d] start_sector[%d]", entry.filename, type, entry.start_track, entry.start_sector);
 
-        // Calculate file size
+        // Calculate file size, following the chain only the first time
         uint8_t t = entry.start_track;
         uint8_t s = entry.start_sector;
-        _size = seekFileSize(t, s);
+        MMediaIndex::File *file = nullptr;
+        if (entry_index > 0 && entry_index <= directory_index.count())
+            file = &directory_index.files[entry_index - 1];
+
+        if (file != nullptr && file->size)
+        {
+            _size = file->size;
+        }
+        else
+        {
+            _size = seekFileSize(t, s);
+            if (file != nullptr)
+                file->size = _size;
+        }
 
         // Set position to beginning of file
         bool r = seekSector(t, s);
+        file_blocks.assign(1, { t, s });
 
         Debug_printv("File Size: blocks[%d] size[%d] available[%d] r[%d]", entry.blocks, _size, available(), r);
 
@@ -471,6 +743,7 @@ bool D64MFile::rewindDirectory()
     auto image = ImageBroker::obtain<D64MStream>(streamFile->url);
     if (image == nullptr)
         Debug_printv("image pointer is null");
+    dir_image = image;
 
     image->resetEntryCounter();
 
@@ -496,8 +769,8 @@ MFile *D64MFile::getNextFileInDir()
     if (!dirIsOpen)
         rewindDirectory();
 
-    // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<D64MStream>(streamFile->url);
+    // Held since rewindDirectory(), so it isn't let go in the middle of the listing
+    auto image = dir_image;
 
     bool r = false;
     do
@@ -521,26 +794,68 @@ MFile *D64MFile::getNextFileInDir()
     {
         // Debug_printv( "END OF DIRECTORY");
         dirIsOpen = false;
+        dir_image.reset();
         return nullptr;
     }
 }
 
+bool D64MFile::readEntry(MDirEntry &entry)
+{
+    if (!dirIsOpen)
+        rewindDirectory();
+
+    auto image = dir_image;
+
+    bool r = false;
+    do
+    {
+        r = image->seekNextImageEntry();
+    } while (r && (image->entry.file_type & 0b00000111) == 0x00); // Skip hidden files
+
+    if (!r)
+    {
+        dirIsOpen = false;
+        dir_image.reset();
+        return false;
+    }
+
+    // Name is padded with shifted spaces
+    size_t length = 0;
+    while (length < sizeof(image->entry.filename) &&
+           image->entry.filename[length] != '\0' && (uint8_t)image->entry.filename[length] != 0xA0)
+        length++;
+    entry.setName(image->entry.filename, length);
+
+    auto type = image->decodeType(image->entry.file_type);
+    entry.setExtension(type.data(), type.size());
+    entry.flags = MDirEntry::PETSCII;
+    entry.blocks = image->entry.blocks;
+    entry.size = entry.blocks * image->block_size;
+
+    return true;
+}
+
 time_t D64MFile::getLastWrite()
 {
+    // The directory changes when the image file does
+    if (isDirectory())
+        return streamFile->getLastWrite();
+
     return getCreationTime();
 }
 
 time_t D64MFile::getCreationTime()
 {
-    tm *entry_time = 0;
+    // GEOS date stamp of the entry, two digit year
+    tm entry_time = {};
     auto entry = ImageBroker::obtain<D64MStream>(streamFile->url)->entry;
-    entry_time->tm_year = entry.year + 1900;
-    entry_time->tm_mon = entry.month;
-    entry_time->tm_mday = entry.day;
-    entry_time->tm_hour = entry.hour;
-    entry_time->tm_min = entry.minute;
+    entry_time.tm_year = entry.year + ((entry.year < 80) ? 100 : 0);
+    entry_time.tm_mon = entry.month ? entry.month - 1 : 0;
+    entry_time.tm_mday = entry.day;
+    entry_time.tm_hour = entry.hour;
+    entry_time.tm_min = entry.minute;
 
-    return mktime(entry_time);
+    return mktime(&entry_time);
 }
 
 bool D64MFile::exists()
@@ -18,9 +18,11 @@
 #include <map>
 #include <bitset>
 #include <ctime>
+#include <cstring>
 
 #include "../meat_media.h"
 #include "string_utils.h"
+#include "track_map.h"
 
 
 /********************************************************
@@ -37,7 +39,10 @@ protected:
         uint8_t offset;
         uint8_t start_track;
         uint8_t end_track;
-        uint8_t byte_count;
+        uint8_t byte_count;     // bytes per track, free count first unless only 3 (bitmap only)
+        uint8_t count_track;    // where the free counts are kept for a bitmap only map (D71 side 2)
+        uint8_t count_sector;
+        uint8_t count_offset;
     };
 
     struct Partition {
@@ -48,6 +53,9 @@ protected:
         uint8_t directory_sector;
         uint8_t directory_offset;
         std::vector<BlockAllocationMap> block_allocation_map;
+        TrackMap track_map;     // Built on first seek, see trackMap()
+        std::vector<std::bitset<256>> bam; // Free sectors of each track, see loadBAM()
+        bool bam_dirty = false;
     };
 
     struct Header {
@@ -87,8 +95,16 @@ public:
     bool error_info = false;
     std::string bam_message = "";
 
+    // A free count and an LSB first bitmap per track, see loadBAM()
+    bool cbm_bam = true;
+
+    // The container can't take sectors back, see blockWrite()
+    bool write_protected = false;
+
     D64MStream(std::shared_ptr<MStream> is) : MMediaStream(is) 
     {
+        direct_buffer.resize(block_size);
+
         // D64 Partition Info
         std::vector<BlockAllocationMap> b = { 
             {
@@ -209,6 +225,10 @@ public:
     //     }; 
     // };
 
+    ~D64MStream() {
+        flush();
+    }
+
     uint16_t blocksFree() override;
 
     uint8_t speedZone( uint8_t track) override
@@ -221,12 +241,20 @@ public:
     bool seekSector( std::vector<uint8_t> trackSectorOffset ) override;
 
     void seekHeader() override {
+        auto &saved = directory_index.header;
+        if ( saved.size() == sizeof(header) )
+        {
+            memcpy(&header, saved.data(), sizeof(header));
+            return;
+        }
+
         seekSector( 
             partitions[partition].header_track, 
             partitions[partition].header_sector, 
             partitions[partition].header_offset 
         );
         containerStream->read((uint8_t*)&header, sizeof(header));
+        saved.assign((uint8_t*)&header, (uint8_t*)&header + sizeof(header));
     }
     uint16_t getSectorCount( uint16_t track )
     {
@@ -237,6 +265,15 @@ public:
         return partitions[0].block_allocation_map[0].end_track;
     }
 
+    // Block offsets of every track in the current partition
+    TrackMap &trackMap()
+    {
+        auto &p = partitions[partition];
+        if ( p.track_map.empty() )
+            p.track_map.build( p.block_allocation_map.back().end_track, [this]( uint8_t track ) { return getSectorCount( track ); } );
+        return p.track_map;
+    }
+
     bool seekNextImageEntry() override {
         return seekEntry( entry_index + 1 );
     }
@@ -244,6 +281,28 @@ public:
     virtual bool seekPath(std::string path) override;
     uint16_t readFile(uint8_t* buf, uint16_t size) override;
 
+    // Within the file seekPath() found, so an image can be read from inside another one
+    bool seek(uint32_t pos) override;
+
+    // Direct access channel, U1/U2 and B-P work on this buffer
+    using MMediaStream::read;
+    uint32_t read(uint8_t* buf, uint32_t size) override;
+    uint32_t write(const uint8_t *buf, uint32_t size) override;
+    uint16_t readContainer(uint8_t *buf, uint16_t size) override;
+
+    bool blockRead( uint8_t track, uint8_t sector ) override;
+    bool blockWrite( uint8_t track, uint8_t sector ) override;
+    bool blockAllocate( uint8_t track, uint8_t sector ) override;
+    bool blockFree( uint8_t track, uint8_t sector ) override;
+    bool hasBAM() override { return cbm_bam; };
+    bool isWriteProtected() override { return write_protected; };
+    bool canBlock() override { return !direct_access && MMediaStream::canBlock(); };
+    size_t footprint() override;
+
+    // Changed sectors and BAM are kept in memory until this is called
+    bool flush() override;
+    void close() override;
+
     Header header;      // Directory header data
     Entry entry;        // Directory entry data
 
@@ -258,18 +317,29 @@ public:
     uint8_t next_sector = 0;
     uint8_t sector_offset = 0;
 
+    // Blocks of the open file followed so far, from its start, for seek()
+    std::vector<std::pair<uint8_t, uint8_t>> file_blocks;
+
+    bool direct_access = false;
+    std::vector<uint8_t> direct_buffer;
+
 private:
     void sendListing();
 
     bool seekEntry( std::string filename ) override;
     bool seekEntry( uint16_t index = 0 ) override;
+    std::string entryName();
 
-    std::string readBlock( uint8_t track, uint8_t sector );
-    bool writeBlock( uint8_t track, uint8_t sector, std::string data );
+    // Sector and BAM access, writes are held in dirty_blocks until flush()
+    bool readBlock( uint8_t track, uint8_t sector, uint8_t* buf );
+    bool writeBlock( uint8_t track, uint8_t sector, const uint8_t* buf );
     bool allocateBlock( uint8_t track, uint8_t sector );
     bool deallocateBlock( uint8_t track, uint8_t sector );
-    bool getNextFreeBlock(uint8_t startTrack, uint8_t startSector, uint8_t *foundTrack, uint8_t *foundSector);
     bool isBlockFree(uint8_t track, uint8_t sector);
+    bool loadBAM();
+    bool writeBAM();
+
+    std::map<uint32_t, std::vector<uint8_t>> dirty_blocks; // block index -> data, in disk order
 
     // Container
     friend class D8BMFile;
@@ -314,6 +384,7 @@ public:
     bool isDirectory() override;
     bool rewindDirectory() override;
     MFile* getNextFileInDir() override;
+    bool readEntry(MDirEntry &entry) override;
     bool mkDir() override { return false; };
 
     bool exists() override;
@@ -325,6 +396,9 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+
+private:
+    std::shared_ptr<D64MStream> dir_image;  // the image being listed, while dirIsOpen
 };
 
 
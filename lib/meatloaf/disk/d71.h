@@ -38,16 +38,19 @@ public:
                 0x00,   // offset
                 36,     // start_track
                 70,     // end_track
-                3       // byte_count
+                3,      // byte_count
+                18,     // count_track
+                0,      // count_sector
+                0xDD    // count_offset
             } 
         };
 
         Partition p = {
-            1,     // track
+            18,    // track
             0,     // sector
-            0x04,  // header_offset
-            1,     // directory_track
-            4,     // directory_sector
+            0x90,  // header_offset
+            18,    // directory_track
+            1,     // directory_sector
             0x00,  // directory_offset
             b      // block_allocation_map
         };
@@ -70,7 +73,7 @@ public:
 
     virtual uint8_t speedZone( uint8_t track) override
     {
-        if ( track < 35 )
+        if ( track <= 35 )
 		    return (track < 18) + (track < 25) + (track < 31);
         else
             return (track < 53) + (track < 60) + (track < 66);
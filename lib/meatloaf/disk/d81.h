@@ -34,7 +34,7 @@ public:
             },
             {
                 40,     // track
-                0,      // sector
+                2,      // sector
                 0x10,   // offset
                 41,     // start_track
                 80,     // end_track
@@ -70,6 +70,7 @@ public:
         partitions.clear();
         partitions.push_back(p);
         sectorsPerTrack = { 17, 18, 19, 21 };
+        cbm_bam = false;    // 4 bitmap bytes for up to 192 sectors a track
 
         // this.size = data.media_data.length;
         // switch (this.size + this.media_header_size) {
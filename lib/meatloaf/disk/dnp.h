@@ -44,6 +44,7 @@ public:
         partitions.clear();
         partitions.push_back(p);
         sectorsPerTrack = { 256 };
+        cbm_bam = false;    // 32 bytes a track, MSB first, no free count
         has_subdirs = true;
     };
 
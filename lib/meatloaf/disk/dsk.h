@@ -46,6 +46,7 @@ public:
         partitions.clear();
         partitions.push_back(p);
         sectorsPerTrack = { 16 };
+        cbm_bam = false;
         dos_rom = "";
         dos_name = "";
         has_subdirs = false;
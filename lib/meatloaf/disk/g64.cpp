@@ -2,80 +2,138 @@
 
 // G64 Utility Functions
 
-bool G64MStream::seekBlock(uint64_t index, uint8_t offset)
+G64SectorStream::G64SectorStream(std::shared_ptr<MStream> is)
 {
-    uint16_t sectorOffset = 0;
-    uint8_t track = 0;
+    gcrStream = is;
+    memset(&header, 0, sizeof(header));
 
-    // Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
-
-    // Determine actual track & sector from index
-    do
+    uint8_t b[sizeof(header)];
+    if (!gcrStream->seek(0) || gcrStream->read(b, sizeof(b)) != sizeof(b) || memcmp(b, "GCR-1541", 8))
+    {
+        Debug_printv("Not a G64 image");
+        return;
+    }
+    memcpy(header.signature, b, 8);
+    header.version = b[8];
+    header.track_count = b[9];
+    header.track_size = b[10] | (b[11] << 8);
+
+    // Offset of each half track's data follows the header, little endian
+    std::vector<uint8_t> table(header.track_count * 4);
+    if (gcrStream->read(table.data(), table.size()) != table.size())
     {
-        track++;
-        uint8_t count = getSectorCount(track);
-        if (sectorOffset + count < index)
-            sectorOffset += count;
-        else
-            break;
+        Debug_printv("Short track offset table");
+        return;
+    }
+    offsets.resize(header.track_count);
+    for (size_t i = 0; i < offsets.size(); i++)
+        offsets[i] = table[i * 4] | (table[i * 4 + 1] << 8) | (table[i * 4 + 2] << 16) | (table[i * 4 + 3] << 24);
 
-        // Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", track, speedZone(track), count, sectorOffset);
-    } while (true);
-    uint8_t sector = index - sectorOffset;
+    // Whole tracks with data decide the size, rounded up to a size a D64 can be
+    uint8_t last = 0;
+    for (uint8_t track = 1; track <= MAX_TRACK_D64 && (track - 1) * 2 < offsets.size(); track++)
+    {
+        if (offsets[(track - 1) * 2])
+            last = track;
+    }
+    end_track = (last <= 35) ? 35 : (last <= 40) ? 40 : MAX_TRACK_D64;
 
-    this->block = index;
-    this->track = track;
-    this->sector = sector;
+    map.build(end_track, [](uint8_t track) { return sector_map_1541[track]; });
+    _size = map.blocks() * block_size;
+    _position = 0;
 
-    // Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
+    // Debug_printv("version[%d] half tracks[%d] track_size[%d] end_track[%d]", header.version, header.track_count, header.track_size, end_track);
+}
 
-    return containerStream->seek((index * block_size) + offset);
+void G64SectorStream::close()
+{
+    tracks.clear();
+    gcr.clear();
+    gcr.shrink_to_fit();
+    if (gcrStream)
+        gcrStream->close();
 }
 
-bool G64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
+bool G64SectorStream::seek(uint32_t pos)
 {
-    uint16_t sectorOffset = 0;
+    if (pos > _size)
+        return false;
 
-    //Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
+    _position = pos;
+    return true;
+}
 
-    // Is this a valid track?
-    uint16_t c = partitions[partition].block_allocation_map.size() - 1;
-    uint8_t start_track = partitions[partition].block_allocation_map[0].start_track;
-    uint8_t end_track = partitions[partition].block_allocation_map[c].end_track;
-    if (track < start_track || track > end_track)
-    {
-        Debug_printv("Invalid Track: track[%d] start_track[%d] end_track[%d]", track, start_track, end_track);
-        return false;
-    }
+uint32_t G64SectorStream::read(uint8_t* buf, uint32_t size)
+{
+    uint32_t count = 0;
 
-    // Is this a valid sector?
-    c = getSectorCount(track);
-    if (sector > c)
+    while (count < size && _position < _size)
     {
-        Debug_printv("Invalid Sector: sector[%d] sectorsPerTrack[%d]", sector, c);
-        return false;
-    }
+        uint8_t track = map.track(_position / block_size);
+        uint32_t start = map.block(track, 0) * block_size;
+        uint32_t end = map.block(track, map.sectors(track)) * block_size;
+        uint32_t length = std::min<uint32_t>(size - count, end - _position);
 
-    track--;
-    for (uint8_t index = 0; index < track; ++index)
-    {
-        sectorOffset += getSectorCount(index + 1);
-        //Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", (index + 1), speedZone(index), getSectorCount(index + 1), sectorOffset);
+        Track *t = loadTrack(track);
+
+        memcpy(buf + count, t->data.data() + (_position - start), length);
+        count += length;
+        _position += length;
     }
-    track++;
-    sectorOffset += sector;
 
-    this->block = sectorOffset;
-    this->track = track;
-    this->sector = sector;
+    return count;
+}
 
-    //Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
+uint8_t G64SectorStream::sectorError(uint8_t track, uint8_t sector)
+{
+    if (track < 1 || track > end_track || sector >= map.sectors(track))
+        return SECTOR_OK;
 
-    return containerStream->seek((sectorOffset * block_size) + offset);
+    Track *t = loadTrack(track);
+    return t ? t->errors[sector] : SYNC_NOT_FOUND;
 }
 
+size_t G64SectorStream::footprint()
+{
+    size_t total = sizeof(*this) + offsets.capacity() * sizeof(uint32_t) + gcr.capacity();
+    for (auto &t : tracks)
+        total += sizeof(t) + t.data.capacity() + t.errors.capacity() + 2 * sizeof(void *);
+    return total;
+}
 
-uint16_t G64MStream::readContainer(uint8_t *buf, uint16_t size)
+G64SectorStream::Track *G64SectorStream::loadTrack(uint8_t track)
 {
-    return containerStream->read(buf, size);
+    for (auto it = tracks.begin(); it != tracks.end(); ++it)
+    {
+        if (it->track == track)
+        {
+            tracks.splice(tracks.begin(), tracks, it);
+            return &tracks.front();
+        }
+    }
+
+    uint16_t sectors = map.sectors(track);
+    Track t = { track, std::vector<uint8_t>(sectors * block_size), std::vector<uint8_t>(sectors) };
+
+    // Each track starts with its length, then the GCR bytes
+    uint8_t half = (track - 1) * 2;
+    uint32_t offset = (half < offsets.size()) ? offsets[half] : 0;
+    uint16_t length = 0;
+    uint8_t b[2];
+    if (offset && gcrStream->seek(offset) && gcrStream->read(b, 2) == 2)
+    {
+        length = std::min<uint16_t>(b[0] | (b[1] << 8), std::max<uint16_t>(header.track_size, G64_TRACK_MAXLEN));
+        gcr.resize(length + GCR_BLOCK_LEN);
+        length = gcrStream->read(gcr.data(), length);
+    }
+
+    int found = decode_GCR_track(gcr.data(), length, t.data.data(), t.errors.data(), track, sectors);
+    if (found < sectors)
+        Debug_printv("track[%d] sectors[%d] read[%d]", track, sectors, found);
+
+    tracks.push_front(std::move(t));
+    if (tracks.size() > G64_TRACK_CACHE)
+        tracks.pop_back();
+
+    return &tracks.front();
 }
@@ -11,8 +11,9 @@
 
 #include "../meatloaf.h"
 #include "d64.h"
+#include "gcr/gcr.h"
 
-#include "endianness.h"
+#include <list>
 
 // Format codes:
 // ID	Description
@@ -50,38 +51,83 @@
  * Streams
  ********************************************************/
 
-class G64MStream : public D64MStream {
-    // override everything that requires overriding here
-
-protected:
+#ifndef G64_TRACK_CACHE
+#ifdef BOARD_HAS_PSRAM
+#define G64_TRACK_CACHE 8       // decoded tracks kept, about 5 KB each
+#else
+#define G64_TRACK_CACHE 3
+#endif
+#endif
+
+// The sectors of a G64 image laid out the way a D64 holds them, so that
+// D64MStream can read one. The track offset table says where the GCR data
+// of each track is. A track is decoded whole the first time one of its
+// sectors is read, and the last few tracks decoded are kept.
+//
+// Encoding GCR again isn't done, so the image is read only.
+class G64SectorStream : public MStream {
+public:
     struct G64Header {
         char signature[8];
         uint8_t version;
-        uint8_t track_count;
-        uint16_t track_size;
+        uint8_t track_count;    // half tracks
+        uint16_t track_size;    // longest track
     };
 
-public:
-    G64MStream(std::shared_ptr<MStream> is) : D64MStream(is) 
-    {
-        // G64 Offsets
-        //directory_header_offset = {18, 0, 0x90};
-        //directory_list_offset = {18, 1, 0x00};
-        //block_allocation_map = { {18, 0, 0x04, 1, 35, 4}, {53, 0, 0x00, 36, 70, 3} };
-        //sectorsPerTrack = { 17, 18, 19, 21 };
-
-        containerStream->read((uint8_t*)&g64_header, sizeof(g64_header));
-        g64_header.track_size = UINT16_FROM_LE_UINT16(g64_header.track_size);
+    G64SectorStream(std::shared_ptr<MStream> is);
+    ~G64SectorStream() override {
+        close();
+    }
+
+    bool isRandomAccess() override { return true; };
+    bool isOpen() override { return gcrStream && gcrStream->isOpen(); };
+    bool open() override { return gcrStream && gcrStream->open(); };
+    bool canBlock() override { return gcrStream && gcrStream->canBlock(); };
+    void close() override;
+
+    uint32_t read(uint8_t* buf, uint32_t size) override;
+    uint32_t write(const uint8_t *buf, uint32_t size) override { return 0; };
+    bool seek(uint32_t pos) override;
+
+    // Controller error code of the sector when it was decoded (SECTOR_OK and so on)
+    uint8_t sectorError(uint8_t track, uint8_t sector);
+
+    // Heap held, mostly the decoded tracks
+    size_t footprint();
+
+    G64Header header;
+    uint8_t end_track = 0;      // as a D64 of the same size
+
+private:
+    struct Track {
+        uint8_t track;
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> errors;
     };
 
-    G64Header g64_header;
+    Track *loadTrack(uint8_t track);
 
-    bool seekBlock( uint64_t index, uint8_t offset = 0 ) override;
-    bool seekSector( uint8_t track, uint8_t sector, uint8_t offset = 0 ) override;
+    std::shared_ptr<MStream> gcrStream;
+    std::vector<uint32_t> offsets;  // GCR data of each half track, 0 if there is none
+    TrackMap map;
+    std::list<Track> tracks;        // decoded, most recently used first
+    std::vector<uint8_t> gcr;       // track being decoded
+};
 
-    uint16_t readContainer(uint8_t *buf, uint16_t size) override;
+class G64MStream : public D64MStream {
+    // override everything that requires overriding here
 
-protected:
+public:
+    G64MStream(std::shared_ptr<MStream> is) : D64MStream(std::make_shared<G64SectorStream>(is))
+    {
+        // Sectors are decoded from GCR, nothing is encoded back
+        cbm_bam = false;
+        write_protected = true;
+    };
+
+    size_t footprint() override {
+        return D64MStream::footprint() + std::static_pointer_cast<G64SectorStream>(containerStream)->footprint();
+    }
 
 private:
     friend class G64MFile;
@@ -57,6 +57,9 @@ int capacity_min[] =		{ (int) (DENSITY0 / 303), (int) (DENSITY1 / 303), (int) (D
 int capacity[] = 				{ (int) (DENSITY0 / 300), (int) (DENSITY1 / 300), (int) (DENSITY2 / 300), (int) (DENSITY3 / 300) };
 int capacity_max[] =		{ (int) (DENSITY0 / 296), (int) (DENSITY1 / 296), (int) (DENSITY2 / 296), (int) (DENSITY3 / 296) };
 
+/* bytes that have to match for find_track_cycle(), the nibtools default */
+int gap_match_length = 7;
+
 /* Nibble-to-GCR conversion table */
 static uint8_t GCR_conv_data[16] = {
 	0x0a, 0x0b, 0x12, 0x13,
@@ -80,6 +83,153 @@ static uint8_t GCR_decode_low[32] = {
 	0xff, 0x09, 0x0a, 0x0b, 0xff, 0x0d, 0x0e, 0xff
 };
 
+/*
+	Whole byte tables, built from the nibble tables above at startup.
+	A data byte is 10 GCR bits, so 4 bytes are 40 bits and one lookup per
+	byte does what took two per byte with the nibble tables. GCR_BAD is set
+	in a decoded byte when either half isn't a GCR code, so a whole block
+	is checked with one OR of everything decoded instead of after every nibble.
+*/
+#define GCR_BAD 0x100
+
+static uint16_t GCR_encode_byte[256];
+static uint16_t GCR_decode_10bit[1024];
+
+static int
+build_GCR_tables(void)
+{
+	int i;
+	uint8_t hnibble, lnibble;
+
+	for (i = 0; i < 256; i++)
+		GCR_encode_byte[i] = (GCR_conv_data[i >> 4] << 5) | GCR_conv_data[i & 0x0f];
+
+	for (i = 0; i < 1024; i++)
+	{
+		hnibble = GCR_decode_high[i >> 5];
+		lnibble = GCR_decode_low[i & 0x1f];
+		GCR_decode_10bit[i] = hnibble | lnibble;
+		if (hnibble == 0xff || lnibble == 0xff)
+			GCR_decode_10bit[i] |= GCR_BAD;
+	}
+	return 1;
+}
+
+static int GCR_tables_built = build_GCR_tables();
+
+static inline uint64_t
+load_GCR_group(const uint8_t * gcr)
+{
+	return ((uint64_t) gcr[0] << 32) | ((uint64_t) gcr[1] << 24) |
+	  ((uint64_t) gcr[2] << 16) | ((uint64_t) gcr[3] << 8) | gcr[4];
+}
+
+static inline uint64_t
+load_word(const uint8_t * p)
+{
+	uint64_t word;
+
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+/* TRUE if any of the 8 bytes at p is 0xff */
+static inline int
+word_has_ff(const uint8_t * p)
+{
+	uint64_t x = ~load_word(p);
+
+	return ((x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL) != 0;
+}
+
+/*
+	TRUE if any byte from p to p + 6 is bad GCR as is_bad_gcr() sees it,
+	three zero bits in a row ending in it. p[-1] is read for the bits before.
+*/
+static inline int
+word_has_bad_gcr(const uint8_t * p)
+{
+	uint64_t z = ~((uint64_t) p[-1] << 56 | (uint64_t) p[0] << 48 |
+	  (uint64_t) p[1] << 40 | (uint64_t) p[2] << 32 | (uint64_t) p[3] << 24 |
+	  (uint64_t) p[4] << 16 | (uint64_t) p[5] << 8 | p[6]);
+
+	return ((z & (z >> 1) & (z >> 2)) & 0x00ffffffffffffffULL) != 0;
+}
+
+/*
+	Bulk conversion of groups of 4 data bytes to 5 GCR bytes and back,
+	for whole sectors and tracks.
+	decode_GCR_block() returns 1 when all of it was good GCR, 0 if not.
+*/
+void
+encode_GCR_block(const uint8_t * plain, uint8_t * gcr, size_t groups)
+{
+	uint64_t bits;
+
+	while (groups--)
+	{
+		bits = ((uint64_t) GCR_encode_byte[plain[0]] << 30) |
+		  ((uint64_t) GCR_encode_byte[plain[1]] << 20) |
+		  ((uint64_t) GCR_encode_byte[plain[2]] << 10) |
+		  GCR_encode_byte[plain[3]];
+		gcr[0] = bits >> 32;
+		gcr[1] = bits >> 24;
+		gcr[2] = bits >> 16;
+		gcr[3] = bits >> 8;
+		gcr[4] = bits;
+		plain += 4;
+		gcr += 5;
+	}
+}
+
+int
+decode_GCR_block(const uint8_t * gcr, uint8_t * plain, size_t groups)
+{
+	uint64_t bits;
+	uint16_t b0, b1, b2, b3, bad = 0;
+
+	while (groups--)
+	{
+		bits = load_GCR_group(gcr);
+		b0 = GCR_decode_10bit[(bits >> 30) & 0x3ff];
+		b1 = GCR_decode_10bit[(bits >> 20) & 0x3ff];
+		b2 = GCR_decode_10bit[(bits >> 10) & 0x3ff];
+		b3 = GCR_decode_10bit[bits & 0x3ff];
+		plain[0] = (uint8_t) b0;
+		plain[1] = (uint8_t) b1;
+		plain[2] = (uint8_t) b2;
+		plain[3] = (uint8_t) b3;
+		bad |= b0 | b1 | b2 | b3;
+		gcr += 5;
+		plain += 4;
+	}
+	return ((bad & GCR_BAD) == 0);
+}
+
+/* TRUE if is_bad_gcr() is for any position of gcrdata, 7 bytes at a time */
+static int
+any_bad_gcr(uint8_t * gcrdata, size_t length)
+{
+	size_t pos;
+
+	if (length == 0)
+		return 0;
+	if (is_bad_gcr(gcrdata, length, 0))
+		return 1;
+
+	for (pos = 1; pos + 7 <= length; pos += 7)
+	{
+		if (word_has_bad_gcr(gcrdata + pos))
+			return 1;
+	}
+	for (; pos < length; pos++)
+	{
+		if (is_bad_gcr(gcrdata, length, pos))
+			return 1;
+	}
+	return 0;
+}
+
 
 int
 find_sync(uint8_t ** gcr_pptr, uint8_t * gcr_end)
@@ -92,6 +242,13 @@ find_sync(uint8_t ** gcr_pptr, uint8_t * gcr_end)
 			return 0;	/* not found */
 		}
 
+		/* no 0xff in the next 8 bytes, no sync can start in them */
+		if ((*gcr_pptr) + 9 <= gcr_end && !word_has_ff((*gcr_pptr) + 1))
+		{
+			(*gcr_pptr) += 8;
+			continue;
+		}
+
 		// sync flag goes up after the 10th bit
 		if ( ((*gcr_pptr)[0] & 0x03) == 0x03 && (*gcr_pptr)[1] == 0xff)
 			break;
@@ -108,64 +265,25 @@ find_sync(uint8_t ** gcr_pptr, uint8_t * gcr_end)
 void
 convert_4bytes_to_GCR(uint8_t * buffer, uint8_t * ptr)
 {
-	*ptr = GCR_conv_data[(*buffer) >> 4] << 3;
-	*ptr |= GCR_conv_data[(*buffer) & 0x0f] >> 2;
-	ptr++;
-
-	*ptr = GCR_conv_data[(*buffer) & 0x0f] << 6;
-	buffer++;
-	*ptr |= GCR_conv_data[(*buffer) >> 4] << 1;
-	*ptr |= GCR_conv_data[(*buffer) & 0x0f] >> 4;
-	ptr++;
-
-	*ptr = GCR_conv_data[(*buffer) & 0x0f] << 4;
-	buffer++;
-	*ptr |= GCR_conv_data[(*buffer) >> 4] >> 1;
-	ptr++;
-
-	*ptr = GCR_conv_data[(*buffer) >> 4] << 7;
-	*ptr |= GCR_conv_data[(*buffer) & 0x0f] << 2;
-	buffer++;
-	*ptr |= GCR_conv_data[(*buffer) >> 4] >> 3;
-	ptr++;
-
-	*ptr = GCR_conv_data[(*buffer) >> 4] << 5;
-	*ptr |= GCR_conv_data[(*buffer) & 0x0f];
+	encode_GCR_block(buffer, ptr, 1);
 }
 
 int
 convert_4bytes_from_GCR(uint8_t * gcr, uint8_t * plain)
 {
-	uint8_t hnibble, lnibble;
-	int badGCR, nConverted;
+	uint64_t bits;
+	uint16_t b;
+	int i, nConverted;
 
-	badGCR = 0;
-
-	hnibble = GCR_decode_high[gcr[0] >> 3];
-	lnibble = GCR_decode_low[((gcr[0] << 2) | (gcr[1] >> 6)) & 0x1f];
-	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
-		badGCR = 1;
-	*plain++ = hnibble | lnibble;
-
-	hnibble = GCR_decode_high[(gcr[1] >> 1) & 0x1f];
-	lnibble = GCR_decode_low[((gcr[1] << 4) | (gcr[2] >> 4)) & 0x1f];
-	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
-		badGCR = 2;
-	*plain++ = hnibble | lnibble;
-
-	hnibble = GCR_decode_high[((gcr[2] << 1) | (gcr[3] >> 7)) & 0x1f];
-	lnibble = GCR_decode_low[(gcr[3] >> 2) & 0x1f];
-	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
-		badGCR = 3;
-	*plain++ = hnibble | lnibble;
-
-	hnibble = GCR_decode_high[((gcr[3] << 3) | (gcr[4] >> 5)) & 0x1f];
-	lnibble = GCR_decode_low[gcr[4] & 0x1f];
-	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
-		badGCR = 4;
-	*plain++ = hnibble | lnibble;
-
-	nConverted = (badGCR == 0) ? 4 : (badGCR - 1);
+	bits = load_GCR_group(gcr);
+	nConverted = 4;
+	for (i = 0; i < 4; i++)
+	{
+		b = GCR_decode_10bit[(bits >> (30 - i * 10)) & 0x3ff];
+		if ((b & GCR_BAD) && nConverted == 4)
+			nConverted = i;
+		*plain++ = (uint8_t) b;
+	}
 
 	return (nConverted);
 }
@@ -224,10 +342,9 @@ convert_GCR_sector(uint8_t * gcr_start, uint8_t * gcr_cycle, uint8_t * d64_secto
 	uint8_t blk_chksum;	/* block  checksum */
 	uint8_t gcr_buffer[2 * NIB_TRACK_LENGTH];
 	uint8_t *gcr_ptr, *gcr_end, *gcr_last;
-	uint8_t *sectordata;
 	uint8_t error_code;
-    int sync_found, i, j, nConverted;
-    size_t track_len;
+    int sync_found, i;
+    size_t track_len, groups;
 
 	error_code = SECTOR_OK;
 
@@ -344,32 +461,20 @@ convert_GCR_sector(uint8_t * gcr_start, uint8_t * gcr_cycle, uint8_t * d64_secto
 	}
 
 	// verify that our header contains no bad GCR, since it can be false positive checksum match
-	for(j = 0; j < 10; j++)
-	{
-		if (is_bad_gcr(gcr_ptr - 1, 10, j)) error_code = (error_code == SECTOR_OK) ? BAD_GCR_CODE : error_code;
-	}
+	if (any_bad_gcr(gcr_ptr - 1, 10)) error_code = (error_code == SECTOR_OK) ? BAD_GCR_CODE : error_code;
 
 	// next look for data portion
 	if (!find_sync(&gcr_ptr, gcr_end))
 		return (DATA_NOT_FOUND);
 
-	for (i = 0, sectordata = d64_sector; i < 65; i++)
-	{
-		if (gcr_ptr >= gcr_end - 5)
-			return (DATA_NOT_FOUND);
-
-		if (4 != (nConverted = convert_4bytes_from_GCR(gcr_ptr, sectordata)))
-		{
-#if 0
-			// XXX Disabled for unknown reason.
-			if ((i < 64) || (nConverted == 0))
-				error_code = BAD_GCR_CODE;
-#endif
-		}
-
-		gcr_ptr += 5;
-		sectordata += 4;
-	}
+	/* the groups before the end of the buffer are decoded even if a sector doesn't fit */
+	groups = (gcr_ptr < gcr_end - 5) ? ((gcr_end - 5 - gcr_ptr) + 4) / 5 : 0;
+	if (groups > 65)
+		groups = 65;
+	decode_GCR_block(gcr_ptr, d64_sector, groups);
+	if (groups < 65)
+		return (DATA_NOT_FOUND);
+	gcr_ptr += 65 * 5;
 
 	/* check for correct disk ID */
 	if (header[5] != id[0] || header[4] != id[1])
@@ -391,12 +496,108 @@ convert_GCR_sector(uint8_t * gcr_start, uint8_t * gcr_cycle, uint8_t * d64_secto
 	}
 
 	// verify that our data contains no bad GCR, since it can be false positive checksum match
-	for(j = 0; j < 320; j++)
-		if (is_bad_gcr(gcr_ptr - 325, 320, j)) error_code = (error_code == SECTOR_OK) ? BAD_GCR_CODE : error_code;
+	if (any_bad_gcr(gcr_ptr - 325, 320)) error_code = (error_code == SECTOR_OK) ? BAD_GCR_CODE : error_code;
 
 	return (error_code);
 }
 
+/*
+	Decodes every sector of a whole track in one pass over it, instead of
+	a search of the track per sector like convert_GCR_sector().
+
+	gcr_track needs room for GCR_BLOCK_LEN bytes past track_len, the start
+	of the track is copied there so a sector that wraps around is read whole.
+	d64_track gets sectors * 256 bytes, errors gets the controller error code
+	of each sector. Disk IDs aren't checked, the sector is read as long as
+	its header and data checksums are right.
+
+	Returns the number of sectors read without errors.
+*/
+int
+decode_GCR_track(uint8_t * gcr_track, size_t track_len, uint8_t * d64_track,
+  uint8_t * errors, int track, int sectors)
+{
+	uint8_t header[8];	/* block header */
+	uint8_t block[260];	/* data block mark, data, checksum, filler */
+	uint8_t *gcr_ptr, *gcr_end, *data_ptr;
+	uint8_t blk_chksum;
+	size_t wrap;
+	int sector, i, found, synced;
+
+	memset(d64_track, 0x00, sectors * 256);
+	memset(errors, SYNC_NOT_FOUND, sectors);
+	if (track_len == 0)
+		return (0);
+
+	wrap = (track_len < GCR_BLOCK_LEN) ? track_len : GCR_BLOCK_LEN;
+	memcpy(gcr_track + track_len, gcr_track, wrap);
+
+	gcr_ptr = gcr_track;
+	gcr_end = gcr_track + track_len + wrap;
+	found = synced = 0;
+
+	/* headers past the end of the track are the ones at its start again */
+	while (found < sectors && find_sync(&gcr_ptr, gcr_end) && gcr_ptr < gcr_track + track_len)
+	{
+		synced = 1;
+		if (gcr_ptr + 10 > gcr_end)
+			break;
+
+		decode_GCR_block(gcr_ptr, header, 2);
+
+		sector = header[2];
+		if (header[0] != 0x08 || header[3] != track || sector >= sectors ||
+		  errors[sector] == SECTOR_OK)
+			continue;
+
+		if ((header[1] ^ header[2] ^ header[3] ^ header[4] ^ header[5]) != 0)
+		{
+			errors[sector] = BAD_HEADER_CHECKSUM;
+			continue;
+		}
+
+		/* data block follows the next sync */
+		data_ptr = gcr_ptr + 10;
+		if (!find_sync(&data_ptr, gcr_end) || data_ptr + 65 * 5 > gcr_end)
+		{
+			errors[sector] = DATA_NOT_FOUND;
+			continue;
+		}
+
+		decode_GCR_block(data_ptr, block, 65);
+
+		if (block[0] != 0x07)
+		{
+			errors[sector] = DATA_NOT_FOUND;
+			continue;
+		}
+
+		for (i = 1, blk_chksum = 0; i <= 256; i++)
+			blk_chksum ^= block[i];
+
+		/* keep what was read either way, like a D64 with error info */
+		memcpy(d64_track + sector * 256, block + 1, 256);
+		if (blk_chksum != block[257])
+		{
+			errors[sector] = BAD_DATA_CHECKSUM;
+			continue;
+		}
+
+		errors[sector] = SECTOR_OK;
+		found++;
+		gcr_ptr = data_ptr + 65 * 5;
+	}
+
+	/* a track with syncs but a sector that never turned up */
+	for (i = 0; i < sectors; i++)
+	{
+		if (errors[i] == SYNC_NOT_FOUND && synced)
+			errors[i] = HEADER_NOT_FOUND;
+	}
+
+	return (found);
+}
+
 void
 convert_sector_to_GCR(uint8_t * buffer, uint8_t * ptr,
   int track, int sector, uint8_t * diskID, int error, int sectorSize)
@@ -468,11 +669,7 @@ convert_sector_to_GCR(uint8_t * buffer, uint8_t * ptr,
 	databuf[0x102] = 0;	/* 2 bytes filler */
 	databuf[0x103] = 0;
 
-	for (i = 0; i < 65; i++)
-	{
-		convert_4bytes_to_GCR(databuf + (4 * i), ptr);
-		ptr += 5;
-	}
+	encode_GCR_block(databuf, ptr, 65);
 }
 
 size_t
@@ -702,6 +899,15 @@ check_formatted(uint8_t * gcrdata)
 	/* try to find longest good gcr run */
 	for (i = 0; i < NIB_TRACK_LENGTH; i++)
 	{
+		if (i > 0 && i + 7 <= NIB_TRACK_LENGTH && !word_has_bad_gcr(gcrdata + i))
+		{
+			run += 7;
+			if (run >= GCR_MIN_FORMATTED)
+				return 1;
+			i += 6;
+			continue;
+		}
+
 		if (is_bad_gcr(gcrdata, NIB_TRACK_LENGTH, i))
 			run = 0;
 		else
@@ -978,6 +1184,15 @@ compare_tracks(uint8_t * track1, uint8_t * track2, int length1, int length2,
 	{
 		for (j = k = 0; j < length2 && k < length1; j++, k++)
 		{
+			/* runs that match are skipped a word at a time */
+			if (j + 8 <= length2 && k + 8 <= length1 &&
+			  load_word(track1 + j) == load_word(track2 + k))
+			{
+				j += 7;
+				k += 7;
+				continue;
+			}
+
 			if (track1[j] == track2[k])
 				continue;
 
@@ -1303,6 +1518,14 @@ check_bad_gcr(uint8_t * gcrdata, int length, int fix)
 
 	for (i = 0; i < length - 1; i++)
 	{
+		/* nothing changes while the GCR is good, so skip that 7 bytes at a time */
+		if (sbadgcr == S_BADGCR_OK && i > 0 && i + 7 < length && !word_has_bad_gcr(gcrdata + i))
+		{
+			i += 6;
+			lastpos = i;
+			continue;
+		}
+
 		b_badgcr = is_bad_gcr(gcrdata, length, i);
 		n_badgcr = is_bad_gcr(gcrdata, length, i + 1);
 
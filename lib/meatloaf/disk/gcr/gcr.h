@@ -125,6 +125,8 @@ extern int gap_match_length;
 
 /* prototypes */
 int find_sync(uint8_t ** gcr_pptr, uint8_t * gcr_end);
+void encode_GCR_block(const uint8_t * plain, uint8_t * gcr, size_t groups);
+int decode_GCR_block(const uint8_t * gcr, uint8_t * plain, size_t groups);
 void convert_4bytes_to_GCR(uint8_t * buffer, uint8_t * ptr);
 int convert_4bytes_from_GCR(uint8_t * gcr, uint8_t * plain);
 int extract_id(uint8_t * gcr_track, uint8_t * id);
@@ -135,6 +137,8 @@ size_t find_nondos_track_cycle(uint8_t ** cycle_start, uint8_t ** cycle_stop,
   int cap_min, int cap_max);
 uint8_t convert_GCR_sector(uint8_t * gcr_start, uint8_t * gcr_end,
   uint8_t * d64_sector, int track, int sector, uint8_t * id);
+int decode_GCR_track(uint8_t * gcr_track, size_t track_len, uint8_t * d64_track,
+  uint8_t * errors, int track, int sectors);
 void convert_sector_to_GCR(uint8_t * buffer, uint8_t * ptr,
   int track, int sector, uint8_t * diskID, int error, int sectorSize);
 uint8_t * find_sector_gap(uint8_t * work_buffer, int tracklen, size_t * p_sectorlen);
@@ -0,0 +1,66 @@
+// Track/sector <-> block lookup for CBM disk images
+//
+// The number of sectors on a track depends on its speed zone, so finding
+// the block of a track/sector meant adding up every earlier track on each
+// seek. This keeps a running total per track instead, built once per
+// partition the first time it is used.
+//
+
+#ifndef MEATLOAF_MEDIA_TRACK_MAP
+#define MEATLOAF_MEDIA_TRACK_MAP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+
+class TrackMap {
+public:
+    // sectorCount(track) is asked once for each track from 1 to end_track
+    template<typename F>
+    void build( uint8_t end_track, F sectorCount )
+    {
+        offsets.assign( end_track + 2, 0 );
+        for ( uint16_t track = 1; track <= end_track; track++ )
+            offsets[track + 1] = offsets[track] + sectorCount( track );
+    }
+
+    bool empty() {
+        return offsets.empty();
+    }
+
+    void clear() {
+        offsets.clear();
+    }
+
+    uint8_t endTrack() {
+        return offsets.size() - 2;
+    }
+
+    // Total number of blocks
+    uint32_t blocks() {
+        return offsets.back();
+    }
+
+    uint16_t sectors( uint8_t track ) {
+        return offsets[track + 1] - offsets[track];
+    }
+
+    // Block index of track/sector
+    uint32_t block( uint8_t track, uint8_t sector ) {
+        return offsets[track] + sector;
+    }
+
+    // Track holding block index, past the end this is the last track
+    uint8_t track( uint32_t block )
+    {
+        auto found = std::upper_bound( offsets.begin() + 2, offsets.end() - 1, block );
+        return (found - offsets.begin()) - 1;
+    }
+
+private:
+    // offsets[track] is the first block of track, tracks start at 1
+    std::vector<uint32_t> offsets;
+};
+
+#endif /* MEATLOAF_MEDIA_TRACK_MAP */
@@ -21,6 +21,8 @@ public:
         seekNextEntry();
     };
 
+    size_t footprint() override { return sizeof(*this) + directory_index.bytes(); }
+
 protected:
     struct Header {
         char signature[7];
@@ -3,6 +3,7 @@
 
 #include "meat_buffer.h"
 #include "wrappers/iec_buffer.h"
+#include "wrappers/block_buffer.h"
 
 /*
 This is the main IEC named channel abstraction. Meatloaf keeps an array/map of these as long as they're alive
@@ -50,9 +51,27 @@ typedef enum {
 class iecPipe {
     Meat::iostream* fileStream = nullptr;
     oiecstream iecStream;
+    std::shared_ptr<MStream> sourceStream;  // LOAD source, read ahead by the prefetch task
+    std::shared_ptr<MBlockBuffer> sourceBuffer;
+    std::streamoff pendingSeek = -1;        // waiting for the old prefetch task to let go of the source
     std::ios_base::openmode mode;
     std::string filename;
 
+    // Carry out a seek once no prefetch task is reading from the source any more,
+    // then start reading ahead again from there
+    bool reposition() {
+        if(pendingSeek < 0)
+            return true;
+        if(sourceBuffer->busy())
+            return false;
+
+        sourceStream->seek(pendingSeek);
+        pendingSeek = -1;
+        sourceBuffer = std::make_shared<MBlockBuffer>(sourceStream, sourceStream->block_size, BLOCK_BUFFER_PREFETCH_BLOCKS);
+        sourceBuffer->startPrefetch();
+        return true;
+    }
+
 public:
     pipe_status_t status = STATUS_OK;
 
@@ -62,7 +81,7 @@ public:
 
     // you call this once, when C64 requested to open the stream
     bool establish(const std::string& fn, std::ios_base::openmode m, systemBus* i) {
-        if(fileStream != nullptr)
+        if(fileStream != nullptr || sourceStream != nullptr)
             return false;
 
         filename = fn;
@@ -70,7 +89,21 @@ public:
         mode = m;
         iecStream.open(i);
 
+        if(mode == std::ios_base::openmode::_S_in) {
+            // LOAD is served from a ring that a background task keeps full
+            std::unique_ptr<MFile> file(MFSOwner::File(filename));
+            if(file != nullptr)
+                sourceStream.reset(file->getSourceStream(mode));
+            if(sourceStream == nullptr)
+                return false;
+
+            sourceBuffer = std::make_shared<MBlockBuffer>(sourceStream, sourceStream->block_size, BLOCK_BUFFER_PREFETCH_BLOCKS);
+            sourceBuffer->startPrefetch();
+            return sourceStream->isOpen();
+        }
+
         fileStream = new Meat::iostream(filename.c_str(), mode);
+        return fileStream->is_open();
     }
 
     // this stream is disposed of, nothing more will happen with it!
@@ -81,10 +114,21 @@ public:
             delete fileStream;
             fileStream = nullptr;
         }
+
+        if(sourceStream != nullptr) {
+            // the prefetch task may still be in a read, it closes the stream when that returns
+            sourceBuffer->stopPrefetch();
+            sourceBuffer->closeSource();
+            sourceBuffer.reset();
+            sourceStream.reset();
+            pendingSeek = -1;
+        }
     }
 
     bool isActive() {
-        if(fileStream != nullptr)
+        if(sourceStream != nullptr)
+            return sourceStream->isOpen();
+        else if(fileStream != nullptr)
             return fileStream->is_open();
         else
             return false;
@@ -92,11 +136,13 @@ public:
 
     bool seek(std::streampos p) {
         if(mode == std::ios_base::openmode::_S_in) {
-            // we are LOADing, so we need to seek within the source file input stream (get buffer):
-            fileStream->seekg(p);
-            // our iec stream put buffer can potentially contain more bytes ready for read, but since we are
-            // seeking, we need to flush them, so they don't get sent to C64 as if they were read from file
-            iecStream.flushpbuff(); 
+            // we are LOADing, so we need to seek within the source stream, after dropping
+            // whatever the prefetch task has read ahead, so it doesn't get sent to C64
+            if(sourceStream != nullptr) {
+                sourceBuffer->stopPrefetch();
+                pendingSeek = p;
+                reposition();
+            }
         }
         else if(mode == std::ios_base::openmode::_S_out) {
             // we are SAVE-ing, so, we need to seek within the destination file output stream (put buffer):
@@ -107,69 +153,70 @@ public:
         return false;
     }
 
-    // LOAD - push file bytes (fileStream.get) to C64 (iecStream.write)
+    // LOAD - push file bytes (sourceBuffer) to C64 (IEC)
     void readFile() {
         // this pipe wasn't itialized or wasn't meant for reading
-        if(fileStream == nullptr || mode != std::ios_base::openmode::_S_in) {
+        if(sourceBuffer == nullptr || mode != std::ios_base::openmode::_S_in) {
             status = STATUS_BAD;
             IEC.senderTimeout();
             return;
         }
-        
-        // push bytes from file to C64 as long as they're available (eying ATN)
-        while(!fileStream->eof() && !fileStream->bad() && !(IEC.flags bitand ATN_PULLED))
+
+        // push bytes from the read ahead ring to C64 as long as they're available (eying ATN)
+        while(!(IEC.flags bitand ATN_PULLED))
         {
-            // If this is a socket stream, it might send NDA ("I have no data for you, but keep asking"), so lte's check it!
-            (*fileStream).checkNda();
-            if((*fileStream).nda()) {
-                status = STATUS_NDA;
-                IEC.senderTimeout();
+            // a seek is still waiting for the old prefetch task
+            if(!reposition()) {
+                sourceBuffer->fill();
+                continue;
             }
-            else {
-                // let's try to get and send next byte to IEC
-                // we will peek next char in case ATN is pulled during attempt to write
-                int next_char = fileStream->peek();
-             
-                if (next_char != EOF) {
-                    // we have a char, let's try to send it
-                    char ch = static_cast<char>(next_char);
-                    iecStream.write(&ch, 1);
-                    //Debug_printf("Sending byte to C64: %.2X ", ch);
-                }
 
-                if(IEC.flags bitand ATN_PULLED) {
-                    // if ATN was pulled, we need to escape from the loop
-                    // PRZEM: set some status here?
-                    break;
+            sourceBuffer->fill();
+
+            const uint8_t *data;
+            size_t len = sourceBuffer->peek(&data);
+            if(len == 0) {
+                if(sourceBuffer->error()) {
+                    // because something went wrong with file stream
+                    status = STATUS_BAD;
+                    IEC.senderTimeout();
+                    return;
                 }
-                else {
-                    // ATN wasn't pulled, so the byte was succesfully sent, so we can safely flush that byte we peeked from the buffer
-                    char nextChar;
-                    fileStream->get(nextChar);
-                    status = STATUS_OK;
+                else if(sourceBuffer->eos()) {
+                    // because we reached EOF on file stream, last byte already went out with EOI
+                    status = STATUS_EOF;
+                    return;
                 }
-            }
-        }
 
-        // the loop exited, we have to check why
-        if(IEC.flags bitand ATN_PULLED) {
-            // because ATN was pulled!
+                // the source has nothing for us yet, so "I have no data for you, but keep asking",
+                // fill() waits for it, keep at it until there's data or ATN is pulled
+                status = STATUS_NDA;
+                continue;
+            }
 
-            // do nothing
-        }
-        else if(fileStream->eof()) {
-            // because we reached EOF on file stream
+            // send a contiguous run, a byte only counts as sent if ATN wasn't pulled during the attempt
+            size_t i = 0;
+            for(; i < len; i++) {
+                bool eoi = sourceBuffer->isLast(i);
+                if(!IEC.sendByte(data[i], eoi)) {
+                    sourceBuffer->consume(i);
+                    status = STATUS_BAD;
+                    IEC.senderTimeout();
+                    return;
+                }
+                if(!eoi && (IEC.flags bitand ATN_PULLED))
+                    break;
+            }
+            sourceBuffer->consume(i);
+            status = STATUS_OK;
 
-            status = STATUS_EOF;
-            // iecStream.close() call will do the last byte trick to signal EOF on C64 side
-            iecStream.close();
+            if(sourceBuffer->eos()) {
+                status = STATUS_EOF;
+                return;
+            }
         }
-        else if(fileStream->bad() || fileStream->fail()) {
-            // because something went wrong with file stream
 
-            status = STATUS_BAD;
-            IEC.senderTimeout();
-        }
+        // ATN was pulled, unsent bytes stay in the ring until readFile() is called again
     }
 
     // SAVE - pull C64 bytes (iecStream.get) to remote file (fileStream.put)
@@ -6,7 +6,6 @@
 #include <string>
 #include <functional>
 #include "meatloaf.h"
-#include "iec_pipe_broker.h"
 #include "../device/disk.h"
 
 // Custom hash function for std::pair<std::string, std::ios_base::openmode>
@@ -42,22 +41,12 @@ public:
         }
     }
 
-    // Function to remove streamCache entries without matching iecPipe instances
-    void flushInactiveStreams(iecPipeBroker& broker) {
-        const auto& deviceChannelMap = broker.getDeviceChannelMap();
-
+    // Remove the streams nobody but the cache holds any more
+    void flushInactiveStreams() {
         for (auto keyStreamPair = streamCache.begin(); keyStreamPair != streamCache.end();) {
-            bool inUse = false;
-            for (const auto& keyPipePair : deviceChannelMap) {
-                if (keyPipePair.second->getFilename().find(keyStreamPair->first.first) != std::string::npos) {
-                    inUse = true;
-                    break;
-                }
-            }
-
-            if (!inUse) {
+            if (keyStreamPair->second.use_count() == 1) {
                 keyStreamPair->second->close(); // Close the stream before removing
-                keyStreamPair = streamCache.erase(keyStreamPair); // Remove the entry if no matching iecPipe found
+                keyStreamPair = streamCache.erase(keyStreamPair);
             } else {
                 ++keyStreamPair;
             }
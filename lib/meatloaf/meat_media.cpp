@@ -1,6 +1,11 @@
 #include "meat_media.h"
 
-std::unordered_map<std::string, MMediaStream*> ImageBroker::repo;
+std::list<ImageBroker::Entry> ImageBroker::lru;
+std::unordered_map<std::string, std::list<ImageBroker::Entry>::iterator> ImageBroker::repo;
+std::recursive_mutex ImageBroker::mutex;
+
+size_t ImageBroker::budget = IMAGE_BROKER_BUDGET;
+size_t ImageBroker::bytes = 0;
 
 // Utility Functions
 
@@ -67,7 +72,10 @@ bool MMediaStream::open()
 void MMediaStream::close()
 {
     Debug_printv("url[%s]", url.c_str());
-    ImageBroker::dispose(url);
+
+    // The broker's own copy goes when the last holder lets go of it
+    if (!brokered)
+        ImageBroker::dispose(url);
 };
 
 uint32_t MMediaStream::seekFileSize( uint8_t start_track, uint8_t start_sector )
@@ -93,7 +101,16 @@ uint32_t MMediaStream::seekFileSize( uint8_t start_track, uint8_t start_sector )
 
 uint16_t MMediaStream::readContainer(uint8_t *buf, uint16_t size)
 {
-    return containerStream->read(buf, size);
+    // A container that is a file in another image comes back a block at a time
+    uint16_t count = 0;
+    while (count < size)
+    {
+        uint32_t r = containerStream->read(buf + count, size - count);
+        if (!r)
+            break;
+        count += r;
+    }
+    return count;
 }
 
 
@@ -128,3 +145,105 @@ bool MMediaStream::isOpen() {
 
     return _is_open;
 };
+
+
+/********************************************************
+ * ImageBroker
+ ********************************************************/
+
+std::shared_ptr<MMediaStream> ImageBroker::find(const std::string &url)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    auto found = repo.find(url);
+    if (found == repo.end())
+        return nullptr;
+
+    auto entry = found->second;
+    lru.splice(lru.begin(), lru, entry);
+
+    // The directory index grows as the image is read
+    bytes -= entry->bytes;
+    entry->bytes = entry->stream->footprint();
+    bytes += entry->bytes;
+
+    auto stream = entry->stream;
+    evict();
+    return stream;
+}
+
+std::shared_ptr<MMediaStream> ImageBroker::store(const std::string &url, std::shared_ptr<MMediaStream> stream)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    // Closing the duplicate mustn't let the one kept go
+    stream->brokered = true;
+
+    auto kept = find(url);
+    if (kept != nullptr)
+        return kept;
+
+    lru.push_front({ url, stream, stream->footprint() });
+    repo[url] = lru.begin();
+    bytes += lru.front().bytes;
+
+    evict();
+    return stream;
+}
+
+void ImageBroker::evict()
+{
+    // Closing an image can close others, so they go once the list is done with
+    std::vector<std::shared_ptr<MMediaStream>> released;
+
+    auto entry = lru.end();
+    while (bytes > budget && entry != lru.begin())
+    {
+        --entry;
+
+        // Still being listed or read from
+        if (entry->stream.use_count() > 1)
+            continue;
+
+        Debug_printv("url[%s] bytes[%d] total[%d] budget[%d]", entry->url.c_str(), (int)entry->bytes, (int)bytes, (int)budget);
+        bytes -= entry->bytes;
+        released.push_back(std::move(entry->stream));
+        repo.erase(entry->url);
+        entry = lru.erase(entry);
+    }
+}
+
+void ImageBroker::invalidate(std::string url)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    auto found = repo.find(url);
+    if (found != repo.end())
+        found->second->stream->directory_index.clear();
+}
+
+void ImageBroker::dispose(std::string url)
+{
+    std::shared_ptr<MMediaStream> released;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    auto found = repo.find(url);
+    if (found != repo.end())
+    {
+        auto entry = found->second;
+        bytes -= entry->bytes;
+        released = std::move(entry->stream);
+        repo.erase(found);
+        lru.erase(entry);
+    }
+}
+
+void ImageBroker::clear()
+{
+    std::list<Entry> released;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    released.swap(lru);
+    repo.clear();
+    bytes = 0;
+}
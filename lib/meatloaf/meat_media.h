@@ -6,6 +6,9 @@
 
 #include <map>
 #include <bitset>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <sstream>
 
@@ -14,6 +17,78 @@
 #include "string_utils.h"
 
 
+/********************************************************
+ * Directory index
+ *
+ * Built while the directory of an image is read for the
+ * first time, so later listings and LOADs by name on the
+ * same image are answered from memory instead of walking
+ * the directory chain through the container stream again.
+ * Anything that writes to the image has to clear() it.
+ ********************************************************/
+
+class MMediaIndex {
+public:
+    struct File {
+        uint8_t start_track;
+        uint8_t start_sector;
+        uint32_t size;          // bytes, 0 until the file has been opened once
+    };
+
+    // Raw entries, in directory order
+    size_t entrySize = 0;
+    std::vector<uint8_t> entries;
+    std::vector<File> files;
+    std::vector<std::string> names;                 // decoded, padding stripped
+    std::unordered_map<std::string, uint16_t> lookup; // name -> first entry with it (1 based)
+
+    bool complete = false;  // every directory sector has been read
+
+    // Header and free blocks, saved by the first listing
+    std::vector<uint8_t> header;
+    int32_t blocks_free = -1;
+
+    size_t count() {
+        return files.size();
+    }
+
+    const uint8_t* entry( uint16_t index ) {
+        return &entries[(index - 1) * entrySize];
+    }
+
+    void add( const uint8_t* entry, size_t size, std::string name, uint8_t start_track, uint8_t start_sector )
+    {
+        entrySize = size;
+        entries.insert(entries.end(), entry, entry + size);
+        files.push_back({ start_track, start_sector, 0 });
+        lookup.emplace(name, files.size());
+        names.push_back(std::move(name));
+    }
+
+    // Heap held, roughly
+    size_t bytes()
+    {
+        size_t total = entries.capacity() + header.capacity() + files.capacity() * sizeof(File);
+        total += names.capacity() * sizeof(std::string);
+        for (auto &name : names)
+            total += name.capacity() * 2;   // the name and its lookup key
+        total += lookup.size() * (sizeof(std::string) + sizeof(uint16_t) + 2 * sizeof(void *));
+        return total;
+    }
+
+    void clear()
+    {
+        entries.clear();
+        files.clear();
+        names.clear();
+        lookup.clear();
+        complete = false;
+        header.clear();
+        blocks_free = -1;
+    }
+};
+
+
 /********************************************************
  * Streams
  ********************************************************/
@@ -40,6 +115,7 @@ public:
     bool isBrowsable() override { return false; };
     // Random access streams might call seekPath to jump to a specific file
     bool isRandomAccess() override { return true; };
+    bool canBlock() override { return containerStream->canBlock(); };
 
     // read = (size) => this.containerStream.read(size);
     virtual uint8_t read() {
@@ -113,8 +189,14 @@ public:
     bool isOpen() override;
     std::string url;
 
+    // Heap held, roughly, counted against ImageBroker's budget. Streams
+    // keeping more than their directory index add that on.
+    virtual size_t footprint() { return sizeof(*this) + directory_index.bytes(); }
+
 protected:
 
+    bool brokered = false;  // owned by ImageBroker, which doesn't need telling when it closes
+
     bool seekCalled = false;
     std::shared_ptr<MStream> containerStream;
 
@@ -128,6 +210,8 @@ protected:
     size_t entry_index = 0;  // Currently selected directory entry
     size_t entry_count = -1; // Directory list entry count (-1 unknown)
 
+    MMediaIndex directory_index; // Directory entries seen so far
+
     enum open_modes { OPEN_READ, OPEN_WRITE, OPEN_APPEND, OPEN_MODIFY };
     std::string file_type_label[12] = { "DEL", "SEQ", "PRG", "USR", "REL", "CBM", "DIR", "SUS", "NAT", "CMD", "CFS", "???" };
 
@@ -158,6 +242,8 @@ protected:
 
 private:
 
+    friend class ImageBroker;
+
     // Commodore Media
     // CARTRIDGE
     friend class CRTFile;
@@ -190,18 +276,37 @@ private:
 /********************************************************
  * Utility implementations
  ********************************************************/
+
+#ifndef IMAGE_BROKER_BUDGET
+#ifdef BOARD_HAS_PSRAM
+#define IMAGE_BROKER_BUDGET (512 * 1024)    // bytes of open images kept, PSRAM boards
+#else
+#define IMAGE_BROKER_BUDGET (48 * 1024)     // bytes of open images kept, internal RAM only
+#endif
+#endif
+
+/********************************************************
+ * ImageBroker
+ *
+ * Keeps the image streams that listings and file lookups
+ * open by url, so the same image isn't opened and its
+ * directory read again for every entry. Callers share the
+ * stream; once the estimated size of everything kept is
+ * over budget, the least recently used images nobody else
+ * holds are let go. The size of each is its footprint().
+ ********************************************************/
+
 class ImageBroker {
-    static std::unordered_map<std::string, MMediaStream*> repo;
 public:
-    template<class T> static T* obtain(std::string url) {
+    template<class T> static std::shared_ptr<T> obtain(std::string url) {
         // obviously you have to supply STREAMFILE.url to this function!
-        if(repo.find(url)!=repo.end()) {
-            return (T*)repo.at(url);
-        }
+        auto found = find(url);
+        if (found != nullptr)
+            return std::static_pointer_cast<T>(found);
 
         // create and add stream to broker if not found
         auto newFile = MFSOwner::File(url);
-        T* newStream = (T*)newFile->getSourceStream();
+        std::shared_ptr<T> newStream((T*)newFile->getSourceStream());
 
         // Are we at the root of the pathInStream?
         if ( newFile->pathInStream == "")
@@ -213,22 +318,47 @@ public:
             Debug_printv("SINGLE FILE [%s]", url.c_str());
         }
 
-        repo.insert(std::make_pair(url, newStream));
         delete newFile;
+
+        // Opened without holding the lock, another task may have stored the same image meanwhile
+        if (newStream != nullptr)
+            return std::static_pointer_cast<T>(store(url, newStream));
         return newStream;
     }
 
-    static MMediaStream* obtain(std::string url) {
+    static std::shared_ptr<MMediaStream> obtain(std::string url) {
         return obtain<MMediaStream>(url);
     }
 
-    static void dispose(std::string url) {
-        if(repo.find(url)!=repo.end()) {
-            auto toDelete = repo.at(url);
-            repo.erase(url);
-            delete toDelete;
-        }
-    }
+    // Makes it the most recently used, nullptr if it isn't kept
+    static std::shared_ptr<MMediaStream> find(const std::string &url);
+
+    // Keeps the stream, unless one for the url is kept already, returns the one kept
+    static std::shared_ptr<MMediaStream> store(const std::string &url, std::shared_ptr<MMediaStream> stream);
+
+    // Call after writing to an image, so its directory is read again
+    static void invalidate(std::string url);
+
+    // Lets go of the image, it stays open while someone still holds it
+    static void dispose(std::string url);
+    static void clear();
+
+private:
+    struct Entry {
+        std::string url;
+        std::shared_ptr<MMediaStream> stream;
+        size_t bytes;   // its footprint(), when last used
+    };
+
+    static void evict();
+
+    // Most recently used at the front
+    static std::list<Entry> lru;
+    static std::unordered_map<std::string, std::list<Entry>::iterator> repo;
+    static std::recursive_mutex mutex;
+
+    static size_t budget;
+    static size_t bytes;
 };
 
 #endif // MEATLOAF_MEDIA
@@ -0,0 +1,146 @@
+#include "meat_resolver.h"
+
+#include <algorithm>
+
+#include "string_utils.h"
+
+#define RESOLVER_INDEX_SIZE 256
+
+
+/********************************************************
+ * MPathResolver
+ ********************************************************/
+
+MPathResolution MPathResolver::resolve(const std::string &path, const std::vector<std::string> &paths)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // The last segment is different for every entry of a listing, so it is
+    // matched on its own and only the prefixes go into the cache
+    return resolveSegment(path, paths, paths.size(), path.size());
+}
+
+MPathResolution MPathResolver::resolveSegment(const std::string &path, const std::vector<std::string> &paths, size_t count, size_t length)
+{
+    MPathResolution resolution;
+    resolution.fs = resolution.upperFS = _filesystems.front();
+
+    if (count == 0)
+        return resolution;
+
+    auto fs = matchSegment(paths[count - 1]);
+    size_t upper = (count > 1) ? length - paths[count - 1].size() - 1 : 0;
+
+    if (fs != nullptr)
+    {
+        resolution.fs = fs;
+        resolution.boundary = count - 1;
+        if (count > 1)
+            resolution.upperFS = resolvePrefix(path, paths, count - 1, upper).fs;
+    }
+    else if (count > 1)
+    {
+        resolution = resolvePrefix(path, paths, count - 1, upper);
+    }
+
+    return resolution;
+}
+
+MPathResolution MPathResolver::resolvePrefix(const std::string &path, const std::vector<std::string> &paths, size_t count, size_t length)
+{
+    std::string key = path.substr(0, length);
+
+    auto found = _cache.find(key);
+    if (found != _cache.end())
+    {
+        _hits++;
+        _lru.splice(_lru.begin(), _lru, found->second);
+        return found->second->second;
+    }
+    _misses++;
+
+    auto resolution = resolveSegment(path, paths, count, length);
+
+    _lru.emplace_front(key, resolution);
+    _cache[key] = _lru.begin();
+
+    if (_lru.size() > _capacity)
+    {
+        _cache.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+
+    return resolution;
+}
+
+MFileSystem* MPathResolver::match(const std::string &part)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return matchSegment(part);
+}
+
+MFileSystem* MPathResolver::matchSegment(const std::string &part)
+{
+    std::string name = part;
+    mstr::toLower(name);
+
+    // Every handles() is either a scheme ("http:", "ml:") or a single dot
+    // extension (".d64") check, so the scheme or last extension of a segment
+    // is enough to pick the only candidate
+    auto colon = name.find(':');
+    auto dot = name.rfind('.');
+
+    std::string key;
+    if (colon != std::string::npos && dot != std::string::npos)
+        return scan(name); // "ml:game.d64", let the registration order decide
+    else if (colon != std::string::npos)
+        key = name.substr(0, colon + 1);
+    else if (dot != std::string::npos)
+        key = name.substr(dot);
+    else
+        return nullptr;
+
+    MFileSystem* fs;
+    auto found = _index.find(key);
+    if (found != _index.end())
+    {
+        fs = found->second;
+    }
+    else
+    {
+        // Host names end up in here too, keep it from growing without bound
+        if (_index.size() >= RESOLVER_INDEX_SIZE)
+            _index.clear();
+
+        fs = scan(key);
+        _index[key] = fs;
+    }
+
+    // Confirm with the filesystem itself ("http:" is not "http:foo")
+    if (fs != nullptr && !fs->handles(name))
+        return scan(name);
+
+    return fs;
+}
+
+MFileSystem* MPathResolver::scan(const std::string &part)
+{
+    auto found = std::find_if(_filesystems.begin() + 1, _filesystems.end(), [&part](MFileSystem* fs) {
+        return fs->handles(part);
+    });
+
+    if (found != _filesystems.end())
+        return (*found);
+
+    return nullptr;
+}
+
+void MPathResolver::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _index.clear();
+    _cache.clear();
+    _lru.clear();
+}
@@ -0,0 +1,82 @@
+#ifndef MEATLOAF_RESOLVER
+#define MEATLOAF_RESOLVER
+
+#include <string>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "meatloaf.h"
+
+#define RESOLVER_CACHE_SIZE 32
+
+
+/********************************************************
+ * MPathResolver
+ *
+ * Works out which filesystem handles a path and where the
+ * container boundary is, for MFSOwner::File.
+ *
+ * - segments are matched through a table keyed by scheme
+ *   ("http:") or extension (".d64"), so most segments cost
+ *   one hash lookup instead of a handles() call on every
+ *   registered filesystem
+ * - resolved prefixes ("http:/host/games.zip") are kept in
+ *   a small LRU, so the entries of a directory listing only
+ *   have to match their own name
+ *
+ * Resolution only depends on the path string, so nothing
+ * ever needs to be invalidated.
+ ********************************************************/
+
+struct MPathResolution {
+    MFileSystem* fs = nullptr;       // filesystem handling the path
+    size_t boundary = 0;             // index of the segment fs matched (the container)
+    MFileSystem* upperFS = nullptr;  // filesystem handling the container itself
+};
+
+class MPathResolver {
+public:
+    MPathResolver(std::vector<MFileSystem*> &filesystems, size_t capacity = RESOLVER_CACHE_SIZE)
+        : _filesystems(filesystems), _capacity(capacity) {};
+
+    // paths is path split on '/'
+    MPathResolution resolve(const std::string &path, const std::vector<std::string> &paths);
+
+    // First filesystem (other than the default) that handles this one segment
+    MFileSystem* match(const std::string &part);
+
+    void clear();
+
+    uint32_t hits() {
+        return _hits;
+    }
+    uint32_t misses() {
+        return _misses;
+    }
+
+private:
+    std::vector<MFileSystem*> &_filesystems;
+    size_t _capacity;
+
+    // Scheme/extension -> filesystem, nullptr if none handles it
+    std::unordered_map<std::string, MFileSystem*> _index;
+
+    // Most recently used prefix at the front
+    typedef std::pair<std::string, MPathResolution> Entry;
+    std::list<Entry> _lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> _cache;
+
+    std::mutex _mutex;
+
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+
+    MPathResolution resolveSegment(const std::string &path, const std::vector<std::string> &paths, size_t count, size_t length);
+    MPathResolution resolvePrefix(const std::string &path, const std::vector<std::string> &paths, size_t count, size_t length);
+    MFileSystem* matchSegment(const std::string &part);
+    MFileSystem* scan(const std::string &part);
+};
+
+#endif /* MEATLOAF_RESOLVER */
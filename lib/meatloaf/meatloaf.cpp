@@ -17,6 +17,7 @@
 
 //#include "meat_broker.h"
 #include "meat_buffer.h"
+#include "meat_resolver.h"
 //#include "wrappers/directory_stream.h"
 
 #include "string_utils.h"
@@ -26,7 +27,9 @@
 #include "../../include/debug.h"
 
 // Archive
+#ifndef TEST_NATIVE
 #include "archive/archive_ml.h"
+#endif
 #include "archive/lbr.h"
 
 // Cartridge
@@ -55,8 +58,10 @@
 // Loaders
 
 // Network
+#ifndef TEST_NATIVE
 #include "network/http.h"
 #include "network/tnfs.h"
+#endif
 // #include "network/ipfs.h"
 // #include "network/smb.h"
 // #include "network/ws.h"
@@ -64,8 +69,10 @@
 // Scanners
 
 // Service
+#ifndef TEST_NATIVE
 #include "service/cs.h"
 #include "service/ml.h"
+#endif
 
 // Tape
 #include "tape/t64.h"
@@ -84,7 +91,9 @@ SDFileSystem sdFS;
 
 
 // Archive
+#ifndef TEST_NATIVE
 ArchiveMFileSystem archiveFS;
+#endif
 LBRMFileSystem lbrFS;
 
 // Cartridge
@@ -106,15 +115,19 @@ D90MFileSystem d90FS;
 DNPMFileSystem dnpFS;
 
 // Network
+#ifndef TEST_NATIVE
 HttpFileSystem httpFS;
 TNFSFileSystem tnfsFS;
+#endif
 // IPFSFileSystem ipfsFS;
 // TcpFileSystem tcpFS;
 //WSFileSystem wsFS;
 
 // Service
 // CServerFileSystem csFS;
+#ifndef TEST_NATIVE
 MLFileSystem mlFS;
+#endif
 
 // Tape
 T64MFileSystem t64FS;
@@ -128,18 +141,24 @@ std::vector<MFileSystem*> MFSOwner::availableFS {
 #ifdef SD_CARD
     &sdFS,
 #endif
+#ifndef TEST_NATIVE
     &archiveFS, // extension-based FS have to be on top to be picked first, otherwise the scheme will pick them!
+#endif
     &lbrFS,
     &d64FS, &d71FS, &d80FS, &d81FS, &d82FS, &d90FS, &dnpFS,
     &d8bFS, &dfiFS,
     &p00FS,
+#ifndef TEST_NATIVE
     &httpFS, &tnfsFS,
     &mlFS,
+#endif
     &t64FS, &tcrtFS
 //    &ipfsFS, &tcpFS,
 //    &tnfsFS
 };
 
+MPathResolver MFSOwner::resolver(MFSOwner::availableFS);
+
 bool MFSOwner::mount(std::string name) {
     Debug_print("MFSOwner::mount fs:");
     Debug_println(name.c_str());
@@ -195,17 +214,18 @@ MFile* MFSOwner::File(std::string path) {
 
     //Debug_printv("Trying to factory path [%s]", path.c_str());
 
-    auto pathIterator = paths.end();
-    auto begin = paths.begin();
-    auto end = paths.end();
-
-    auto foundFS = testScan(begin, end, pathIterator);
+    auto resolution = resolver.resolve(path, paths);
+    auto foundFS = resolution.fs;
 
     if(foundFS != nullptr) {
         //Debug_printv("PATH: '%s' is in FS [%s]", path.c_str(), foundFS->symbol);
         auto newFile = foundFS->getFile(path);
         //Debug_printv("newFile: '%s'", newFile->url.c_str());
 
+        auto begin = paths.begin();
+        auto end = paths.end();
+        auto pathIterator = begin + resolution.boundary;
+
         pathIterator++;
         newFile->pathInStream = mstr::joinToString(&pathIterator, &end, "/");
         //Debug_printv("newFile->pathInStream: '%s'", newFile->pathInStream.c_str());
@@ -220,21 +240,17 @@ MFile* MFSOwner::File(std::string path) {
         } 
         else 
         {
-            auto upperPath = mstr::joinToString(&begin, &pathIterator, "/");
-            //Debug_printv("** LOOK DOWN PATH: %s", upperPath.c_str());
-
-            auto upperFS = testScan(begin, end, pathIterator);
+            auto upperFS = resolution.upperFS;
 
             if(upperFS != nullptr) {
                 auto wholePath = mstr::joinToString(&begin, &endHere, "/");
 
-                //auto cp = mstr::joinToString(&begin, &pathIterator, "/");
                 //Debug_printv("CONTAINER PATH WILL BE: '%s' ", wholePath.c_str());
-                newFile->streamFile = upperFS->getFile(wholePath); // skończy się na d64
+                newFile->streamFile = containerFile(upperFS, paths, resolution.boundary); // skończy się na d64
                 //Debug_printv("CONTAINER: '%s' is in FS [%s]", newFile->streamFile->url.c_str(), upperFS->symbol);
             }
             else {
-                Debug_printv("WARNING!!!! CONTAINER FAILED FOR: '%s'", upperPath.c_str());
+                Debug_printv("WARNING!!!! CONTAINER FAILED FOR: '%s'", path.c_str());
             }
         }
 
@@ -244,6 +260,32 @@ MFile* MFSOwner::File(std::string path) {
     return nullptr;
 }
 
+MFile* MFSOwner::containerFile(MFileSystem* fs, std::vector<std::string> &paths, size_t end)
+{
+    auto begin = paths.begin();
+    auto endHere = begin + end + 1;
+    auto container = fs->getFile(mstr::joinToString(&begin, &endHere, "/"));
+
+    // An image inside another image (or archive) is a file in that one,
+    // so it gets a stream file and path of its own. Schemes ("http:") are
+    // where the path starts, not containers.
+    if (fs != availableFS.front() && end > 0 && container->streamFile == nullptr)
+    {
+        auto upperEnd = begin + end;
+        std::vector<std::string> upperPaths(begin, upperEnd);
+        auto resolution = resolver.resolve(mstr::joinToString(&begin, &upperEnd, "/"), upperPaths);
+
+        if (resolution.fs == fs && paths[resolution.boundary].find(':') == std::string::npos)
+        {
+            auto inner = begin + resolution.boundary + 1;
+            container->pathInStream = mstr::joinToString(&inner, &endHere, "/");
+            container->streamFile = containerFile(resolution.upperFS, paths, resolution.boundary);
+        }
+    }
+
+    return container;
+}
+
 std::string MFSOwner::existsLocal( std::string path )
 {
     auto url = PeoplesUrlParser::parseURL( path );
@@ -293,14 +335,10 @@ MFileSystem* MFSOwner::testScan(std::vector<std::string>::iterator &begin, std::
 
         //Debug_printv("index[%d] pathIterator[%s] size[%d]", pathIterator, pathIterator->c_str(), pathIterator->size());
 
-        auto foundIter=std::find_if(availableFS.begin() + 1, availableFS.end(), [&part](MFileSystem* fs){ 
-            //Debug_printv("symbol[%s]", fs->symbol);
-            return fs->handles(part); 
-        } );
-
-        if(foundIter != availableFS.end()) {
+        auto found = resolver.match(part);
+        if(found != nullptr) {
             //Debug_printv("matched part '%s'\r\n", part.c_str());
-            return (*foundIter);
+            return found;
         }
     };
 
@@ -400,6 +438,25 @@ MStream* MFile::getSourceStream(std::ios_base::openmode mode) {
     return decodedStream;
 };
 
+bool MFile::readEntry(MDirEntry &entry)
+{
+    std::unique_ptr<MFile> file(getNextFileInDir());
+    if (file == nullptr)
+        return false;
+
+    entry.setName(file->name.data(), file->name.size());
+    entry.setExtension(file->extension.data(), file->extension.size());
+    entry.flags = 0;
+    if (file->isDirectory())
+        entry.flags |= MDirEntry::DIRECTORY;
+    if (file->isPETSCII)
+        entry.flags |= MDirEntry::PETSCII;
+    entry.size = file->size();
+    entry.blocks = file->blocks();
+
+    return true;
+}
+
 MFile* MFile::cd(std::string newDir) 
 {
     Debug_printv("cd requested: [%s]", newDir.c_str());
@@ -1,6 +1,7 @@
 #ifndef MEATLOAF_FILE
 #define MEATLOAF_FILE
 
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
@@ -108,6 +109,7 @@ public:
     virtual bool isOpen() = 0;
     virtual bool isBrowsable() { return false; };
     virtual bool isRandomAccess() { return false; };
+    virtual bool canBlock() { return false; };  // reads may wait on a network or a decoder, worth reading ahead
 
     virtual void close() = 0;
     virtual bool open() = 0;
@@ -144,6 +146,60 @@ public:
     virtual bool seekBlock( uint64_t index, uint8_t offset = 0 ) { return false; };
     virtual bool seekSector( uint8_t track, uint8_t sector, uint8_t offset = 0 ) { return false; };
     virtual bool seekSector( std::vector<uint8_t> trackSectorOffset ) { return false; };
+
+    // DOS block commands on a direct access ("#") channel of a disk image
+    virtual bool blockRead( uint8_t track, uint8_t sector ) { return false; };     // U1
+    virtual bool blockWrite( uint8_t track, uint8_t sector ) { return false; };    // U2
+    virtual bool blockAllocate( uint8_t track, uint8_t sector ) { return false; }; // B-A
+    virtual bool blockFree( uint8_t track, uint8_t sector ) { return false; };     // B-F
+    virtual bool hasBAM() { return false; };  // B-A and B-F can be used
+    virtual bool isWriteProtected() { return false; };  // U2 fails with 26 write protect on
+
+    // Write out anything held back in memory
+    virtual bool flush() { return true; };
+};
+
+
+/********************************************************
+ * Directory entry
+ *
+ * What a listing needs to know about one entry of a
+ * directory. MFile::readEntry() fills one in place, so a
+ * directory can be walked with a single reused entry
+ * instead of an MFile per file.
+ ********************************************************/
+
+#define MDIRENTRY_NAME_MAX 255
+#define MDIRENTRY_EXTENSION_MAX 15
+
+struct MDirEntry {
+    enum : uint8_t {
+        DIRECTORY = 0x01,
+        PETSCII = 0x02     // name and extension are PETSCII, not UTF-8
+    };
+
+    char name[MDIRENTRY_NAME_MAX + 1];
+    uint8_t name_length;
+    char extension[MDIRENTRY_EXTENSION_MAX + 1];
+    uint8_t flags;
+    uint32_t size;      // bytes
+    uint32_t blocks;    // as the listing shows them
+
+    bool isDirectory() const { return flags & DIRECTORY; }
+    bool isPETSCII() const { return flags & PETSCII; }
+
+    void setName(const char *text, size_t length) {
+        name_length = (length > MDIRENTRY_NAME_MAX) ? MDIRENTRY_NAME_MAX : length;
+        memcpy(name, text, name_length);
+        name[name_length] = '\0';
+    }
+
+    void setExtension(const char *text, size_t length) {
+        if (length > MDIRENTRY_EXTENSION_MAX)
+            length = MDIRENTRY_EXTENSION_MAX;
+        memcpy(extension, text, length);
+        extension[length] = '\0';
+    }
 };
 
 
@@ -193,6 +249,10 @@ public:
     virtual bool isDirectory() = 0;
     virtual bool rewindDirectory() = 0 ;
     virtual MFile* getNextFileInDir() = 0 ;
+    // Next entry of the directory into entry, false at the end like getNextFileInDir().
+    // The default goes through getNextFileInDir(), override it where the entry can be
+    // read straight from the directory.
+    virtual bool readEntry(MDirEntry &entry);
     virtual bool mkDir() = 0 ;    
 
     virtual bool exists() { return _exists; };
@@ -273,9 +333,12 @@ protected:
  * MFile factory
  ********************************************************/
 
+class MPathResolver;
+
 class MFSOwner {
 public:
     static std::vector<MFileSystem*> availableFS;
+    static MPathResolver resolver;
 
     static MFile* File(std::string name);
     static MFile* File(std::shared_ptr<MFile> file);
@@ -283,6 +346,9 @@ public:
 
     static MFileSystem* scanPathLeft(std::vector<std::string> paths, std::vector<std::string>::iterator &pathIterator);
 
+    // File for the container ending at paths[end], with its own container set up when it is in one
+    static MFile* containerFile(MFileSystem* fs, std::vector<std::string> &paths, size_t end);
+
     static std::string existsLocal( std::string path );
     static MFileSystem* testScan(std::vector<std::string>::iterator &begin, std::vector<std::string>::iterator &end, std::vector<std::string>::iterator &pathIterator);
 
@@ -2,6 +2,9 @@
 
 #include <esp_idf_version.h>
 
+#include <algorithm>
+#include <cstring>
+
 #include "../../../include/debug.h"
 #include "../../../include/global_defines.h"
 
@@ -154,18 +157,74 @@ bool HttpIStream::open() {
 
 void HttpIStream::close() {
     //Debug_printv("CLOSE called explicitly on this HTTP stream!");    
+    _cache.reset();
     _http.close();
 }
 
+bool HttpIStream::startCache() {
+    if ( _http.isFriendlySkipper )
+    {
+        // The open GET is used for as long as the reads carry on from where it is
+        std::unique_ptr<MPageCache> cache( new MPageCache(_size, [this](uint32_t offset, uint8_t* buf, uint32_t length, uint32_t run) {
+            return _http.readRange(offset, buf, length, run);
+        }) );
+        if ( !cache->valid() )
+            return false;
+
+        _http._range_end = _size;
+        _cache = std::move(cache);
+        return true;
+    }
+
+    // No ranges, download it once into a spill file as far as the reads need it
+    char spill[40];
+    snprintf(spill, sizeof spill, SYSTEM_DIR "/http%08x.tmp", (unsigned int)std::hash<std::string>{}(url));
+
+    std::unique_ptr<MPageCache> cache( new MPageCache(_size, nullptr) );
+    if ( !cache->valid() || !cache->spill(spill, [this](uint8_t* buf, uint32_t length) {
+            return (int32_t)_http.read(buf, length);
+        }) )
+        return false;
+
+    // The body has to be copied from the start
+    if ( _http._position != 0 )
+    {
+        _http.close();
+        if ( !_http.GET(url) )
+            return false;
+    }
+
+    _cache = std::move(cache);
+    return true;
+}
+
 bool HttpIStream::seek(uint32_t pos) {
-    if ( !_http._is_open )
+    if ( !_http._is_open && _cache == nullptr )
     {
         Debug_printv("error");
         _error = 1;
         return false;
     }
 
-    return _http.seek(pos);
+    if ( pos == _position )
+        return true;
+
+    if ( _cache == nullptr && (_no_cache || !startCache()) )
+    {
+        // No memory for the pages or nowhere to spill to, reopen and skip
+        _no_cache = true;
+        if ( !_http.seek(pos) )
+            return false;
+
+        _position = pos;
+        return true;
+    }
+
+    if ( pos > _size )
+        return false;
+
+    _position = pos;
+    return true;
 }
 
 uint32_t HttpIStream::read(uint8_t* buf, uint32_t size) {
@@ -175,9 +234,17 @@ uint32_t HttpIStream::read(uint8_t* buf, uint32_t size) {
     
     if ( size > 0 )
     {
-        bytesRead = _http.read(buf, size);
+        if ( _cache != nullptr )
+        {
+            bytesRead = _cache->read(_position, buf, size);
+            _error = ( bytesRead < size ) ? 1 : 0;
+        }
+        else
+        {
+            bytesRead = _http.read(buf, size);
+            _error = _http._error;
+        }
         _position += bytesRead;
-        _error = _http._error;
     }
 
     return bytesRead;
@@ -261,6 +328,8 @@ bool MeatHttpClient::processRedirectsAndOpen(int range) {
     _is_open = true;
     _exists = true;
     _position = 0;
+    _received = 0;
+    _window_fill = 0;
 
     Debug_printv("size[%d] avail[%d] isFriendlySkipper[%d] isText[%d] httpCode[%d] method[%d]", _size, available(), isFriendlySkipper, isText, lastRC, lastMethod);
 
@@ -281,7 +350,7 @@ void MeatHttpClient::close() {
             esp_http_client_close(_http);
         }
         esp_http_client_cleanup(_http);
-        Debug_printv("HTTP Close and Cleanup");
+        Debug_printv("HTTP Close and Cleanup discarded[%u]", _discarded);
         _http = nullptr;
     }
     _is_open = false;
@@ -295,6 +364,12 @@ bool MeatHttpClient::seek(uint32_t pos) {
     if(pos==_position)
         return true;
 
+    // Still in the window of what was read last?
+    if(pos <= _received && pos >= _received - _window_fill) {
+        _position = pos;
+        return true;
+    }
+
     if(isFriendlySkipper) {
         esp_http_client_close(_http);
 
@@ -311,6 +386,7 @@ bool MeatHttpClient::seek(uint32_t pos) {
             Debug_printv("Seek successful");
 
             _position = pos;
+            _received = pos;
             return true;
         }
     }
@@ -318,34 +394,22 @@ bool MeatHttpClient::seek(uint32_t pos) {
     if(lastMethod == HTTP_METHOD_GET) {
         Debug_printv("Server doesn't support resume, reading from start and discarding");
         // server doesn't support resume, so...
-        if(pos<_position || pos == 0) {
-            // skipping backward let's simply reopen the stream...
+        if(_window.empty())
+            _window.resize(HTTP_WINDOW_SIZE);
+
+        if(pos < _received) {
+            // skipping backward past the window let's simply reopen the stream...
             esp_http_client_close(_http);
             bool op = open(url, lastMethod);
             if(!op)
                 return false;
-
-            // and read pos bytes - requires some buffer
-            for(int i = 0; i<pos; i++) {
-                char c;
-                int rc = esp_http_client_read(_http, &c, 1);
-                if(rc == -1)
-                    return false;
-            }
-        }
-        else {
-            auto delta = pos-_position;
-            // skipping forward let's skip a proper amount of bytes - requires some buffer
-            for(int i = 0; i<delta; i++) {
-                char c;
-                int rc = esp_http_client_read(_http, &c, 1);
-                if(rc == -1)
-                    return false;
-            }
         }
 
+        if(!skip(pos - _received))
+            return false;
+
         _position = pos;
-        Debug_printv("stream opened[%s]", url.c_str());
+        Debug_printv("stream opened[%s] discarded[%u]", url.c_str(), _discarded);
 
         return true;
     }
@@ -353,6 +417,45 @@ bool MeatHttpClient::seek(uint32_t pos) {
         return false;
 }
 
+bool MeatHttpClient::skip(uint32_t delta) {
+    // Drain in big reads, what goes through still ends up in the window
+    uint8_t scratch[HTTP_SKIP_CHUNK];
+
+    while(delta > 0) {
+        int rc = esp_http_client_read(_http, (char *)scratch, std::min<uint32_t>(delta, sizeof(scratch)));
+        if(rc <= 0)
+            return false;
+
+        remember(scratch, rc);
+        _discarded += rc;
+        delta -= rc;
+    }
+
+    _position = _received;
+    return true;
+}
+
+// Keep the last HTTP_WINDOW_SIZE bytes received, once a seek has happened
+void MeatHttpClient::remember(const uint8_t* buf, uint32_t size) {
+    uint32_t end = _received + size;
+    _received = end;
+
+    if(_window.empty())
+        return;
+
+    if(size > _window.size()) {
+        buf += size - _window.size();
+        size = _window.size();
+    }
+
+    uint32_t offset = (end - size) % _window.size();
+    uint32_t n = std::min<uint32_t>(size, _window.size() - offset);
+    memcpy(_window.data() + offset, buf, n);
+    memcpy(_window.data(), buf + n, size - n);
+
+    _window_fill = std::min<uint32_t>(_window_fill + size, _window.size());
+}
+
 uint32_t MeatHttpClient::read(uint8_t* buf, uint32_t size) {
 
     if (!_is_open) {
@@ -361,16 +464,91 @@ uint32_t MeatHttpClient::read(uint8_t* buf, uint32_t size) {
     }
 
     if (_is_open) {
+        // Replay from the window after a short seek back
+        if (_position < _received) {
+            uint32_t n = std::min<uint32_t>(size, _received - _position);
+            uint32_t offset = _position % _window.size();
+            uint32_t first = std::min<uint32_t>(n, _window.size() - offset);
+            memcpy(buf, _window.data() + offset, first);
+            memcpy(buf + first, _window.data(), n - first);
+            _position += n;
+            return n;
+        }
+
         auto bytesRead= esp_http_client_read(_http, (char *)buf, size );
         
         if(bytesRead>0) {
-            _position+=bytesRead;
+            remember(buf, bytesRead);
+            _position = _received;
         }
         return bytesRead;        
     }
     return 0;
 };
 
+int32_t MeatHttpClient::readRange(uint32_t offset, uint8_t* buf, uint32_t length, uint32_t run) {
+    // Carry on with the open response if it is already there
+    if ( !_is_open || offset != _position || offset + length > _range_end )
+    {
+        int rc = requestRange(offset, offset + run);
+        if ( rc != 206 && !(rc == HttpStatus_Ok && offset == 0) )
+        {
+            Debug_printv("Range request failed offset[%u] run[%u] httpCode[%d]", offset, run, rc);
+            return -1;
+        }
+    }
+
+    uint32_t total = 0;
+    while ( total < length )
+    {
+        int bytesRead = esp_http_client_read(_http, (char *)buf + total, length - total);
+        if ( bytesRead <= 0 )
+            break;
+
+        total += bytesRead;
+    }
+    _position += total;
+    _received = _position;
+
+    return total;
+}
+
+int MeatHttpClient::requestRange(uint32_t start, uint32_t end) {
+    // Content-Length of a range response isn't the size of the resource
+    uint32_t size = _size;
+    int rc = 0;
+
+    char str[40];
+    snprintf(str, sizeof str, "bytes=%lu-%lu", (unsigned long)start, (unsigned long)end - 1);
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    if ( _http != nullptr && _is_open )
+    {
+        // Drain what is left of the last response, then ask again on the same connection
+        esp_http_client_flush_response(_http, nullptr);
+        esp_http_client_set_header(_http, "range", str);
+        if ( esp_http_client_open(_http, 0) == ESP_OK && esp_http_client_fetch_headers(_http) >= 0 )
+            rc = esp_http_client_get_status_code(_http);
+    }
+#endif
+
+    if ( rc != 206 )
+    {
+        // The server let the connection go, start a new one
+        close();
+        rc = openAndFetchHeaders(HTTP_METHOD_GET, start, end);
+    }
+
+    _size = size;
+    _is_open = ( rc == 206 || rc == HttpStatus_Ok );
+    _position = start;
+    _received = start;
+    _window_fill = 0;
+    _range_end = ( rc == 206 ) ? end : _size;
+
+    return rc;
+}
+
 uint32_t MeatHttpClient::write(const uint8_t* buf, uint32_t size) {
     if (!_is_open) 
     {
@@ -386,7 +564,7 @@ uint32_t MeatHttpClient::write(const uint8_t* buf, uint32_t size) {
     return 0;
 };
 
-int MeatHttpClient::openAndFetchHeaders(esp_http_client_method_t meth, int resume) {
+int MeatHttpClient::openAndFetchHeaders(esp_http_client_method_t meth, int resume, int end) {
 
     if ( url.size() < 5)
         return 0;
@@ -414,7 +592,12 @@ int MeatHttpClient::openAndFetchHeaders(esp_http_client_method_t meth, int resum
         esp_http_client_set_header(_http, pair.first.c_str(), pair.second.c_str());
     }
 
-    if(resume > 0) {
+    if(end > 0) {
+        char str[40];
+        snprintf(str, sizeof str, "bytes=%lu-%lu", (unsigned long)resume, (unsigned long)end - 1);
+        esp_http_client_set_header(_http, "range", str);
+    }
+    else if(resume > 0) {
         char str[40];
         snprintf(str, sizeof str, "bytes=%lu-", (unsigned long)resume);
         esp_http_client_set_header(_http, "range", str);
@@ -13,13 +13,18 @@
 #include <esp_http_client.h>
 #include <functional>
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "../../../include/debug.h"
 //#include "../../include/global_defines.h"
 //#include "../../include/version.h"
 #include "utils.h"
+#include "../wrappers/page_cache.h"
 
 #define HTTP_BLOCK_SIZE 256
+#define HTTP_SKIP_CHUNK 1024    // bytes per read when skipping forward without ranges
+#define HTTP_WINDOW_SIZE 4096   // recently read bytes kept for short seeks back
 
 //#define PRODUCT_ID "MEATLOAF CBM"
 //#define PLATFORM_DETAILS "C64; 6510; 2; NTSC; EN;" // Make configurable. This will help server side to select appropriate content.
@@ -28,7 +33,7 @@
 class MeatHttpClient {
     esp_http_client_handle_t _http = nullptr;
     static esp_err_t _http_event_handler(esp_http_client_event_t *evt);
-    int openAndFetchHeaders(esp_http_client_method_t meth, int resume = 0);
+    int openAndFetchHeaders(esp_http_client_method_t meth, int resume = 0, int end = 0);
     esp_http_client_method_t lastMethod;
     std::function<int(char*, char*)> onHeader = [] (char* key, char* value){ 
         //Debug_printv("HTTP_EVENT_ON_HEADER, key=%s, value=%s", key, value);
@@ -37,6 +42,12 @@ class MeatHttpClient {
 
     std::map<std::string, std::string> headers;
 
+    // Without range support seeks have to read their way there
+    bool skip(uint32_t delta);
+    void remember(const uint8_t* buf, uint32_t size);
+    std::vector<uint8_t> _window;   // ring of the bytes before _received, set up on the first seek
+    uint32_t _window_fill = 0;
+
 public:
 
     MeatHttpClient() {
@@ -73,6 +84,12 @@ public:
     uint32_t read(uint8_t* buf, uint32_t size);
     uint32_t write(const uint8_t* buf, uint32_t size);
 
+    // Read length bytes at offset for MPageCache, asking for offset..offset+run
+    // in one range request, on the same connection when the server keeps it alive
+    int32_t readRange(uint32_t offset, uint8_t* buf, uint32_t length, uint32_t run);
+    int requestRange(uint32_t start, uint32_t end);
+    uint32_t _range_end = 0;    // end of the range the open response covers
+
     bool _is_open = false;
     bool _exists = false;
 
@@ -83,6 +100,8 @@ public:
     uint32_t _size = 0;
     // uint32_t m_bytesAvailable = 0;
     uint32_t _position = 0;
+    uint32_t _received = 0;     // bytes of the response read off the connection, _position is behind after a seek back
+    uint32_t _discarded = 0;    // bytes read only to get to a seek position, for this client
     size_t _error = 0;
 
     bool m_isWebDAV = false;
@@ -168,10 +187,15 @@ public:
     uint32_t write(const uint8_t *buf, uint32_t size) override;
 
     bool isOpen() override;
+    bool canBlock() override { return true; };
 
 protected:
     MeatHttpClient _http;
 
+    // Set up on the first seek, reads only ever moving forward go straight through
+    std::unique_ptr<MPageCache> _cache;
+    bool _no_cache = false;     // startCache() failed, seek on the connection instead
+    bool startCache();
 };
 
 
@@ -225,6 +225,10 @@ public:
     uint32_t available() override {
         return 0;
     }
+    // No size to run out of, the stream ends when the connection does
+    bool eos() override {
+        return !isOpen();
+    }
     uint32_t position() override {
         return 0;
     }
@@ -245,6 +249,8 @@ public:
         return socket.open(p->host.c_str(), p->getPort());
     }
 
+    bool canBlock() override { return true; };
+
     // MStream methods
     uint32_t read(uint8_t* buf, uint32_t size) override {
         return socket.read(buf, size);
@@ -60,7 +60,8 @@ MStream* TNFSFile::getSourceStream(std::ios_base::openmode mode)
 time_t TNFSFile::getLastWrite()
 {
     struct stat info;
-    stat( std::string(basepath + path).c_str(), &info);
+    if ( stat( std::string(basepath + path).c_str(), &info) != 0 )
+        return 0;
 
     time_t ftime = info.st_mtime; // Time of last modification
     return ftime;
@@ -69,7 +70,8 @@ time_t TNFSFile::getLastWrite()
 time_t TNFSFile::getCreationTime()
 {
     struct stat info;
-    stat( std::string(basepath + path).c_str(), &info);
+    if ( stat( std::string(basepath + path).c_str(), &info) != 0 )
+        return 0;
 
     time_t ftime = info.st_ctime; // Time of last status change
     return ftime;
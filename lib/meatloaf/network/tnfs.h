@@ -116,6 +116,7 @@ public:
 
     bool isBrowsable() override { return false; };
     bool isRandomAccess() override { return true; };
+    bool canBlock() override { return true; };
 
     virtual bool seek(uint32_t pos) override;
     virtual bool seek(uint32_t pos, int mode) override;    
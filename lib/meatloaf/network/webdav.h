@@ -51,6 +51,8 @@ public:
     void close() override;
     bool open() override;
 
+    bool canBlock() override { return true; };
+
     // MStream methods
     uint32_t position() override;
     uint32_t available() override;
@@ -92,6 +94,8 @@ public:
     void close() override;
     bool open() override;
 
+    bool canBlock() override { return true; };
+
     // MStream methods
     uint32_t read(uint8_t* buf, uint32_t size) override;
     bool isOpen();
@@ -134,6 +138,8 @@ public:
     bool open() override;
 
 
+    bool canBlock() override { return true; };
+
     // MStream methods
     size_t write(const uint8_t *buf, size_t size) override;
     bool isOpen();
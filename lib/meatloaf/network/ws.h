@@ -48,6 +48,8 @@ public:
         return _is_open;
     };
 
+    bool canBlock() override { return true; };
+
     // MStream methods
     uint32_t position() override { return 0; };
     uint32_t available() override { return INT_MAX; };
@@ -273,6 +273,7 @@ public:
     uint32_t read(uint8_t* buf, uint32_t size) override;
     uint32_t write(const uint8_t *buf, uint32_t size) override;
     bool isOpen() override;
+    bool canBlock() override { return true; };
 
 protected:
     std::string url;
@@ -92,24 +92,20 @@ bool T64MStream::seekEntry( uint16_t index )
 uint16_t T64MStream::readFile(uint8_t* buf, uint16_t size) {
     uint16_t bytesRead = 0;
 
-    if ( _position < 2)
+    // Load address first, it isn't stored with the data
+    while ( _position + bytesRead < 2 && bytesRead < size )
     {
         //Debug_printv("position[%d] load00[%d] load01[%d]", _position, _load_address[0], _load_address[1]);
-
-        buf[0] = _load_address[_position];
-        bytesRead = size;
-        // if ( size > 1 )
-        // {
-        //     buf[0] = m_load_address[0];
-        //     buf[1] = m_load_address[1];
-        //     bytesRead += containerStream->read(buf, size);
-        // }
-    }
-    else
-    {
-        bytesRead += containerStream->read(buf, size);
+        buf[bytesRead] = _load_address[_position + bytesRead];
+        bytesRead++;
     }
 
+    if ( size > available() )
+        size = available();
+
+    if ( bytesRead < size )
+        bytesRead += containerStream->read(buf + bytesRead, size - bytesRead);
+
     return bytesRead;
 }
 
@@ -172,6 +168,7 @@ bool T64MFile::rewindDirectory() {
     auto image = ImageBroker::obtain<T64MStream>(streamFile->url);
     if ( image == nullptr )
         Debug_printv("image pointer is null");
+    dir_image = image;
 
     image->resetEntryCounter();
 
@@ -196,8 +193,8 @@ MFile* T64MFile::getNextFileInDir() {
     if(!dirIsOpen)
         rewindDirectory();
 
-    // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<T64MStream>(streamFile->url);
+    // Held since rewindDirectory(), so it isn't let go in the middle of the listing
+    auto image = dir_image;
 
     if ( image->seekNextImageEntry() )
     {
@@ -214,6 +211,7 @@ MFile* T64MFile::getNextFileInDir() {
     {
         //Debug_printv( "END OF DIRECTORY");
         dirIsOpen = false;
+        dir_image.reset();
         return nullptr;
     }
 }
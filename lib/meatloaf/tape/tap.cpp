@@ -136,6 +136,7 @@ bool TAPMFile::rewindDirectory() {
     auto image = ImageBroker::obtain<TAPMStream>(streamFile->url);
     if ( image == nullptr )
         Debug_printv("image pointer is null");
+    dir_image = image;
 
     image->resetEntryCounter();
 
@@ -160,8 +161,8 @@ MFile* TAPMFile::getNextFileInDir() {
     if(!dirIsOpen)
         rewindDirectory();
 
-    // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<TAPMStream>(streamFile->url);
+    // Held since rewindDirectory(), so it isn't let go in the middle of the listing
+    auto image = dir_image;
 
     if ( image->seekNextImageEntry() )
     {
@@ -176,6 +177,7 @@ MFile* TAPMFile::getNextFileInDir() {
     {
         //Debug_printv( "END OF DIRECTORY");
         dirIsOpen = false;
+        dir_image.reset();
         return nullptr;
     }
 }
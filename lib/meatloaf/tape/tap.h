@@ -27,6 +27,8 @@ class TAPMStream : public MMediaStream {
 public:
     TAPMStream(std::shared_ptr<MStream> is) : MMediaStream(is) { };
 
+    size_t footprint() override { return sizeof(*this) + directory_index.bytes(); }
+
 protected:
     struct Header {
         char disk_name[24];
@@ -101,6 +103,9 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+
+private:
+    std::shared_ptr<TAPMStream> dir_image;  // the image being listed, while dirIsOpen
 };
 
 
@@ -210,6 +210,7 @@ bool TCRTMFile::rewindDirectory() {
     auto image = ImageBroker::obtain<TCRTMStream>(streamFile->url);
     if ( image == nullptr )
         Debug_printv("image pointer is null");
+    dir_image = image;
 
     image->resetEntryCounter();
 
@@ -234,8 +235,8 @@ MFile* TCRTMFile::getNextFileInDir() {
     if(!dirIsOpen)
         rewindDirectory();
 
-    // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<TCRTMStream>(streamFile->url);
+    // Held since rewindDirectory(), so it isn't let go in the middle of the listing
+    auto image = dir_image;
 
     bool r = false;
     do
@@ -256,6 +257,7 @@ MFile* TCRTMFile::getNextFileInDir() {
     {
         //Debug_printv( "END OF DIRECTORY");
         dirIsOpen = false;
+        dir_image.reset();
         return nullptr;
     }
 }
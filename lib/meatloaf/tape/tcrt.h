@@ -21,6 +21,8 @@ class TCRTMStream : public MMediaStream {
 public:
     TCRTMStream(std::shared_ptr<MStream> is) : MMediaStream(is) {};
 
+    size_t footprint() override { return sizeof(*this) + directory_index.bytes(); }
+
 protected:
     struct Header {
         char disk_name[16];
@@ -102,6 +104,9 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+
+private:
+    std::shared_ptr<TCRTMStream> dir_image;  // the image being listed, while dirIsOpen
 };
 
 
@@ -0,0 +1,244 @@
+#include "block_buffer.h"
+
+#ifndef ESP_PLATFORM
+#include <unistd.h>
+#endif
+
+#include "../../../include/debug.h"
+
+/********************************************************
+ * MBlockBuffer
+ ********************************************************/
+
+MBlockBuffer::MBlockBuffer(std::shared_ptr<MStream> source, size_t block_size, size_t block_count)
+{
+    _source = source;
+    _block_size = block_size;
+    _capacity = block_size * block_count;
+    _data = new uint8_t[_capacity];
+    _position = _source->position();
+    _size = _source->size();
+}
+
+MBlockBuffer::~MBlockBuffer()
+{
+    // The task holds a reference, so it is gone by now
+    if (_data != nullptr)
+        delete[] _data;
+}
+
+size_t MBlockBuffer::fill()
+{
+    if (!_prefetching && !_producer_running)
+        return readAhead();
+
+    // Only the producer may touch the source, so wait for it to catch up,
+    // or to let go of it after stopPrefetch()
+    if (buffered() <= 1 && !_source_eos && !_error)
+    {
+        if (!_starved)
+            _underruns++;
+        _starved = true;
+
+#ifdef ESP_PLATFORM
+        _consumer = xTaskGetCurrentTaskHandle();
+        _consumer_waiting = true;
+        if (buffered() <= 1 && !_source_eos && !_error)
+            ulTaskNotifyTake(pdTRUE, 1);
+        _consumer_waiting = false;
+#else
+        usleep(1000);
+#endif
+    }
+    else
+    {
+        _starved = false;
+    }
+
+    return buffered();
+}
+
+size_t MBlockBuffer::readAhead()
+{
+    size_t count = 0;
+
+    while (!_source_eos && !_error)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t room = _capacity - (head - _tail.load(std::memory_order_acquire));
+        if (room == 0)
+            break;
+
+        // Keep the ring block aligned, a short read leaves the rest of
+        // the block to be topped up on the next call
+        size_t want = _block_size - (head % _block_size);
+        if (want > room)
+            want = room;
+
+        uint32_t got = _source->read(_data + (head % _capacity), want);
+        if (_source->error() || got > want)
+        {
+            Debug_printv("Error reading stream.");
+            _error = true;
+            break;
+        }
+
+        _head.store(head + got, std::memory_order_release);
+        count += got;
+
+        // End of stream is worked out once per block, not once per byte. A
+        // source with no data available yet (NDA) is asked again next time.
+        if (got < want)
+        {
+            if (_source->eos())
+                _source_eos = true;
+            break;
+        }
+    }
+
+    return count;
+}
+
+size_t MBlockBuffer::peek(const uint8_t **data)
+{
+    bool eos = _source_eos;
+    size_t index = _tail.load(std::memory_order_relaxed) % _capacity;
+    size_t count = buffered();
+
+    // Hold back the final buffered byte until we know if it is the last one
+    if (!eos && count > 0)
+        count--;
+
+    if (count > _capacity - index)
+        count = _capacity - index;
+
+    *data = _data + index;
+    return count;
+}
+
+void MBlockBuffer::consume(size_t count)
+{
+    if (count > buffered())
+        count = buffered();
+
+    _tail.store(_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    _position += count;
+
+    if (_prefetching)
+        wakeProducer();
+}
+
+/********************************************************
+ * Background prefetch
+ ********************************************************/
+
+bool MBlockBuffer::startPrefetch()
+{
+    if (_prefetching || _producer_running || _source_eos || _error)
+        return _prefetching;
+
+    // Local sources are read inline, a task would only add latency
+    if (!_source->canBlock())
+        return false;
+
+    // The task keeps the buffer alive until it returns
+    auto self = weak_from_this().lock();
+    if (self == nullptr)
+    {
+        Debug_printv("Buffer not shared, reading inline.");
+        return false;
+    }
+    auto *arg = new std::shared_ptr<MBlockBuffer>(self);
+
+    _prefetching = true;
+    _producer_running = true;
+#ifdef ESP_PLATFORM
+    if (xTaskCreate((TaskFunction_t)prefetchTask, "prefetch", BLOCK_BUFFER_TASK_STACKSIZE, arg, BLOCK_BUFFER_TASK_PRIORITY, &_producer) != pdPASS)
+        _prefetching = false;
+#else
+    pthread_t producer;
+    if (pthread_create(&producer, nullptr, prefetchTask, arg) == 0)
+        pthread_detach(producer);
+    else
+        _prefetching = false;
+#endif
+
+    if (!_prefetching)
+    {
+        Debug_printv("Could not start prefetch task, reading inline.");
+        _producer_running = false;
+        delete arg;
+    }
+
+    return _prefetching;
+}
+
+void MBlockBuffer::stopPrefetch()
+{
+    // No waiting here, a read stuck in the network would hold up the bus
+    _prefetching = false;
+}
+
+void MBlockBuffer::closeSource()
+{
+    _close_source = true;
+    if (!_producer_running && _close_source.exchange(false))
+        _source->close();
+}
+
+void *MBlockBuffer::prefetchTask(void *arg)
+{
+    auto *self = (std::shared_ptr<MBlockBuffer> *)arg;
+    (*self)->prefetch();
+    delete self;
+#ifdef ESP_PLATFORM
+    vTaskDelete(NULL);
+#endif
+    return nullptr;
+}
+
+void MBlockBuffer::prefetch()
+{
+    while (_prefetching && !_source_eos && !_error)
+    {
+        if (readAhead())
+        {
+            wakeConsumer();
+            continue;
+        }
+
+        // Ring is full (or the source had nothing for us), wait for room
+        _producer_waiting = true;
+#ifdef ESP_PLATFORM
+        if (_prefetching)
+            ulTaskNotifyTake(pdTRUE, 1);
+#else
+        usleep(500);
+#endif
+        _producer_waiting = false;
+    }
+
+    // Make sure the consumer sees end of stream or error
+    wakeConsumer();
+
+    // Whoever gets here second closes the source
+    _producer_running = false;
+    if (_close_source.exchange(false))
+        _source->close();
+}
+
+void MBlockBuffer::wakeProducer()
+{
+#ifdef ESP_PLATFORM
+    if (_producer_waiting)
+        xTaskNotifyGive(_producer);
+#endif
+}
+
+void MBlockBuffer::wakeConsumer()
+{
+#ifdef ESP_PLATFORM
+    if (_consumer_waiting && _consumer != nullptr)
+        xTaskNotifyGive(_consumer);
+#endif
+}
@@ -0,0 +1,170 @@
+#ifndef MEATLOAF_WRAPPER_BLOCK_BUFFER
+#define MEATLOAF_WRAPPER_BLOCK_BUFFER
+
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <pthread.h>
+#endif
+
+#if HOST_OS==win32
+#include "../meatloaf.h"
+#else
+#include "meatloaf.h"
+#endif
+
+#define BLOCK_BUFFER_BLOCK_SIZE 256
+#define BLOCK_BUFFER_BLOCK_COUNT 4
+#define BLOCK_BUFFER_PREFETCH_BLOCKS 16 // 4KB read ahead with 256 byte blocks
+
+#define BLOCK_BUFFER_TASK_STACKSIZE 4096
+#define BLOCK_BUFFER_TASK_PRIORITY 5
+
+/********************************************************
+ * MBlockBuffer
+ *
+ * Ring of fixed size blocks filled from an MStream ahead
+ * of the bus, so senders can push bytes out of contiguous
+ * memory instead of calling read() for every byte.
+ *
+ * - the source is read one whole block at a time
+ * - end of stream is detected once per block, when a block
+ *   comes back short, so the last byte (EOI) is known
+ *   before it is sent
+ * - a read that comes back empty before the source's eos()
+ *   means no data available yet (NDA), not end of stream
+ * - bytes that were peeked but not consumed stay in the
+ *   ring, so an interrupted transfer (ATN pulled) resumes
+ *   from the ring without seeking the source back
+ *
+ * With startPrefetch() the ring is filled by a background
+ * task (a pthread on the host build) and the bus task only
+ * consumes, so a network stall only stalls the bus once
+ * the read ahead has run dry. The ring is single producer,
+ * single consumer and lock free.
+ *
+ * The task holds its own reference to the buffer, so
+ * stopPrefetch() and dropping the buffer never wait on a
+ * read that is stuck in the network; the task lets go
+ * when that read returns.
+ ********************************************************/
+
+class MBlockBuffer : public std::enable_shared_from_this<MBlockBuffer> {
+public:
+    MBlockBuffer(std::shared_ptr<MStream> source, size_t block_size = BLOCK_BUFFER_BLOCK_SIZE, size_t block_count = BLOCK_BUFFER_BLOCK_COUNT);
+    ~MBlockBuffer();
+
+    MBlockBuffer(const MBlockBuffer&) = delete;
+    MBlockBuffer& operator=(const MBlockBuffer&) = delete;
+
+    // Read whole blocks from the source into every free slot of the ring,
+    // while prefetching this waits for the background task instead
+    size_t fill();
+
+    // Get a pointer to the longest contiguous run of buffered bytes, the last
+    // buffered byte is only handed out once it is known whether it ends the stream
+    size_t peek(const uint8_t **data);
+
+    // Mark bytes returned by peek() as sent
+    void consume(size_t count);
+
+    // Hand filling over to a background task, only for a buffer owned by a
+    // shared_ptr and a source that can stall (see MStream::canBlock())
+    bool startPrefetch();
+
+    // Tell the task to stop, it returns once its current read does
+    void stopPrefetch();
+
+    // Close the source once the task is done with it, now if it already is
+    void closeSource();
+
+    bool isPrefetching() {
+        return _prefetching;
+    }
+
+    // Is the task still reading from the source?
+    bool busy() {
+        return _producer_running;
+    }
+
+    // Is the byte at offset from the read pointer the last byte of the stream?
+    bool isLast(size_t offset = 0) {
+        return _source_eos && (buffered() - offset) == 1;
+    }
+
+    bool eos() {
+        return _source_eos && buffered() == 0;
+    }
+
+    bool error() {
+        return _error;
+    }
+
+    // Ring depth and fill level in bytes
+    size_t depth() {
+        return _capacity;
+    }
+    size_t buffered() {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    // Number of times the consumer found the ring empty while the source
+    // still had data, i.e. the network was the bottleneck
+    uint32_t underruns() {
+        return _underruns;
+    }
+
+    // Source position of the next byte to be consumed
+    uint32_t position() {
+        return _position;
+    }
+
+    uint32_t size() {
+        return _size;
+    }
+
+private:
+    std::shared_ptr<MStream> _source;
+
+    uint8_t *_data = nullptr;
+    size_t _block_size;
+    size_t _capacity;
+
+    // Running byte counters, index into _data modulo _capacity
+    std::atomic<size_t> _head{0};   // only written by the producer
+    std::atomic<size_t> _tail{0};   // only written by the consumer
+
+    std::atomic<bool> _source_eos{false};
+    std::atomic<bool> _error{false};
+
+    uint32_t _position = 0;
+    uint32_t _size = 0;
+    uint32_t _underruns = 0;
+    bool _starved = false;
+
+    // Background producer
+    std::atomic<bool> _prefetching{false};
+    std::atomic<bool> _producer_running{false};
+    std::atomic<bool> _producer_waiting{false};
+    std::atomic<bool> _consumer_waiting{false};
+    std::atomic<bool> _close_source{false};
+#ifdef ESP_PLATFORM
+    TaskHandle_t _producer = nullptr;
+    TaskHandle_t _consumer = nullptr;
+#endif
+
+    size_t readAhead();
+    void prefetch();
+    void wakeProducer();
+    void wakeConsumer();
+
+    static void *prefetchTask(void *arg);
+};
+
+#endif /* MEATLOAF_WRAPPER_BLOCK_BUFFER */
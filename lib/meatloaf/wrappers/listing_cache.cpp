@@ -0,0 +1,247 @@
+#include "listing_cache.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+#include "../../../include/debug.h"
+
+/********************************************************
+ * MListing
+ ********************************************************/
+
+MListing::MListing(uint16_t load_address)
+{
+    uint8_t address[2] = { (uint8_t)(load_address & 0xFF), (uint8_t)(load_address >> 8) };
+    append(address, sizeof(address));
+}
+
+MListing::~MListing()
+{
+    if (_data != nullptr)
+        free(_data);
+}
+
+bool MListing::append(const uint8_t *data, size_t length)
+{
+    if (_size + length > _capacity)
+    {
+        size_t capacity = _capacity ? _capacity : 1024;
+        while (capacity < _size + length)
+            capacity *= 2;
+
+        uint8_t *grown = nullptr;
+#ifdef ESP_PLATFORM
+        grown = (uint8_t *)heap_caps_realloc(_data, capacity, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        if (grown == nullptr)
+#endif
+        grown = (uint8_t *)realloc(_data, capacity);
+        if (grown == nullptr)
+        {
+            Debug_printv("Out of memory for listing size[%d]", (int)(_size + length));
+            return false;
+        }
+
+        _data = grown;
+        _capacity = capacity;
+    }
+
+    memcpy(_data + _size, data, length);
+    _size += length;
+    return true;
+}
+
+uint16_t MListing::line(uint16_t blocks, const char *text, size_t length)
+{
+    // No basic line pointer is used in the directory listing set to 0x0101
+    uint8_t start[4] = { 0x01, 0x01, (uint8_t)(blocks & 0xFF), (uint8_t)(blocks >> 8) };
+    uint8_t end = 0;
+
+    if (!append(start, sizeof(start)) || !append((const uint8_t *)text, length) || !append(&end, 1))
+        return 0;
+
+    return length + 5;
+}
+
+void MListing::beginEntries()
+{
+    _entries_start = _size;
+    _entries_end = _size;
+}
+
+void MListing::endEntries()
+{
+    _entries_end = _size;
+}
+
+void MListing::finish()
+{
+    // End program with two zeros after last line
+    uint8_t end[2] = { 0, 0 };
+    append(end, sizeof(end));
+}
+
+std::shared_ptr<MListing> MListing::filter(const std::string &filter) const
+{
+    std::string pattern = filter;
+    char type = 0;
+
+    size_t equals = filter.find('=');
+    if (equals != std::string::npos)
+    {
+        pattern = filter.substr(0, equals);
+        if (equals + 1 < filter.size())
+            type = filter[equals + 1];
+    }
+
+    // Same load address and header
+    auto filtered = std::make_shared<MListing>(_data[0] | _data[1] << 8);
+    filtered->append(_data + 2, _entries_start - 2);
+    filtered->beginEntries();
+
+    size_t offset = _entries_start;
+    while (offset < _entries_end)
+    {
+        // link, blocks, then the text up to its zero
+        const char *text = (const char *)_data + offset + 4;
+        size_t length = strlen(text);
+        size_t next = offset + 4 + length + 1;
+
+        // '   "NAME"   PRG'
+        const char *name = (const char *)memchr(text, '"', length);
+        const char *name_end = name ? (const char *)memchr(name + 1, '"', length - (name + 1 - text)) : nullptr;
+
+        bool keep = (name_end != nullptr);
+        if (keep && pattern.size())
+            keep = matches(pattern, name + 1, name_end - (name + 1));
+
+        if (keep && type)
+        {
+            // Splat files show a '*' in front of the type
+            const char *t = name_end + 1;
+            while (*t == ' ' || *t == '*')
+                t++;
+            keep = (*t == type);
+        }
+
+        if (keep)
+            filtered->append(_data + offset, next - offset);
+
+        offset = next;
+    }
+
+    filtered->endEntries();
+    filtered->append(_data + _entries_end, _size - _entries_end);
+    return filtered;
+}
+
+bool MListing::matches(const std::string &pattern, const char *name, size_t length)
+{
+    size_t i = 0;
+    for (; i < pattern.size(); i++)
+    {
+        if (pattern[i] == '*')
+            return true;
+        if (i >= length)
+            return false;
+        if (pattern[i] != '?' && pattern[i] != name[i])
+            return false;
+    }
+
+    return (i == length);
+}
+
+
+/********************************************************
+ * MListingCache
+ ********************************************************/
+
+MListingCache::MListingCache(size_t budget, time_t max_age)
+{
+    _budget = budget;
+    _max_age = max_age;
+}
+
+std::shared_ptr<MListing> MListingCache::find(const std::string &url, time_t stamp, time_t now)
+{
+    for (auto entry = _lru.begin(); entry != _lru.end(); entry++)
+    {
+        if (entry->url != url)
+            continue;
+
+        if (entry->stamp != stamp || now - entry->rendered >= _max_age || now < entry->rendered)
+        {
+            // Changed since, or too old to trust
+            _bytes -= entry->listing->size();
+            _lru.erase(entry);
+            break;
+        }
+
+        _hits++;
+        _lru.splice(_lru.begin(), _lru, entry);
+        return entry->listing;
+    }
+
+    _misses++;
+    return nullptr;
+}
+
+void MListingCache::store(const std::string &url, time_t stamp, time_t now, std::shared_ptr<MListing> listing)
+{
+    for (auto entry = _lru.begin(); entry != _lru.end(); entry++)
+    {
+        if (entry->url == url)
+        {
+            _bytes -= entry->listing->size();
+            _lru.erase(entry);
+            break;
+        }
+    }
+
+    if (listing->size() > _budget)
+        return;
+
+    _lru.push_front({ url, stamp, now, listing });
+    _bytes += listing->size();
+
+    while (_bytes > _budget)
+    {
+        _bytes -= _lru.back().listing->size();
+        _lru.pop_back();
+    }
+}
+
+void MListingCache::clear()
+{
+    _lru.clear();
+    _bytes = 0;
+}
+
+
+/********************************************************
+ * MListingStream
+ ********************************************************/
+
+uint32_t MListingStream::read(uint8_t* buf, uint32_t size)
+{
+    if (_position >= _size)
+        return 0;
+    if (size > _size - _position)
+        size = _size - _position;
+
+    memcpy(buf, _listing->data() + _position, size);
+    _position += size;
+    return size;
+}
+
+bool MListingStream::seek(uint32_t pos)
+{
+    if (pos > _size)
+        return false;
+
+    _position = pos;
+    return true;
+}
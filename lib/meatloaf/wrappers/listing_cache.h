@@ -0,0 +1,154 @@
+#ifndef MEATLOAF_WRAPPER_LISTING_CACHE
+#define MEATLOAF_WRAPPER_LISTING_CACHE
+
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <string>
+
+#if HOST_OS==win32
+#include "../meatloaf.h"
+#else
+#include "meatloaf.h"
+#endif
+
+#define LISTING_CACHE_BUDGET (64 * 1024)   // bytes of rendered listings, from PSRAM when there is some
+#define LISTING_CACHE_MAX_AGE 60           // seconds before a listing is read again anyway
+
+/********************************************************
+ * MListing
+ *
+ * A directory listing rendered as the BASIC program that
+ * LOAD"$" sends: load address, one line each for the
+ * header, entries and footer, then the end of program.
+ *
+ * Entry lines are kept together, so LOAD"$:pattern=type"
+ * can be cut from the same listing without reading the
+ * directory again.
+ ********************************************************/
+
+class MListing {
+public:
+    MListing(uint16_t load_address);
+    ~MListing();
+
+    MListing(const MListing&) = delete;
+    MListing& operator=(const MListing&) = delete;
+
+    // Header lines first, then entries, then the footer and finish()
+    uint16_t line(uint16_t blocks, const char *text, size_t length);
+    void beginEntries();
+    void endEntries();
+    void finish();
+
+    // The same listing with only the entries matching "pattern[=type]",
+    // '*' matches the rest of a name and '?' any one character
+    std::shared_ptr<MListing> filter(const std::string &filter) const;
+
+    const uint8_t *data() const {
+        return _data;
+    }
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    uint8_t *_data = nullptr;
+    size_t _size = 0;
+    size_t _capacity = 0;
+
+    // Byte range of the entry lines
+    size_t _entries_start = 0;
+    size_t _entries_end = 0;
+
+    bool append(const uint8_t *data, size_t length);
+
+    static bool matches(const std::string &pattern, const char *name, size_t length);
+};
+
+
+/********************************************************
+ * MListingCache
+ *
+ * Rendered listings by directory url, so listing the same
+ * directory again costs no directory reads. A listing is
+ * used again while the directory's modification stamp is
+ * unchanged and it is no older than max_age, which covers
+ * filesystems that can't tell (stamp 0) or don't update a
+ * directory's time when its contents change.
+ *
+ * Least recently used listings go first once the rendered
+ * bytes are over budget.
+ ********************************************************/
+
+class MListingCache {
+public:
+    MListingCache(size_t budget = LISTING_CACHE_BUDGET, time_t max_age = LISTING_CACHE_MAX_AGE);
+
+    std::shared_ptr<MListing> find(const std::string &url, time_t stamp, time_t now);
+    void store(const std::string &url, time_t stamp, time_t now, std::shared_ptr<MListing> listing);
+
+    // After anything was written
+    void clear();
+
+    size_t bytes() {
+        return _bytes;
+    }
+    uint32_t hits() {
+        return _hits;
+    }
+    uint32_t misses() {
+        return _misses;
+    }
+
+private:
+    struct Entry {
+        std::string url;
+        time_t stamp;
+        time_t rendered;
+        std::shared_ptr<MListing> listing;
+    };
+
+    // Most recently used at the front
+    std::list<Entry> _lru;
+
+    size_t _budget;
+    time_t _max_age;
+    size_t _bytes = 0;
+
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+};
+
+
+/********************************************************
+ * MListingStream
+ *
+ * Reads a rendered listing, so it goes out through the
+ * channel's block buffer like any other file.
+ ********************************************************/
+
+class MListingStream: public MStream {
+public:
+    MListingStream(std::shared_ptr<MListing> listing) : _listing(listing) {
+        _size = listing->size();
+    }
+
+    bool isOpen() override { return true; };
+    bool isRandomAccess() override { return true; };
+
+    void close() override {};
+    bool open() override { return true; };
+
+    uint32_t write(const uint8_t *buf, uint32_t size) override { return 0; };
+    uint32_t read(uint8_t* buf, uint32_t size) override;
+
+    bool seek(uint32_t pos) override;
+
+private:
+    std::shared_ptr<MListing> _listing;
+};
+
+#endif /* MEATLOAF_WRAPPER_LISTING_CACHE */
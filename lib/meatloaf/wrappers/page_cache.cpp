@@ -0,0 +1,223 @@
+#include "page_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+#include "../../../include/debug.h"
+
+/********************************************************
+ * MPageCache
+ ********************************************************/
+
+MPageCache::MPageCache(uint32_t size, Fetch fetch, size_t page_count, size_t page_size)
+{
+    _size = size;
+    _fetch = fetch;
+    _page_size = page_size;
+    _page_count = page_count;
+
+#ifdef ESP_PLATFORM
+    _data = (uint8_t *)heap_caps_malloc(_page_count * _page_size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (_data == nullptr)
+#endif
+    _data = (uint8_t *)malloc(_page_count * _page_size);
+
+    if (_data == nullptr)
+    {
+        Debug_printv("Can't allocate %u pages", (unsigned int)_page_count);
+        return;
+    }
+
+    for (size_t slot = _page_count; slot > 0; slot--)
+        _free.push_back(slot - 1);
+}
+
+MPageCache::~MPageCache()
+{
+    if (_spill != nullptr)
+    {
+        fclose(_spill);
+        remove(_spill_path.c_str());
+    }
+
+    if (_data != nullptr)
+        free(_data);
+}
+
+bool MPageCache::spill(const std::string &path, Stream stream)
+{
+    _spill = fopen(path.c_str(), "w+b");
+    if (_spill == nullptr)
+    {
+        Debug_printv("Can't create spill file [%s]", path.c_str());
+        return false;
+    }
+
+    _spill_path = path;
+    _stream = stream;
+    _spilled = 0;
+    return true;
+}
+
+uint32_t MPageCache::read(uint32_t offset, uint8_t *buf, uint32_t length)
+{
+    if (_data == nullptr || offset >= _size)
+        return 0;
+    if (length > _size - offset)
+        length = _size - offset;
+
+    uint32_t total = 0;
+    while (total < length)
+    {
+        uint32_t page = offset / _page_size;
+        uint8_t *data = lookup(page);
+
+        if (data == nullptr)
+        {
+            _misses++;
+
+            // Sequential misses read further ahead each time
+            if (page == _next_page)
+                _read_ahead = std::min<uint32_t>(_read_ahead ? _read_ahead * 2 : 1, PAGE_CACHE_COALESCE);
+            else
+                _read_ahead = 0;
+
+            // Take every missing page this read still needs in the same request
+            uint32_t last = (offset + (length - total) - 1) / _page_size;
+            uint32_t end = (_size + _page_size - 1) / _page_size;
+            uint32_t limit = std::max<uint32_t>(1, std::min<uint32_t>(PAGE_CACHE_COALESCE, _page_count / 2));
+            uint32_t count = 1;
+            while (count < limit && page + count < end &&
+                   (page + count <= last || count <= _read_ahead) &&
+                   _pages.find(page + count) == _pages.end())
+                count++;
+
+            if (!load(page, count))
+                break;
+
+            _next_page = page + count;
+            data = lookup(page);
+        }
+        else
+        {
+            _hits++;
+        }
+
+        uint32_t page_offset = offset % _page_size;
+        uint32_t n = std::min<uint32_t>(length - total, _page_size - page_offset);
+        memcpy(buf + total, data + page_offset, n);
+
+        offset += n;
+        total += n;
+    }
+
+    return total;
+}
+
+void MPageCache::clear()
+{
+    _lru.clear();
+    _pages.clear();
+
+    _free.clear();
+    if (_data == nullptr)
+        return;
+    for (size_t slot = _page_count; slot > 0; slot--)
+        _free.push_back(slot - 1);
+}
+
+uint8_t *MPageCache::lookup(uint32_t page)
+{
+    auto found = _pages.find(page);
+    if (found == _pages.end())
+        return nullptr;
+
+    _lru.splice(_lru.begin(), _lru, found->second);
+    return _data + (found->second->second * _page_size);
+}
+
+uint8_t *MPageCache::claim(uint32_t page)
+{
+    size_t slot;
+    if (!_free.empty())
+    {
+        slot = _free.back();
+        _free.pop_back();
+    }
+    else
+    {
+        slot = _lru.back().second;
+        _pages.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+
+    _lru.emplace_front(page, slot);
+    _pages[page] = _lru.begin();
+    return _data + (slot * _page_size);
+}
+
+void MPageCache::drop(uint32_t page)
+{
+    auto found = _pages.find(page);
+    if (found == _pages.end())
+        return;
+
+    _free.push_back(found->second->second);
+    _lru.erase(found->second);
+    _pages.erase(found);
+}
+
+bool MPageCache::load(uint32_t page, uint32_t count)
+{
+    uint32_t start = page * _page_size;
+    uint32_t run = std::min<uint32_t>(count * _page_size, _size - start);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t offset = start + (i * _page_size);
+        uint32_t length = std::min<uint32_t>(_page_size, _size - offset);
+        uint8_t *data = claim(page + i);
+
+        _fetches++;
+        int32_t got = (_spill != nullptr) ? readSpill(offset, data, length)
+                                          : _fetch(offset, data, length, start + run - offset);
+        if (got != (int32_t)length)
+        {
+            Debug_printv("Short fetch offset[%u] length[%u] got[%d]", offset, length, got);
+            drop(page + i);
+            return i > 0;
+        }
+    }
+
+    return true;
+}
+
+int32_t MPageCache::readSpill(uint32_t offset, uint8_t *buf, uint32_t length)
+{
+    // Copy the body into the spill file until it covers this page, using
+    // buf as the bounce buffer
+    if (_spilled < offset + length)
+        fseek(_spill, _spilled, SEEK_SET);
+
+    while (_spilled < offset + length)
+    {
+        int32_t got = _stream(buf, length);
+        if (got <= 0)
+            return -1;
+
+        if (fwrite(buf, 1, got, _spill) != (size_t)got)
+        {
+            Debug_printv("Error writing spill file [%s]", _spill_path.c_str());
+            return -1;
+        }
+        _spilled += got;
+    }
+
+    fseek(_spill, offset, SEEK_SET);
+    return fread(buf, 1, length, _spill);
+}
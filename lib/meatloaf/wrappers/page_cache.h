@@ -0,0 +1,122 @@
+#ifndef MEATLOAF_WRAPPER_PAGE_CACHE
+#define MEATLOAF_WRAPPER_PAGE_CACHE
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define PAGE_CACHE_PAGE_SIZE 4096
+#ifndef PAGE_CACHE_PAGES
+#ifdef BOARD_HAS_PSRAM
+#define PAGE_CACHE_PAGES 16        // 64KB from PSRAM
+#else
+#define PAGE_CACHE_PAGES 4         // 16KB, internal RAM only
+#endif
+#endif
+#define PAGE_CACHE_COALESCE 8      // most pages fetched with one request
+
+/********************************************************
+ * MPageCache
+ *
+ * Aligned page cache in front of a slow random access
+ * source, for disk images and archives opened over HTTP
+ * that seek all over the place.
+ *
+ * - pages are kept in a small LRU
+ * - a miss fetches the missing pages the read needs in one
+ *   ranged request, and keeps reading ahead while the
+ *   misses are sequential
+ * - fetch() is told the whole run up front, so a source
+ *   can ask for it once and then hand it out a page at a
+ *   time on the same connection
+ *
+ * Sources that can't do ranges are copied to a spill file
+ * as the reads get to them, from a single sequential
+ * read of the whole body, and pages are read from there.
+ ********************************************************/
+
+class MPageCache {
+public:
+    // Read length bytes at offset, the caller will go on reading up to
+    // offset + run sequentially. Returns bytes read, < 0 on error.
+    typedef std::function<int32_t(uint32_t offset, uint8_t *buf, uint32_t length, uint32_t run)> Fetch;
+
+    // Next bytes of the body from the start, returns bytes read, 0 at the end, < 0 on error
+    typedef std::function<int32_t(uint8_t *buf, uint32_t length)> Stream;
+
+    MPageCache(uint32_t size, Fetch fetch, size_t page_count = PAGE_CACHE_PAGES, size_t page_size = PAGE_CACHE_PAGE_SIZE);
+    ~MPageCache();
+
+    MPageCache(const MPageCache&) = delete;
+    MPageCache& operator=(const MPageCache&) = delete;
+
+    // False if the pages couldn't be allocated, nothing can be read then
+    bool valid() {
+        return _data != nullptr;
+    }
+
+    // Switch to a spill file for a source without range support
+    bool spill(const std::string &path, Stream stream);
+
+    uint32_t read(uint32_t offset, uint8_t *buf, uint32_t length);
+
+    void clear();
+
+    uint32_t size() {
+        return _size;
+    }
+
+    uint32_t hits() {
+        return _hits;
+    }
+    uint32_t misses() {
+        return _misses;
+    }
+    // Calls to fetch(), a ranged request each unless the source could continue one
+    uint32_t fetches() {
+        return _fetches;
+    }
+    // Bytes copied into the spill file so far
+    uint32_t spilled() {
+        return _spilled;
+    }
+
+private:
+    uint32_t _size;
+    Fetch _fetch;
+
+    size_t _page_size;
+    size_t _page_count;
+    uint8_t *_data = nullptr;
+
+    // Page index -> slot, most recently used at the front
+    std::list<std::pair<uint32_t, size_t>> _lru;
+    std::unordered_map<uint32_t, std::list<std::pair<uint32_t, size_t>>::iterator> _pages;
+    std::vector<size_t> _free;
+
+    uint32_t _next_page = 0;    // page after the last miss, to spot sequential reads
+    uint32_t _read_ahead = 0;
+
+    FILE *_spill = nullptr;
+    std::string _spill_path;
+    Stream _stream;
+    uint32_t _spilled = 0;
+
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+    uint32_t _fetches = 0;
+
+    uint8_t *lookup(uint32_t page);
+    uint8_t *claim(uint32_t page);
+    void drop(uint32_t page);
+    bool load(uint32_t page, uint32_t count);
+
+    int32_t readSpill(uint32_t offset, uint8_t *buf, uint32_t length);
+};
+
+#endif /* MEATLOAF_WRAPPER_PAGE_CACHE */
@@ -0,0 +1,623 @@
+#include "png_deflate.h"
+
+#include <algorithm>
+#include <cstring>
+
+/********************************************************
+ * Checksums
+ ********************************************************/
+
+// Slice-by-4 CRC-32, four table lookups per 32 bit word instead of
+// one per byte. The tables are built by the compiler and live in flash.
+struct crc32_tables_t {
+    uint32_t t[4][256];
+};
+
+static constexpr crc32_tables_t make_crc32_tables()
+{
+    crc32_tables_t tables {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t rem = i;
+        for (int j = 0; j < 8; j++)
+            rem = (rem & 1) ? (rem >> 1) ^ 0xEDB88320 : rem >> 1;
+        tables.t[0][i] = rem;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int k = 1; k < 4; k++)
+            tables.t[k][i] = (tables.t[k - 1][i] >> 8) ^ tables.t[0][tables.t[k - 1][i] & 0xFF];
+    }
+    return tables;
+}
+
+static constexpr crc32_tables_t crc32_tables = make_crc32_tables();
+
+uint32_t png_crc32(uint32_t crc, const uint8_t *buf, size_t len)
+{
+    const auto &t = crc32_tables.t;
+
+    crc = ~crc;
+    while (len >= 4)
+    {
+        crc ^= (uint32_t)buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+        crc = t[3][crc & 0xFF] ^ t[2][(crc >> 8) & 0xFF] ^ t[1][(crc >> 16) & 0xFF] ^ t[0][crc >> 24];
+        buf += 4;
+        len -= 4;
+    }
+    while (len--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xFF];
+    return ~crc;
+}
+
+// Adler-32 in 16 byte blocks: the byte sum and the position weighted
+// sum of a block are independent, so the compiler can vectorize them,
+// and the modulo is only taken every 5552 bytes (zlib's NMAX)
+uint32_t png_adler32(uint32_t adler, const uint8_t *buf, size_t len)
+{
+    const uint32_t base = 65521;
+    const size_t nmax = 5552;
+
+    uint32_t s1 = adler & 0xFFFF;
+    uint32_t s2 = adler >> 16;
+
+    while (len > 0)
+    {
+        size_t n = std::min(len, nmax);
+        len -= n;
+
+        while (n >= 16)
+        {
+            uint32_t sum = 0, weighted = 0;
+            for (int i = 0; i < 16; i++)
+            {
+                sum += buf[i];
+                weighted += (16 - i) * buf[i];
+            }
+            s2 += 16 * s1 + weighted;
+            s1 += sum;
+            buf += 16;
+            n -= 16;
+        }
+        while (n--)
+        {
+            s1 += *buf++;
+            s2 += s1;
+        }
+
+        s1 %= base;
+        s2 %= base;
+    }
+
+    return (s2 << 16) | s1;
+}
+
+
+/********************************************************
+ * Deflate tables, RFC 1951 3.2.5
+ ********************************************************/
+
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MIN_LOOKAHEAD (DEFLATE_MAX_MATCH + DEFLATE_MIN_MATCH + 1)
+#define DEFLATE_NIL 0
+#define DEFLATE_MAX_INSERT 32       // longer matches aren't hashed past their first byte
+#define DEFLATE_NICE_MATCH 128      // long enough to stop looking for a longer one
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Order the code length code lengths are sent in
+static const uint8_t cl_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static inline int floor_log2(uint32_t v)
+{
+    return 31 - __builtin_clz(v);
+}
+
+// Index into length_base, 257 less than the literal/length symbol
+static inline int length_index(uint16_t length)
+{
+    uint32_t l = length - 3;
+    if (l < 8)
+        return l;
+    if (l == 255)
+        return 28;
+    int n = floor_log2(l);
+    return 4 * (n - 1) + ((l >> (n - 2)) & 3);
+}
+
+static inline int dist_index(uint16_t distance)
+{
+    uint32_t d = distance - 1;
+    if (d < 4)
+        return d;
+    int n = floor_log2(d);
+    return 2 * n + ((d >> (n - 1)) & 1);
+}
+
+// Canonical codes from code lengths, bit reversed since deflate sends
+// Huffman codes most significant bit first into an LSB first stream
+static void build_codes(const uint8_t *lengths, int n, uint16_t *codes)
+{
+    uint16_t count[16] = { 0 };
+    uint16_t next[16] = { 0 };
+
+    for (int i = 0; i < n; i++)
+        count[lengths[i]]++;
+    count[0] = 0;
+
+    uint16_t code = 0;
+    for (int bits = 1; bits < 16; bits++)
+    {
+        code = (code + count[bits - 1]) << 1;
+        next[bits] = code;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        uint8_t len = lengths[i];
+        if (len == 0)
+            continue;
+
+        uint16_t c = next[len]++;
+        uint16_t reversed = 0;
+        for (int b = 0; b < len; b++)
+        {
+            reversed = (reversed << 1) | (c & 1);
+            c >>= 1;
+        }
+        codes[i] = reversed;
+    }
+}
+
+static void fixed_lengths(uint8_t *lit, uint8_t *dist)
+{
+    for (int i = 0; i < 288; i++)
+        lit[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    for (int i = 0; i < 30; i++)
+        dist[i] = 5;
+}
+
+
+/********************************************************
+ * pngDeflate
+ ********************************************************/
+
+pngDeflate::pngDeflate(sink_t sink) : _sink(sink)
+{
+    memset(_head, 0, sizeof(_head));
+    memset(_prev, 0, sizeof(_prev));
+    memset(_lit_freq, 0, sizeof(_lit_freq));
+    memset(_dist_freq, 0, sizeof(_dist_freq));
+
+    // zlib header: deflate with a 1 KB window (CINFO 2), no dictionary,
+    // check bits making 0x2815 a multiple of 31
+    put_byte(0x08 | ((DEFLATE_WINDOW_BITS - 8) << 4));
+    put_byte(0x15);
+}
+
+void pngDeflate::write(const uint8_t *data, size_t length)
+{
+    _adler = png_adler32(_adler, data, length);
+    _total_in += length;
+
+    while (length > 0)
+    {
+        size_t n = std::min(length, (size_t)(2 * DEFLATE_WINDOW_SIZE - _end));
+        memcpy(_window + _end, data, n);
+        _end += n;
+        data += n;
+        length -= n;
+
+        compress(false);
+        if (_end == 2 * DEFLATE_WINDOW_SIZE)
+            slide();
+    }
+}
+
+void pngDeflate::finish()
+{
+    compress(true);
+    flush_block(true);
+    flush_bits();
+
+    put_byte(_adler >> 24);
+    put_byte(_adler >> 16);
+    put_byte(_adler >> 8);
+    put_byte(_adler);
+    flush_out();
+}
+
+// Upper half of the window down to the lower half, positions
+// that fall out of it are dropped from the hash chains
+void pngDeflate::slide()
+{
+    memcpy(_window, _window + DEFLATE_WINDOW_SIZE, DEFLATE_WINDOW_SIZE);
+    _pos -= DEFLATE_WINDOW_SIZE;
+    _end -= DEFLATE_WINDOW_SIZE;
+
+    for (auto &h : _head)
+        h = (h >= DEFLATE_WINDOW_SIZE) ? h - DEFLATE_WINDOW_SIZE : DEFLATE_NIL;
+    for (auto &p : _prev)
+        p = (p >= DEFLATE_WINDOW_SIZE) ? p - DEFLATE_WINDOW_SIZE : DEFLATE_NIL;
+}
+
+static inline uint32_t hash3(const uint8_t *p)
+{
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+    return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+void pngDeflate::insert(uint32_t pos)
+{
+    if (pos + DEFLATE_MIN_MATCH > _end)
+        return;
+
+    uint32_t h = hash3(_window + pos);
+    _prev[pos & (DEFLATE_WINDOW_SIZE - 1)] = _head[h];
+    _head[h] = pos;
+}
+
+uint16_t pngDeflate::longest_match(uint32_t pos, uint16_t &distance)
+{
+    uint32_t max = std::min(_end - pos, (uint32_t)DEFLATE_MAX_MATCH);
+    if (max < DEFLATE_MIN_MATCH)
+        return 0;
+
+    // Older than a window and the chain entry may already be reused
+    uint32_t limit = (pos > DEFLATE_WINDOW_SIZE) ? pos - DEFLATE_WINDOW_SIZE : DEFLATE_NIL;
+    uint32_t candidate = _head[hash3(_window + pos)];
+    int chain = DEFLATE_MAX_CHAIN;
+
+    const uint8_t *current = _window + pos;
+    uint32_t best = 0;
+
+    while (candidate > limit && chain-- > 0)
+    {
+        const uint8_t *match = _window + candidate;
+        if (match[best] == current[best] && match[0] == current[0] && match[1] == current[1])
+        {
+            uint32_t len = 2;
+            while (len < max && match[len] == current[len])
+                len++;
+
+            if (len > best)
+            {
+                best = len;
+                distance = pos - candidate;
+                if (len >= DEFLATE_NICE_MATCH)
+                    break;
+            }
+        }
+        candidate = _prev[candidate & (DEFLATE_WINDOW_SIZE - 1)];
+    }
+
+    return (best >= DEFLATE_MIN_MATCH) ? best : 0;
+}
+
+// Greedy LZ77 over the window, leaving enough lookahead for a full
+// length match unless this is the end of the input
+void pngDeflate::compress(bool flush)
+{
+    while (_pos < _end)
+    {
+        if (!flush && _end - _pos < DEFLATE_MIN_LOOKAHEAD)
+            break;
+
+        uint16_t distance = 0;
+        uint16_t length = longest_match(_pos, distance);
+        if (length)
+        {
+            // Inside a long match only its start goes in the hash chains,
+            // runs of repeated lines would otherwise cost a chain walk a byte
+            add_match(length, distance);
+            uint16_t inserts = (length <= DEFLATE_MAX_INSERT) ? length : 1;
+            for (uint16_t i = 0; i < inserts; i++)
+                insert(_pos + i);
+            _pos += length;
+        }
+        else
+        {
+            add_literal(_window[_pos]);
+            insert(_pos);
+            _pos++;
+        }
+    }
+}
+
+void pngDeflate::add_literal(uint8_t c)
+{
+    _symbols[_symbol_count++] = c;
+    _lit_freq[c]++;
+    if (_symbol_count == DEFLATE_BLOCK_SYMBOLS)
+        flush_block(false);
+}
+
+void pngDeflate::add_match(uint16_t length, uint16_t distance)
+{
+    _symbols[_symbol_count++] = (uint32_t)length << 16 | distance;
+    _lit_freq[257 + length_index(length)]++;
+    _dist_freq[dist_index(distance)]++;
+    if (_symbol_count == DEFLATE_BLOCK_SYMBOLS)
+        flush_block(false);
+}
+
+// Huffman code lengths no longer than limit. When the tree comes out
+// too deep the frequencies are flattened and it is built again.
+void pngDeflate::build_lengths(const uint16_t *freq, int n, uint8_t limit, uint8_t *lengths)
+{
+    memcpy(_freq, freq, n * sizeof(uint16_t));
+
+    for (;;)
+    {
+        int count = 0;
+        for (int i = 0; i < n; i++)
+        {
+            lengths[i] = 0;
+            if (_freq[i])
+                _order[count++] = i;
+        }
+
+        if (count < 2)
+        {
+            // A code needs two symbols, the second one just isn't used
+            int used = count ? _order[0] : 0;
+            lengths[used] = 1;
+            lengths[used ? 0 : 1] = 1;
+            return;
+        }
+
+        std::sort(_order, _order + count, [this](uint16_t a, uint16_t b) {
+            return _freq[a] < _freq[b] || (_freq[a] == _freq[b] && a < b);
+        });
+
+        // Two queue Huffman: leaves in frequency order, then the internal
+        // nodes in the order they are made, which is also by weight
+        for (int i = 0; i < count; i++)
+            _weight[i] = _freq[_order[i]];
+
+        int leaf = 0, node = count, next = count;
+        auto smallest = [&]() {
+            if (leaf < count && (node >= next || _weight[leaf] <= _weight[node]))
+                return leaf++;
+            return node++;
+        };
+        while (next < 2 * count - 1)
+        {
+            int a = smallest();
+            int b = smallest();
+            _weight[next] = _weight[a] + _weight[b];
+            _parent[a] = _parent[b] = next;
+            next++;
+        }
+
+        // Depths, parents always come after their children
+        int root = next - 1;
+        _parent[root] = 0;
+        int deepest = 0;
+        for (int i = root - 1; i >= 0; i--)
+        {
+            _parent[i] = _parent[_parent[i]] + 1;
+            if (i < count)
+                deepest = std::max(deepest, (int)_parent[i]);
+        }
+
+        if (deepest <= limit)
+        {
+            for (int i = 0; i < count; i++)
+                lengths[_order[i]] = _parent[i];
+            return;
+        }
+
+        for (int i = 0; i < n; i++)
+            if (_freq[i])
+                _freq[i] = (_freq[i] >> 1) | 1;
+    }
+}
+
+void pngDeflate::flush_block(bool last)
+{
+    _lit_freq[256] = 1;
+
+    // Extra bits are the same whichever codes are used
+    uint32_t extra_bits = 0;
+    for (int i = 0; i < 29; i++)
+        extra_bits += _lit_freq[257 + i] * length_extra[i];
+    for (int i = 0; i < 30; i++)
+        extra_bits += _dist_freq[i] * dist_extra[i];
+
+    // Fixed codes
+    uint8_t fixed_lit[288], fixed_dist[30];
+    fixed_lengths(fixed_lit, fixed_dist);
+    uint32_t fixed_bits = 3 + extra_bits;
+    for (int i = 0; i < 286; i++)
+        fixed_bits += _lit_freq[i] * fixed_lit[i];
+    for (int i = 0; i < 30; i++)
+        fixed_bits += _dist_freq[i] * fixed_dist[i];
+
+    // This block's own codes
+    build_lengths(_lit_freq, 286, 15, _lit_len);
+    _lit_len[286] = _lit_len[287] = 0;
+    build_lengths(_dist_freq, 30, 15, _dist_len);
+
+    int hlit = 286;
+    while (hlit > 257 && _lit_len[hlit - 1] == 0)
+        hlit--;
+    int hdist = 30;
+    while (hdist > 1 && _dist_len[hdist - 1] == 0)
+        hdist--;
+
+    // Run length coded code lengths: 16 repeats the previous length
+    // 3-6 times, 17 and 18 are runs of 3-10 and 11-138 zeros
+    uint8_t lengths[286 + 30];
+    memcpy(lengths, _lit_len, hlit);
+    memcpy(lengths + hlit, _dist_len, hdist);
+    int total = hlit + hdist;
+
+    uint16_t runs[286 + 30];   // symbol | extra << 8
+    int run_count = 0;
+    uint16_t cl_freq[19] = { 0 };
+    for (int i = 0; i < total;)
+    {
+        uint8_t len = lengths[i];
+        int run = 1;
+        while (i + run < total && lengths[i + run] == len)
+            run++;
+
+        if (len == 0 && run >= 3)
+        {
+            run = std::min(run, 138);
+            if (run >= 11)
+                runs[run_count++] = 18 | (run - 11) << 8, cl_freq[18]++;
+            else
+                runs[run_count++] = 17 | (run - 3) << 8, cl_freq[17]++;
+            i += run;
+        }
+        else if (len != 0 && run >= 4)
+        {
+            runs[run_count++] = len, cl_freq[len]++;
+            run = std::min(run - 1, 6);
+            runs[run_count++] = 16 | (run - 3) << 8, cl_freq[16]++;
+            i += run + 1;
+        }
+        else
+        {
+            runs[run_count++] = len, cl_freq[len]++;
+            i++;
+        }
+    }
+
+    uint8_t cl_len[19];
+    uint16_t cl_code[19];
+    build_lengths(cl_freq, 19, 7, cl_len);
+
+    int hclen = 19;
+    while (hclen > 4 && cl_len[cl_order[hclen - 1]] == 0)
+        hclen--;
+
+    uint32_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * hclen + extra_bits;
+    for (int i = 0; i < 19; i++)
+        dynamic_bits += cl_freq[i] * cl_len[i];
+    dynamic_bits += cl_freq[16] * 2 + cl_freq[17] * 3 + cl_freq[18] * 7;
+    for (int i = 0; i < 286; i++)
+        dynamic_bits += _lit_freq[i] * _lit_len[i];
+    for (int i = 0; i < 30; i++)
+        dynamic_bits += _dist_freq[i] * _dist_len[i];
+
+    put_bits(last ? 1 : 0, 1);
+    if (dynamic_bits < fixed_bits)
+    {
+        put_bits(2, 2);
+        put_bits(hlit - 257, 5);
+        put_bits(hdist - 1, 5);
+        put_bits(hclen - 4, 4);
+        for (int i = 0; i < hclen; i++)
+            put_bits(cl_len[cl_order[i]], 3);
+
+        build_codes(cl_len, 19, cl_code);
+        for (int i = 0; i < run_count; i++)
+        {
+            uint8_t symbol = runs[i] & 0xFF;
+            put_code(cl_code[symbol], cl_len[symbol]);
+            if (symbol == 16)
+                put_bits(runs[i] >> 8, 2);
+            else if (symbol == 17)
+                put_bits(runs[i] >> 8, 3);
+            else if (symbol == 18)
+                put_bits(runs[i] >> 8, 7);
+        }
+    }
+    else
+    {
+        put_bits(1, 2);
+        memcpy(_lit_len, fixed_lit, sizeof(fixed_lit));
+        memcpy(_dist_len, fixed_dist, sizeof(fixed_dist));
+    }
+
+    build_codes(_lit_len, 288, _lit_code);
+    build_codes(_dist_len, 30, _dist_code);
+
+    for (int i = 0; i < _symbol_count; i++)
+    {
+        uint32_t symbol = _symbols[i];
+        if (symbol < 256)
+        {
+            put_code(_lit_code[symbol], _lit_len[symbol]);
+            continue;
+        }
+
+        uint16_t length = symbol >> 16;
+        uint16_t distance = symbol & 0xFFFF;
+
+        int l = length_index(length);
+        put_code(_lit_code[257 + l], _lit_len[257 + l]);
+        if (length_extra[l])
+            put_bits(length - length_base[l], length_extra[l]);
+
+        int d = dist_index(distance);
+        put_code(_dist_code[d], _dist_len[d]);
+        if (dist_extra[d])
+            put_bits(distance - dist_base[d], dist_extra[d]);
+    }
+    put_code(_lit_code[256], _lit_len[256]);
+
+    _symbol_count = 0;
+    memset(_lit_freq, 0, sizeof(_lit_freq));
+    memset(_dist_freq, 0, sizeof(_dist_freq));
+}
+
+
+/********************************************************
+ * Output
+ ********************************************************/
+
+void pngDeflate::put_bits(uint32_t value, uint8_t count)
+{
+    _bits |= value << _bit_count;
+    _bit_count += count;
+    while (_bit_count >= 8)
+    {
+        put_byte(_bits & 0xFF);
+        _bits >>= 8;
+        _bit_count -= 8;
+    }
+}
+
+void pngDeflate::put_code(uint16_t code, uint8_t length)
+{
+    put_bits(code, length);
+}
+
+void pngDeflate::put_byte(uint8_t b)
+{
+    _out[_out_len++] = b;
+    if (_out_len == DEFLATE_OUT_SIZE)
+        flush_out();
+}
+
+void pngDeflate::flush_bits()
+{
+    if (_bit_count)
+        put_bits(0, 8 - _bit_count);
+}
+
+void pngDeflate::flush_out()
+{
+    if (_out_len == 0)
+        return;
+
+    _sink(_out, _out_len);
+    _total_out += _out_len;
+    _out_len = 0;
+}
@@ -0,0 +1,101 @@
+#ifndef PNG_DEFLATE_H
+#define PNG_DEFLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Checksums for PNG chunks (CRC-32) and the zlib stream (Adler-32),
+// both take and return the running value
+uint32_t png_crc32(uint32_t crc, const uint8_t *buf, size_t len);
+uint32_t png_adler32(uint32_t adler, const uint8_t *buf, size_t len);
+
+#define DEFLATE_WINDOW_BITS 10                          // 1 KB window, three printer lines
+#define DEFLATE_WINDOW_SIZE (1 << DEFLATE_WINDOW_BITS)
+#define DEFLATE_HASH_BITS 10
+#define DEFLATE_MAX_CHAIN 32                            // match candidates tried per position
+#define DEFLATE_BLOCK_SYMBOLS 1024                      // literals and matches per block
+#define DEFLATE_OUT_SIZE 1024                           // output handed to the sink at a time
+
+/********************************************************
+ * pngDeflate
+ *
+ * Streaming zlib (RFC 1950/1951) compressor. Input goes
+ * through a small LZ77 window and comes out as Huffman
+ * coded blocks, each block using fixed or its own dynamic
+ * codes, whichever is smaller. Memory is fixed at about
+ * 16 KB whatever the input size, and the output is handed
+ * to the sink as it is produced.
+ ********************************************************/
+
+class pngDeflate
+{
+public:
+    using sink_t = std::function<void(const uint8_t *data, size_t length)>;
+
+    pngDeflate(sink_t sink);
+
+    void write(const uint8_t *data, size_t length);
+    // Last block and the Adler-32, the stream is done after this
+    void finish();
+
+    uint32_t total_in() { return _total_in; }
+    uint32_t total_out() { return _total_out; }
+
+private:
+    sink_t _sink;
+
+    // LZ77
+    uint8_t _window[2 * DEFLATE_WINDOW_SIZE];
+    uint16_t _head[1 << DEFLATE_HASH_BITS];
+    uint16_t _prev[DEFLATE_WINDOW_SIZE];
+    uint32_t _pos = 0;          // next byte to encode
+    uint32_t _end = 0;          // end of input in the window
+
+    // Symbols of the current block, literal or length << 16 | distance
+    uint32_t _symbols[DEFLATE_BLOCK_SYMBOLS];
+    uint16_t _symbol_count = 0;
+    uint16_t _lit_freq[286];
+    uint16_t _dist_freq[30];
+
+    // Codes for the block being written, 288 as the fixed codes count
+    // the two literal/length symbols that are never used
+    uint8_t _lit_len[288];
+    uint8_t _dist_len[30];
+    uint16_t _lit_code[288];
+    uint16_t _dist_code[30];
+
+    // Huffman tree building, kept here rather than on the stack
+    uint16_t _weight[2 * 286];
+    uint16_t _parent[2 * 286];
+    uint16_t _order[286];
+    uint16_t _freq[286];
+
+    // Output
+    uint32_t _bits = 0;
+    uint8_t _bit_count = 0;
+    uint8_t _out[DEFLATE_OUT_SIZE];
+    uint16_t _out_len = 0;
+
+    uint32_t _adler = 1;
+    uint32_t _total_in = 0;
+    uint32_t _total_out = 0;
+
+    void compress(bool flush);
+    void slide();
+    uint16_t longest_match(uint32_t pos, uint16_t &distance);
+    void insert(uint32_t pos);
+
+    void add_literal(uint8_t c);
+    void add_match(uint16_t length, uint16_t distance);
+    void flush_block(bool last);
+    void build_lengths(const uint16_t *freq, int n, uint8_t limit, uint8_t *lengths);
+
+    void put_bits(uint32_t value, uint8_t count);
+    void put_code(uint16_t code, uint8_t length);
+    void put_byte(uint8_t b);
+    void flush_bits();
+    void flush_out();
+};
+
+#endif // PNG_DEFLATE_H
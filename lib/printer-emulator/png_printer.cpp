@@ -1,12 +1,11 @@
 #include "png_printer.h"
 
-#include "../../include/debug.h"
+#include <cstring>
 
+#include "../../include/debug.h"
 
 // rewrite of TinyPngOut https://www.nayuki.io/page/tiny-png-output
 
-#define DEFLATE_MAX_BLOCK_SIZE 0xFFFF
-
 void pngPrinter::uint32_to_array(uint32_t src, uint8_t dest[4])
 {
     dest[0] = (uint8_t)((src >> 24) & 0xff);
@@ -15,69 +14,22 @@ void pngPrinter::uint32_to_array(uint32_t src, uint8_t dest[4])
     dest[3] = (uint8_t)(src & 0xff);
 }
 
-uint32_t pngPrinter::update_adler32(uint32_t adler, uint8_t data)
+// One chunk: length, type, data and the CRC-32 of type and data
+void pngPrinter::png_chunk(const char *type, const uint8_t *data, uint32_t length)
 {
-    // https://gist.github.com/kornelski/710db9d30a64db0807c5bfbdbdecf85e
-    unsigned s1 = adler & 0xffff;
-    unsigned s2 = (adler >> 16) & 0xffff;
-
-    s1 += data;
-    s1 %= 65521;
+    uint8_t len[4], ccc[4];
 
-    s2 += s1;
-    s2 %= 65521;
+    uint32_to_array(length, len);
+    uint32_t crc_value = png_crc32(0, (const uint8_t *)type, 4);
+    crc_value = png_crc32(crc_value, data, length);
+    uint32_to_array(crc_value, ccc);
 
-    return (s2 << 16) | s1;
-}
-
-uint32_t pngPrinter::rc_crc32(uint32_t crc, const uint8_t *buf, size_t len)
-// https://rosettacode.org/wiki/CRC-32#Implementation_2
-{
-    static uint32_t table[256];
-    static int have_table = 0;
-    uint32_t rem;
-    uint8_t octet;
-    int i, j;
-    const uint8_t *p, *q;
-
-    /* This check is not thread safe; there is no mutex. */
-    if (have_table == 0)
-    {
-        /* Calculate CRC table. */
-        for (i = 0; i < 256; i++)
-        {
-            rem = i; /* remainder from polynomial division */
-            for (j = 0; j < 8; j++)
-            {
-                if (rem & 1)
-                {
-                    rem >>= 1;
-                    rem ^= 0xedb88320;
-                }
-                else
-                    rem >>= 1;
-            }
-            table[i] = rem;
-        }
-        have_table = 1;
-    }
-
-    crc = ~crc;
-    q = buf + len;
-    for (p = buf; p < q; p++)
-    {
-        octet = *p; /* Cast to unsigned octet. */
-        crc = (crc >> 8) ^ table[(crc & 0xff) ^ octet];
-    }
-    return ~crc;
+    fwrite(len, 1, 4, _file);
+    fwrite(type, 1, 4, _file);
+    fwrite(data, 1, length, _file);
+    fwrite(ccc, 1, 4, _file);
 }
 
-// uint32_t pngPrinter::rc_crc32(uint32_t crc, uint8_t c)
-// // pass a single character
-// {
-//     rc_crc32(crc, &c, 1);
-// }
-
 void pngPrinter::png_signature()
 {
     Debug_println("Writing PNG Signature.");
@@ -111,7 +63,7 @@ void pngPrinter::png_header()
         0x08,                   // 16       1 byte depth
         0x03,                   // 17       0x03 color with palette
         0x00,                   // 18       compression method always 0
-        0x00,                   // 19       no filter
+        0x00,                   // 19       filter method 0, a filter type per line
         0x00,                   // 20       no interlace
         0, 0, 0, 0,             // 21-24    IHDR CRC-32 placeholder
     };
@@ -126,7 +78,7 @@ void pngPrinter::png_header()
         chunk type code and chunk data fields, but 
         not including the length field.
     */
-    crc_value = rc_crc32(0, &header[4], 17);
+    uint32_t crc_value = png_crc32(0, &header[4], 17);
     uint32_to_array(crc_value, &header[21]);
     fwrite(header, 1, 25, _file);
 }
@@ -189,7 +141,7 @@ void pngPrinter::png_palette()
     uint8_t ccc[] = {0, 0, 0, 0}; // crc placeholder
 
     uint32_to_array(768, &len[0]);
-    crc_value = rc_crc32(0, &data[0], 4 + 768);
+    uint32_t crc_value = png_crc32(0, &data[0], 4 + 768);
     uint32_to_array(crc_value, &ccc[0]);
 
     fwrite(len, 1, 4, _file);
@@ -219,141 +171,68 @@ void pngPrinter::png_data()
     significance and can occur at any point in the compressed datastream
 */
     Debug_println("Starting PNG Image Data...");
-    uint8_t data[] = {
-        // IDAT chunk
-        0x00, 0x00, 0x00, 0x00, // 0-3      size placeholder
-        'I', 'D', 'A', 'T',     // 4-7      IDAT
-    };
-    crc_value = rc_crc32(0, &data[4], 4); // begin CRC calculation
-
-    // Compute data size
-    // imgSize = (width + 1) * height; // +1 per line for filter 0's
-    uint32_t numBlocks = imgSize / DEFLATE_MAX_BLOCK_SIZE;
-    if (imgSize % DEFLATE_MAX_BLOCK_SIZE != 0)
-        numBlocks++; // Round up
-
-    dataSize += numBlocks * 5; // 5 bytes per DEFLATE uncompressed block header
-    dataSize += 2;             // 2 bytes for zlib header
-    dataSize += 4;             // 4 bytes for zlib Adler-32 checksum
-    dataSize += imgSize;       // plus the image data
 
-    uint32_to_array(dataSize, &data[0]); // store the computed size
-
-    fwrite(data, 1, 8, _file); // write out the IDAT header
+    // Each block of compressed output goes out as its own IDAT chunk, so
+    // nothing of the page is held beyond the compressor's window
+    delete deflate;
+    deflate = new pngDeflate([this](const uint8_t *data, size_t length) {
+        png_chunk("IDAT", data, length);
+    });
+    memset(prev_line, 0, sizeof(prev_line));
+    Ypos = 0;
 }
 
 void pngPrinter::png_add_data(uint8_t *buf, uint32_t n)
 {
-    uint8_t c = 0;
-    // Deflate-compressed datastreams within PNG are stored in the “zlib” format
-    // https://tools.ietf.org/html/rfc1950#page-4
-
-    if (img_pos == 0)
-    {
-        Debug_println("Writing ZLIB header.");
-        // write out a ZLIB header
-        // Compression method/flags code: 1 byte (For PNG compression method 0, the zlib compression method/flags code must specify method code 8 (“deflate” compression))
-        c = 0x08; // ZLIB "Deflate" compression scheme
-        crc_value = rc_crc32(crc_value, c);
-        fputc(c, _file);
-        //  Additional flags/check bits: 1 byte (must be such that method + flags, when viewed as a 16-bit unsigned integer stored in MSB order (CMF*256 + FLG), is a multiple of 31.)
-        c = 0x1D; // precompute so that 0x081D is divisible by 31 [ (0x800 / 31 + 1) * 31 - 0x800 ]
-        crc_value = rc_crc32(crc_value, c);
-        fputc(c, _file);
-
-        //printf("new image\r\n");
-    }
-
-    uint32_t idx = 0;
-    while (idx < n)
+    /*
+        https://www.w3.org/TR/REC-png.pdf
+        6.6 Filter selection
+        Each line gets whichever of None, Sub and Up leaves the
+        smallest sum of absolute differences, Sub for runs along
+        the line and Up for a line much like the one above.
+    */
+    if (deflate == nullptr || Ypos >= height)
+        return;
+
+    uint32_t sums[3] = { 0, 0, 0 };
+    filtered[0][0] = 0;
+    filtered[1][0] = 1;
+    filtered[2][0] = 2;
+    for (uint32_t x = 0; x < n; x++)
     {
-        // at beginning of block?
-        if (blk_pos == 0)
-        {
-            blkSize = DEFLATE_MAX_BLOCK_SIZE;
-            uint8_t c = 0;
-            if (imgSize - img_pos <= (uint32_t)blkSize)
-            {
-                c = 1; // final block
-                blkSize = (uint16_t)(imgSize - img_pos);
-            }
+        uint8_t none = buf[x];
+        uint8_t sub = buf[x] - (x ? buf[x - 1] : 0);
+        uint8_t up = buf[x] - prev_line[x];
 
-            Debug_println("Writing ZLIB block header.");
-            // write out block header
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-
-            // write out block size
-            c = (uint8_t)(blkSize >> 0);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)(blkSize >> 8);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)((blkSize >> 0) ^ 0xFF);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)((blkSize >> 8) ^ 0xFF);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-
-            //printf("new block\r\n");
-        }
+        filtered[0][x + 1] = none;
+        filtered[1][x + 1] = sub;
+        filtered[2][x + 1] = up;
 
-        //at beginning of a line?
-        if (Xpos == 0)
-        {
-            Debug_printf("Starting PNG line %d ... ",Ypos);
-            c = 0;
-            crc_value = rc_crc32(crc_value, c);
-            adler_value = update_adler32(adler_value, c);
-            fputc(c, _file);
-            //printf("\nnew line %d ", c);
-
-            img_pos++;
-            blk_pos++;
-        }
+        sums[0] += (none < 128) ? none : 256 - none;
+        sums[1] += (sub < 128) ? sub : 256 - sub;
+        sums[2] += (up < 128) ? up : 256 - up;
+    }
 
-        // put byte from buffer
-        c = buf[idx];
-        crc_value = rc_crc32(crc_value, c);
-        adler_value = update_adler32(adler_value, c);
-        fputc(c, _file);
-        //printf("%d ", c);
+    int best = 0;
+    for (int f = 1; f < 3; f++)
+        if (sums[f] < sums[best])
+            best = f;
 
-        Xpos++;
-        idx++;
-        img_pos++;
-        blk_pos++;
+    deflate->write(filtered[best], n + 1);
+    memcpy(prev_line, buf, n);
+    Ypos++;
 
-        // check for end of's
-        if (Xpos == width)
-        {
-            Debug_println("Finished PNG line.");
-            Xpos = 0;
-            Ypos++;
-        }
-        if (blk_pos == blkSize)
-        {
-            Debug_println("End of ZLIB block.");
-            blk_pos = 0;
-        }
-    };
+    if (Ypos == height)
+        png_finish();
+}
 
-    if (img_pos == imgSize)
-    {
-        Debug_println("Writing ZLIB Adler checksum and PNG data CRC.");
-        uint8_t data[] = {
-            0, 0, 0, 0, // Adler32 Check value: 4 bytes
-            0, 0, 0, 0  // CRC32: 4 bytes
-        };
-        uint32_to_array(adler_value, &data[0]);
-        for (int i = 0; i < 4; i++)
-            crc_value = rc_crc32(crc_value, data[i]); // crc_value = rc_crc32(crc_value, data[0],4); ?????????
-        uint32_to_array(crc_value, &data[4]);
-        fwrite(data, 1, 8, _file);
-        png_end();
-    }
+void pngPrinter::png_finish()
+{
+    Debug_printf("Finishing PNG data, %u bytes compressed to %u.\r\n", deflate->total_in(), deflate->total_out());
+    deflate->finish();
+    delete deflate;
+    deflate = nullptr;
+    png_end();
 }
 
 void pngPrinter::png_end()
@@ -366,14 +245,24 @@ void pngPrinter::png_end()
     fwrite(end, 1, 12, _file);
 }
 
-// TODO: Anything here?
 void pngPrinter::pre_close_file()
 {
-
+    // Page not filled yet, blank lines to the bottom so the PNG is complete
+    if (deflate != nullptr)
+    {
+        memset(line_buffer, 0, sizeof(line_buffer));
+        while (deflate != nullptr)
+            png_add_data(line_buffer, width);
+    }
+    BOLflag = true;
+    line_index = 0;
 }
 
 void pngPrinter::post_new_file()
 {
+    BOLflag = true;
+    line_index = 0;
+
     // call PNG header routines
     png_signature();
     png_header();
@@ -387,7 +276,7 @@ bool pngPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
 // copy buffer[] into linebuffer[]
     Debug_printf("%d bytes rx'd by PNG printer\r\n", n);
     uint16_t i = 0;
-    while (i < n && img_pos < imgSize)
+    while (i < n && deflate != nullptr)
     {
         //Debug_println("processing buffer.");
         if (BOLflag)
@@ -402,7 +291,7 @@ bool pngPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
         }
         if (line_index == 320)
         {
-            while (rep_code-- > 0)
+            while (rep_code-- > 0 && deflate != nullptr)
             {
                 Debug_printf("Adding line %d\r\n", rep_code);
                 png_add_data(&line_buffer[0], 320);
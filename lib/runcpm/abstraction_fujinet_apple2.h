@@ -11,6 +11,7 @@
 #include "compat_string.h"
 
 #include "globals.h"
+#include "filecache.h"
 
 #include "../../include/debug.h"
 
@@ -28,8 +29,12 @@
 // using namespace std;
 
 #ifdef ESP_PLATFORM // OS
-QueueHandle_t rxq;
-QueueHandle_t txq;
+#include <freertos/stream_buffer.h>
+
+// Console rings between the CP/M task and the IEC bus, one writer and one reader each,
+// so bytes go in and out without taking a queue lock and whole runs can be moved at once
+StreamBufferHandle_t rxq;	// console output, CP/M to the bus
+StreamBufferHandle_t txq;	// console input, bus to CP/M
 #endif
 
 typedef struct
@@ -68,6 +73,11 @@ char *full_path(char *fn)
 	return full_filename;
 }
 
+FILE *_fc_fopen(uint8 *filename, const char *mode)
+{
+	return fnSDFAT.file_open(full_path((char *)filename), mode);
+}
+
 /* Memory abstraction functions */
 /*===============================================================================*/
 bool _RamLoad(char *fn, uint16_t address)
@@ -138,15 +148,17 @@ int _sys_select(uint8_t *disk)
 long _sys_filesize(uint8_t *fn)
 {
 	unsigned long fs = -1;
-	FILE *fp = fnSDFAT.file_open(full_path((char *)fn), "r");
+	FILE *fp;
 
+	_fc_flush(fn);
+	fp = fnSDFAT.file_open(full_path((char *)fn), "r");
 	if (fp)
 	{
 		fseek(fp, 0L, SEEK_END);
 		fs = ftell(fp);
+		fclose(fp);
 	}
 
-	fclose(fp);
 	return fs;
 }
 
@@ -164,6 +176,8 @@ int _sys_openfile(uint8_t *fn)
 
 int _sys_makefile(uint8_t *fn)
 {
+	_fc_close(fn);
+
 	FILE *fp = fnSDFAT.file_open(full_path((char *)fn), "w");
 	if (fp)
 	{
@@ -176,6 +190,7 @@ int _sys_makefile(uint8_t *fn)
 
 int _sys_deletefile(uint8_t *fn)
 {
+	_fc_close(fn);
 	return fnSDFAT.remove(full_path((char *)fn));
 }
 
@@ -183,6 +198,9 @@ int _sys_renamefile(uint8_t *fn, uint8_t *newname)
 {
 	std::string from, to;
 
+	_fc_close(fn);
+	_fc_close(newname);
+
 	from = std::string(full_path((char *)fn));
 	to = std::string(full_path((char *)newname));
 
@@ -194,179 +212,71 @@ void _sys_logbuffer(uint8_t *buffer)
 	// not implemented at present.
 }
 
-bool _sys_extendfile(char *fn, unsigned long fpos)
-{
-	FILE *fp = fnSDFAT.file_open(full_path((char *)fn), "a");
-
-	if (!fp)
-		return false;
-
-	long origSize = fnSDFAT.filesize(full_path(fn));
-
-	// This was patterned after the arduino abstraction, and I do not like how this works.
-
-	if (fpos > origSize)
-	{
-		for (long i = 0; i < (origSize - fpos); ++i)
-		{
-			if (fwrite("\0", sizeof(uint8_t), 1, fp) != 1)
-			{
-				fclose(fp);
-				return false;
-			}
-		}
-	}
-	fclose(fp);
-	return true;
-}
+// Records go through the open file cache, see filecache.h
 
 uint8_t _sys_readseq(uint8_t *fn, long fpos)
 {
-	uint8_t result = 0xff;
-	FILE *f;
-	uint8_t bytesread;
 	uint8_t dmabuf[BlkSZ];
-	int seekErr;
+	int bytesread;
 
-	f = fnSDFAT.file_open(full_path((char *)fn), "r");
-	if (!f)
-	{
-		result = 0x10;
-		return result;
-	}
+	bytesread = _fc_read(fn, fpos, dmabuf);
+	if (bytesread < 0)
+		return 0x10;
 
-	seekErr = fseek(f, fpos, SEEK_SET);
-	if (f)
-	{
-		if (fpos > 0 && seekErr != 0)
-		{
-			// EOF
-			result = 0x01;
-		}
-		else
-		{
-			// set DMA buffer to EOF
-			memset(dmabuf, 0x1a, BlkSZ);
-			bytesread = fread(&dmabuf[0], BlkSZ, sizeof(uint8_t), f);
-			if (bytesread)
-				memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
-			result = bytesread ? 0x00 : 0x01;
-		}
-	}
-	else
-	{
-		result = 0x10;
-	}
-	fclose(f);
-	return (result);
+	if (bytesread)
+		memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
+	return bytesread ? 0x00 : 0x01;
 }
 
 uint8_t _sys_writeseq(uint8_t *fn, long fpos)
 {
-	uint8_t result = 0xff;
-	FILE *f;
-
-	if (_sys_extendfile((char *)fn, fpos))
-		f = fnSDFAT.file_open(full_path((char *)fn), "r+");
-	else
-		return result;
+	int result = _fc_write(fn, fpos, _RamSysAddr(dmaAddr));
 
-	if (f)
-	{
-		if (fseek(f, fpos, SEEK_SET) == 0)
-		{
-			if (fwrite(_RamSysAddr(dmaAddr), BlkSZ, sizeof(uint8_t), f))
-				result = 0x00;
-		}
-		else
-		{
-			result = 0x01;
-		}
-	}
-	else
-	{
-		result = 0x10;
-	}
-	fclose(f);
-	return (result);
+	if (result < 0)
+		return 0x10;
+	return result ? 0x00 : 0x01;
 }
 
 uint8_t _sys_readrand(uint8_t *fn, long fpos)
 {
-	uint8 result = 0xff;
-	FILE *f;
-	uint8 bytesread;
 	uint8 dmabuf[BlkSZ];
+	int bytesread;
 	long extSize;
 
-	f = fnSDFAT.file_open(full_path((char *)fn), "r+");
-	if (f)
-	{
-		if (fseek(f, fpos, SEEK_SET) == 0)
-		{
-			memset(dmabuf, 0x1A, BlkSZ);
-			bytesread = fread(&dmabuf[0], BlkSZ, sizeof(uint8_t), f);
-			if (bytesread)
-				memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
-			result = bytesread ? 0x00 : 0x01;
-		}
-		else
-		{
-			if (fpos >= 65536L * BlkSZ)
-			{
-				result = 0x06; // seek past 8MB (largest file size in CP/M)
-			}
-			else
-			{
-				extSize = _sys_filesize((uint8_t *)full_path((char *)fn));
+	if (fpos >= 65536L * BlkSZ)
+		return 0x06; // seek past 8MB (largest file size in CP/M)
 
-				// round file size up to next full logical extent
-				extSize = ExtSZ * ((extSize / ExtSZ) + ((extSize % ExtSZ) ? 1 : 0));
-				if (fpos < extSize)
-					result = 0x01; // reading unwritten data
-				else
-					result = 0x04; // seek to unwritten extent
-			}
-		}
-	}
-	else
+	bytesread = _fc_read(fn, fpos, dmabuf);
+	if (bytesread < 0)
+		return 0x10;
+
+	if (bytesread)
 	{
-		result = 0x10;
+		memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
+		return 0x00;
 	}
-	fclose(f);
-	return (result);
+
+	extSize = _fc_size(fn);
+
+	// round file size up to next full logical extent
+	extSize = ExtSZ * ((extSize / ExtSZ) + ((extSize % ExtSZ) ? 1 : 0));
+	if (fpos < extSize)
+		return 0x01; // reading unwritten data
+	else
+		return 0x04; // seek to unwritten extent
 }
 
 uint8_t _sys_writerand(uint8_t *fn, long fpos)
 {
-	uint8 result = 0xff;
-	FILE *f;
+	int result;
 
-	if (_sys_extendfile((char *)fn, fpos))
-	{
-		f = fnSDFAT.file_open(full_path((char *)fn), "r+");
-	}
-	else
-		return result;
+	if (fpos >= 65536L * BlkSZ)
+		return 0x06;
 
-	if (f)
-	{
-		if (fseek(f, fpos, SEEK_SET) == 0)
-		{
-			if (fwrite(_RamSysAddr(dmaAddr), BlkSZ, sizeof(uint8_t), f))
-				result = 0x00;
-		}
-		else
-		{
-			result = 0x06;
-		}
-	}
-	else
-	{
-		result = 0x10;
-	}
-	fclose(f);
-	return (result);
+	result = _fc_write(fn, fpos, _RamSysAddr(dmaAddr));
+	if (result < 0)
+		return 0x10;
+	return result ? 0x00 : 0x06;
 }
 
 uint8_t findNextDirName[17];
@@ -514,7 +424,7 @@ uint8_t _sys_makedisk(uint8_t drive)
 int _kbhit(void)
 {
 #ifdef ESP_PLATFORM // OS
-	return uxQueueMessagesWaiting(txq);
+	return xStreamBufferBytesAvailable(txq);
 #else
 	return 0;
 #endif
@@ -524,7 +434,7 @@ uint8_t _getch(void)
 {
 	uint8_t c;
 #ifdef ESP_PLATFORM // OS
-	xQueueReceive(txq,&c,portMAX_DELAY);
+	xStreamBufferReceive(txq,&c,1,portMAX_DELAY);
 #endif
 	return c;
 }
@@ -533,7 +443,7 @@ uint8_t _getche(void)
 {
 	uint8_t c = _getch();
 #ifdef ESP_PLATFORM // OS
-	xQueueSend(rxq,&c,portMAX_DELAY);
+	xStreamBufferSend(rxq,&c,1,portMAX_DELAY);
 #endif
 	return c;
 }
@@ -541,22 +451,17 @@ uint8_t _getche(void)
 void _putch(uint8_t ch)
 {
 #ifdef ESP_PLATFORM // OS
-	xQueueSend(rxq,&ch,portMAX_DELAY);
+	xStreamBufferSend(rxq,&ch,1,portMAX_DELAY);
 #endif
 }
 
 void _clrscr(void)
 {
-	_putch(0x1B);
-	_putch('[');
-	_putch('1');
-	_putch(';');
-	_putch('1');
-	_putch('H');
-	_putch(0x1B);
-	_putch('[');
-	_putch('2');
-	_putch('J');
+#ifdef ESP_PLATFORM // OS
+	static const uint8_t cls[] = { 0x1B, '[', '1', ';', '1', 'H', 0x1B, '[', '2', 'J' };
+
+	xStreamBufferSend(rxq,cls,sizeof(cls),portMAX_DELAY);
+#endif
 }
 
 uint8_t bdos_networkConfig(uint16_t addr)
@@ -29,6 +29,8 @@ lua_State* L;
 
 #define HostOS 0x02
 
+#include "filecache.h"
+
 /* Externals for abstracted functions need to go here */
 FILE* _sys_fopen_r(uint8* filename);
 int _sys_fseek(FILE* file, long delta, int origin);
@@ -92,6 +94,10 @@ FILE* _sys_fopen_a(uint8* filename) {
 	return(fopen((const char*)filename, "a"));
 }
 
+FILE* _fc_fopen(uint8* filename, const char* mode) {
+	return(fopen((const char*)filename, mode));
+}
+
 int _sys_fseek(FILE* file, long delta, int origin) {
 	return(fseek(file, delta, origin));
 }
@@ -139,6 +145,7 @@ int _sys_select(uint8* disk) {
 
 long _sys_filesize(uint8* filename) {
 	long l = -1;
+	_fc_flush(filename);
 	FILE* file = _sys_fopen_r(filename);
 	if (file != NULL) {
 		_sys_fseek(file, 0, SEEK_END);
@@ -156,6 +163,7 @@ int _sys_openfile(uint8* filename) {
 }
 
 int _sys_makefile(uint8* filename) {
+	_fc_close(filename);
 	FILE* file = _sys_fopen_a(filename);
 	if (file != NULL)
 		_sys_fclose(file);
@@ -163,10 +171,13 @@ int _sys_makefile(uint8* filename) {
 }
 
 int _sys_deletefile(uint8* filename) {
+	_fc_close(filename);
 	return(!_sys_remove(filename));
 }
 
 int _sys_renamefile(uint8* filename, uint8* newname) {
+	_fc_close(filename);
+	_fc_close(newname);
 	return(!_sys_rename(&filename[0], &newname[0]));
 }
 
@@ -186,114 +197,72 @@ void _sys_logbuffer(uint8* buffer) {
 }
 #endif
 
+// Records go through the open file cache, see filecache.h
+
 uint8 _sys_readseq(uint8* filename, long fpos) {
-	uint8 result = 0xff;
-	uint8 bytesread;
 	uint8 dmabuf[128];
 	uint8 i;
 
-	FILE* file = _sys_fopen_r(&filename[0]);
-	if (file != NULL) {
-		if (!_sys_fseek(file, fpos, 0)) {
-			for (i = 0; i < 128; ++i)
-				dmabuf[i] = 0x1a;
-			bytesread = (uint8)_sys_fread(&dmabuf[0], 1, 128, file);
-			if (bytesread) {
-				for (i = 0; i < 128; ++i)
-					_RamWrite(dmaAddr + i, dmabuf[i]);
-			}
-			result = bytesread ? 0x00 : 0x01;
-		} else {
-			result = 0x01;
-		}
-		_sys_fclose(file);
-	} else {
-		result = 0x10;
-	}
+	int bytesread = _fc_read(&filename[0], fpos, &dmabuf[0]);
+	if (bytesread < 0)
+		return(0x10);
 
-	return(result);
+	if (bytesread) {
+		for (i = 0; i < 128; ++i)
+			_RamWrite(dmaAddr + i, dmabuf[i]);
+	}
+	return(bytesread ? 0x00 : 0x01);
 }
 
 uint8 _sys_writeseq(uint8* filename, long fpos) {
-	uint8 result = 0xff;
-
-	FILE* file = _sys_fopen_rw(&filename[0]);
-	if (file != NULL) {
-		if (!_sys_fseek(file, fpos, 0)) {
-			if (_sys_fwrite(_RamSysAddr(dmaAddr), 1, 128, file))
-				result = 0x00;
-		} else {
-			result = 0x01;
-		}
-		_sys_fclose(file);
-	} else {
-		result = 0x10;
-	}
+	int result = _fc_write(&filename[0], fpos, _RamSysAddr(dmaAddr));
+	if (result < 0)
+		return(0x10);
 
-	return(result);
+	return(result ? 0x00 : 0x01);
 }
 
 uint8 _sys_readrand(uint8* filename, long fpos) {
-	uint8 result = 0xff;
-	uint8 bytesread;
 	uint8 dmabuf[128];
 	uint8 i;
 	long extSize;
 
-	FILE* file = _sys_fopen_r(&filename[0]);
-	if (file != NULL) {
-		if (!_sys_fseek(file, fpos, 0)) {
-			for (i = 0; i < 128; ++i)
-				dmabuf[i] = 0x1a;
-			bytesread = (uint8)_sys_fread(&dmabuf[0], 1, 128, file);
-			if (bytesread) {
-				for (i = 0; i < 128; ++i)
-					_RamWrite(dmaAddr + i, dmabuf[i]);
-			}
-			result = bytesread ? 0x00 : 0x01;
-		} else {
-			if (fpos >= 65536L * 128) {
-				result = 0x06;	// seek past 8MB (largest file size in CP/M)
-			} else {
-				_sys_fseek(file, 0, SEEK_END);
-				extSize = _sys_ftell(file);
-				// round file size up to next full logical extent
-				extSize = 16384 * ((extSize / 16384) + ((extSize % 16384) ? 1 : 0));
-				if (fpos < extSize)
-					result = 0x01;	// reading unwritten data
-				else
-					result = 0x04; // seek to unwritten extent
-			}
-		}
-		_sys_fclose(file);
-	} else {
-		result = 0x10;
+	if (fpos >= 65536L * 128)
+		return(0x06);	// seek past 8MB (largest file size in CP/M)
+
+	int bytesread = _fc_read(&filename[0], fpos, &dmabuf[0]);
+	if (bytesread < 0)
+		return(0x10);
+
+	if (bytesread) {
+		for (i = 0; i < 128; ++i)
+			_RamWrite(dmaAddr + i, dmabuf[i]);
+		return(0x00);
 	}
 
-	return(result);
+	extSize = _fc_size(&filename[0]);
+	// round file size up to next full logical extent
+	extSize = 16384 * ((extSize / 16384) + ((extSize % 16384) ? 1 : 0));
+	if (fpos < extSize)
+		return(0x01);	// reading unwritten data
+	else
+		return(0x04);	// seek to unwritten extent
 }
 
 uint8 _sys_writerand(uint8* filename, long fpos) {
-	uint8 result = 0xff;
+	if (fpos >= 65536L * 128)
+		return(0x06);
 
-	FILE* file = _sys_fopen_rw(&filename[0]);
-	if (file != NULL) {
-		if (!_sys_fseek(file, fpos, 0)) {
-			if (_sys_fwrite(_RamSysAddr(dmaAddr), 1, 128, file))
-				result = 0x00;
-		} else {
-			result = 0x06;
-		}
-		_sys_fclose(file);
-	} else {
-		result = 0x10;
-	}
+	int result = _fc_write(&filename[0], fpos, _RamSysAddr(dmaAddr));
+	if (result < 0)
+		return(0x10);
 
-	return(result);
+	return(result ? 0x00 : 0x06);
 }
 
 uint8 _Truncate(char* fn, uint8 rc) {
 	uint8 result = 0x00;
+	_fc_close((uint8*)fn);
 	if (truncate(fn, rc * 128))
 		result = 0xff;
 	return(result);
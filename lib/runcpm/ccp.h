@@ -623,6 +623,9 @@ uint8 _ccp_ext(void) {
         SP = BDOSjmppage;								// Sets the stack to the top of the TPA
         
         Z80run();										// Starts Z80 simulation
+#ifdef FILECACHE
+        _fc_closeall();									// Files the program left open are written out
+#endif
         
         error = FALSE;
     }
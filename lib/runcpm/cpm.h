@@ -977,6 +977,9 @@ void _Bdos(void) {
 		   C = 13 (0Dh) : Reset disk system
 		 */
 		case DRV_ALLRESET: {
+#ifdef FILECACHE
+			_fc_closeall();
+#endif
 			roVector = 0;       // Make all drives R/W
 			loginVector = 0;
 			dmaAddr = 0x0080;
@@ -898,6 +898,285 @@ static const uint8 cpTable[256] = {
 	128,128,128,128,128,128,128,128,128,128,128,128,128,128,128,128,
 };
 
+/*
+	Z80_THREADED selects the threaded core: every instruction ends by jumping
+	straight to the code of the next one through a table of label addresses
+	(a GCC extension), instead of going back round the loop and through the
+	switch. Only IN and OUT, which reach the BIOS and BDOS, go back to check
+	Status. The debugger steps the loop, so DEBUG and iDEBUG builds always
+	use the switch.
+*/
+#if defined(Z80_THREADED) && (defined(DEBUG) || defined(iDEBUG) || !defined(__GNUC__))
+#undef Z80_THREADED
+#endif
+
+#ifdef Z80_THREADED
+/*
+	Both cores already take S, Z and P from xororTable, andTable, rrdrldTable
+	and rotateShiftTable, and H (with C and V) from the cbits tables indexed
+	by a ^ b ^ result. DAA was the one instruction still worked out bit by bit.
+*/
+/* daaTable[i] = AF after DAA, i = A | (C << 8) | (H << 9) | (N << 10) */
+static const uint16 daaTable[2048] = {
+	0x0044,0x0100,0x0200,0x0304,0x0400,0x0504,0x0604,0x0700,
+	0x0808,0x090c,0x1010,0x1114,0x1214,0x1310,0x1414,0x1510,
+	0x1000,0x1104,0x1204,0x1300,0x1404,0x1500,0x1600,0x1704,
+	0x180c,0x1908,0x2030,0x2134,0x2234,0x2330,0x2434,0x2530,
+	0x2020,0x2124,0x2224,0x2320,0x2424,0x2520,0x2620,0x2724,
+	0x282c,0x2928,0x3034,0x3130,0x3230,0x3334,0x3430,0x3534,
+	0x3024,0x3120,0x3220,0x3324,0x3420,0x3524,0x3624,0x3720,
+	0x3828,0x392c,0x4010,0x4114,0x4214,0x4310,0x4414,0x4510,
+	0x4000,0x4104,0x4204,0x4300,0x4404,0x4500,0x4600,0x4704,
+	0x480c,0x4908,0x5014,0x5110,0x5210,0x5314,0x5410,0x5514,
+	0x5004,0x5100,0x5200,0x5304,0x5400,0x5504,0x5604,0x5700,
+	0x5808,0x590c,0x6034,0x6130,0x6230,0x6334,0x6430,0x6534,
+	0x6024,0x6120,0x6220,0x6324,0x6420,0x6524,0x6624,0x6720,
+	0x6828,0x692c,0x7030,0x7134,0x7234,0x7330,0x7434,0x7530,
+	0x7020,0x7124,0x7224,0x7320,0x7424,0x7520,0x7620,0x7724,
+	0x782c,0x7928,0x8090,0x8194,0x8294,0x8390,0x8494,0x8590,
+	0x8080,0x8184,0x8284,0x8380,0x8484,0x8580,0x8680,0x8784,
+	0x888c,0x8988,0x9094,0x9190,0x9290,0x9394,0x9490,0x9594,
+	0x9084,0x9180,0x9280,0x9384,0x9480,0x9584,0x9684,0x9780,
+	0x9888,0x998c,0x0055,0x0111,0x0211,0x0315,0x0411,0x0515,
+	0x0045,0x0101,0x0201,0x0305,0x0401,0x0505,0x0605,0x0701,
+	0x0809,0x090d,0x1011,0x1115,0x1215,0x1311,0x1415,0x1511,
+	0x1001,0x1105,0x1205,0x1301,0x1405,0x1501,0x1601,0x1705,
+	0x180d,0x1909,0x2031,0x2135,0x2235,0x2331,0x2435,0x2531,
+	0x2021,0x2125,0x2225,0x2321,0x2425,0x2521,0x2621,0x2725,
+	0x282d,0x2929,0x3035,0x3131,0x3231,0x3335,0x3431,0x3535,
+	0x3025,0x3121,0x3221,0x3325,0x3421,0x3525,0x3625,0x3721,
+	0x3829,0x392d,0x4011,0x4115,0x4215,0x4311,0x4415,0x4511,
+	0x4001,0x4105,0x4205,0x4301,0x4405,0x4501,0x4601,0x4705,
+	0x480d,0x4909,0x5015,0x5111,0x5211,0x5315,0x5411,0x5515,
+	0x5005,0x5101,0x5201,0x5305,0x5401,0x5505,0x5605,0x5701,
+	0x5809,0x590d,0x6035,0x6131,0x6231,0x6335,0x6431,0x6535,
+	0x6025,0x6121,0x6221,0x6325,0x6421,0x6525,0x6625,0x6721,
+	0x6829,0x692d,0x7031,0x7135,0x7235,0x7331,0x7435,0x7531,
+	0x7021,0x7125,0x7225,0x7321,0x7425,0x7521,0x7621,0x7725,
+	0x782d,0x7929,0x8091,0x8195,0x8295,0x8391,0x8495,0x8591,
+	0x8081,0x8185,0x8285,0x8381,0x8485,0x8581,0x8681,0x8785,
+	0x888d,0x8989,0x9095,0x9191,0x9291,0x9395,0x9491,0x9595,
+	0x9085,0x9181,0x9281,0x9385,0x9481,0x9585,0x9685,0x9781,
+	0x9889,0x998d,0xa0b5,0xa1b1,0xa2b1,0xa3b5,0xa4b1,0xa5b5,
+	0xa0a5,0xa1a1,0xa2a1,0xa3a5,0xa4a1,0xa5a5,0xa6a5,0xa7a1,
+	0xa8a9,0xa9ad,0xb0b1,0xb1b5,0xb2b5,0xb3b1,0xb4b5,0xb5b1,
+	0xb0a1,0xb1a5,0xb2a5,0xb3a1,0xb4a5,0xb5a1,0xb6a1,0xb7a5,
+	0xb8ad,0xb9a9,0xc095,0xc191,0xc291,0xc395,0xc491,0xc595,
+	0xc085,0xc181,0xc281,0xc385,0xc481,0xc585,0xc685,0xc781,
+	0xc889,0xc98d,0xd091,0xd195,0xd295,0xd391,0xd495,0xd591,
+	0xd081,0xd185,0xd285,0xd381,0xd485,0xd581,0xd681,0xd785,
+	0xd88d,0xd989,0xe0b1,0xe1b5,0xe2b5,0xe3b1,0xe4b5,0xe5b1,
+	0xe0a1,0xe1a5,0xe2a5,0xe3a1,0xe4a5,0xe5a1,0xe6a1,0xe7a5,
+	0xe8ad,0xe9a9,0xf0b5,0xf1b1,0xf2b1,0xf3b5,0xf4b1,0xf5b5,
+	0xf0a5,0xf1a1,0xf2a1,0xf3a5,0xf4a1,0xf5a5,0xf6a5,0xf7a1,
+	0xf8a9,0xf9ad,0x0055,0x0111,0x0211,0x0315,0x0411,0x0515,
+	0x0045,0x0101,0x0201,0x0305,0x0401,0x0505,0x0605,0x0701,
+	0x0809,0x090d,0x1011,0x1115,0x1215,0x1311,0x1415,0x1511,
+	0x1001,0x1105,0x1205,0x1301,0x1405,0x1501,0x1601,0x1705,
+	0x180d,0x1909,0x2031,0x2135,0x2235,0x2331,0x2435,0x2531,
+	0x2021,0x2125,0x2225,0x2321,0x2425,0x2521,0x2621,0x2725,
+	0x282d,0x2929,0x3035,0x3131,0x3231,0x3335,0x3431,0x3535,
+	0x3025,0x3121,0x3221,0x3325,0x3421,0x3525,0x3625,0x3721,
+	0x3829,0x392d,0x4011,0x4115,0x4215,0x4311,0x4415,0x4511,
+	0x4001,0x4105,0x4205,0x4301,0x4405,0x4501,0x4601,0x4705,
+	0x480d,0x4909,0x5015,0x5111,0x5211,0x5315,0x5411,0x5515,
+	0x5005,0x5101,0x5201,0x5305,0x5401,0x5505,0x5605,0x5701,
+	0x5809,0x590d,0x6035,0x6131,0x6231,0x6335,0x6431,0x6535,
+	0x0604,0x0700,0x0808,0x090c,0x0a0c,0x0b08,0x0c0c,0x0d08,
+	0x0e08,0x0f0c,0x1010,0x1114,0x1214,0x1310,0x1414,0x1510,
+	0x1600,0x1704,0x180c,0x1908,0x1a08,0x1b0c,0x1c08,0x1d0c,
+	0x1e0c,0x1f08,0x2030,0x2134,0x2234,0x2330,0x2434,0x2530,
+	0x2620,0x2724,0x282c,0x2928,0x2a28,0x2b2c,0x2c28,0x2d2c,
+	0x2e2c,0x2f28,0x3034,0x3130,0x3230,0x3334,0x3430,0x3534,
+	0x3624,0x3720,0x3828,0x392c,0x3a2c,0x3b28,0x3c2c,0x3d28,
+	0x3e28,0x3f2c,0x4010,0x4114,0x4214,0x4310,0x4414,0x4510,
+	0x4600,0x4704,0x480c,0x4908,0x4a08,0x4b0c,0x4c08,0x4d0c,
+	0x4e0c,0x4f08,0x5014,0x5110,0x5210,0x5314,0x5410,0x5514,
+	0x5604,0x5700,0x5808,0x590c,0x5a0c,0x5b08,0x5c0c,0x5d08,
+	0x5e08,0x5f0c,0x6034,0x6130,0x6230,0x6334,0x6430,0x6534,
+	0x6624,0x6720,0x6828,0x692c,0x6a2c,0x6b28,0x6c2c,0x6d28,
+	0x6e28,0x6f2c,0x7030,0x7134,0x7234,0x7330,0x7434,0x7530,
+	0x7620,0x7724,0x782c,0x7928,0x7a28,0x7b2c,0x7c28,0x7d2c,
+	0x7e2c,0x7f28,0x8090,0x8194,0x8294,0x8390,0x8494,0x8590,
+	0x8680,0x8784,0x888c,0x8988,0x8a88,0x8b8c,0x8c88,0x8d8c,
+	0x8e8c,0x8f88,0x9094,0x9190,0x9290,0x9394,0x9490,0x9594,
+	0x9684,0x9780,0x9888,0x998c,0x9a8c,0x9b88,0x9c8c,0x9d88,
+	0x9e88,0x9f8c,0x0055,0x0111,0x0211,0x0315,0x0411,0x0515,
+	0x0605,0x0701,0x0809,0x090d,0x0a0d,0x0b09,0x0c0d,0x0d09,
+	0x0e09,0x0f0d,0x1011,0x1115,0x1215,0x1311,0x1415,0x1511,
+	0x1601,0x1705,0x180d,0x1909,0x1a09,0x1b0d,0x1c09,0x1d0d,
+	0x1e0d,0x1f09,0x2031,0x2135,0x2235,0x2331,0x2435,0x2531,
+	0x2621,0x2725,0x282d,0x2929,0x2a29,0x2b2d,0x2c29,0x2d2d,
+	0x2e2d,0x2f29,0x3035,0x3131,0x3231,0x3335,0x3431,0x3535,
+	0x3625,0x3721,0x3829,0x392d,0x3a2d,0x3b29,0x3c2d,0x3d29,
+	0x3e29,0x3f2d,0x4011,0x4115,0x4215,0x4311,0x4415,0x4511,
+	0x4601,0x4705,0x480d,0x4909,0x4a09,0x4b0d,0x4c09,0x4d0d,
+	0x4e0d,0x4f09,0x5015,0x5111,0x5211,0x5315,0x5411,0x5515,
+	0x5605,0x5701,0x5809,0x590d,0x5a0d,0x5b09,0x5c0d,0x5d09,
+	0x5e09,0x5f0d,0x6035,0x6131,0x6231,0x6335,0x6431,0x6535,
+	0x6625,0x6721,0x6829,0x692d,0x6a2d,0x6b29,0x6c2d,0x6d29,
+	0x6e29,0x6f2d,0x7031,0x7135,0x7235,0x7331,0x7435,0x7531,
+	0x7621,0x7725,0x782d,0x7929,0x7a29,0x7b2d,0x7c29,0x7d2d,
+	0x7e2d,0x7f29,0x8091,0x8195,0x8295,0x8391,0x8495,0x8591,
+	0x8681,0x8785,0x888d,0x8989,0x8a89,0x8b8d,0x8c89,0x8d8d,
+	0x8e8d,0x8f89,0x9095,0x9191,0x9291,0x9395,0x9491,0x9595,
+	0x9685,0x9781,0x9889,0x998d,0x9a8d,0x9b89,0x9c8d,0x9d89,
+	0x9e89,0x9f8d,0xa0b5,0xa1b1,0xa2b1,0xa3b5,0xa4b1,0xa5b5,
+	0xa6a5,0xa7a1,0xa8a9,0xa9ad,0xaaad,0xaba9,0xacad,0xada9,
+	0xaea9,0xafad,0xb0b1,0xb1b5,0xb2b5,0xb3b1,0xb4b5,0xb5b1,
+	0xb6a1,0xb7a5,0xb8ad,0xb9a9,0xbaa9,0xbbad,0xbca9,0xbdad,
+	0xbead,0xbfa9,0xc095,0xc191,0xc291,0xc395,0xc491,0xc595,
+	0xc685,0xc781,0xc889,0xc98d,0xca8d,0xcb89,0xcc8d,0xcd89,
+	0xce89,0xcf8d,0xd091,0xd195,0xd295,0xd391,0xd495,0xd591,
+	0xd681,0xd785,0xd88d,0xd989,0xda89,0xdb8d,0xdc89,0xdd8d,
+	0xde8d,0xdf89,0xe0b1,0xe1b5,0xe2b5,0xe3b1,0xe4b5,0xe5b1,
+	0xe6a1,0xe7a5,0xe8ad,0xe9a9,0xeaa9,0xebad,0xeca9,0xedad,
+	0xeead,0xefa9,0xf0b5,0xf1b1,0xf2b1,0xf3b5,0xf4b1,0xf5b5,
+	0xf6a5,0xf7a1,0xf8a9,0xf9ad,0xfaad,0xfba9,0xfcad,0xfda9,
+	0xfea9,0xffad,0x0055,0x0111,0x0211,0x0315,0x0411,0x0515,
+	0x0605,0x0701,0x0809,0x090d,0x0a0d,0x0b09,0x0c0d,0x0d09,
+	0x0e09,0x0f0d,0x1011,0x1115,0x1215,0x1311,0x1415,0x1511,
+	0x1601,0x1705,0x180d,0x1909,0x1a09,0x1b0d,0x1c09,0x1d0d,
+	0x1e0d,0x1f09,0x2031,0x2135,0x2235,0x2331,0x2435,0x2531,
+	0x2621,0x2725,0x282d,0x2929,0x2a29,0x2b2d,0x2c29,0x2d2d,
+	0x2e2d,0x2f29,0x3035,0x3131,0x3231,0x3335,0x3431,0x3535,
+	0x3625,0x3721,0x3829,0x392d,0x3a2d,0x3b29,0x3c2d,0x3d29,
+	0x3e29,0x3f2d,0x4011,0x4115,0x4215,0x4311,0x4415,0x4511,
+	0x4601,0x4705,0x480d,0x4909,0x4a09,0x4b0d,0x4c09,0x4d0d,
+	0x4e0d,0x4f09,0x5015,0x5111,0x5211,0x5315,0x5411,0x5515,
+	0x5605,0x5701,0x5809,0x590d,0x5a0d,0x5b09,0x5c0d,0x5d09,
+	0x5e09,0x5f0d,0x6035,0x6131,0x6231,0x6335,0x6431,0x6535,
+	0x0046,0x0102,0x0202,0x0306,0x0402,0x0506,0x0606,0x0702,
+	0x080a,0x090e,0x0402,0x0506,0x0606,0x0702,0x080a,0x090e,
+	0x1002,0x1106,0x1206,0x1302,0x1406,0x1502,0x1602,0x1706,
+	0x180e,0x190a,0x1406,0x1502,0x1602,0x1706,0x180e,0x190a,
+	0x2022,0x2126,0x2226,0x2322,0x2426,0x2522,0x2622,0x2726,
+	0x282e,0x292a,0x2426,0x2522,0x2622,0x2726,0x282e,0x292a,
+	0x3026,0x3122,0x3222,0x3326,0x3422,0x3526,0x3626,0x3722,
+	0x382a,0x392e,0x3422,0x3526,0x3626,0x3722,0x382a,0x392e,
+	0x4002,0x4106,0x4206,0x4302,0x4406,0x4502,0x4602,0x4706,
+	0x480e,0x490a,0x4406,0x4502,0x4602,0x4706,0x480e,0x490a,
+	0x5006,0x5102,0x5202,0x5306,0x5402,0x5506,0x5606,0x5702,
+	0x580a,0x590e,0x5402,0x5506,0x5606,0x5702,0x580a,0x590e,
+	0x6026,0x6122,0x6222,0x6326,0x6422,0x6526,0x6626,0x6722,
+	0x682a,0x692e,0x6422,0x6526,0x6626,0x6722,0x682a,0x692e,
+	0x7022,0x7126,0x7226,0x7322,0x7426,0x7522,0x7622,0x7726,
+	0x782e,0x792a,0x7426,0x7522,0x7622,0x7726,0x782e,0x792a,
+	0x8082,0x8186,0x8286,0x8382,0x8486,0x8582,0x8682,0x8786,
+	0x888e,0x898a,0x8486,0x8582,0x8682,0x8786,0x888e,0x898a,
+	0x9086,0x9182,0x9282,0x9386,0x9482,0x9586,0x9686,0x9782,
+	0x988a,0x998e,0x3423,0x3527,0x3627,0x3723,0x382b,0x392f,
+	0x4003,0x4107,0x4207,0x4303,0x4407,0x4503,0x4603,0x4707,
+	0x480f,0x490b,0x4407,0x4503,0x4603,0x4707,0x480f,0x490b,
+	0x5007,0x5103,0x5203,0x5307,0x5403,0x5507,0x5607,0x5703,
+	0x580b,0x590f,0x5403,0x5507,0x5607,0x5703,0x580b,0x590f,
+	0x6027,0x6123,0x6223,0x6327,0x6423,0x6527,0x6627,0x6723,
+	0x682b,0x692f,0x6423,0x6527,0x6627,0x6723,0x682b,0x692f,
+	0x7023,0x7127,0x7227,0x7323,0x7427,0x7523,0x7623,0x7727,
+	0x782f,0x792b,0x7427,0x7523,0x7623,0x7727,0x782f,0x792b,
+	0x8083,0x8187,0x8287,0x8383,0x8487,0x8583,0x8683,0x8787,
+	0x888f,0x898b,0x8487,0x8583,0x8683,0x8787,0x888f,0x898b,
+	0x9087,0x9183,0x9283,0x9387,0x9483,0x9587,0x9687,0x9783,
+	0x988b,0x998f,0x9483,0x9587,0x9687,0x9783,0x988b,0x998f,
+	0xa0a7,0xa1a3,0xa2a3,0xa3a7,0xa4a3,0xa5a7,0xa6a7,0xa7a3,
+	0xa8ab,0xa9af,0xa4a3,0xa5a7,0xa6a7,0xa7a3,0xa8ab,0xa9af,
+	0xb0a3,0xb1a7,0xb2a7,0xb3a3,0xb4a7,0xb5a3,0xb6a3,0xb7a7,
+	0xb8af,0xb9ab,0xb4a7,0xb5a3,0xb6a3,0xb7a7,0xb8af,0xb9ab,
+	0xc087,0xc183,0xc283,0xc387,0xc483,0xc587,0xc687,0xc783,
+	0xc88b,0xc98f,0xc483,0xc587,0xc687,0xc783,0xc88b,0xc98f,
+	0xd083,0xd187,0xd287,0xd383,0xd487,0xd583,0xd683,0xd787,
+	0xd88f,0xd98b,0xd487,0xd583,0xd683,0xd787,0xd88f,0xd98b,
+	0xe0a3,0xe1a7,0xe2a7,0xe3a3,0xe4a7,0xe5a3,0xe6a3,0xe7a7,
+	0xe8af,0xe9ab,0xe4a7,0xe5a3,0xe6a3,0xe7a7,0xe8af,0xe9ab,
+	0xf0a7,0xf1a3,0xf2a3,0xf3a7,0xf4a3,0xf5a7,0xf6a7,0xf7a3,
+	0xf8ab,0xf9af,0xf4a3,0xf5a7,0xf6a7,0xf7a3,0xf8ab,0xf9af,
+	0x0047,0x0103,0x0203,0x0307,0x0403,0x0507,0x0607,0x0703,
+	0x080b,0x090f,0x0403,0x0507,0x0607,0x0703,0x080b,0x090f,
+	0x1003,0x1107,0x1207,0x1303,0x1407,0x1503,0x1603,0x1707,
+	0x180f,0x190b,0x1407,0x1503,0x1603,0x1707,0x180f,0x190b,
+	0x2023,0x2127,0x2227,0x2323,0x2427,0x2523,0x2623,0x2727,
+	0x282f,0x292b,0x2427,0x2523,0x2623,0x2727,0x282f,0x292b,
+	0x3027,0x3123,0x3223,0x3327,0x3423,0x3527,0x3627,0x3723,
+	0x382b,0x392f,0x3423,0x3527,0x3627,0x3723,0x382b,0x392f,
+	0x4003,0x4107,0x4207,0x4303,0x4407,0x4503,0x4603,0x4707,
+	0x480f,0x490b,0x4407,0x4503,0x4603,0x4707,0x480f,0x490b,
+	0x5007,0x5103,0x5203,0x5307,0x5403,0x5507,0x5607,0x5703,
+	0x580b,0x590f,0x5403,0x5507,0x5607,0x5703,0x580b,0x590f,
+	0x6027,0x6123,0x6223,0x6327,0x6423,0x6527,0x6627,0x6723,
+	0x682b,0x692f,0x6423,0x6527,0x6627,0x6723,0x682b,0x692f,
+	0x7023,0x7127,0x7227,0x7323,0x7427,0x7523,0x7623,0x7727,
+	0x782f,0x792b,0x7427,0x7523,0x7623,0x7727,0x782f,0x792b,
+	0x8083,0x8187,0x8287,0x8383,0x8487,0x8583,0x8683,0x8787,
+	0x888f,0x898b,0x8487,0x8583,0x8683,0x8787,0x888f,0x898b,
+	0x9087,0x9183,0x9283,0x9387,0x9483,0x9587,0x9687,0x9783,
+	0x988b,0x998f,0x9483,0x9587,0x9687,0x9783,0x988b,0x998f,
+	0xfabe,0xfbba,0xfcbe,0xfdba,0xfeba,0xffbe,0x0046,0x0102,
+	0x0202,0x0306,0x0402,0x0506,0x0606,0x0702,0x080a,0x090e,
+	0x0a1e,0x0b1a,0x0c1e,0x0d1a,0x0e1a,0x0f1e,0x1002,0x1106,
+	0x1206,0x1302,0x1406,0x1502,0x1602,0x1706,0x180e,0x190a,
+	0x1a1a,0x1b1e,0x1c1a,0x1d1e,0x1e1e,0x1f1a,0x2022,0x2126,
+	0x2226,0x2322,0x2426,0x2522,0x2622,0x2726,0x282e,0x292a,
+	0x2a3a,0x2b3e,0x2c3a,0x2d3e,0x2e3e,0x2f3a,0x3026,0x3122,
+	0x3222,0x3326,0x3422,0x3526,0x3626,0x3722,0x382a,0x392e,
+	0x3a3e,0x3b3a,0x3c3e,0x3d3a,0x3e3a,0x3f3e,0x4002,0x4106,
+	0x4206,0x4302,0x4406,0x4502,0x4602,0x4706,0x480e,0x490a,
+	0x4a1a,0x4b1e,0x4c1a,0x4d1e,0x4e1e,0x4f1a,0x5006,0x5102,
+	0x5202,0x5306,0x5402,0x5506,0x5606,0x5702,0x580a,0x590e,
+	0x5a1e,0x5b1a,0x5c1e,0x5d1a,0x5e1a,0x5f1e,0x6026,0x6122,
+	0x6222,0x6326,0x6422,0x6526,0x6626,0x6722,0x682a,0x692e,
+	0x6a3e,0x6b3a,0x6c3e,0x6d3a,0x6e3a,0x6f3e,0x7022,0x7126,
+	0x7226,0x7322,0x7426,0x7522,0x7622,0x7726,0x782e,0x792a,
+	0x7a3a,0x7b3e,0x7c3a,0x7d3e,0x7e3e,0x7f3a,0x8082,0x8186,
+	0x8286,0x8382,0x8486,0x8582,0x8682,0x8786,0x888e,0x898a,
+	0x8a9a,0x8b9e,0x8c9a,0x8d9e,0x8e9e,0x8f9a,0x9086,0x9182,
+	0x9282,0x9386,0x3423,0x3527,0x3627,0x3723,0x382b,0x392f,
+	0x3a3f,0x3b3b,0x3c3f,0x3d3b,0x3e3b,0x3f3f,0x4003,0x4107,
+	0x4207,0x4303,0x4407,0x4503,0x4603,0x4707,0x480f,0x490b,
+	0x4a1b,0x4b1f,0x4c1b,0x4d1f,0x4e1f,0x4f1b,0x5007,0x5103,
+	0x5203,0x5307,0x5403,0x5507,0x5607,0x5703,0x580b,0x590f,
+	0x5a1f,0x5b1b,0x5c1f,0x5d1b,0x5e1b,0x5f1f,0x6027,0x6123,
+	0x6223,0x6327,0x6423,0x6527,0x6627,0x6723,0x682b,0x692f,
+	0x6a3f,0x6b3b,0x6c3f,0x6d3b,0x6e3b,0x6f3f,0x7023,0x7127,
+	0x7227,0x7323,0x7427,0x7523,0x7623,0x7727,0x782f,0x792b,
+	0x7a3b,0x7b3f,0x7c3b,0x7d3f,0x7e3f,0x7f3b,0x8083,0x8187,
+	0x8287,0x8383,0x8487,0x8583,0x8683,0x8787,0x888f,0x898b,
+	0x8a9b,0x8b9f,0x8c9b,0x8d9f,0x8e9f,0x8f9b,0x9087,0x9183,
+	0x9283,0x9387,0x9483,0x9587,0x9687,0x9783,0x988b,0x998f,
+	0x9a9f,0x9b9b,0x9c9f,0x9d9b,0x9e9b,0x9f9f,0xa0a7,0xa1a3,
+	0xa2a3,0xa3a7,0xa4a3,0xa5a7,0xa6a7,0xa7a3,0xa8ab,0xa9af,
+	0xaabf,0xabbb,0xacbf,0xadbb,0xaebb,0xafbf,0xb0a3,0xb1a7,
+	0xb2a7,0xb3a3,0xb4a7,0xb5a3,0xb6a3,0xb7a7,0xb8af,0xb9ab,
+	0xbabb,0xbbbf,0xbcbb,0xbdbf,0xbebf,0xbfbb,0xc087,0xc183,
+	0xc283,0xc387,0xc483,0xc587,0xc687,0xc783,0xc88b,0xc98f,
+	0xca9f,0xcb9b,0xcc9f,0xcd9b,0xce9b,0xcf9f,0xd083,0xd187,
+	0xd287,0xd383,0xd487,0xd583,0xd683,0xd787,0xd88f,0xd98b,
+	0xda9b,0xdb9f,0xdc9b,0xdd9f,0xde9f,0xdf9b,0xe0a3,0xe1a7,
+	0xe2a7,0xe3a3,0xe4a7,0xe5a3,0xe6a3,0xe7a7,0xe8af,0xe9ab,
+	0xeabb,0xebbf,0xecbb,0xedbf,0xeebf,0xefbb,0xf0a7,0xf1a3,
+	0xf2a3,0xf3a7,0xf4a3,0xf5a7,0xf6a7,0xf7a3,0xf8ab,0xf9af,
+	0xfabf,0xfbbb,0xfcbf,0xfdbb,0xfebb,0xffbf,0x0047,0x0103,
+	0x0203,0x0307,0x0403,0x0507,0x0607,0x0703,0x080b,0x090f,
+	0x0a1f,0x0b1b,0x0c1f,0x0d1b,0x0e1b,0x0f1f,0x1003,0x1107,
+	0x1207,0x1303,0x1407,0x1503,0x1603,0x1707,0x180f,0x190b,
+	0x1a1b,0x1b1f,0x1c1b,0x1d1f,0x1e1f,0x1f1b,0x2023,0x2127,
+	0x2227,0x2323,0x2427,0x2523,0x2623,0x2727,0x282f,0x292b,
+	0x2a3b,0x2b3f,0x2c3b,0x2d3f,0x2e3f,0x2f3b,0x3027,0x3123,
+	0x3223,0x3327,0x3423,0x3527,0x3627,0x3723,0x382b,0x392f,
+	0x3a3f,0x3b3b,0x3c3f,0x3d3b,0x3e3b,0x3f3f,0x4003,0x4107,
+	0x4207,0x4303,0x4407,0x4503,0x4603,0x4707,0x480f,0x490b,
+	0x4a1b,0x4b1f,0x4c1b,0x4d1f,0x4e1f,0x4f1b,0x5007,0x5103,
+	0x5203,0x5307,0x5403,0x5507,0x5607,0x5703,0x580b,0x590f,
+	0x5a1f,0x5b1b,0x5c1f,0x5d1b,0x5e1b,0x5f1f,0x6027,0x6123,
+	0x6223,0x6327,0x6423,0x6527,0x6627,0x6723,0x682b,0x692f,
+	0x6a3f,0x6b3b,0x6c3f,0x6d3b,0x6e3b,0x6f3f,0x7023,0x7127,
+	0x7227,0x7323,0x7427,0x7523,0x7623,0x7727,0x782f,0x792b,
+	0x7a3b,0x7b3f,0x7c3b,0x7d3f,0x7e3f,0x7f3b,0x8083,0x8187,
+	0x8287,0x8383,0x8487,0x8583,0x8683,0x8787,0x888f,0x898b,
+	0x8a9b,0x8b9f,0x8c9b,0x8d9f,0x8e9f,0x8f9b,0x9087,0x9183,
+	0x9283,0x9387,0x9483,0x9587,0x9687,0x9783,0x988b,0x998f,
+};
+#endif
+
 #if defined(DEBUG) || defined(iDEBUG)
 static const char* Mnemonics[256] =
 {
@@ -1459,6 +1738,18 @@ void Z80debug(void) {
 }
 #endif
 
+#ifdef Z80_THREADED
+#define OP(n)		case n: op_##n
+#define NEXT		do { PCX = PC; INCR(1); goto *dispatch[RAM_PP(PC)]; } while (0)
+#define NEXT_IO		do { if (Status) goto end_decode; NEXT; } while (0)	/* the BIOS or BDOS may have stopped the CPU */
+#define OPS(h)		&&op_0x##h##0, &&op_0x##h##1, &&op_0x##h##2, &&op_0x##h##3, &&op_0x##h##4, &&op_0x##h##5, &&op_0x##h##6, &&op_0x##h##7, \
+					&&op_0x##h##8, &&op_0x##h##9, &&op_0x##h##a, &&op_0x##h##b, &&op_0x##h##c, &&op_0x##h##d, &&op_0x##h##e, &&op_0x##h##f
+#else
+#define OP(n)		case n
+#define NEXT		break
+#define NEXT_IO		break
+#endif
+
 static inline void Z80run(void) {
 	uint32 temp = 0;
 	uint32 acu = 0;
@@ -1466,6 +1757,12 @@ static inline void Z80run(void) {
 	uint32 cbits = 0;
 	uint32 op = 0;
 	uint32 adr = 0;
+#ifdef Z80_THREADED
+	static const void* const dispatch[256] = {
+		OPS(0), OPS(1), OPS(2), OPS(3), OPS(4), OPS(5), OPS(6), OPS(7),
+		OPS(8), OPS(9), OPS(a), OPS(b), OPS(c), OPS(d), OPS(e), OPS(f)
+	};
+#endif
 
 	/* main instruction fetch/decode loop */
 	while (!Status) {	/* loop until Status != 0 */
@@ -1509,205 +1806,208 @@ static inline void Z80run(void) {
 
 		switch (RAM_PP(PC)) {
 
-		case 0x00:      /* NOP */
-			break;
+		OP(0x00):      /* NOP */
+			NEXT;
 
-		case 0x01:      /* LD BC,nnnn */
+		OP(0x01):      /* LD BC,nnnn */
 			BC = GET_WORD(PC);
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x02:      /* LD (BC),A */
+		OP(0x02):      /* LD (BC),A */
 			PUT_BYTE(BC, HIGH_REGISTER(AF));
-			break;
+			NEXT;
 
-		case 0x03:      /* INC BC */
+		OP(0x03):      /* INC BC */
 			++BC;
-			break;
+			NEXT;
 
-		case 0x04:      /* INC B */
+		OP(0x04):      /* INC B */
 			BC += 0x100;
 			temp = HIGH_REGISTER(BC);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x05:      /* DEC B */
+		OP(0x05):      /* DEC B */
 			BC -= 0x100;
 			temp = HIGH_REGISTER(BC);
 			AF = (AF & ~0xfe) | decTable[temp] | SET_PV2(0x7f); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x06:      /* LD B,nn */
+		OP(0x06):      /* LD B,nn */
 			SET_HIGH_REGISTER(BC, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x07:      /* RLCA */
+		OP(0x07):      /* RLCA */
 			AF = ((AF >> 7) & 0x0128) | ((AF << 1) & ~0x1ff) |
 				(AF & 0xc4) | ((AF >> 15) & 1);
-			break;
+			NEXT;
 
-		case 0x08:      /* EX AF,AF' */
+		OP(0x08):      /* EX AF,AF' */
 			temp = AF;
 			AF = AF1;
 			AF1 = temp;
-			break;
+			NEXT;
 
-		case 0x09:      /* ADD HL,BC */
+		OP(0x09):      /* ADD HL,BC */
 			HL &= ADDRMASK;
 			BC &= ADDRMASK;
 			sum = HL + BC;
 			AF = (AF & ~0x3b) | ((sum >> 8) & 0x28) | cbitsTable[(HL ^ BC ^ sum) >> 8];
 			HL = sum;
-			break;
+			NEXT;
 
-		case 0x0a:      /* LD A,(BC) */
+		OP(0x0a):      /* LD A,(BC) */
 			SET_HIGH_REGISTER(AF, GET_BYTE(BC));
-			break;
+			NEXT;
 
-		case 0x0b:      /* DEC BC */
+		OP(0x0b):      /* DEC BC */
 			--BC;
-			break;
+			NEXT;
 
-		case 0x0c:      /* INC C */
+		OP(0x0c):      /* INC C */
 			temp = LOW_REGISTER(BC) + 1;
 			SET_LOW_REGISTER(BC, temp);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80);
-			break;
+			NEXT;
 
-		case 0x0d:      /* DEC C */
+		OP(0x0d):      /* DEC C */
 			temp = LOW_REGISTER(BC) - 1;
 			SET_LOW_REGISTER(BC, temp);
 			AF = (AF & ~0xfe) | decTable[temp & 0xff] | SET_PV2(0x7f);
-			break;
+			NEXT;
 
-		case 0x0e:      /* LD C,nn */
+		OP(0x0e):      /* LD C,nn */
 			SET_LOW_REGISTER(BC, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x0f:      /* RRCA */
+		OP(0x0f):      /* RRCA */
 			AF = (AF & 0xc4) | rrcaTable[HIGH_REGISTER(AF)];
-			break;
+			NEXT;
 
-		case 0x10:      /* DJNZ dd */
+		OP(0x10):      /* DJNZ dd */
 			if ((BC -= 0x100) & 0xff00)
 				PC += (int8)GET_BYTE(PC) + 1;
 			else
 				++PC;
-			break;
+			NEXT;
 
-		case 0x11:      /* LD DE,nnnn */
+		OP(0x11):      /* LD DE,nnnn */
 			DE = GET_WORD(PC);
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x12:      /* LD (DE),A */
+		OP(0x12):      /* LD (DE),A */
 			PUT_BYTE(DE, HIGH_REGISTER(AF));
-			break;
+			NEXT;
 
-		case 0x13:      /* INC DE */
+		OP(0x13):      /* INC DE */
 			++DE;
-			break;
+			NEXT;
 
-		case 0x14:      /* INC D */
+		OP(0x14):      /* INC D */
 			DE += 0x100;
 			temp = HIGH_REGISTER(DE);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x15:      /* DEC D */
+		OP(0x15):      /* DEC D */
 			DE -= 0x100;
 			temp = HIGH_REGISTER(DE);
 			AF = (AF & ~0xfe) | decTable[temp] | SET_PV2(0x7f); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x16:      /* LD D,nn */
+		OP(0x16):      /* LD D,nn */
 			SET_HIGH_REGISTER(DE, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x17:      /* RLA */
+		OP(0x17):      /* RLA */
 			AF = ((AF << 8) & 0x0100) | ((AF >> 7) & 0x28) | ((AF << 1) & ~0x01ff) |
 				(AF & 0xc4) | ((AF >> 15) & 1);
-			break;
+			NEXT;
 
-		case 0x18:      /* JR dd */
+		OP(0x18):      /* JR dd */
 			PC += (int8)GET_BYTE(PC) + 1;
-			break;
+			NEXT;
 
-		case 0x19:      /* ADD HL,DE */
+		OP(0x19):      /* ADD HL,DE */
 			HL &= ADDRMASK;
 			DE &= ADDRMASK;
 			sum = HL + DE;
 			AF = (AF & ~0x3b) | ((sum >> 8) & 0x28) | cbitsTable[(HL ^ DE ^ sum) >> 8];
 			HL = sum;
-			break;
+			NEXT;
 
-		case 0x1a:      /* LD A,(DE) */
+		OP(0x1a):      /* LD A,(DE) */
 			SET_HIGH_REGISTER(AF, GET_BYTE(DE));
-			break;
+			NEXT;
 
-		case 0x1b:      /* DEC DE */
+		OP(0x1b):      /* DEC DE */
 			--DE;
-			break;
+			NEXT;
 
-		case 0x1c:      /* INC E */
+		OP(0x1c):      /* INC E */
 			temp = LOW_REGISTER(DE) + 1;
 			SET_LOW_REGISTER(DE, temp);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80);
-			break;
+			NEXT;
 
-		case 0x1d:      /* DEC E */
+		OP(0x1d):      /* DEC E */
 			temp = LOW_REGISTER(DE) - 1;
 			SET_LOW_REGISTER(DE, temp);
 			AF = (AF & ~0xfe) | decTable[temp & 0xff] | SET_PV2(0x7f);
-			break;
+			NEXT;
 
-		case 0x1e:      /* LD E,nn */
+		OP(0x1e):      /* LD E,nn */
 			SET_LOW_REGISTER(DE, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x1f:      /* RRA */
+		OP(0x1f):      /* RRA */
 			AF = ((AF & 1) << 15) | (AF & 0xc4) | rraTable[HIGH_REGISTER(AF)];
-			break;
+			NEXT;
 
-		case 0x20:      /* JR NZ,dd */
+		OP(0x20):      /* JR NZ,dd */
 			if (TSTFLAG(Z))
 				++PC;
 			else
 				PC += (int8)GET_BYTE(PC) + 1;
-			break;
+			NEXT;
 
-		case 0x21:      /* LD HL,nnnn */
+		OP(0x21):      /* LD HL,nnnn */
 			HL = GET_WORD(PC);
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x22:      /* LD (nnnn),HL */
+		OP(0x22):      /* LD (nnnn),HL */
 			temp = GET_WORD(PC);
 			PUT_WORD(temp, HL);
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x23:      /* INC HL */
+		OP(0x23):      /* INC HL */
 			++HL;
-			break;
+			NEXT;
 
-		case 0x24:      /* INC H */
+		OP(0x24):      /* INC H */
 			HL += 0x100;
 			temp = HIGH_REGISTER(HL);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x25:      /* DEC H */
+		OP(0x25):      /* DEC H */
 			HL -= 0x100;
 			temp = HIGH_REGISTER(HL);
 			AF = (AF & ~0xfe) | decTable[temp] | SET_PV2(0x7f); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x26:      /* LD H,nn */
+		OP(0x26):      /* LD H,nn */
 			SET_HIGH_REGISTER(HL, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x27:      /* DAA */
+		OP(0x27):      /* DAA */
+#ifdef Z80_THREADED
+			AF = daaTable[HIGH_REGISTER(AF) | ((AF & FLAG_C) << 8) | ((AF & FLAG_H) << 5) | ((AF & FLAG_N) << 9)];
+#else
 			acu = HIGH_REGISTER(AF);
 			temp = LOW_DIGIT(acu);
 			cbits = TSTFLAG(C);
@@ -1730,350 +2030,351 @@ static inline void Z80run(void) {
 					acu += 0x60;   /* adjust high digit */
 			}
 			AF = (AF & 0x12) | rrdrldTable[acu & 0xff] | ((acu >> 8) & 1) | cbits;
-			break;
+#endif
+			NEXT;
 
-		case 0x28:      /* JR Z,dd */
+		OP(0x28):      /* JR Z,dd */
 			if (TSTFLAG(Z))
 				PC += (int8)GET_BYTE(PC) + 1;
 			else
 				++PC;
-			break;
+			NEXT;
 
-		case 0x29:      /* ADD HL,HL */
+		OP(0x29):      /* ADD HL,HL */
 			HL &= ADDRMASK;
 			sum = HL + HL;
 			AF = (AF & ~0x3b) | cbitsDup16Table[sum >> 8];
 			HL = sum;
-			break;
+			NEXT;
 
-		case 0x2a:      /* LD HL,(nnnn) */
+		OP(0x2a):      /* LD HL,(nnnn) */
 			temp = GET_WORD(PC);
 			HL = GET_WORD(temp);
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x2b:      /* DEC HL */
+		OP(0x2b):      /* DEC HL */
 			--HL;
-			break;
+			NEXT;
 
-		case 0x2c:      /* INC L */
+		OP(0x2c):      /* INC L */
 			temp = LOW_REGISTER(HL) + 1;
 			SET_LOW_REGISTER(HL, temp);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80);
-			break;
+			NEXT;
 
-		case 0x2d:      /* DEC L */
+		OP(0x2d):      /* DEC L */
 			temp = LOW_REGISTER(HL) - 1;
 			SET_LOW_REGISTER(HL, temp);
 			AF = (AF & ~0xfe) | decTable[temp & 0xff] | SET_PV2(0x7f);
-			break;
+			NEXT;
 
-		case 0x2e:      /* LD L,nn */
+		OP(0x2e):      /* LD L,nn */
 			SET_LOW_REGISTER(HL, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x2f:      /* CPL */
+		OP(0x2f):      /* CPL */
 			AF = (~AF & ~0xff) | (AF & 0xc5) | ((~AF >> 8) & 0x28) | 0x12;
-			break;
+			NEXT;
 
-		case 0x30:      /* JR NC,dd */
+		OP(0x30):      /* JR NC,dd */
 			if (TSTFLAG(C))
 				++PC;
 			else
 				PC += (int8)GET_BYTE(PC) + 1;
-			break;
+			NEXT;
 
-		case 0x31:      /* LD SP,nnnn */
+		OP(0x31):      /* LD SP,nnnn */
 			SP = GET_WORD(PC);
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x32:      /* LD (nnnn),A */
+		OP(0x32):      /* LD (nnnn),A */
 			temp = GET_WORD(PC);
 			PUT_BYTE(temp, HIGH_REGISTER(AF));
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x33:      /* INC SP */
+		OP(0x33):      /* INC SP */
 			++SP;
-			break;
+			NEXT;
 
-		case 0x34:      /* INC (HL) */
+		OP(0x34):      /* INC (HL) */
 			temp = GET_BYTE(HL) + 1;
 			PUT_BYTE(HL, temp);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80);
-			break;
+			NEXT;
 
-		case 0x35:      /* DEC (HL) */
+		OP(0x35):      /* DEC (HL) */
 			temp = GET_BYTE(HL) - 1;
 			PUT_BYTE(HL, temp);
 			AF = (AF & ~0xfe) | decTable[temp & 0xff] | SET_PV2(0x7f);
-			break;
+			NEXT;
 
-		case 0x36:      /* LD (HL),nn */
+		OP(0x36):      /* LD (HL),nn */
 			PUT_BYTE(HL, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x37:      /* SCF */
+		OP(0x37):      /* SCF */
 			AF = (AF & ~0x3b) | ((AF >> 8) & 0x28) | 1;
-			break;
+			NEXT;
 
-		case 0x38:      /* JR C,dd */
+		OP(0x38):      /* JR C,dd */
 			if (TSTFLAG(C))
 				PC += (int8)GET_BYTE(PC) + 1;
 			else
 				++PC;
-			break;
+			NEXT;
 
-		case 0x39:      /* ADD HL,SP */
+		OP(0x39):      /* ADD HL,SP */
 			HL &= ADDRMASK;
 			SP &= ADDRMASK;
 			sum = HL + SP;
 			AF = (AF & ~0x3b) | ((sum >> 8) & 0x28) | cbitsTable[(HL ^ SP ^ sum) >> 8];
 			HL = sum;
-			break;
+			NEXT;
 
-		case 0x3a:      /* LD A,(nnnn) */
+		OP(0x3a):      /* LD A,(nnnn) */
 			temp = GET_WORD(PC);
 			SET_HIGH_REGISTER(AF, GET_BYTE(temp));
 			PC += 2;
-			break;
+			NEXT;
 
-		case 0x3b:      /* DEC SP */
+		OP(0x3b):      /* DEC SP */
 			--SP;
-			break;
+			NEXT;
 
-		case 0x3c:      /* INC A */
+		OP(0x3c):      /* INC A */
 			AF += 0x100;
 			temp = HIGH_REGISTER(AF);
 			AF = (AF & ~0xfe) | incTable[temp] | SET_PV2(0x80); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x3d:      /* DEC A */
+		OP(0x3d):      /* DEC A */
 			AF -= 0x100;
 			temp = HIGH_REGISTER(AF);
 			AF = (AF & ~0xfe) | decTable[temp] | SET_PV2(0x7f); /* SET_PV2 uses temp */
-			break;
+			NEXT;
 
-		case 0x3e:      /* LD A,nn */
+		OP(0x3e):      /* LD A,nn */
 			SET_HIGH_REGISTER(AF, RAM_PP(PC));
-			break;
+			NEXT;
 
-		case 0x3f:      /* CCF */
+		OP(0x3f):      /* CCF */
 			AF = (AF & ~0x3b) | ((AF >> 8) & 0x28) | ((AF & 1) << 4) | (~AF & 1);
-			break;
+			NEXT;
 
-		case 0x40:      /* LD B,B */
-			break;
+		OP(0x40):      /* LD B,B */
+			NEXT;
 
-		case 0x41:      /* LD B,C */
+		OP(0x41):      /* LD B,C */
 			BC = (BC & 0xff) | ((BC & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x42:      /* LD B,D */
+		OP(0x42):      /* LD B,D */
 			BC = (BC & 0xff) | (DE & ~0xff);
-			break;
+			NEXT;
 
-		case 0x43:      /* LD B,E */
+		OP(0x43):      /* LD B,E */
 			BC = (BC & 0xff) | ((DE & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x44:      /* LD B,H */
+		OP(0x44):      /* LD B,H */
 			BC = (BC & 0xff) | (HL & ~0xff);
-			break;
+			NEXT;
 
-		case 0x45:      /* LD B,L */
+		OP(0x45):      /* LD B,L */
 			BC = (BC & 0xff) | ((HL & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x46:      /* LD B,(HL) */
+		OP(0x46):      /* LD B,(HL) */
 			SET_HIGH_REGISTER(BC, GET_BYTE(HL));
-			break;
+			NEXT;
 
-		case 0x47:      /* LD B,A */
+		OP(0x47):      /* LD B,A */
 			BC = (BC & 0xff) | (AF & ~0xff);
-			break;
+			NEXT;
 
-		case 0x48:      /* LD C,B */
+		OP(0x48):      /* LD C,B */
 			BC = (BC & ~0xff) | ((BC >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x49:      /* LD C,C */
-			break;
+		OP(0x49):      /* LD C,C */
+			NEXT;
 
-		case 0x4a:      /* LD C,D */
+		OP(0x4a):      /* LD C,D */
 			BC = (BC & ~0xff) | ((DE >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x4b:      /* LD C,E */
+		OP(0x4b):      /* LD C,E */
 			BC = (BC & ~0xff) | (DE & 0xff);
-			break;
+			NEXT;
 
-		case 0x4c:      /* LD C,H */
+		OP(0x4c):      /* LD C,H */
 			BC = (BC & ~0xff) | ((HL >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x4d:      /* LD C,L */
+		OP(0x4d):      /* LD C,L */
 			BC = (BC & ~0xff) | (HL & 0xff);
-			break;
+			NEXT;
 
-		case 0x4e:      /* LD C,(HL) */
+		OP(0x4e):      /* LD C,(HL) */
 			SET_LOW_REGISTER(BC, GET_BYTE(HL));
-			break;
+			NEXT;
 
-		case 0x4f:      /* LD C,A */
+		OP(0x4f):      /* LD C,A */
 			BC = (BC & ~0xff) | ((AF >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x50:      /* LD D,B */
+		OP(0x50):      /* LD D,B */
 			DE = (DE & 0xff) | (BC & ~0xff);
-			break;
+			NEXT;
 
-		case 0x51:      /* LD D,C */
+		OP(0x51):      /* LD D,C */
 			DE = (DE & 0xff) | ((BC & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x52:      /* LD D,D */
-			break;
+		OP(0x52):      /* LD D,D */
+			NEXT;
 
-		case 0x53:      /* LD D,E */
+		OP(0x53):      /* LD D,E */
 			DE = (DE & 0xff) | ((DE & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x54:      /* LD D,H */
+		OP(0x54):      /* LD D,H */
 			DE = (DE & 0xff) | (HL & ~0xff);
-			break;
+			NEXT;
 
-		case 0x55:      /* LD D,L */
+		OP(0x55):      /* LD D,L */
 			DE = (DE & 0xff) | ((HL & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x56:      /* LD D,(HL) */
+		OP(0x56):      /* LD D,(HL) */
 			SET_HIGH_REGISTER(DE, GET_BYTE(HL));
-			break;
+			NEXT;
 
-		case 0x57:      /* LD D,A */
+		OP(0x57):      /* LD D,A */
 			DE = (DE & 0xff) | (AF & ~0xff);
-			break;
+			NEXT;
 
-		case 0x58:      /* LD E,B */
+		OP(0x58):      /* LD E,B */
 			DE = (DE & ~0xff) | ((BC >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x59:      /* LD E,C */
+		OP(0x59):      /* LD E,C */
 			DE = (DE & ~0xff) | (BC & 0xff);
-			break;
+			NEXT;
 
-		case 0x5a:      /* LD E,D */
+		OP(0x5a):      /* LD E,D */
 			DE = (DE & ~0xff) | ((DE >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x5b:      /* LD E,E */
-			break;
+		OP(0x5b):      /* LD E,E */
+			NEXT;
 
-		case 0x5c:      /* LD E,H */
+		OP(0x5c):      /* LD E,H */
 			DE = (DE & ~0xff) | ((HL >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x5d:      /* LD E,L */
+		OP(0x5d):      /* LD E,L */
 			DE = (DE & ~0xff) | (HL & 0xff);
-			break;
+			NEXT;
 
-		case 0x5e:      /* LD E,(HL) */
+		OP(0x5e):      /* LD E,(HL) */
 			SET_LOW_REGISTER(DE, GET_BYTE(HL));
-			break;
+			NEXT;
 
-		case 0x5f:      /* LD E,A */
+		OP(0x5f):      /* LD E,A */
 			DE = (DE & ~0xff) | ((AF >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x60:      /* LD H,B */
+		OP(0x60):      /* LD H,B */
 			HL = (HL & 0xff) | (BC & ~0xff);
-			break;
+			NEXT;
 
-		case 0x61:      /* LD H,C */
+		OP(0x61):      /* LD H,C */
 			HL = (HL & 0xff) | ((BC & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x62:      /* LD H,D */
+		OP(0x62):      /* LD H,D */
 			HL = (HL & 0xff) | (DE & ~0xff);
-			break;
+			NEXT;
 
-		case 0x63:      /* LD H,E */
+		OP(0x63):      /* LD H,E */
 			HL = (HL & 0xff) | ((DE & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x64:      /* LD H,H */
-			break;
+		OP(0x64):      /* LD H,H */
+			NEXT;
 
-		case 0x65:      /* LD H,L */
+		OP(0x65):      /* LD H,L */
 			HL = (HL & 0xff) | ((HL & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x66:      /* LD H,(HL) */
+		OP(0x66):      /* LD H,(HL) */
 			SET_HIGH_REGISTER(HL, GET_BYTE(HL));
-			break;
+			NEXT;
 
-		case 0x67:      /* LD H,A */
+		OP(0x67):      /* LD H,A */
 			HL = (HL & 0xff) | (AF & ~0xff);
-			break;
+			NEXT;
 
-		case 0x68:      /* LD L,B */
+		OP(0x68):      /* LD L,B */
 			HL = (HL & ~0xff) | ((BC >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x69:      /* LD L,C */
+		OP(0x69):      /* LD L,C */
 			HL = (HL & ~0xff) | (BC & 0xff);
-			break;
+			NEXT;
 
-		case 0x6a:      /* LD L,D */
+		OP(0x6a):      /* LD L,D */
 			HL = (HL & ~0xff) | ((DE >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x6b:      /* LD L,E */
+		OP(0x6b):      /* LD L,E */
 			HL = (HL & ~0xff) | (DE & 0xff);
-			break;
+			NEXT;
 
-		case 0x6c:      /* LD L,H */
+		OP(0x6c):      /* LD L,H */
 			HL = (HL & ~0xff) | ((HL >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x6d:      /* LD L,L */
-			break;
+		OP(0x6d):      /* LD L,L */
+			NEXT;
 
-		case 0x6e:      /* LD L,(HL) */
+		OP(0x6e):      /* LD L,(HL) */
 			SET_LOW_REGISTER(HL, GET_BYTE(HL));
-			break;
+			NEXT;
 
-		case 0x6f:      /* LD L,A */
+		OP(0x6f):      /* LD L,A */
 			HL = (HL & ~0xff) | ((AF >> 8) & 0xff);
-			break;
+			NEXT;
 
-		case 0x70:      /* LD (HL),B */
+		OP(0x70):      /* LD (HL),B */
 			PUT_BYTE(HL, HIGH_REGISTER(BC));
-			break;
+			NEXT;
 
-		case 0x71:      /* LD (HL),C */
+		OP(0x71):      /* LD (HL),C */
 			PUT_BYTE(HL, LOW_REGISTER(BC));
-			break;
+			NEXT;
 
-		case 0x72:      /* LD (HL),D */
+		OP(0x72):      /* LD (HL),D */
 			PUT_BYTE(HL, HIGH_REGISTER(DE));
-			break;
+			NEXT;
 
-		case 0x73:      /* LD (HL),E */
+		OP(0x73):      /* LD (HL),E */
 			PUT_BYTE(HL, LOW_REGISTER(DE));
-			break;
+			NEXT;
 
-		case 0x74:      /* LD (HL),H */
+		OP(0x74):      /* LD (HL),H */
 			PUT_BYTE(HL, HIGH_REGISTER(HL));
-			break;
+			NEXT;
 
-		case 0x75:      /* LD (HL),L */
+		OP(0x75):      /* LD (HL),L */
 			PUT_BYTE(HL, LOW_REGISTER(HL));
-			break;
+			NEXT;
 
-		case 0x76:      /* HALT */
+		OP(0x76):      /* HALT */
 #ifdef DEBUG
 			_puts("\r\n::CPU HALTED::");	// A halt is a good indicator of broken code
 			_puts("Press any key...");
@@ -2081,383 +2382,383 @@ static inline void Z80run(void) {
 #endif
 			--PC;
 			goto end_decode;
-			break;
+			NEXT;
 
-		case 0x77:      /* LD (HL),A */
+		OP(0x77):      /* LD (HL),A */
 			PUT_BYTE(HL, HIGH_REGISTER(AF));
-			break;
+			NEXT;
 
-		case 0x78:      /* LD A,B */
+		OP(0x78):      /* LD A,B */
 			AF = (AF & 0xff) | (BC & ~0xff);
-			break;
+			NEXT;
 
-		case 0x79:      /* LD A,C */
+		OP(0x79):      /* LD A,C */
 			AF = (AF & 0xff) | ((BC & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x7a:      /* LD A,D */
+		OP(0x7a):      /* LD A,D */
 			AF = (AF & 0xff) | (DE & ~0xff);
-			break;
+			NEXT;
 
-		case 0x7b:      /* LD A,E */
+		OP(0x7b):      /* LD A,E */
 			AF = (AF & 0xff) | ((DE & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x7c:      /* LD A,H */
+		OP(0x7c):      /* LD A,H */
 			AF = (AF & 0xff) | (HL & ~0xff);
-			break;
+			NEXT;
 
-		case 0x7d:      /* LD A,L */
+		OP(0x7d):      /* LD A,L */
 			AF = (AF & 0xff) | ((HL & 0xff) << 8);
-			break;
+			NEXT;
 
-		case 0x7e:      /* LD A,(HL) */
+		OP(0x7e):      /* LD A,(HL) */
 			SET_HIGH_REGISTER(AF, GET_BYTE(HL));
-			break;
+			NEXT;
 
-		case 0x7f:      /* LD A,A */
-			break;
+		OP(0x7f):      /* LD A,A */
+			NEXT;
 
-		case 0x80:      /* ADD A,B */
+		OP(0x80):      /* ADD A,B */
 			temp = HIGH_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x81:      /* ADD A,C */
+		OP(0x81):      /* ADD A,C */
 			temp = LOW_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x82:      /* ADD A,D */
+		OP(0x82):      /* ADD A,D */
 			temp = HIGH_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x83:      /* ADD A,E */
+		OP(0x83):      /* ADD A,E */
 			temp = LOW_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x84:      /* ADD A,H */
+		OP(0x84):      /* ADD A,H */
 			temp = HIGH_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x85:      /* ADD A,L */
+		OP(0x85):      /* ADD A,L */
 			temp = LOW_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x86:      /* ADD A,(HL) */
+		OP(0x86):      /* ADD A,(HL) */
 			temp = GET_BYTE(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x87:      /* ADD A,A */
+		OP(0x87):      /* ADD A,A */
 			cbits = 2 * HIGH_REGISTER(AF);
 			AF = cbitsDup8Table[cbits] | (SET_PVS(cbits));
-			break;
+			NEXT;
 
-		case 0x88:      /* ADC A,B */
+		OP(0x88):      /* ADC A,B */
 			temp = HIGH_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x89:      /* ADC A,C */
+		OP(0x89):      /* ADC A,C */
 			temp = LOW_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x8a:      /* ADC A,D */
+		OP(0x8a):      /* ADC A,D */
 			temp = HIGH_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x8b:      /* ADC A,E */
+		OP(0x8b):      /* ADC A,E */
 			temp = LOW_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x8c:      /* ADC A,H */
+		OP(0x8c):      /* ADC A,H */
 			temp = HIGH_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x8d:      /* ADC A,L */
+		OP(0x8d):      /* ADC A,L */
 			temp = LOW_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x8e:      /* ADC A,(HL) */
+		OP(0x8e):      /* ADC A,(HL) */
 			temp = GET_BYTE(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x8f:      /* ADC A,A */
+		OP(0x8f):      /* ADC A,A */
 			cbits = 2 * HIGH_REGISTER(AF) + TSTFLAG(C);
 			AF = cbitsDup8Table[cbits] | (SET_PVS(cbits));
-			break;
+			NEXT;
 
-		case 0x90:      /* SUB B */
+		OP(0x90):      /* SUB B */
 			temp = HIGH_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x91:      /* SUB C */
+		OP(0x91):      /* SUB C */
 			temp = LOW_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x92:      /* SUB D */
+		OP(0x92):      /* SUB D */
 			temp = HIGH_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x93:      /* SUB E */
+		OP(0x93):      /* SUB E */
 			temp = LOW_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x94:      /* SUB H */
+		OP(0x94):      /* SUB H */
 			temp = HIGH_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x95:      /* SUB L */
+		OP(0x95):      /* SUB L */
 			temp = LOW_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x96:      /* SUB (HL) */
+		OP(0x96):      /* SUB (HL) */
 			temp = GET_BYTE(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x97:      /* SUB A */
+		OP(0x97):      /* SUB A */
 			AF = 0x42;
-			break;
+			NEXT;
 
-		case 0x98:      /* SBC A,B */
+		OP(0x98):      /* SBC A,B */
 			temp = HIGH_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x99:      /* SBC A,C */
+		OP(0x99):      /* SBC A,C */
 			temp = LOW_REGISTER(BC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x9a:      /* SBC A,D */
+		OP(0x9a):      /* SBC A,D */
 			temp = HIGH_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x9b:      /* SBC A,E */
+		OP(0x9b):      /* SBC A,E */
 			temp = LOW_REGISTER(DE);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x9c:      /* SBC A,H */
+		OP(0x9c):      /* SBC A,H */
 			temp = HIGH_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x9d:      /* SBC A,L */
+		OP(0x9d):      /* SBC A,L */
 			temp = LOW_REGISTER(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x9e:      /* SBC A,(HL) */
+		OP(0x9e):      /* SBC A,(HL) */
 			temp = GET_BYTE(HL);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0x9f:      /* SBC A,A */
+		OP(0x9f):      /* SBC A,A */
 			cbits = -TSTFLAG(C);
 			AF = subTable[cbits & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PVS(cbits));
-			break;
+			NEXT;
 
-		case 0xa0:      /* AND B */
+		OP(0xa0):      /* AND B */
 			AF = andTable[((AF & BC) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa1:      /* AND C */
+		OP(0xa1):      /* AND C */
 			AF = andTable[((AF >> 8)& BC) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa2:      /* AND D */
+		OP(0xa2):      /* AND D */
 			AF = andTable[((AF & DE) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa3:      /* AND E */
+		OP(0xa3):      /* AND E */
 			AF = andTable[((AF >> 8)& DE) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa4:      /* AND H */
+		OP(0xa4):      /* AND H */
 			AF = andTable[((AF & HL) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa5:      /* AND L */
+		OP(0xa5):      /* AND L */
 			AF = andTable[((AF >> 8)& HL) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa6:      /* AND (HL) */
+		OP(0xa6):      /* AND (HL) */
 			AF = andTable[((AF >> 8)& GET_BYTE(HL)) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa7:      /* AND A */
+		OP(0xa7):      /* AND A */
 			AF = andTable[(AF >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa8:      /* XOR B */
+		OP(0xa8):      /* XOR B */
 			AF = xororTable[((AF ^ BC) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xa9:      /* XOR C */
+		OP(0xa9):      /* XOR C */
 			AF = xororTable[((AF >> 8) ^ BC) & 0xff];
-			break;
+			NEXT;
 
-		case 0xaa:      /* XOR D */
+		OP(0xaa):      /* XOR D */
 			AF = xororTable[((AF ^ DE) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xab:      /* XOR E */
+		OP(0xab):      /* XOR E */
 			AF = xororTable[((AF >> 8) ^ DE) & 0xff];
-			break;
+			NEXT;
 
-		case 0xac:      /* XOR H */
+		OP(0xac):      /* XOR H */
 			AF = xororTable[((AF ^ HL) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xad:      /* XOR L */
+		OP(0xad):      /* XOR L */
 			AF = xororTable[((AF >> 8) ^ HL) & 0xff];
-			break;
+			NEXT;
 
-		case 0xae:      /* XOR (HL) */
+		OP(0xae):      /* XOR (HL) */
 			AF = xororTable[((AF >> 8) ^ GET_BYTE(HL)) & 0xff];
-			break;
+			NEXT;
 
-		case 0xaf:      /* XOR A */
+		OP(0xaf):      /* XOR A */
 			AF = 0x44;
-			break;
+			NEXT;
 
-		case 0xb0:      /* OR B */
+		OP(0xb0):      /* OR B */
 			AF = xororTable[((AF | BC) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb1:      /* OR C */
+		OP(0xb1):      /* OR C */
 			AF = xororTable[((AF >> 8) | BC) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb2:      /* OR D */
+		OP(0xb2):      /* OR D */
 			AF = xororTable[((AF | DE) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb3:      /* OR E */
+		OP(0xb3):      /* OR E */
 			AF = xororTable[((AF >> 8) | DE) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb4:      /* OR H */
+		OP(0xb4):      /* OR H */
 			AF = xororTable[((AF | HL) >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb5:      /* OR L */
+		OP(0xb5):      /* OR L */
 			AF = xororTable[((AF >> 8) | HL) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb6:      /* OR (HL) */
+		OP(0xb6):      /* OR (HL) */
 			AF = xororTable[((AF >> 8) | GET_BYTE(HL)) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb7:      /* OR A */
+		OP(0xb7):      /* OR A */
 			AF = xororTable[(AF >> 8) & 0xff];
-			break;
+			NEXT;
 
-		case 0xb8:      /* CP B */
+		OP(0xb8):      /* CP B */
 			temp = HIGH_REGISTER(BC);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -2465,9 +2766,9 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xb9:      /* CP C */
+		OP(0xb9):      /* CP C */
 			temp = LOW_REGISTER(BC);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -2475,9 +2776,9 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xba:      /* CP D */
+		OP(0xba):      /* CP D */
 			temp = HIGH_REGISTER(DE);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -2485,9 +2786,9 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xbb:      /* CP E */
+		OP(0xbb):      /* CP E */
 			temp = LOW_REGISTER(DE);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -2495,9 +2796,9 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xbc:      /* CP H */
+		OP(0xbc):      /* CP H */
 			temp = HIGH_REGISTER(HL);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -2505,9 +2806,9 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xbd:      /* CP L */
+		OP(0xbd):      /* CP L */
 			temp = LOW_REGISTER(HL);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -2515,9 +2816,9 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xbe:      /* CP (HL) */
+		OP(0xbe):      /* CP (HL) */
 			temp = GET_BYTE(HL);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -2525,64 +2826,64 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xbf:      /* CP A */
+		OP(0xbf):      /* CP A */
 			SET_LOW_REGISTER(AF, (HIGH_REGISTER(AF) & 0x28) | 0x42);
-			break;
+			NEXT;
 
-		case 0xc0:      /* RET NZ */
+		OP(0xc0):      /* RET NZ */
 			if (!(TSTFLAG(Z)))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xc1:      /* POP BC */
+		OP(0xc1):      /* POP BC */
 			POP(BC);
-			break;
+			NEXT;
 
-		case 0xc2:      /* JP NZ,nnnn */
+		OP(0xc2):      /* JP NZ,nnnn */
 			JPC(!TSTFLAG(Z));
-			break;
+			NEXT;
 
-		case 0xc3:      /* JP nnnn */
+		OP(0xc3):      /* JP nnnn */
 			JPC(1);
-			break;
+			NEXT;
 
-		case 0xc4:      /* CALL NZ,nnnn */
+		OP(0xc4):      /* CALL NZ,nnnn */
 			CALLC(!TSTFLAG(Z));
-			break;
+			NEXT;
 
-		case 0xc5:      /* PUSH BC */
+		OP(0xc5):      /* PUSH BC */
 			PUSH(BC);
-			break;
+			NEXT;
 
-		case 0xc6:      /* ADD A,nn */
+		OP(0xc6):      /* ADD A,nn */
 			temp = RAM_PP(PC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp;
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0xc7:      /* RST 0 */
+		OP(0xc7):      /* RST 0 */
 			PUSH(PC);
 			PC = 0;
-			break;
+			NEXT;
 
-		case 0xc8:      /* RET Z */
+		OP(0xc8):      /* RET Z */
 			if (TSTFLAG(Z))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xc9:      /* RET */
+		OP(0xc9):      /* RET */
 			POP(PC);
-			break;
+			NEXT;
 
-		case 0xca:      /* JP Z,nnnn */
+		OP(0xca):      /* JP Z,nnnn */
 			JPC(TSTFLAG(Z));
-			break;
+			NEXT;
 
-		case 0xcb:      /* CB prefix */
+		OP(0xcb):      /* CB prefix */
 			INCR(1); /* Add one M1 cycle to refresh counter */
 			adr = HL;
 			switch ((op = GET_BYTE(PC)) & 7) {
@@ -2727,73 +3028,73 @@ static inline void Z80run(void) {
 				SET_HIGH_REGISTER(AF, temp);
 				break;
 			}
-			break;
+			NEXT;
 
-		case 0xcc:      /* CALL Z,nnnn */
+		OP(0xcc):      /* CALL Z,nnnn */
 			CALLC(TSTFLAG(Z));
-			break;
+			NEXT;
 
-		case 0xcd:      /* CALL nnnn */
+		OP(0xcd):      /* CALL nnnn */
 			CALLC(1);
-			break;
+			NEXT;
 
-		case 0xce:      /* ADC A,nn */
+		OP(0xce):      /* ADC A,nn */
 			temp = RAM_PP(PC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu + temp + TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = addTable[sum] | cbitsTable[cbits] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0xcf:      /* RST 8 */
+		OP(0xcf):      /* RST 8 */
 			PUSH(PC);
 			PC = 8;
-			break;
+			NEXT;
 
-		case 0xd0:      /* RET NC */
+		OP(0xd0):      /* RET NC */
 			if (!(TSTFLAG(C)))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xd1:      /* POP DE */
+		OP(0xd1):      /* POP DE */
 			POP(DE);
-			break;
+			NEXT;
 
-		case 0xd2:      /* JP NC,nnnn */
+		OP(0xd2):      /* JP NC,nnnn */
 			JPC(!TSTFLAG(C));
-			break;
+			NEXT;
 
-		case 0xd3:      /* OUT (nn),A */
+		OP(0xd3):      /* OUT (nn),A */
 			cpu_out(RAM_PP(PC), HIGH_REGISTER(AF));
-			break;
+			NEXT_IO;
 
-		case 0xd4:      /* CALL NC,nnnn */
+		OP(0xd4):      /* CALL NC,nnnn */
 			CALLC(!TSTFLAG(C));
-			break;
+			NEXT;
 
-		case 0xd5:      /* PUSH DE */
+		OP(0xd5):      /* PUSH DE */
 			PUSH(DE);
-			break;
+			NEXT;
 
-		case 0xd6:      /* SUB nn */
+		OP(0xd6):      /* SUB nn */
 			temp = RAM_PP(PC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp;
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0xd7:      /* RST 10H */
+		OP(0xd7):      /* RST 10H */
 			PUSH(PC);
 			PC = 0x10;
-			break;
+			NEXT;
 
-		case 0xd8:      /* RET C */
+		OP(0xd8):      /* RET C */
 			if (TSTFLAG(C))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xd9:      /* EXX */
+		OP(0xd9):      /* EXX */
 			temp = BC;
 			BC = BC1;
 			BC1 = temp;
@@ -2803,21 +3104,21 @@ static inline void Z80run(void) {
 			temp = HL;
 			HL = HL1;
 			HL1 = temp;
-			break;
+			NEXT;
 
-		case 0xda:      /* JP C,nnnn */
+		OP(0xda):      /* JP C,nnnn */
 			JPC(TSTFLAG(C));
-			break;
+			NEXT;
 
-		case 0xdb:      /* IN A,(nn) */
+		OP(0xdb):      /* IN A,(nn) */
 			SET_HIGH_REGISTER(AF, cpu_in(RAM_PP(PC)));
-			break;
+			NEXT_IO;
 
-		case 0xdc:      /* CALL C,nnnn */
+		OP(0xdc):      /* CALL C,nnnn */
 			CALLC(TSTFLAG(C));
-			break;
+			NEXT;
 
-		case 0xdd:      /* DD prefix */
+		OP(0xdd):      /* DD prefix */
 			INCR(1); /* Add one M1 cycle to refresh counter */
 			switch (RAM_PP(PC)) {
 
@@ -3410,81 +3711,81 @@ static inline void Z80run(void) {
 			default:                /* ignore DD */
 				--PC;
 			}
-			break;
+			NEXT;
 
-		case 0xde:          /* SBC A,nn */
+		OP(0xde):          /* SBC A,nn */
 			temp = RAM_PP(PC);
 			acu = HIGH_REGISTER(AF);
 			sum = acu - temp - TSTFLAG(C);
 			cbits = acu ^ temp ^ sum;
 			AF = subTable[sum & 0xff] | cbitsTable[cbits & 0x1ff] | (SET_PV);
-			break;
+			NEXT;
 
-		case 0xdf:      /* RST 18H */
+		OP(0xdf):      /* RST 18H */
 			PUSH(PC);
 			PC = 0x18;
-			break;
+			NEXT;
 
-		case 0xe0:      /* RET PO */
+		OP(0xe0):      /* RET PO */
 			if (!(TSTFLAG(P)))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xe1:      /* POP HL */
+		OP(0xe1):      /* POP HL */
 			POP(HL);
-			break;
+			NEXT;
 
-		case 0xe2:      /* JP PO,nnnn */
+		OP(0xe2):      /* JP PO,nnnn */
 			JPC(!TSTFLAG(P));
-			break;
+			NEXT;
 
-		case 0xe3:      /* EX (SP),HL */
+		OP(0xe3):      /* EX (SP),HL */
 			temp = HL;
 			POP(HL);
 			PUSH(temp);
-			break;
+			NEXT;
 
-		case 0xe4:      /* CALL PO,nnnn */
+		OP(0xe4):      /* CALL PO,nnnn */
 			CALLC(!TSTFLAG(P));
-			break;
+			NEXT;
 
-		case 0xe5:      /* PUSH HL */
+		OP(0xe5):      /* PUSH HL */
 			PUSH(HL);
-			break;
+			NEXT;
 
-		case 0xe6:      /* AND nn */
+		OP(0xe6):      /* AND nn */
 			AF = andTable[((AF >> 8)& RAM_PP(PC)) & 0xff];
-			break;
+			NEXT;
 
-		case 0xe7:      /* RST 20H */
+		OP(0xe7):      /* RST 20H */
 			PUSH(PC);
 			PC = 0x20;
-			break;
+			NEXT;
 
-		case 0xe8:      /* RET PE */
+		OP(0xe8):      /* RET PE */
 			if (TSTFLAG(P))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xe9:      /* JP (HL) */
+		OP(0xe9):      /* JP (HL) */
 			PC = HL;
-			break;
+			NEXT;
 
-		case 0xea:      /* JP PE,nnnn */
+		OP(0xea):      /* JP PE,nnnn */
 			JPC(TSTFLAG(P));
-			break;
+			NEXT;
 
-		case 0xeb:      /* EX DE,HL */
+		OP(0xeb):      /* EX DE,HL */
 			temp = HL;
 			HL = DE;
 			DE = temp;
-			break;
+			NEXT;
 
-		case 0xec:      /* CALL PE,nnnn */
+		OP(0xec):      /* CALL PE,nnnn */
 			CALLC(TSTFLAG(P));
-			break;
+			NEXT;
 
-		case 0xed:      /* ED prefix */
+		OP(0xed):      /* ED prefix */
 			INCR(1); /* Add one M1 cycle to refresh counter */
 			switch (RAM_PP(PC)) {
 
@@ -4000,73 +4301,73 @@ static inline void Z80run(void) {
 			default:    /* ignore ED and following byte */
 				break;
 			}
-			break;
+			NEXT_IO;
 
-		case 0xee:      /* XOR nn */
+		OP(0xee):      /* XOR nn */
 			AF = xororTable[((AF >> 8) ^ RAM_PP(PC)) & 0xff];
-			break;
+			NEXT;
 
-		case 0xef:      /* RST 28H */
+		OP(0xef):      /* RST 28H */
 			PUSH(PC);
 			PC = 0x28;
-			break;
+			NEXT;
 
-		case 0xf0:      /* RET P */
+		OP(0xf0):      /* RET P */
 			if (!(TSTFLAG(S)))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xf1:      /* POP AF */
+		OP(0xf1):      /* POP AF */
 			POP(AF);
-			break;
+			NEXT;
 
-		case 0xf2:      /* JP P,nnnn */
+		OP(0xf2):      /* JP P,nnnn */
 			JPC(!TSTFLAG(S));
-			break;
+			NEXT;
 
-		case 0xf3:      /* DI */
+		OP(0xf3):      /* DI */
 			IFF = 0;
-			break;
+			NEXT;
 
-		case 0xf4:      /* CALL P,nnnn */
+		OP(0xf4):      /* CALL P,nnnn */
 			CALLC(!TSTFLAG(S));
-			break;
+			NEXT;
 
-		case 0xf5:      /* PUSH AF */
+		OP(0xf5):      /* PUSH AF */
 			PUSH(AF);
-			break;
+			NEXT;
 
-		case 0xf6:      /* OR nn */
+		OP(0xf6):      /* OR nn */
 			AF = xororTable[((AF >> 8) | RAM_PP(PC)) & 0xff];
-			break;
+			NEXT;
 
-		case 0xf7:      /* RST 30H */
+		OP(0xf7):      /* RST 30H */
 			PUSH(PC);
 			PC = 0x30;
-			break;
+			NEXT;
 
-		case 0xf8:      /* RET M */
+		OP(0xf8):      /* RET M */
 			if (TSTFLAG(S))
 				POP(PC);
-			break;
+			NEXT;
 
-		case 0xf9:      /* LD SP,HL */
+		OP(0xf9):      /* LD SP,HL */
 			SP = HL;
-			break;
+			NEXT;
 
-		case 0xfa:      /* JP M,nnnn */
+		OP(0xfa):      /* JP M,nnnn */
 			JPC(TSTFLAG(S));
-			break;
+			NEXT;
 
-		case 0xfb:      /* EI */
+		OP(0xfb):      /* EI */
 			IFF = 3;
-			break;
+			NEXT;
 
-		case 0xfc:      /* CALL M,nnnn */
+		OP(0xfc):      /* CALL M,nnnn */
 			CALLC(TSTFLAG(S));
-			break;
+			NEXT;
 
-		case 0xfd:      /* FD prefix */
+		OP(0xfd):      /* FD prefix */
 			INCR(1); /* Add one M1 cycle to refresh counter */
 			switch (RAM_PP(PC)) {
 
@@ -4659,9 +4960,9 @@ static inline void Z80run(void) {
 			default:            /* ignore FD */
 				--PC;
 			}
-			break;
+			NEXT;
 
-		case 0xfe:      /* CP nn */
+		OP(0xfe):      /* CP nn */
 			temp = RAM_PP(PC);
 			AF = (AF & ~0x28) | (temp & 0x28);
 			acu = HIGH_REGISTER(AF);
@@ -4669,16 +4970,22 @@ static inline void Z80run(void) {
 			cbits = acu ^ temp ^ sum;
 			AF = (AF & ~0xff) | cpTable[sum & 0xff] | (temp & 0x28) |
 				(SET_PV) | cbits2Table[cbits & 0x1ff];
-			break;
+			NEXT;
 
-		case 0xff:      /* RST 38H */
+		OP(0xff):      /* RST 38H */
 			PUSH(PC);
 			PC = 0x38;
+			NEXT;
 		}
 	}
 end_decode:
 	;
 }
 
+#undef OP
+#undef NEXT
+#undef NEXT_IO
+#undef OPS
+
 
 #endif
@@ -310,9 +310,13 @@ uint8 _CloseFile(uint16 fcbaddr) {
 	uint8 result = 0xff;
 
 	if (!_SelectDisk(F->dr)) {
+		_FCBtoHostname(fcbaddr, &filename[0]);
+#ifdef FILECACHE
+		if (!_fc_close(&filename[0]))			// writes out the records held back
+			return(result);
+#endif
 		if (!(F->s2 & 0x80)) {					// if file is modified
 			if (!RW) {
-				_FCBtoHostname(fcbaddr, &filename[0]);
 				if (fcbaddr == BatchFCB)
 					_Truncate((char*)filename, F->rc);	// Truncate $$$.SUB to F->rc CP/M records so SUBMIT.COM can work
 				result = 0x00;
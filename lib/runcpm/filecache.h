@@ -0,0 +1,235 @@
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+/* Open file cache for the disk abstractions */
+/*===============================================================================*/
+// CP/M reads and writes a 128 byte record per BDOS call. Opening the host file for
+// each one costs a path lookup on the host filesystem every time, so the files used
+// last are kept open, each with a buffer of the records around the last one used.
+// Reads are served from the buffer, and writes are held in it until another part
+// of the file is needed, the file is closed or its handle is taken for another file.
+//
+// The abstraction supplies _fc_fopen() and has to close a file here before it
+// deletes, renames, truncates or recreates it on the host.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILECACHE
+
+#ifndef FC_HANDLES
+#define FC_HANDLES	4		// host files kept open
+#endif
+#ifndef FC_BUFSZ
+#define FC_BUFSZ	4096	// bytes buffered per file, a multiple of BlkSZ
+#endif
+#define FC_NAMESZ	17		// same as filename[]
+
+FILE* _fc_fopen(uint8* filename, const char* mode);
+
+typedef struct {
+	FILE* file;
+	uint8 name[FC_NAMESZ];
+	uint8 writable;
+	uint32 used;		// when it was last used, for the LRU
+	long pos;			// file position of buf[0]
+	uint16 len;			// bytes of buf in use
+	uint16 dlo, dhi;	// part of buf not written to the file yet
+	uint8* buf;
+} FC_HANDLE;
+
+static FC_HANDLE fc_handle[FC_HANDLES];
+static uint32 fc_clock = 0;
+
+static uint8 _fc_flushhandle(FC_HANDLE* h) {
+	uint8 result = TRUE;
+	uint16 count = h->dhi - h->dlo;
+
+	if (count) {
+		if (fseek(h->file, h->pos + h->dlo, SEEK_SET) || fwrite(&h->buf[h->dlo], 1, count, h->file) != count)
+			result = FALSE;
+		fflush(h->file);	// so the size seen by anyone opening it is right
+		h->dlo = h->dhi = 0;
+	}
+	return(result);
+}
+
+static uint8 _fc_closehandle(FC_HANDLE* h) {
+	uint8 result = TRUE;
+
+	if (h->file) {
+		result = _fc_flushhandle(h);
+		fclose(h->file);
+		h->file = NULL;
+	}
+	h->name[0] = 0;
+	h->pos = 0;
+	h->len = 0;
+	return(result);
+}
+
+static FC_HANDLE* _fc_find(uint8* filename) {
+	uint8 i;
+
+	for (i = 0; i < FC_HANDLES; ++i) {
+		if (fc_handle[i].file && !strncmp((char*)fc_handle[i].name, (char*)filename, FC_NAMESZ))
+			return(&fc_handle[i]);
+	}
+	return(NULL);
+}
+
+// Returns the open handle for filename, opening it in a free or the least recently used one
+static FC_HANDLE* _fc_get(uint8* filename, uint8 write) {
+	FC_HANDLE* h = _fc_find(filename);
+	FC_HANDLE* f;
+	uint8 i;
+
+	if (h && write && !h->writable)
+		_fc_closehandle(h);		// opened before the file was writable, open it again
+	else if (h) {
+		h->used = ++fc_clock;
+		return(h);
+	}
+
+	if (!h) {
+		h = &fc_handle[0];
+		for (i = 1; i < FC_HANDLES; ++i) {
+			f = &fc_handle[i];
+			if (h->file && (!f->file || f->used < h->used))
+				h = f;
+		}
+		_fc_closehandle(h);
+	}
+
+	if (!h->buf) {
+		h->buf = (uint8*)malloc(FC_BUFSZ);
+		if (!h->buf)
+			return(NULL);
+	}
+
+	h->writable = TRUE;
+	h->file = _fc_fopen(filename, "r+");
+	if (!h->file && write) {
+		h->file = _fc_fopen(filename, "a");		// create it
+		if (h->file) {
+			fclose(h->file);
+			h->file = _fc_fopen(filename, "r+");
+		}
+	} else if (!h->file) {
+		h->writable = FALSE;
+		h->file = _fc_fopen(filename, "r");
+	}
+	if (!h->file)
+		return(NULL);
+
+	// All reads and writes are whole buffers or records, stdio's buffer would only be copied through
+	setvbuf(h->file, NULL, _IONBF, 0);
+
+	strncpy((char*)h->name, (char*)filename, FC_NAMESZ - 1);
+	h->name[FC_NAMESZ - 1] = 0;
+	h->used = ++fc_clock;
+	h->pos = 0;
+	h->len = 0;
+	h->dlo = h->dhi = 0;
+	return(h);
+}
+
+// Reads the record at fpos into buffer, padded with ^Z past the end of the file
+// Returns the bytes read from the file, 0 at the end of it, -1 if it can't be opened
+int _fc_read(uint8* filename, long fpos, uint8* buffer) {
+	FC_HANDLE* h = _fc_get(filename, FALSE);
+	long count;
+
+	if (!h)
+		return(-1);
+
+	if (fpos < h->pos || fpos + BlkSZ > h->pos + h->len) {
+		if (!_fc_flushhandle(h))
+			return(0);
+		h->pos = fpos - (fpos % FC_BUFSZ);
+		h->len = 0;
+		if (fseek(h->file, h->pos, SEEK_SET))
+			return(0);
+		h->len = (uint16)fread(h->buf, 1, FC_BUFSZ, h->file);
+	}
+
+	count = h->pos + h->len - fpos;
+	if (count <= 0)
+		return(0);
+	if (count > BlkSZ)
+		count = BlkSZ;
+
+	memcpy(buffer, &h->buf[fpos - h->pos], count);
+	memset(&buffer[count], 0x1a, BlkSZ - count);
+	return((int)count);
+}
+
+// Writes the record at fpos from buffer
+// Returns TRUE when it was taken, FALSE if it couldn't be written, -1 if the file can't be opened
+int _fc_write(uint8* filename, long fpos, uint8* buffer) {
+	FC_HANDLE* h = _fc_get(filename, TRUE);
+	uint16 offset;
+
+	if (!h)
+		return(-1);
+
+	// Anywhere but in or right after the part buffered starts it again there
+	if (fpos < h->pos || fpos > h->pos + h->len || fpos + BlkSZ > h->pos + FC_BUFSZ) {
+		if (!_fc_flushhandle(h))
+			return(FALSE);
+		h->pos = fpos;
+		h->len = 0;
+	}
+
+	offset = (uint16)(fpos - h->pos);
+	memcpy(&h->buf[offset], buffer, BlkSZ);
+	if (h->dlo == h->dhi) {
+		h->dlo = offset;
+		h->dhi = offset + BlkSZ;
+	} else {
+		if (offset < h->dlo)
+			h->dlo = offset;
+		if (offset + BlkSZ > h->dhi)
+			h->dhi = offset + BlkSZ;
+	}
+	if (offset + BlkSZ > h->len)
+		h->len = offset + BlkSZ;
+	return(TRUE);
+}
+
+// Size of the file with anything buffered written out, -1 if it can't be opened
+long _fc_size(uint8* filename) {
+	FC_HANDLE* h = _fc_get(filename, FALSE);
+
+	if (!h || !_fc_flushhandle(h) || fseek(h->file, 0, SEEK_END))
+		return(-1);
+	return(ftell(h->file));
+}
+
+// Writes out what is buffered for filename, if it is open
+uint8 _fc_flush(uint8* filename) {
+	FC_HANDLE* h = _fc_find(filename);
+
+	return(h ? _fc_flushhandle(h) : TRUE);
+}
+
+// Writes out what is buffered for filename and closes it, if it is open
+uint8 _fc_close(uint8* filename) {
+	FC_HANDLE* h = _fc_find(filename);
+
+	return(h ? _fc_closehandle(h) : TRUE);
+}
+
+// Closes every file and lets go of the buffers, when programs end or CP/M stops
+void _fc_closeall(void) {
+	uint8 i;
+
+	for (i = 0; i < FC_HANDLES; ++i) {
+		_fc_closehandle(&fc_handle[i]);
+		free(fc_handle[i].buf);
+		fc_handle[i].buf = NULL;
+	}
+}
+
+#endif
@@ -9,6 +9,9 @@
 /* Definition for enabling incrementing the R register for each M1 cycle */
 #define DO_INCR
 
+/* Definition for the threaded Z80 core, see cpu.h (GCC only, DEBUG and iDEBUG builds use the switch core) */
+#define Z80_THREADED
+
 /* Definitions for enabling PUN: and LST: devices */
 //#define USE_PUN	// The pun.txt and lst.txt files will appear on drive A: user 0
 //#define USE_LST
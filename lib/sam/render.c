@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "sam.h"
 #include "render.h"
 #include "RenderTabs.h"
 
@@ -58,13 +59,73 @@ int timetable[5][5] =
         {200, 0, 0, 54, 55},
         {199, 0, 0, 54, 54}};
 
-static unsigned oldtimetableindex = 0;
+// Streaming output. Samples are only ever written at or after bufferpos / 50,
+// so everything before it is final and can be handed to the sink in chunks of
+// SAM_CHUNK. The window holds the samples from the last chunk handed on up to
+// the few written in advance, so memory doesn't grow with the length of the text.
+#define SAM_WINDOW (SAM_CHUNK * 2)
+
+typedef struct
+{
+    SamSink sink;
+    void *user;
+    int flushed;                // samples handed to the sink so far
+    unsigned oldtimetableindex; // index of the last output, kept across utterances
+    unsigned char window[SAM_WINDOW];
+} SamOutput;
+
+static SamOutput output;
+
+void SetOutputSink(SamSink sink, void *user)
+{
+    output.sink = sink;
+    output.user = user;
+}
+
+int HasOutputSink() { return output.sink != NULL; }
+
+void ResetOutput()
+{
+    output.flushed = 0;
+    memset(output.window, 0x80, SAM_WINDOW);
+}
+
+static void EmitOutput(int count)
+{
+    unsigned char *chunk = output.window + (output.flushed & (SAM_WINDOW - 1));
+
+    output.sink(output.user, chunk, count);
+    memset(chunk, 0x80, count);
+    output.flushed += count;
+}
+
+void FlushOutput()
+{
+    if (!output.sink)
+        return;
+
+    int end = bufferpos / 50;
+    while (end - output.flushed >= SAM_CHUNK)
+        EmitOutput(SAM_CHUNK);
+    if (end > output.flushed)
+        EmitOutput(end - output.flushed);
+}
+
 void Output8BitAry(int index, unsigned char ary[5])
 {
     // printf("Output8BitAry\r\n");
     int k;
-    bufferpos += timetable[oldtimetableindex][index];
-    oldtimetableindex = index;
+    bufferpos += timetable[output.oldtimetableindex][index];
+    output.oldtimetableindex = index;
+    if (output.sink)
+    {
+        int pos = bufferpos / 50;
+        while (pos - output.flushed >= SAM_CHUNK)
+            EmitOutput(SAM_CHUNK);
+        for (k = 0; k < 5; k++)
+            output.window[(pos + k) & (SAM_WINDOW - 1)] = ary[k];
+        return;
+    }
     // write a little bit in advance
     for (k = 0; k < 5; k++)
     {
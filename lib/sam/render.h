@@ -4,4 +4,8 @@
 void Render();
 void SetMouthThroat(unsigned char mouth, unsigned char throat);
 
+int HasOutputSink();
+void ResetOutput();
+void FlushOutput();
+
 #endif
@@ -1,7 +1,9 @@
 
 #include "sam.h"
 
+#ifdef ESP_PLATFORM
 #include <esp_heap_caps.h>
+#endif
 
 #include <stdio.h>
 #include <string.h>
@@ -65,7 +67,11 @@ void SetThroat(unsigned char _throat) { throat = _throat; }
 void EnableSingmode() { singmode = 1; }
 char *GetBuffer() { return buffer; }
 int GetBufferLength() { return bufferpos; }
-void FreeBuffer() { free(buffer); }
+void FreeBuffer()
+{
+    free(buffer);
+    buffer = NULL;
+}
 
 void Init();
 int Parser1();
@@ -97,10 +103,23 @@ void Init()
     SetMouthThroat(mouth, throat);
 
     bufferpos = 0;
-    // TODO, check for free the memory, 10 seconds of output should be more than enough
-    //buffer = (char*)ps_malloc(22050 * 5);
-    // switch to ESP-IDF equivalent
-    buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (HasOutputSink())
+    {
+        // Streamed, no buffer for the whole utterance
+        ResetOutput();
+    }
+    else
+    {
+        // TODO, check for free the memory, 10 seconds of output should be more than enough
+        //buffer = (char*)ps_malloc(22050 * 5);
+        // switch to ESP-IDF equivalent
+#ifdef ESP_PLATFORM
+        buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+        buffer = (char *)malloc(22050 * 10);
+#endif
+        memset(buffer, 0x80, 22050 * 10);
+    }
     /*
     Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
     The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
@@ -183,6 +202,7 @@ int SAMMain()
     }
 
     PrepareOutput();
+    FlushOutput();
 
     return 1;
 }
@@ -16,6 +16,13 @@ extern "C"
 
     int SAMMain();
 
+    // Samples are 8 bit unsigned at 22050Hz. With a sink set, SAMMain hands them
+    // on in chunks of SAM_CHUNK as they are rendered instead of collecting the
+    // whole utterance in the buffer; the last chunk of an utterance may be shorter.
+    #define SAM_CHUNK 256
+    typedef void (*SamSink)(void *user, const unsigned char *samples, int count);
+    void SetOutputSink(SamSink sink, void *user);
+
     char *GetBuffer();
     int GetBufferLength();
     void FreeBuffer();
@@ -1,8 +1,10 @@
 
 #include "samlib.h"
 
+#ifdef ESP_PLATFORM
 #include <freertos/FreeRTOS.h>
-#include <freertos/timers.h>
+#include <freertos/stream_buffer.h>
+#include <freertos/task.h>
 #include <driver/gpio.h>
 #ifndef CONFIG_IDF_TARGET_ESP32S3
 #include <driver/dac.h>
@@ -10,6 +12,7 @@
 
 
 #include "fnSystem.h"
+#endif
 
 #ifdef __cplusplus
 extern char input[256];
@@ -20,14 +23,15 @@ int debug = 0;
 
 #ifndef ESP_PLATFORM
 
-void WriteWav(char *filename, char *buffer, int bufferlength)
+// The sizes in the header are filled in by CloseWav once the length is known
+FILE *OpenWav(char *filename)
 {
     FILE *file = fopen(filename, "wb");
     if (file == NULL)
-        return;
+        return NULL;
     //RIFF header
     fwrite("RIFF", 4, 1, file);
-    unsigned int filesize = bufferlength + 12 + 16 + 8 - 8;
+    unsigned int filesize = 0;
     fwrite(&filesize, 4, 1, file);
     fwrite("WAVE", 4, 1, file);
 
@@ -49,9 +53,25 @@ void WriteWav(char *filename, char *buffer, int bufferlength)
 
     //data chunk
     fwrite("data", 4, 1, file);
-    fwrite(&bufferlength, 4, 1, file);
-    fwrite(buffer, bufferlength, 1, file);
+    unsigned int datalength = 0;
+    fwrite(&datalength, 4, 1, file);
+
+    return file;
+}
+
+void WriteWavChunk(void *file, const unsigned char *samples, int count)
+{
+    fwrite(samples, count, 1, (FILE *)file);
+}
 
+void CloseWav(FILE *file)
+{
+    unsigned int datalength = ftell(file) - 44;
+    unsigned int filesize = datalength + 44 - 8;
+    fseek(file, 4, SEEK_SET);
+    fwrite(&filesize, 4, 1, file);
+    fseek(file, 40, SEEK_SET);
+    fwrite(&datalength, 4, 1, file);
     fclose(file);
 }
 #endif // NOT ESP_PLATFORM
@@ -157,34 +177,78 @@ void OutputSound()
 
 void OutputSound()
 {
+}
+
+#endif
+
 #ifdef ESP_PLATFORM
 #ifndef CONFIG_IDF_TARGET_ESP32S3
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
 
-    //fnSystem.dac_output_enable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    //fnSystem.dac_output_voltage(SystemManager::dac_channel_t::DAC_CHANNEL_1, 100);
+// Rendered samples queue here for the output task, so speech starts with the
+// first chunk instead of after the whole utterance. SAMMain blocks when it
+// gets this far ahead of the DAC.
+#define SAM_RING (SAM_CHUNK * 8)
+#define SAM_TASK_PRIORITY 15
 
-    dac_output_enable(DAC_CHANNEL_1);
+static StreamBufferHandle_t sam_ring = NULL;
 
-    for (int i = 0; i < n; i++)
+static void sam_output_task(void *arg)
+{
+    unsigned char chunk[SAM_CHUNK];
+    bool enabled = false;
+
+    while (true)
     {
-        //dacWrite(DAC1, s[i]);
-        // fnSystem.dac_write(PIN_DAC1, s[i]);
-        dac_output_voltage(DAC_CHANNEL_1, s[i]);
-        //delayMicroseconds(40);
-        fnSystem.delay_microseconds(40);
+        // Let the DAC go once nothing more has arrived for a while
+        size_t n = xStreamBufferReceive(sam_ring, chunk, sizeof(chunk), enabled ? pdMS_TO_TICKS(100) : portMAX_DELAY);
+        if (n == 0)
+        {
+            dac_output_disable(DAC_CHANNEL_1);
+            enabled = false;
+            continue;
+        }
+
+        if (!enabled)
+        {
+            dac_output_enable(DAC_CHANNEL_1);
+            enabled = true;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            dac_output_voltage(DAC_CHANNEL_1, chunk[i]);
+            fnSystem.delay_microseconds(40);
+        }
     }
+}
 
-    //fnSystem.dac_output_disable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    dac_output_disable(DAC_CHANNEL_1);
+static void sam_output_sink(void *user, const unsigned char *samples, int count)
+{
+    xStreamBufferSend(sam_ring, samples, count, portMAX_DELAY);
+}
 
-    FreeBuffer();
-#endif
-#endif
+static void StartOutput()
+{
+    if (sam_ring != NULL)
+        return;
+
+    sam_ring = xStreamBufferCreate(SAM_RING, 1);
+    xTaskCreatePinnedToCore(sam_output_task, "sam_output", 4096, NULL, SAM_TASK_PRIORITY, NULL, 0);
+}
+
+#else
+
+// No DAC to play on
+static void sam_output_sink(void *user, const unsigned char *samples, int count)
+{
+}
+
+static void StartOutput()
+{
 }
 
 #endif
+#endif // ESP_PLATFORM
 
 int sam(int argc, char **argv)
 {
@@ -308,19 +372,41 @@ int sam(int argc, char **argv)
 
     // printf("right before SAMMain");
 
-    if (!SAMMain())
+#ifdef ESP_PLATFORM
+    StartOutput();
+    SetOutputSink(sam_output_sink, NULL);
+#else
+    FILE *wavfile = NULL;
+    if (wavfilename != NULL)
     {
-        PrintUsage();
-        return 1;
+        wavfile = OpenWav(wavfilename);
+        if (wavfile == NULL)
+            return 1;
+        SetOutputSink(WriteWavChunk, wavfile);
     }
+    else
+        SetOutputSink(NULL, NULL);
+#endif // ESP_PLATFORM
+
+    int ok = SAMMain();
     // printf("right after SAMMain");
 
 #ifndef ESP_PLATFORM
-    if (wavfilename != NULL)
-        WriteWav(wavfilename, GetBuffer(), GetBufferLength() / 50);
+    if (wavfile != NULL)
+        CloseWav(wavfile);
     else
+    {
+        if (ok)
+            OutputSound();
+        FreeBuffer();
+    }
 #endif // ESP_PLATFORM
-        OutputSound();
+
+    if (!ok)
+    {
+        PrintUsage();
+        return 1;
+    }
 
     return 0;
 }
@@ -21,7 +21,9 @@ extern char input[256];
 #endif
 
 #ifndef ESP_PLATFORM
-void WriteWav(char *filename, char *buffer, int bufferlength);
+FILE *OpenWav(char *filename);
+void WriteWavChunk(void *file, const unsigned char *samples, int count);
+void CloseWav(FILE *file);
 #endif // ESP_PLATFORM
 
 void PrintUsage();
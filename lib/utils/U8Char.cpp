@@ -1,6 +1,9 @@
 #include "U8Char.h"
 #include "punycode.h"
 
+#include <algorithm>
+#include <vector>
+
 // from https://style64.org/petscii/
 
 // PETSCII table in UTF8,  non-mappable characters mapped to Private Use Area E000-F8FF
@@ -37,6 +40,66 @@ const char16_t U8Char::utf8map[] = {
 // std::unordered_map<char16_t, uint8_t> U8Char::ch_to_petascii_map;
 // std::once_flag U8Char::ch_to_petascii_init_flag;
 
+struct U8Char::Tables {
+    // PETSCII to UTF8, utf8_length is 0 for PETSCII 0 which is dropped
+    uint8_t utf8_length[256];
+    char utf8[256][3];
+
+    // Code points below 0x80 to PETSCII, all of them are in utf8map
+    uint8_t ascii[128];
+    // The rest sorted by code point. Where utf8map has a character twice
+    // (A-Z, the graphics block) the lower PETSCII code wins.
+    std::vector<std::pair<char16_t, uint8_t>> wide;
+
+    Tables() {
+        for (int p = 255; p >= 0; p--) {
+            char16_t ch = utf8map[p];
+
+            if (p == 0)
+                utf8_length[p] = 0;
+            else if (ch < 0x80) {
+                utf8[p][0] = ch;
+                utf8_length[p] = 1;
+            }
+            else if (ch < 0x800) {
+                utf8[p][0] = 0b11000000 | (ch >> 6);
+                utf8[p][1] = 0b10000000 | (ch & 0b111111);
+                utf8_length[p] = 2;
+            }
+            else {
+                utf8[p][0] = 0b11100000 | (ch >> 12);
+                utf8[p][1] = 0b10000000 | ((ch >> 6) & 0b111111);
+                utf8[p][2] = 0b10000000 | (ch & 0b111111);
+                utf8_length[p] = 3;
+            }
+
+            // Going down so the lower code is the one left in ascii[]
+            if (ch < 0x80)
+                ascii[ch] = p;
+            else
+                wide.push_back({ ch, (uint8_t)p });
+        }
+
+        std::sort(wide.begin(), wide.end());
+        wide.erase(std::unique(wide.begin(), wide.end(), [](auto &a, auto &b) { return a.first == b.first; }), wide.end());
+    }
+
+    uint8_t petscii(uint32_t ch) const {
+        if (ch < 0x80)
+            return ascii[ch];
+
+        auto found = std::lower_bound(wide.begin(), wide.end(), ch, [](auto &e, uint32_t ch) { return e.first < ch; });
+        if (found == wide.end() || found->first != ch)
+            return '?';
+        return found->second;
+    }
+};
+
+const U8Char::Tables &U8Char::tables() {
+    static const Tables t;
+    return t;
+}
+
 void U8Char::fromUtf8Stream(std::istream* reader) {
     uint8_t byte = reader->get();
     if(byte<=0x7f) {
@@ -114,16 +177,7 @@ std::string U8Char::toUtf8() {
 }
 
 uint8_t U8Char::toPetscii() {
-    // we only need to convert standard ascii values 0-255 to petscii, everything else is "missing". This only needs to be done in 2 ranges, no need for map
-    if (ch > 255) return missing;
-
-    uint8_t c = (uint8_t) ch;
-    if ((c > 0x40) && (c < 0x5B))
-        c += 0x20;
-    else if ((c > 0x60) && (c < 0x7B))
-        c -= 0x20;
-    
-    return c;
+    return tables().petscii(ch);
 }
 
 // for punycode we need utf8 converted to uint32_t 
@@ -177,4 +231,85 @@ std::string U8Char::fromPunycode(std::string punycodeString) {
 
     punycode_decode(punycodeString.c_str(), punycodeString.length(), asU32, &dstlen);
     return temp.fromUnicode32(asU32, dstlen);
-}
\ No newline at end of file
+}
+
+std::string U8Char::petsciiToUtf8(std::string_view petscii) {
+    auto &t = tables();
+
+    // Size the output up front, and note whether it's one byte per character
+    size_t length = 0;
+    uint8_t single = 1;
+    for (uint8_t c : petscii) {
+        length += t.utf8_length[c];
+        single &= (t.utf8_length[c] == 1);
+    }
+
+    std::string utf8(length, '\0');
+    char *out = utf8.data();
+
+    if (single) {
+        for (uint8_t c : petscii)
+            *out++ = t.utf8[c][0];
+    }
+    else {
+        for (uint8_t c : petscii) {
+            switch (t.utf8_length[c]) {
+                case 3: out[2] = t.utf8[c][2]; [[fallthrough]];
+                case 2: out[1] = t.utf8[c][1]; [[fallthrough]];
+                case 1: out[0] = t.utf8[c][0];
+            }
+            out += t.utf8_length[c];
+        }
+    }
+
+    return utf8;
+}
+
+std::string U8Char::utf8ToPetscii(std::string_view utf8) {
+    // Never longer than the input
+    std::string petscii(utf8.size(), '\0');
+    petscii.resize(utf8ToPetscii(utf8, petscii.data()));
+    return petscii;
+}
+
+size_t U8Char::utf8ToPetscii(std::string_view utf8, char *petscii) {
+    auto &t = tables();
+
+    // One byte out for every character read, so out never gets ahead of in
+    char *out = petscii;
+
+    const uint8_t *in = (const uint8_t *)utf8.data();
+    const uint8_t *end = in + utf8.size();
+    while (in < end) {
+        // ASCII runs
+        while (in < end && *in < 0x80)
+            *out++ = t.ascii[*in++];
+        if (in == end)
+            break;
+
+        size_t length = ((*in & 0b11100000) == 0b11000000) ? 2 :
+                        ((*in & 0b11110000) == 0b11100000) ? 3 :
+                        ((*in & 0b11111000) == 0b11110000) ? 4 : 0;
+        bool valid = (length != 0) && (size_t)(end - in) >= length;
+        for (size_t i = 1; valid && i < length; i++)
+            valid = (in[i] & 0b11000000) == 0b10000000;
+
+        if (!valid) {
+            // Stray continuation bytes or a cut off sequence, one '?' for the lot
+            *out++ = '?';
+            do
+                in++;
+            while (in < end && (*in & 0b11000000) == 0b10000000);
+            continue;
+        }
+
+        uint32_t ch = *in & (0b01111111 >> length);
+        for (size_t i = 1; i < length; i++)
+            ch = (ch << 6) | (in[i] & 0b111111);
+
+        *out++ = t.petscii(ch);
+        in += length;
+    }
+
+    return out - petscii;
+}
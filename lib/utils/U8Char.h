@@ -5,6 +5,7 @@
 #include <iostream>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 /********************************************************
@@ -18,6 +19,10 @@ class U8Char {
     static const char16_t utf8map[];
     const char missing = '?';
     void fromUtf8Stream(std::istream* reader);
+
+    // Forward and reverse lookup tables built from utf8map on first use
+    struct Tables;
+    static const Tables &tables();
     // static std::once_flag ch_to_petascii_init_flag;
 
 public:
@@ -45,6 +50,14 @@ public:
     static std::string toPunycode(std::string utf8String);
     static std::string fromPunycode(std::string punycodeString);
 
+    // Whole strings at once. PETSCII 0 is dropped, anything PETSCII has no
+    // glyph for (or broken UTF8) comes out as '?'
+    static std::string petsciiToUtf8(std::string_view petscii);
+    static std::string utf8ToPetscii(std::string_view utf8);
+    // Into petscii, which needs room for utf8.size() bytes and may be the
+    // same buffer as utf8. Returns the PETSCII length.
+    static size_t utf8ToPetscii(std::string_view utf8, char *petscii);
+
     // This is a reverse lookup map used to quickly find the petascci code from the ch value, making it O(1) complexity
     // static std::unordered_map<char16_t, uint8_t> ch_to_petascii_map;
 
@@ -239,34 +239,16 @@ namespace mstr {
     //                 [](unsigned char c) { return ascii2petscii(c); });
     // }
 
-    // convert PETSCII to UTF8, using methods from U8Char
+    // convert PETSCII to UTF8, using the U8Char tables
     std::string toUTF8(const std::string &petsciiInput)
     {
-        std::string utf8string;
-        for(char petscii : petsciiInput) {
-            if(petscii > 0)
-            {
-                U8Char u8char(petscii);
-                utf8string+=u8char.toUtf8();
-            }
-        }
-        return utf8string;
+        return U8Char::petsciiToUtf8(petsciiInput);
     }
 
-    // convert UTF8 to PETSCII, using methods from U8Char
+    // convert UTF8 to PETSCII, using the U8Char tables
     std::string toPETSCII2(const std::string &utfInputString)
     {
-        std::string petsciiString;
-        char* utfInput = (char*)utfInputString.c_str();
-        auto end = utfInput + utfInputString.length();
-
-        while(utfInput<end) {
-            U8Char u8char(' ');
-            size_t skip = u8char.fromCharArray(utfInput);
-            petsciiString+=u8char.toPetscii();
-            utfInput+=skip;
-        }
-        return petsciiString;
+        return U8Char::utf8ToPetscii(utfInputString);
     }
 
     // convert bytes to hex
@@ -499,9 +481,11 @@ namespace mstr {
     std::string format(const char *format, ...)
     {
         // Format our string
-        va_list args;
+        va_list args, size_args;
         va_start(args, format);
-        char text[vsnprintf(NULL, 0, format, args) + 1];
+        va_copy(size_args, args);
+        char text[vsnprintf(NULL, 0, format, size_args) + 1];
+        va_end(size_args);
         vsnprintf(text, sizeof text, format, args);
         va_end(args);
 
@@ -0,0 +1,203 @@
+#include "compiled_template.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Last op, the literal runs to the end of the file
+#define TEMPLATE_TAG_NONE -2
+
+/********************************************************
+ * CompiledTemplate
+ ********************************************************/
+
+// Same rules as parse_contents(), a tag runs from "{{" to the first "}}"
+// after it, and a "{{" without one is sent as it is
+bool CompiledTemplate::compile(FILE *file, lookup_t lookup)
+{
+    enum { TEXT, OPEN, TAG, CLOSE } state = TEXT;
+
+    _ops.clear();
+    if (fseek(file, 0, SEEK_SET) != 0)
+        return false;
+
+    uint32_t literal_start = 0;
+    uint32_t tag_start = 0;
+    uint32_t pos = 0;
+    std::string name;
+
+    char buffer[256];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        for (size_t i = 0; i < count; i++, pos++)
+        {
+            char c = buffer[i];
+            switch (state)
+            {
+            case TEXT:
+                if (c == '{')
+                    state = OPEN;
+                break;
+
+            case OPEN:
+                if (c == '{')
+                {
+                    tag_start = pos - 1;
+                    name.clear();
+                    state = TAG;
+                }
+                else
+                    state = TEXT;
+                break;
+
+            case CLOSE:
+                if (c == '}')
+                {
+                    uint32_t raw = pos - 1 - (tag_start + 2);
+                    int tag = (raw <= TEMPLATE_TAG_MAX) ? lookup(name) : TEMPLATE_TAG_UNKNOWN;
+                    _ops.push_back({ tag_start - literal_start, raw, (int16_t)tag });
+
+                    literal_start = pos + 1;
+                    state = TEXT;
+                    break;
+                }
+                if (name.size() <= TEMPLATE_TAG_MAX)
+                    name += '}';
+                state = TAG;
+                // fall through
+
+            case TAG:
+                if (c == '}')
+                    state = CLOSE;
+                else if (name.size() <= TEMPLATE_TAG_MAX)
+                    name += c;
+                break;
+            }
+        }
+    }
+
+    if (ferror(file))
+        return false;
+
+    _ops.push_back({ pos - literal_start, 0, TEMPLATE_TAG_NONE });
+    _ops.shrink_to_fit();
+    return true;
+}
+
+bool CompiledTemplate::render(FILE *file, substitute_t substitute, send_t send, char *buffer, size_t buffer_size) const
+{
+    size_t used = 0;
+
+    auto flush = [&]() {
+        if (used && !send(buffer, used))
+            return false;
+        used = 0;
+        return true;
+    };
+
+    // Substituted text
+    auto put = [&](const char *data, size_t length) {
+        while (length)
+        {
+            if (used == buffer_size && !flush())
+                return false;
+
+            size_t n = std::min(length, buffer_size - used);
+            memcpy(buffer + used, data, n);
+            used += n;
+            data += n;
+            length -= n;
+        }
+        return true;
+    };
+
+    // Bytes of the file, read straight into the send buffer
+    auto copy = [&](size_t length) {
+        while (length)
+        {
+            if (used == buffer_size && !flush())
+                return false;
+
+            size_t n = fread(buffer + used, 1, std::min(length, buffer_size - used), file);
+            if (n == 0)
+                return false;
+            used += n;
+            length -= n;
+        }
+        return true;
+    };
+
+    // Braces and tag names are read past rather than seeked over, a seek
+    // can throw away what stdio has buffered
+    char skipped[TEMPLATE_TAG_MAX + 4];
+    auto skip = [&](size_t length) {
+        return fread(skipped, 1, length, file) == length;
+    };
+
+    if (fseek(file, 0, SEEK_SET) != 0)
+        return false;
+
+    for (auto &op : _ops)
+    {
+        if (!copy(op.literal))
+            return false;
+
+        if (op.tag == TEMPLATE_TAG_NONE)
+            continue;
+
+        if (op.tag == TEMPLATE_TAG_UNKNOWN)
+        {
+            // Name without the braces
+            if (!skip(2) || !copy(op.raw) || !skip(2))
+                return false;
+        }
+        else
+        {
+            if (!skip(op.raw + 4))
+                return false;
+            std::string text = substitute(op.tag);
+            if (!put(text.data(), text.size()))
+                return false;
+        }
+    }
+
+    return flush();
+}
+
+
+/********************************************************
+ * CompiledTemplateCache
+ ********************************************************/
+
+std::shared_ptr<CompiledTemplate> CompiledTemplateCache::get(const std::string &path, FILE *file, time_t mtime, size_t size,
+                                                             CompiledTemplate::lookup_t lookup)
+{
+    for (auto entry = _templates.begin(); entry != _templates.end(); entry++)
+    {
+        if (entry->first != path)
+            continue;
+
+        if (entry->second->mtime == mtime && entry->second->size == size)
+        {
+            _templates.splice(_templates.begin(), _templates, entry);
+            return entry->second;
+        }
+
+        // Changed since
+        _templates.erase(entry);
+        break;
+    }
+
+    auto compiled = std::make_shared<CompiledTemplate>();
+    if (!compiled->compile(file, lookup))
+        return nullptr;
+    compiled->mtime = mtime;
+    compiled->size = size;
+    _compiles++;
+
+    _templates.push_front({ path, compiled });
+    if (_templates.size() > TEMPLATE_CACHE_ENTRIES)
+        _templates.pop_back();
+
+    return compiled;
+}
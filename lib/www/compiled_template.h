@@ -0,0 +1,81 @@
+#ifndef HTTP_COMPILED_TEMPLATE_H
+#define HTTP_COMPILED_TEMPLATE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define TEMPLATE_TAG_UNKNOWN -1
+#define TEMPLATE_TAG_MAX 64         // longer tags can't be one we know
+#define TEMPLATE_CACHE_ENTRIES 8
+
+/********************************************************
+ * CompiledTemplate
+ *
+ * A page with {{TAG}} substitutions, read once into a list
+ * of ops: so many bytes of the file as they are, then a tag.
+ * Only the ops are kept, rendering reads the literal spans
+ * back from the file, so no copy of the page is ever held
+ * in memory.
+ ********************************************************/
+
+class CompiledTemplate {
+public:
+    // Tag name to tag id, TEMPLATE_TAG_UNKNOWN if it isn't one
+    using lookup_t = std::function<int(const std::string &tag)>;
+    // Text for a tag id
+    using substitute_t = std::function<std::string(int tag)>;
+    // Send some of the rendered page, false to give up
+    using send_t = std::function<bool(const char *data, size_t length)>;
+
+    bool compile(FILE *file, lookup_t lookup);
+    bool render(FILE *file, substitute_t substitute, send_t send, char *buffer, size_t buffer_size) const;
+
+    size_t ops() const {
+        return _ops.size();
+    }
+
+    time_t mtime = 0;
+    size_t size = 0;
+
+private:
+    struct Op {
+        uint32_t literal;   // bytes sent as they are
+        uint32_t raw;       // length of the tag name between {{ and }}, 0 for none
+        int16_t tag;        // TEMPLATE_TAG_UNKNOWN sends the name without the braces
+    };
+    std::vector<Op> _ops;
+};
+
+
+/********************************************************
+ * CompiledTemplateCache
+ *
+ * Compiled templates by path, compiled again when the
+ * file's size or modification time changes.
+ ********************************************************/
+
+class CompiledTemplateCache {
+public:
+    std::shared_ptr<CompiledTemplate> get(const std::string &path, FILE *file, time_t mtime, size_t size,
+                                          CompiledTemplate::lookup_t lookup);
+    void clear() {
+        _templates.clear();
+    }
+
+    uint32_t compiles() {
+        return _compiles;
+    }
+
+private:
+    // Most recently used at the front
+    std::list<std::pair<std::string, std::shared_ptr<CompiledTemplate>>> _templates;
+    uint32_t _compiles = 0;
+};
+
+#endif // HTTP_COMPILED_TEMPLATE_H
@@ -0,0 +1,236 @@
+#include "http_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char *http_days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char *http_months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+static std::string trim(const std::string &s)
+{
+    size_t start = s.find_first_not_of(" \t");
+    if (start == std::string::npos)
+        return "";
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(start, end - start + 1);
+}
+
+static bool is_weak(const std::string &etag)
+{
+    return etag.compare(0, 2, "W/") == 0;
+}
+
+static std::string opaque(const std::string &etag)
+{
+    return is_weak(etag) ? etag.substr(2) : etag;
+}
+
+// Days since 1970-01-01, no timegm() in newlib
+static long days_from_civil(int y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long)doe - 719468;
+}
+
+std::string http_etag(size_t size, time_t mtime, bool weak)
+{
+    char etag[40];
+    snprintf(etag, sizeof(etag), "%s\"%lx-%llx\"", weak ? "W/" : "", (unsigned long)size, (unsigned long long)mtime);
+    return etag;
+}
+
+std::string http_date(time_t t)
+{
+    struct tm gmt;
+    gmtime_r(&t, &gmt);
+
+    char date[32];
+    snprintf(date, sizeof(date), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+             http_days[gmt.tm_wday], gmt.tm_mday, http_months[gmt.tm_mon], gmt.tm_year + 1900,
+             gmt.tm_hour, gmt.tm_min, gmt.tm_sec);
+    return date;
+}
+
+time_t http_parse_date(const char *date)
+{
+    char month[4] = { 0 };
+    int day, year, hour, minute, second;
+
+    if (sscanf(date, "%*3s, %d %3s %d %d:%d:%d", &day, month, &year, &hour, &minute, &second) == 6)
+        ;   // Sun, 06 Nov 1994 08:49:37 GMT
+    else if (sscanf(date, "%*[^,], %d-%3s-%d %d:%d:%d", &day, month, &year, &hour, &minute, &second) == 6)
+        year += (year < 70) ? 2000 : (year < 100) ? 1900 : 0;   // Sunday, 06-Nov-94 08:49:37 GMT
+    else if (sscanf(date, "%*3s %3s %d %d:%d:%d %d", month, &day, &hour, &minute, &second, &year) == 6)
+        ;   // Sun Nov  6 08:49:37 1994
+    else
+        return -1;
+
+    int m = 0;
+    while (m < 12 && strcmp(month, http_months[m]))
+        m++;
+    if (m == 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return -1;
+
+    return (time_t)days_from_civil(year, m + 1, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+bool http_etag_matches(const std::string &if_none_match, const std::string &etag)
+{
+    if (trim(if_none_match) == "*")
+        return true;
+
+    std::string tag = opaque(etag);
+
+    size_t pos = 0;
+    while (pos < if_none_match.size())
+    {
+        // Tags are quoted and may hold commas
+        size_t open = if_none_match.find('"', pos);
+        if (open == std::string::npos)
+            break;
+        size_t close = if_none_match.find('"', open + 1);
+        if (close == std::string::npos)
+            break;
+
+        if (if_none_match.compare(open, close - open + 1, tag) == 0)
+            return true;
+
+        pos = close + 1;
+    }
+
+    return false;
+}
+
+bool http_not_modified(const std::string &if_none_match, const std::string &if_modified_since,
+                       const std::string &etag, time_t mtime)
+{
+    if (!if_none_match.empty())
+        return http_etag_matches(if_none_match, etag);
+
+    if (!if_modified_since.empty())
+    {
+        time_t since = http_parse_date(if_modified_since.c_str());
+        return (since != -1 && mtime <= since);
+    }
+
+    return false;
+}
+
+http_range_t http_parse_range(const std::string &range, const std::string &if_range,
+                              size_t size, const std::string &etag, time_t mtime)
+{
+    http_range_t result;
+
+    std::string spec = trim(range);
+    if (spec.compare(0, 6, "bytes=") != 0 || spec.find(',') != std::string::npos)
+        return result;
+    spec = trim(spec.substr(6));
+
+    // The range only stands while the client's copy is the current one,
+    // which needs a strong validator
+    std::string validator = trim(if_range);
+    if (!validator.empty())
+    {
+        if (validator[0] == '"' || is_weak(validator))
+        {
+            if (is_weak(validator) || is_weak(etag) || validator != etag)
+                return result;
+        }
+        else if (http_parse_date(validator.c_str()) != mtime)
+            return result;
+    }
+
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos)
+        return result;
+
+    std::string first = trim(spec.substr(0, dash));
+    std::string last = trim(spec.substr(dash + 1));
+    if (first.find_first_not_of("0123456789") != std::string::npos ||
+        last.find_first_not_of("0123456789") != std::string::npos ||
+        (first.empty() && last.empty()))
+        return result;
+
+    if (first.empty())
+    {
+        // Suffix, the last n bytes
+        unsigned long long n = strtoull(last.c_str(), nullptr, 10);
+        if (n == 0 || size == 0)
+        {
+            result.status = 416;
+            return result;
+        }
+        if (n > size)
+            n = size;
+        result.start = size - n;
+        result.length = n;
+    }
+    else
+    {
+        unsigned long long start = strtoull(first.c_str(), nullptr, 10);
+        unsigned long long end = last.empty() ? size - 1 : strtoull(last.c_str(), nullptr, 10);
+        if (!last.empty() && end < start)
+            return result;
+        if (start >= size)
+        {
+            result.status = 416;
+            return result;
+        }
+        if (end >= size)
+            end = size - 1;
+        result.start = start;
+        result.length = end - start + 1;
+    }
+
+    result.status = 206;
+    return result;
+}
+
+std::string http_content_range(const http_range_t &range, size_t size)
+{
+    char content_range[64];
+    if (range.status == 206)
+        snprintf(content_range, sizeof(content_range), "bytes %lu-%lu/%lu",
+                 (unsigned long)range.start, (unsigned long)(range.start + range.length - 1), (unsigned long)size);
+    else
+        snprintf(content_range, sizeof(content_range), "bytes */%lu", (unsigned long)size);
+    return content_range;
+}
+
+bool http_accepts_gzip(const std::string &accept_encoding)
+{
+    size_t pos = 0;
+    while (pos <= accept_encoding.size())
+    {
+        size_t comma = accept_encoding.find(',', pos);
+        if (comma == std::string::npos)
+            comma = accept_encoding.size();
+
+        std::string coding = accept_encoding.substr(pos, comma - pos);
+        std::string q;
+        size_t semicolon = coding.find(';');
+        if (semicolon != std::string::npos)
+        {
+            q = trim(coding.substr(semicolon + 1));
+            coding = coding.substr(0, semicolon);
+        }
+        coding = trim(coding);
+
+        if (coding == "gzip" || coding == "x-gzip" || coding == "*")
+        {
+            // "gzip;q=0" turns it off
+            if (q.compare(0, 2, "q=") == 0 && strtod(q.c_str() + 2, nullptr) == 0)
+                return false;
+            return true;
+        }
+
+        pos = comma + 1;
+    }
+
+    return false;
+}
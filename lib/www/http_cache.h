@@ -0,0 +1,47 @@
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+
+// Validators and byte ranges for GET/HEAD of plain files, shared by the
+// static file server and WebDAV. Nothing here touches the server itself,
+// the handlers pass in the request headers and stat() results.
+
+// Entity tag from size and modification time. Strong unless the
+// content can differ with the same size and time (parsed templates).
+std::string http_etag(size_t size, time_t mtime, bool weak = false);
+
+// IMF-fixdate, "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string http_date(time_t t);
+// IMF-fixdate, RFC 850 or asctime() date, -1 if it isn't one
+time_t http_parse_date(const char *date);
+
+// Does an If-None-Match list ("*" or tags) match, weak comparison
+bool http_etag_matches(const std::string &if_none_match, const std::string &etag);
+
+// True when the client's copy is still good and 304 is the answer.
+// If-None-Match wins over If-Modified-Since when both are sent.
+bool http_not_modified(const std::string &if_none_match, const std::string &if_modified_since,
+                       const std::string &etag, time_t mtime);
+
+// Byte range of a response, from the Range and If-Range headers
+struct http_range_t {
+    int status = 200;           // 200 whole file, 206 partial, 416 not satisfiable
+    size_t start = 0;
+    size_t length = 0;
+};
+
+// Only a single range is served, anything else (several ranges, other
+// units, a stale If-Range) gets the whole file, as RFC 9110 allows
+http_range_t http_parse_range(const std::string &range, const std::string &if_range,
+                              size_t size, const std::string &etag, time_t mtime);
+
+// "bytes 0-499/1234", or "bytes */1234" for a 416
+std::string http_content_range(const http_range_t &range, size_t size);
+
+// Does Accept-Encoding allow gzip
+bool http_accepts_gzip(const std::string &accept_encoding);
+
+#endif // HTTP_CACHE_H
@@ -27,6 +27,7 @@
 #include "fnFsSD.h"
 
 #include "template.h"
+#include "http_cache.h"
 
 #define MIN(a, b) \
     ({ __typeof__ (a) _a = (a); \
@@ -228,7 +229,7 @@ esp_err_t cHttpdServer::webdav_handler(httpd_req_t *httpd_req)
         break;
     case HTTP_GET:
         ret = server->doGet(req, resp);
-        if ( ret == 200 )
+        if ( ret == 200 || ret == 206 )
             return ESP_OK;
         break;
     case HTTP_HEAD:
@@ -480,8 +481,22 @@ void cHttpdServer::set_file_content_type(httpd_req_t *req, const char *filepath)
     }
 }
 
+// Request header value, empty if it wasn't sent
+static std::string get_header(httpd_req_t *req, const char *name)
+{
+    size_t len = httpd_req_get_hdr_value_len(req, name);
+    if (len == 0)
+        return "";
+
+    std::string value(len, '\0');
+    httpd_req_get_hdr_value_str(req, name, &value[0], len + 1);
+    return value;
+}
+
 // Send content of given file out to client
-void cHttpdServer::send_file(httpd_req_t *req, const char *filename)
+// Static assets are served from a precompressed "file.gz" when there is one and the
+// client takes gzip, and answer conditional and Range requests when cacheable is set
+void cHttpdServer::send_file(httpd_req_t *req, const char *filename, bool cacheable)
 {
     // Build the full file path
     std::string fpath = http_FILE_ROOT;
@@ -494,39 +509,127 @@ void cHttpdServer::send_file(httpd_req_t *req, const char *filename)
     if (is_parsable(get_extension(filename)))
         return send_file_parsed(req, fpath.c_str());
 
+    // Precompressed variant
+    std::string spath = fpath;
+    bool gzipped = false;
+    struct stat sb;
+    if (http_accepts_gzip(get_header(req, "Accept-Encoding")) && stat((fpath + ".gz").c_str(), &sb) == 0)
+    {
+        spath += ".gz";
+        gzipped = true;
+    }
+    else if (stat(fpath.c_str(), &sb) != 0)
+    {
+        Debug_printv("Failed to open file for sending: [%s]", fpath.c_str());
+        send_http_error(req, 404);
+        return;
+    }
+
     // Retrieve server state
     serverstate *pState = (serverstate *)httpd_get_global_user_ctx(req->handle);
-    FILE *file = pState->_FS->file_open(fpath.c_str());
+    FILE *file = pState->_FS->file_open(spath.c_str());
 
-    Debug_printv("filename[%s]", filename);
+    Debug_printv("filename[%s] gzip[%d]", filename, gzipped);
     if (file == nullptr)
     {
-        Debug_printv("Failed to open file for sending: [%s]", fpath.c_str());
+        Debug_printv("Failed to open file for sending: [%s]", spath.c_str());
         send_http_error(req, 404);
+        return;
     }
-    else
+
+    // Set the response content type, from the name without the ".gz"
+    set_file_content_type(req, fpath.c_str());
+
+    // httpd keeps pointers to these until the response is sent
+    std::string etag = http_etag(sb.st_size, sb.st_mtime);
+    std::string last_modified = http_date(sb.st_mtime);
+    std::string content_range;
+    http_range_t range;
+    range.length = sb.st_size;
+
+    if (cacheable)
     {
-        // Set the response content type
-        set_file_content_type(req, fpath.c_str());
-        // Set the expected length of the content
-        char hdrval[10];
-        snprintf(hdrval, 10, "%ld", FileSystem::filesize(file));
-        httpd_resp_set_hdr(req, "Content-Length", hdrval);
+        httpd_resp_set_hdr(req, "ETag", etag.c_str());
+        httpd_resp_set_hdr(req, "Last-Modified", last_modified.c_str());
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+        httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+        if (gzipped)
+            httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+
+        // Client already has it
+        if (http_not_modified(get_header(req, "If-None-Match"), get_header(req, "If-Modified-Since"), etag, sb.st_mtime))
+        {
+            fclose(file);
+            httpd_resp_set_status(req, "304 Not Modified");
+            httpd_resp_send(req, NULL, 0);
+            return;
+        }
 
-        // Send the file content out in chunks
-        char *buf = (char *)malloc(http_SEND_BUFF_SIZE);
-        size_t count = 0;
-        do
+        range = http_parse_range(get_header(req, "Range"), get_header(req, "If-Range"), sb.st_size, etag, sb.st_mtime);
+        if (range.status != 200)
+            content_range = http_content_range(range, sb.st_size);
+
+        if (range.status == 416)
+        {
+            fclose(file);
+            httpd_resp_set_status(req, "416 Range Not Satisfiable");
+            httpd_resp_set_hdr(req, "Content-Range", content_range.c_str());
+            httpd_resp_send(req, NULL, 0);
+            return;
+        }
+        else if (range.status == 206)
+        {
+            httpd_resp_set_status(req, "206 Partial Content");
+            httpd_resp_set_hdr(req, "Content-Range", content_range.c_str());
+            fseek(file, range.start, SEEK_SET);
+        }
+        else
         {
-            count = fread(buf, 1, http_SEND_BUFF_SIZE, file);
-            httpd_resp_send_chunk(req, buf, count);
-        } while (count > 0);
+            range.start = 0;
+            range.length = sb.st_size;
+        }
+    }
+    else if (gzipped)
+    {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+
+    char *buf = (char *)malloc(http_SEND_BUFF_SIZE);
+    if (buf == nullptr)
+    {
         fclose(file);
-        free(buf);
+        httpd_resp_send_500(req);
+        return;
+    }
+
+    if (range.length <= http_SEND_BUFF_SIZE)
+    {
+        // Small enough for one send with its Content-Length
+        size_t count = fread(buf, 1, range.length, file);
+        httpd_resp_send(req, buf, count);
+    }
+    else
+    {
+        // Send the file content out in chunks
+        size_t remaining = range.length;
+        while (remaining > 0)
+        {
+            size_t count = fread(buf, 1, MIN(remaining, (size_t)http_SEND_BUFF_SIZE), file);
+            if (count == 0 || httpd_resp_send_chunk(req, buf, count) != ESP_OK)
+                break;
+            remaining -= count;
+        }
+        httpd_resp_send_chunk(req, NULL, 0);
     }
+
+    fclose(file);
+    free(buf);
 }
 
 // Send file content after parsing for replaceable strings
+// The file is compiled once into literal spans and tags, then each request
+// reads the spans back and sends them with the substitutions in chunks
 void cHttpdServer::send_file_parsed(httpd_req_t *req, const char *filename)
 {
     // Note that we don't add FNWS_FILE_ROOT as it should've been done in send_file()
@@ -539,36 +642,42 @@ void cHttpdServer::send_file_parsed(httpd_req_t *req, const char *filename)
     serverstate *pState = (serverstate *)httpd_get_global_user_ctx(req->handle);
     FILE *file = pState->_FS->file_open(filename);
 
-    if (file == nullptr)
+    struct stat sb;
+    if (file == nullptr || stat(filename, &sb) != 0)
     {
         Debug_printv("Failed to open file for parsing: [%s]", filename);
         err = 404;
     }
     else
     {
-        // Set the response content type
-        set_file_content_type(req, filename);
+        auto compiled = pState->templates.get(filename, file, sb.st_mtime, sb.st_size, [](const std::string &tag) {
+            return find_tag(tag);
+        });
 
-        // We're going to load the whole thing into memory, so watch out for big files!
-        size_t sz = FileSystem::filesize(file) + 1;
-        char *buf = (char *)calloc(sz, 1);
-        if (buf == NULL)
+        char *buf = (char *)malloc(http_SEND_BUFF_SIZE);
+        if (compiled == nullptr || buf == NULL)
         {
-            Debug_printf("Couldn't allocate %u bytes to load file contents!\r\n", sz);
+            Debug_printf("Couldn't compile or allocate a send buffer for [%s]\r\n", filename);
             err = 500;
         }
         else
         {
-            fread(buf, 1, sz, file);
-            std::string contents(buf);
-            free(buf);
-            contents = parse_contents(contents);
-
-            httpd_resp_send(req, contents.c_str(), contents.length());
+            // Set the response content type
+            set_file_content_type(req, filename);
+
+            compiled->render(file, [](int tag) {
+                return substitute_tag(tag);
+            }, [req](const char *data, size_t length) {
+                return httpd_resp_send_chunk(req, data, length) == ESP_OK;
+            }, buf, http_SEND_BUFF_SIZE);
+            httpd_resp_send_chunk(req, NULL, 0);
         }
-        fclose(file);
+        free(buf);
     }
 
+    if (file != nullptr)
+        fclose(file);
+
     if (err != 200)
         send_http_error(req, err);
 }
@@ -581,7 +690,7 @@ void cHttpdServer::send_http_error(httpd_req_t *req, int errnum)
     error_page << "error/" << errnum << ".html";
 
     if ( exists(error_page.str()) )
-        send_file(req, error_page.str().c_str());
+        send_file(req, error_page.str().c_str(), false);
     else
         httpd_resp_send(req, NULL, 0);
 }
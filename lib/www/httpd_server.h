@@ -4,6 +4,7 @@
 #include "webdav/request.h"
 
 #include "fnFS.h"
+#include "compiled_template.h"
 
 #define http_FILE_ROOT "/.www/"
 #define http_SEND_BUFF_SIZE 512 // Used when sending files in chunks
@@ -21,6 +22,7 @@ private:
     struct serverstate {
         httpd_handle_t hServer;
         FileSystem *_FS = nullptr;
+        CompiledTemplateCache templates;
     } state;
 
     static void custom_global_ctx_free(void * ctx);
@@ -30,7 +32,7 @@ private:
     static char * get_extension(const char *filename);
     static const char *find_mimetype_str(const char *extension);
     static void set_file_content_type(httpd_req_t *req, const char *filepath);
-    static void send_file(httpd_req_t *req, const char *filename);
+    static void send_file(httpd_req_t *req, const char *filename, bool cacheable = true);
     static void send_file_parsed(httpd_req_t *req, const char *filename);
     static void send_http_error(httpd_req_t *req, int errnum);
 
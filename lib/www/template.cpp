@@ -95,194 +95,204 @@ std::string format_uptime()
 }
 
 
-const std::string substitute_tag(const std::string &tag)
+enum tagids
 {
-    enum tagids
-    {
-        DEVICE_HOSTNAME = 0,
-        DEVICE_VERSION,
-        DEVICE_IPADDRESS,
-        DEVICE_IPMASK,
-        DEVICE_IPGATEWAY,
-        DEVICE_IPDNS,
-        DEVICE_WIFISSID,
-        DEVICE_WIFIBSSID,
-        DEVICE_WIFIMAC,
-        DEVICE_WIFIDETAIL,
-        DEVICE_SPIFFS_SIZE,
-        DEVICE_SPIFFS_USED,
-        DEVICE_SD_SIZE,
-        DEVICE_SD_USED,
-        DEVICE_UPTIME_STRING,
-        DEVICE_UPTIME,
-        DEVICE_CURRENTTIME,
-        DEVICE_TIMEZONE,
-        DEVICE_ROTATION_SOUNDS,
-        DEVICE_UDPSTREAM_HOST,
-        DEVICE_HEAPSIZE,
-        DEVICE_SYSSDK,
-        DEVICE_SYSCPUREV,
-        DEVICE_SIOVOLTS,
-        DEVICE_SIO_HSINDEX,
-        DEVICE_SIO_HSBAUD,
-        DEVICE_PRINTER1_MODEL,
-        DEVICE_PRINTER1_PORT,
-        DEVICE_PLAY_RECORD,
-        DEVICE_PULLDOWN,
-        DEVICE_CASSETTE_ENABLED,
-        DEVICE_CONFIG_ENABLED,
-        DEVICE_STATUS_WAIT_ENABLED,
-        DEVICE_BOOT_MODE,
-        DEVICE_PRINTER_ENABLED,
-        DEVICE_MODEM_ENABLED,
-        DEVICE_MODEM_SNIFFER_ENABLED,
-        DEVICE_DRIVE1HOST,
-        DEVICE_DRIVE2HOST,
-        DEVICE_DRIVE3HOST,
-        DEVICE_DRIVE4HOST,
-        DEVICE_DRIVE5HOST,
-        DEVICE_DRIVE6HOST,
-        DEVICE_DRIVE7HOST,
-        DEVICE_DRIVE8HOST,
-        DEVICE_DRIVE1MOUNT,
-        DEVICE_DRIVE2MOUNT,
-        DEVICE_DRIVE3MOUNT,
-        DEVICE_DRIVE4MOUNT,
-        DEVICE_DRIVE5MOUNT,
-        DEVICE_DRIVE6MOUNT,
-        DEVICE_DRIVE7MOUNT,
-        DEVICE_DRIVE8MOUNT,
-        DEVICE_HOST1,
-        DEVICE_HOST2,
-        DEVICE_HOST3,
-        DEVICE_HOST4,
-        DEVICE_HOST5,
-        DEVICE_HOST6,
-        DEVICE_HOST7,
-        DEVICE_HOST8,
-        DEVICE_DRIVE1,
-        DEVICE_DRIVE2,
-        DEVICE_DRIVE3,
-        DEVICE_DRIVE4,
-        DEVICE_DRIVE5,
-        DEVICE_DRIVE6,
-        DEVICE_DRIVE7,
-        DEVICE_DRIVE8,
-        DEVICE_HOST1PREFIX,
-        DEVICE_HOST2PREFIX,
-        DEVICE_HOST3PREFIX,
-        DEVICE_HOST4PREFIX,
-        DEVICE_HOST5PREFIX,
-        DEVICE_HOST6PREFIX,
-        DEVICE_HOST7PREFIX,
-        DEVICE_HOST8PREFIX,
-        DEVICE_ERRMSG,
-        DEVICE_HARDWARE_VER,
-        DEVICE_PRINTER_LIST,
-        DEVICE_UUID,
-        DEVICE_LASTTAG
-    };
+    DEVICE_HOSTNAME = 0,
+    DEVICE_VERSION,
+    DEVICE_IPADDRESS,
+    DEVICE_IPMASK,
+    DEVICE_IPGATEWAY,
+    DEVICE_IPDNS,
+    DEVICE_WIFISSID,
+    DEVICE_WIFIBSSID,
+    DEVICE_WIFIMAC,
+    DEVICE_WIFIDETAIL,
+    DEVICE_SPIFFS_SIZE,
+    DEVICE_SPIFFS_USED,
+    DEVICE_SD_SIZE,
+    DEVICE_SD_USED,
+    DEVICE_UPTIME_STRING,
+    DEVICE_UPTIME,
+    DEVICE_CURRENTTIME,
+    DEVICE_TIMEZONE,
+    DEVICE_ROTATION_SOUNDS,
+    DEVICE_UDPSTREAM_HOST,
+    DEVICE_HEAPSIZE,
+    DEVICE_SYSSDK,
+    DEVICE_SYSCPUREV,
+    DEVICE_SIOVOLTS,
+    DEVICE_SIO_HSINDEX,
+    DEVICE_SIO_HSBAUD,
+    DEVICE_PRINTER1_MODEL,
+    DEVICE_PRINTER1_PORT,
+    DEVICE_PLAY_RECORD,
+    DEVICE_PULLDOWN,
+    DEVICE_CASSETTE_ENABLED,
+    DEVICE_CONFIG_ENABLED,
+    DEVICE_STATUS_WAIT_ENABLED,
+    DEVICE_BOOT_MODE,
+    DEVICE_PRINTER_ENABLED,
+    DEVICE_MODEM_ENABLED,
+    DEVICE_MODEM_SNIFFER_ENABLED,
+    DEVICE_DRIVE1HOST,
+    DEVICE_DRIVE2HOST,
+    DEVICE_DRIVE3HOST,
+    DEVICE_DRIVE4HOST,
+    DEVICE_DRIVE5HOST,
+    DEVICE_DRIVE6HOST,
+    DEVICE_DRIVE7HOST,
+    DEVICE_DRIVE8HOST,
+    DEVICE_DRIVE1MOUNT,
+    DEVICE_DRIVE2MOUNT,
+    DEVICE_DRIVE3MOUNT,
+    DEVICE_DRIVE4MOUNT,
+    DEVICE_DRIVE5MOUNT,
+    DEVICE_DRIVE6MOUNT,
+    DEVICE_DRIVE7MOUNT,
+    DEVICE_DRIVE8MOUNT,
+    DEVICE_HOST1,
+    DEVICE_HOST2,
+    DEVICE_HOST3,
+    DEVICE_HOST4,
+    DEVICE_HOST5,
+    DEVICE_HOST6,
+    DEVICE_HOST7,
+    DEVICE_HOST8,
+    DEVICE_DRIVE1,
+    DEVICE_DRIVE2,
+    DEVICE_DRIVE3,
+    DEVICE_DRIVE4,
+    DEVICE_DRIVE5,
+    DEVICE_DRIVE6,
+    DEVICE_DRIVE7,
+    DEVICE_DRIVE8,
+    DEVICE_HOST1PREFIX,
+    DEVICE_HOST2PREFIX,
+    DEVICE_HOST3PREFIX,
+    DEVICE_HOST4PREFIX,
+    DEVICE_HOST5PREFIX,
+    DEVICE_HOST6PREFIX,
+    DEVICE_HOST7PREFIX,
+    DEVICE_HOST8PREFIX,
+    DEVICE_ERRMSG,
+    DEVICE_HARDWARE_VER,
+    DEVICE_PRINTER_LIST,
+    DEVICE_UUID,
+    DEVICE_LASTTAG
+};
+
+static const char *tagids[DEVICE_LASTTAG] =
+{
+    "DEVICE_HOSTNAME",
+    "DEVICE_VERSION",
+    "DEVICE_IPADDRESS",
+    "DEVICE_IPMASK",
+    "DEVICE_IPGATEWAY",
+    "DEVICE_IPDNS",
+    "DEVICE_WIFISSID",
+    "DEVICE_WIFIBSSID",
+    "DEVICE_WIFIMAC",
+    "DEVICE_WIFIDETAIL",
+    "DEVICE_SPIFFS_SIZE",
+    "DEVICE_SPIFFS_USED",
+    "DEVICE_SD_SIZE",
+    "DEVICE_SD_USED",
+    "DEVICE_UPTIME_STRING",
+    "DEVICE_UPTIME",
+    "DEVICE_CURRENTTIME",
+    "DEVICE_TIMEZONE",
+    "DEVICE_ROTATION_SOUNDS",
+    "DEVICE_UDPSTREAM_HOST",
+    "DEVICE_HEAPSIZE",
+    "DEVICE_SYSSDK",
+    "DEVICE_SYSCPUREV",
+    "DEVICE_SIOVOLTS",
+    "DEVICE_SIO_HSINDEX",
+    "DEVICE_SIO_HSBAUD",
+    "DEVICE_PRINTER1_MODEL",
+    "DEVICE_PRINTER1_PORT",
+    "DEVICE_PLAY_RECORD",
+    "DEVICE_PULLDOWN",
+    "DEVICE_CASSETTE_ENABLED",
+    "DEVICE_CONFIG_ENABLED",
+    "DEVICE_STATUS_WAIT_ENABLED",
+    "DEVICE_BOOT_MODE",
+    "DEVICE_PRINTER_ENABLED",
+    "DEVICE_MODEM_ENABLED",
+    "DEVICE_MODEM_SNIFFER_ENABLED",
+    "DEVICE_DRIVE1HOST",
+    "DEVICE_DRIVE2HOST",
+    "DEVICE_DRIVE3HOST",
+    "DEVICE_DRIVE4HOST",
+    "DEVICE_DRIVE5HOST",
+    "DEVICE_DRIVE6HOST",
+    "DEVICE_DRIVE7HOST",
+    "DEVICE_DRIVE8HOST",
+    "DEVICE_DRIVE1MOUNT",
+    "DEVICE_DRIVE2MOUNT",
+    "DEVICE_DRIVE3MOUNT",
+    "DEVICE_DRIVE4MOUNT",
+    "DEVICE_DRIVE5MOUNT",
+    "DEVICE_DRIVE6MOUNT",
+    "DEVICE_DRIVE7MOUNT",
+    "DEVICE_DRIVE8MOUNT",
+    "DEVICE_HOST1",
+    "DEVICE_HOST2",
+    "DEVICE_HOST3",
+    "DEVICE_HOST4",
+    "DEVICE_HOST5",
+    "DEVICE_HOST6",
+    "DEVICE_HOST7",
+    "DEVICE_HOST8",
+    "DEVICE_DRIVE1",
+    "DEVICE_DRIVE2",
+    "DEVICE_DRIVE3",
+    "DEVICE_DRIVE4",
+    "DEVICE_DRIVE5",
+    "DEVICE_DRIVE6",
+    "DEVICE_DRIVE7",
+    "DEVICE_DRIVE8",
+    "DEVICE_HOST1PREFIX",
+    "DEVICE_HOST2PREFIX",
+    "DEVICE_HOST3PREFIX",
+    "DEVICE_HOST4PREFIX",
+    "DEVICE_HOST5PREFIX",
+    "DEVICE_HOST6PREFIX",
+    "DEVICE_HOST7PREFIX",
+    "DEVICE_HOST8PREFIX",
+    "DEVICE_ERRMSG",
+    "DEVICE_HARDWARE_VER",
+    "DEVICE_PRINTER_LIST",
+    "DEVICE_UUID"
+};
 
-    const char *tagids[DEVICE_LASTTAG] =
+int find_tag(const std::string &tag)
+{
+    for (int tagid = 0; tagid < DEVICE_LASTTAG; tagid++)
     {
-        "DEVICE_HOSTNAME",
-        "DEVICE_VERSION",
-        "DEVICE_IPADDRESS",
-        "DEVICE_IPMASK",
-        "DEVICE_IPGATEWAY",
-        "DEVICE_IPDNS",
-        "DEVICE_WIFISSID",
-        "DEVICE_WIFIBSSID",
-        "DEVICE_WIFIMAC",
-        "DEVICE_WIFIDETAIL",
-        "DEVICE_SPIFFS_SIZE",
-        "DEVICE_SPIFFS_USED",
-        "DEVICE_SD_SIZE",
-        "DEVICE_SD_USED",
-        "DEVICE_UPTIME_STRING",
-        "DEVICE_UPTIME",
-        "DEVICE_CURRENTTIME",
-        "DEVICE_TIMEZONE",
-        "DEVICE_ROTATION_SOUNDS",
-        "DEVICE_UDPSTREAM_HOST",
-        "DEVICE_HEAPSIZE",
-        "DEVICE_SYSSDK",
-        "DEVICE_SYSCPUREV",
-        "DEVICE_SIOVOLTS",
-        "DEVICE_SIO_HSINDEX",
-        "DEVICE_SIO_HSBAUD",
-        "DEVICE_PRINTER1_MODEL",
-        "DEVICE_PRINTER1_PORT",
-        "DEVICE_PLAY_RECORD",
-        "DEVICE_PULLDOWN",
-        "DEVICE_CASSETTE_ENABLED",
-        "DEVICE_CONFIG_ENABLED",
-        "DEVICE_STATUS_WAIT_ENABLED",
-        "DEVICE_BOOT_MODE",
-        "DEVICE_PRINTER_ENABLED",
-        "DEVICE_MODEM_ENABLED",
-        "DEVICE_MODEM_SNIFFER_ENABLED",
-        "DEVICE_DRIVE1HOST",
-        "DEVICE_DRIVE2HOST",
-        "DEVICE_DRIVE3HOST",
-        "DEVICE_DRIVE4HOST",
-        "DEVICE_DRIVE5HOST",
-        "DEVICE_DRIVE6HOST",
-        "DEVICE_DRIVE7HOST",
-        "DEVICE_DRIVE8HOST",
-        "DEVICE_DRIVE1MOUNT",
-        "DEVICE_DRIVE2MOUNT",
-        "DEVICE_DRIVE3MOUNT",
-        "DEVICE_DRIVE4MOUNT",
-        "DEVICE_DRIVE5MOUNT",
-        "DEVICE_DRIVE6MOUNT",
-        "DEVICE_DRIVE7MOUNT",
-        "DEVICE_DRIVE8MOUNT",
-        "DEVICE_HOST1",
-        "DEVICE_HOST2",
-        "DEVICE_HOST3",
-        "DEVICE_HOST4",
-        "DEVICE_HOST5",
-        "DEVICE_HOST6",
-        "DEVICE_HOST7",
-        "DEVICE_HOST8",
-        "DEVICE_DRIVE1",
-        "DEVICE_DRIVE2",
-        "DEVICE_DRIVE3",
-        "DEVICE_DRIVE4",
-        "DEVICE_DRIVE5",
-        "DEVICE_DRIVE6",
-        "DEVICE_DRIVE7",
-        "DEVICE_DRIVE8",
-        "DEVICE_HOST1PREFIX",
-        "DEVICE_HOST2PREFIX",
-        "DEVICE_HOST3PREFIX",
-        "DEVICE_HOST4PREFIX",
-        "DEVICE_HOST5PREFIX",
-        "DEVICE_HOST6PREFIX",
-        "DEVICE_HOST7PREFIX",
-        "DEVICE_HOST8PREFIX",
-        "DEVICE_ERRMSG",
-        "DEVICE_HARDWARE_VER",
-        "DEVICE_PRINTER_LIST",
-        "DEVICE_UUID"
-    };
+        if (0 == tag.compare(tagids[tagid]))
+            return tagid;
+    }
+    return -1;
+}
+
+const std::string substitute_tag(const std::string &tag)
+{
+    int tagid = find_tag(tag);
+    if (tagid < 0)
+        return tag;
 
+    return substitute_tag(tagid);
+}
+
+const std::string substitute_tag(int tagid)
+{
     std::stringstream resultstream;
 
 #ifdef DEBUG
-    // Debug_printf("Substituting tag '%s'\r\n", tag.c_str());
+    // Debug_printf("Substituting tag %d\r\n", tagid);
 #endif
 
-    int tagid;
-    for (tagid = 0; tagid < DEVICE_LASTTAG; tagid++)
-    {
-        if (0 == tag.compare(tagids[tagid]))
-        {
-            break;
-        }
-    }
-
     int drive_slot, host_slot;
     char disk_id;
 
@@ -555,7 +565,6 @@ const std::string substitute_tag(const std::string &tag)
         // }
         break;
     default:
-        resultstream << tag;
         break;
     }
 #ifdef DEBUG
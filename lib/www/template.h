@@ -7,7 +7,10 @@
 std::string format_uptime();
 long uptime_seconds();
 
+// Tag id for a {{TAG}} name, -1 if there is no such tag
+int find_tag(const std::string &tag);
 const std::string substitute_tag(const std::string &tag);
+const std::string substitute_tag(int tagid);
 
 std::string parse_contents(const std::string &contents);
 bool is_parsable(const char *extension);
@@ -23,7 +23,9 @@ void Response::setHeader(std::string header, size_t value) {
 }
 
 void Response::flushHeaders() {
-    for (const auto &h: headers)
-        writeHeader(h.first.c_str(), h.second.c_str());
+    for (const auto &h: headers) {
+        flushed.push_back(h);
+        writeHeader(flushed.back().first.c_str(), flushed.back().second.c_str());
+    }
     headers.clear();
 }
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <list>
 
 #include <esp_http_server.h>
 
@@ -12,7 +13,9 @@
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_201      "201 Created"
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
+#define HTTPD_206      "206 Partial Content"
 #define HTTPD_207      "207 Multi-Status"           /*!< HTTP Response 207 */
+#define HTTPD_304      "304 Not Modified"
 #define HTTPD_400      "400 Bad Request"            /*!< HTTP Response 400 */
 #define HTTPD_403      "403 Forbidden"
 #define HTTPD_404      "404 Not Found"              /*!< HTTP Response 404 */
@@ -21,6 +24,7 @@
 #define HTTPD_409      "409 Conflict"
 #define HTTPD_412      "412 Precondition Failed"
 #define HTTPD_415      "415 Unspported Media Type"
+#define HTTPD_416      "416 Range Not Satisfiable"
 #define HTTPD_500      "500 Internal Server Error"  /*!< HTTP Response 500 */
 #define HTTPD_501      "501 Not Implemented"
 #define HTTPD_507      "507 Insufficient Storage"
@@ -66,9 +70,15 @@ namespace WebDav
                 case 204:
                     status = HTTPD_204;
                     break;
+                case 206:
+                    status = HTTPD_206;
+                    break;
                 case 207:
                     status = HTTPD_207;
                     break;
+                case 304:
+                    status = HTTPD_304;
+                    break;
                 case 400:
                     status = HTTPD_400;
                     break;
@@ -93,6 +103,9 @@ namespace WebDav
                 case 415:
                     status = HTTPD_415;
                     break;
+                case 416:
+                    status = HTTPD_416;
+                    break;
                 case 500:
                     status = HTTPD_500;
                     break;
@@ -157,6 +170,10 @@ private:
         bool chunked = false;
 
         std::map<std::string, std::string> headers;
+
+        // httpd only keeps pointers to header values until the response
+        // goes out, so flushed headers live here until then
+        std::list<std::pair<std::string, std::string>> flushed;
     };
 
 } // namespace
\ No newline at end of file
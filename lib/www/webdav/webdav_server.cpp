@@ -14,6 +14,7 @@
 
 #include "file-utils.h"
 #include "string_utils.h"
+#include "../http_cache.h"
 
 using namespace WebDav;
 
@@ -46,13 +47,8 @@ std::string Server::pathToURI(std::string path)
 
 std::string Server::formatTime(time_t t)
 {
-    char buf[32];
-    struct tm *lt = localtime(&t);
     // <D:getlastmodified>Tue, 22 Aug 2023 02:37:31 GMT</D:getlastmodified>
-    // strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", lt);
-    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S %Z", lt);
-
-    return std::string(buf);
+    return http_date(t);
 }
 
 static void xmlElement(std::ostringstream &s, const char *name, const char *value)
@@ -114,7 +110,7 @@ int Server::sendPropResponse(Response &resp, std::string path, int recurse)
         {
             r.props["esp:getcontentlength"] = std::to_string(sb.st_size);
             r.props["esp:getcontenttype"] = HTTPD_TYPE_OCTET;
-            r.props["esp:getetag"] = std::to_string(sb.st_ino);
+            r.props["esp:getetag"] = http_etag(sb.st_size, sb.st_mtime);
         }
         //Debug_printv("Found!");
     }
@@ -229,42 +225,95 @@ int Server::doGet(Request &req, Response &resp)
     if ((sb.st_mode & S_IFMT) == S_IFDIR)
         return 405;
 
+    std::string etag = http_etag(sb.st_size, sb.st_mtime);
+    resp.setHeader("ETag", etag);
+    resp.setHeader("Last-Modified", formatTime(sb.st_mtime));
+    resp.setHeader("Accept-Ranges", "bytes");
+
+    // Client already has it
+    if (http_not_modified(req.getHeader("If-None-Match"), req.getHeader("If-Modified-Since"), etag, sb.st_mtime))
+        return 304;
+
+    // Random access into large images only reads what was asked for
+    http_range_t range = http_parse_range(req.getHeader("Range"), req.getHeader("If-Range"), sb.st_size, etag, sb.st_mtime);
+    if (range.status == 416)
+    {
+        resp.setHeader("Content-Range", http_content_range(range, sb.st_size));
+        resp.flushHeaders();
+        return 416;
+    }
+    if (range.status == 206)
+    {
+        resp.setHeader("Content-Range", http_content_range(range, sb.st_size));
+    }
+    else
+    {
+        range.start = 0;
+        range.length = sb.st_size;
+    }
+
     // Send File
     FILE *f = fopen(path.c_str(), "r");
     if (!f)
         return 404;
 
-    resp.setHeader("Content-Length", sb.st_size);
-    resp.setHeader("ETag", sb.st_ino);
-    resp.setHeader("Last-Modified", formatTime(sb.st_mtime));
+    if (range.start && fseek(f, range.start, SEEK_SET) != 0)
+    {
+        fclose(f);
+        return 500;
+    }
+
+    const int chunkSize = 8192;
+    char *chunk = (char *)malloc(std::min(range.length, (size_t)chunkSize) + 1);
+    if (!chunk)
+    {
+        fclose(f);
+        return 500;
+    }
+
+    resp.setStatus(range.status);
     resp.setHeader("Connection","close");
+    resp.flushHeaders();
 
     ret = 0;
 
-    const int chunkSize = 8192;
-    char *chunk = (char *)malloc(chunkSize);
-
-    for (;;)
+    if (range.length <= chunkSize)
     {
-        size_t r = fread(chunk, 1, chunkSize, f);
-        if (r <= 0)
-            break;
-
-        if (!resp.sendChunk(chunk, r))
-        {
+        // Fits one send, goes out with a Content-Length
+        size_t r = fread(chunk, 1, range.length, f);
+        if (r != range.length)
             ret = -1;
-            break;
+        else
+            resp.sendBody(chunk, r);
+    }
+    else
+    {
+        size_t remaining = range.length;
+        while (remaining > 0)
+        {
+            size_t r = fread(chunk, 1, std::min(remaining, (size_t)chunkSize), f);
+            if (r <= 0)
+                break;
+
+            if (!resp.sendChunk(chunk, r))
+            {
+                ret = -1;
+                break;
+            }
+
+            remaining -= r;
         }
+
+        resp.closeChunk();
     }
 
     free(chunk);
     fclose(f);
-    resp.closeChunk();
 
     if (ret != 0)
         return 500;
 
-    return 200;
+    return range.status;
 }
 
 int Server::doHead(Request &req, Response &resp)
@@ -278,9 +327,14 @@ int Server::doHead(Request &req, Response &resp)
     if (ret < 0)
         return 404;
 
+    std::string etag = http_etag(sb.st_size, sb.st_mtime);
     resp.setHeader("Content-Length", sb.st_size);
-    resp.setHeader("ETag", sb.st_ino);
+    resp.setHeader("ETag", etag);
     resp.setHeader("Last-Modified", formatTime(sb.st_mtime));
+    resp.setHeader("Accept-Ranges", "bytes");
+
+    if (http_not_modified(req.getHeader("If-None-Match"), req.getHeader("If-Modified-Since"), etag, sb.st_mtime))
+        return 304;
 
     return 200;
 }
@@ -0,0 +1,184 @@
+#include "esp_http_client.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+HttpStandIn http_stand_in;
+
+struct esp_http_client
+{
+    esp_http_client_config_t config;
+    std::string url;
+    std::map<std::string, std::string> headers;
+    bool connected = false;
+
+    // Response being read
+    int status = 0;
+    std::vector<std::pair<std::string, std::string>> response_headers;
+    const std::vector<uint8_t> *body = nullptr;
+    uint32_t position = 0;
+    uint32_t end = 0;
+};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t client = new esp_http_client;
+    client->config = *config;
+    client->url = config->url;
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    client->headers[key] = value;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    HttpStandIn &server = http_stand_in;
+
+    // A connection is only used again once the last response has been read off it
+    bool reused = client->connected && server.keep_alive && client->position == client->end;
+    if (!reused)
+        server.connections++;
+    client->connected = true;
+
+    std::string range;
+    auto header = client->headers.find("range");
+    if (header != client->headers.end())
+        range = header->second;
+
+    server.requests.push_back({ client->config.method, client->url, range, reused });
+    if (server.on_request)
+        server.on_request();
+
+    client->response_headers.clear();
+    client->body = nullptr;
+    client->position = client->end = 0;
+
+    auto resource = server.resources.find(client->url);
+    if (resource == server.resources.end())
+    {
+        client->status = HttpStatus_NotFound;
+        client->response_headers.push_back({ "Content-Length", "0" });
+        return ESP_OK;
+    }
+
+    uint32_t size = resource->second.size();
+    uint32_t start = 0, end = size;
+    client->status = HttpStatus_Ok;
+
+    unsigned long first, last;
+    if (server.ranges && !range.empty())
+    {
+        if (sscanf(range.c_str(), "bytes=%lu-%lu", &first, &last) == 2)
+        {
+            start = first;
+            end = std::min<uint32_t>(last + 1, size);
+        }
+        else if (sscanf(range.c_str(), "bytes=%lu-", &first) == 1)
+        {
+            start = first;
+        }
+
+        if (start >= size)
+        {
+            client->status = 416;
+            start = end = size;
+        }
+        else
+        {
+            client->status = 206;
+        }
+    }
+
+    if (server.ranges)
+        client->response_headers.push_back({ "Accept-Ranges", "bytes" });
+    client->response_headers.push_back({ "Content-Type", "application/octet-stream" });
+    client->response_headers.push_back({ "Content-Length", std::to_string(end - start) });
+
+    if (client->config.method != HTTP_METHOD_HEAD)
+    {
+        client->body = &resource->second;
+        client->position = start;
+        client->end = end;
+    }
+
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    int64_t length = 0;
+    for (auto &header : client->response_headers)
+    {
+        std::string key = header.first, value = header.second;
+        esp_http_client_event_t evt = {};
+        evt.event_id = HTTP_EVENT_ON_HEADER;
+        evt.client = client;
+        evt.user_data = client->config.user_data;
+        evt.header_key = (char *)key.c_str();
+        evt.header_value = (char *)value.c_str();
+        if (client->config.event_handler)
+            client->config.event_handler(&evt);
+
+        if (key == "Content-Length")
+            length = std::stoll(value);
+    }
+    return length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (client->body == nullptr)
+        return 0;
+
+    int n = std::min<int>({ len, http_stand_in.segment, (int)(client->end - client->position) });
+    memcpy(buffer, client->body->data() + client->position, n);
+    client->position += n;
+    http_stand_in.transferred += n;
+    return n;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len)
+{
+    return len;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len)
+{
+    if (len != nullptr)
+        *len = client->end - client->position;
+    client->position = client->end;
+    return ESP_OK;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client)
+{
+    return false;
+}
+
+esp_err_t esp_http_client_get_chunk_length(esp_http_client_handle_t client, int *len)
+{
+    *len = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    client->connected = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    delete client;
+    return ESP_OK;
+}
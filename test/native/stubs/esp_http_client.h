@@ -0,0 +1,128 @@
+// Host stand-in for ESP-IDF's esp_http_client.h
+//
+// Just the part of the API MeatHttpClient uses. Every client talks to
+// http_stand_in, an in-process server holding the resources, which records
+// the requests that reach it. The implementation is in esp_http_client.cpp,
+// include it once in the test that needs it.
+
+#ifndef _ESP_HTTP_CLIENT_H
+#define _ESP_HTTP_CLIENT_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_HEADER_SENT = HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+    HTTP_EVENT_REDIRECT,
+} esp_http_client_event_id_t;
+
+typedef struct esp_http_client_event {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_PATCH,
+    HTTP_METHOD_DELETE,
+    HTTP_METHOD_HEAD,
+} esp_http_client_method_t;
+
+// Only the fields MeatHttpClient sets, in the order it sets them
+typedef struct {
+    const char *url;
+    const char *user_agent;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    int max_redirection_count;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    bool keep_alive_enable;
+    int keep_alive_idle;
+    int keep_alive_interval;
+} esp_http_client_config_t;
+
+typedef enum {
+    HttpStatus_Ok                = 200,
+    HttpStatus_MultipleChoices   = 300,
+    HttpStatus_MovedPermanently  = 301,
+    HttpStatus_Found             = 302,
+    HttpStatus_SeeOther          = 303,
+    HttpStatus_TemporaryRedirect = 307,
+    HttpStatus_PermanentRedirect = 308,
+    HttpStatus_BadRequest        = 400,
+    HttpStatus_Unauthorized      = 401,
+    HttpStatus_Forbidden         = 403,
+    HttpStatus_NotFound          = 404,
+    HttpStatus_InternalError     = 500
+} HttpStatus_Code;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, int len);
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len);
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client);
+esp_err_t esp_http_client_get_chunk_length(esp_http_client_handle_t client, int *len);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+// The server at the other end of every client
+struct HttpStandIn
+{
+    struct Request {
+        esp_http_client_method_t method;
+        std::string url;
+        std::string range;      // the Range header sent, if any
+        bool reused;            // came on a connection kept alive from the last response
+    };
+
+    std::map<std::string, std::vector<uint8_t>> resources;
+    bool ranges = true;         // Accept-Ranges: bytes, and 206 for a Range header
+    bool keep_alive = true;     // a drained response can be followed on the same connection
+    int segment = 1460;         // most bytes one esp_http_client_read() returns
+
+    std::vector<Request> requests;
+    uint32_t connections = 0;
+    uint64_t transferred = 0;   // body bytes read by the clients
+
+    // Called for every request, to charge a round trip
+    std::function<void()> on_request;
+
+    void reset()
+    {
+        *this = HttpStandIn();
+    }
+};
+
+extern HttpStandIn http_stand_in;
+
+#endif // _ESP_HTTP_CLIENT_H
@@ -0,0 +1,14 @@
+// Host stand-in for ESP-IDF's esp_idf_version.h, claims the version the
+// firmware is built with so the same code paths are compiled
+
+#ifndef ESP_IDF_VERSION_H
+#define ESP_IDF_VERSION_H
+
+#define ESP_IDF_VERSION_MAJOR 5
+#define ESP_IDF_VERSION_MINOR 1
+#define ESP_IDF_VERSION_PATCH 0
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) ((major << 16) | (minor << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(ESP_IDF_VERSION_MAJOR, ESP_IDF_VERSION_MINOR, ESP_IDF_VERSION_PATCH)
+
+#endif // ESP_IDF_VERSION_H
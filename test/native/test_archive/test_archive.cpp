@@ -0,0 +1,292 @@
+// Seeks inside ZIP members through ArchiveMStream the way a D64 in a ZIP is
+// read, both decompressed into ArchiveMemberCache and streamed with skipTo.
+//
+// Links against the host's libarchive (-larchive), lib/libarchive is
+// configured for ESP-IDF only. The fixture is written with it in memory.
+
+#include "unity.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Small enough for a member to go over it, and for three to evict one
+#define ARCHIVE_MEMBER_CACHE_SIZE (64 * 1024)
+
+#include "../lib/utils/string_utils.cpp"
+#include "../lib/utils/U8Char.cpp"
+#include "../lib/utils/peoples_url_parser.cpp"
+
+#include "../lib/meatloaf/meatloaf.cpp"
+#include "../lib/meatloaf/meat_media.cpp"
+#include "../lib/meatloaf/meat_resolver.cpp"
+#include "../lib/meatloaf/device/flash.cpp"
+#include "../lib/meatloaf/disk/d64.cpp"
+#include "../lib/meatloaf/disk/dnp.h"
+#include "../lib/meatloaf/file/p00.cpp"
+#include "../lib/meatloaf/tape/t64.cpp"
+#include "../lib/meatloaf/tape/tcrt.cpp"
+#include "../lib/meatloaf/archive/lbr.cpp"
+#include "../lib/meatloaf/archive/archive_ml.cpp"
+
+#include "../lib/utils/punycode.cpp"
+#undef min // punycode.cpp's own, would get in the way of std::min
+
+#define SMALL_SIZE (30 * 1024)  // cached, three of these are over the limit
+#define BIG_SIZE 174848         // a D64, over the limit so it is streamed
+
+// The archive in memory, counting the seeks libarchive asks for
+class MemoryMStream: public MStream {
+public:
+    MemoryMStream(std::vector<uint8_t> data) : data(data) {
+        _size = data.size();
+        url = "memory://fixture.zip";
+    }
+
+    bool isOpen() override { return true; };
+    bool open() override { return true; };
+    void close() override {};
+
+    uint32_t read(uint8_t* buf, uint32_t size) override {
+        uint32_t length = std::min<uint32_t>(size, _size - _position);
+        memcpy(buf, data.data() + _position, length);
+        _position += length;
+        bytes_read += length;
+        return length;
+    }
+    uint32_t write(const uint8_t *buf, uint32_t size) override { return 0; };
+    bool seek(uint32_t pos) override {
+        if (pos > _size)
+            return false;
+        if (pos != _position)
+            seeks++;
+        _position = pos;
+        return true;
+    }
+
+    std::vector<uint8_t> data;
+    uint32_t bytes_read = 0;
+    uint32_t seeks = 0;
+};
+
+// Contents of member n
+static std::vector<uint8_t> memberData(int n, size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = (uint8_t)(i * 7 + n * 31 + (i >> 8));
+    return data;
+}
+
+static std::vector<std::pair<std::string, std::vector<uint8_t>>> members = {
+    { "one.d64", memberData(1, SMALL_SIZE) },
+    { "two.d64", memberData(2, SMALL_SIZE) },
+    { "three.d64", memberData(3, SMALL_SIZE) },
+    { "big.d64", memberData(4, BIG_SIZE) },
+};
+
+static std::vector<uint8_t> makeZip()
+{
+    std::vector<uint8_t> zip(BIG_SIZE + 4 * SMALL_SIZE + 4096);
+    size_t used = 0;
+
+    struct archive *a = archive_write_new();
+    archive_write_set_format_zip(a);
+    TEST_ASSERT_EQUAL(ARCHIVE_OK, archive_write_open_memory(a, zip.data(), zip.size(), &used));
+
+    for (auto &member : members)
+    {
+        struct archive_entry *entry = archive_entry_new();
+        archive_entry_set_pathname(entry, member.first.c_str());
+        archive_entry_set_size(entry, member.second.size());
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+        TEST_ASSERT_EQUAL(ARCHIVE_OK, archive_write_header(a, entry));
+        TEST_ASSERT_EQUAL(member.second.size(), archive_write_data(a, member.second.data(), member.second.size()));
+        archive_entry_free(entry);
+    }
+
+    archive_write_close(a);
+    archive_write_free(a);
+
+    zip.resize(used);
+    return zip;
+}
+
+static std::shared_ptr<MemoryMStream> zip;
+
+static std::unique_ptr<ArchiveMStream> openMember(std::string name)
+{
+    zip->seek(0);
+    std::unique_ptr<ArchiveMStream> stream(new ArchiveMStream(zip));
+    TEST_ASSERT_TRUE(stream->isOpen());
+    TEST_ASSERT_TRUE(stream->seekPath(name));
+    return stream;
+}
+
+static void readAt(ArchiveMStream *stream, const std::vector<uint8_t> &expected, uint32_t pos, uint32_t length)
+{
+    std::vector<uint8_t> buf(length);
+    TEST_ASSERT_TRUE(stream->seek(pos));
+    TEST_ASSERT_EQUAL(pos, stream->position());
+
+    uint32_t count = 0;
+    while (count < length)
+    {
+        uint32_t r = stream->read(buf.data() + count, length - count);
+        if (r == 0)
+            break;
+        count += r;
+    }
+    TEST_ASSERT_EQUAL(length, count);
+    TEST_ASSERT_EQUAL_MEMORY(expected.data() + pos, buf.data(), length);
+}
+
+void setUp(void)
+{
+    ArchiveMemberCache::clear();
+    if (zip == nullptr)
+        zip = std::make_shared<MemoryMStream>(makeZip());
+}
+
+void tearDown(void)
+{
+}
+
+// cb_seek answers with the new absolute position, and cb_skip never goes past the end
+void test_archive_callbacks(void)
+{
+    ArchiveMStreamData data;
+    data.srcStream = zip;
+    uint32_t size = zip->size();
+
+    TEST_ASSERT_EQUAL(100, cb_seek(nullptr, &data, 100, SEEK_SET));
+    TEST_ASSERT_EQUAL(150, cb_seek(nullptr, &data, 50, SEEK_CUR));
+    TEST_ASSERT_EQUAL(120, cb_seek(nullptr, &data, -30, SEEK_CUR));
+    TEST_ASSERT_EQUAL(size - 22, cb_seek(nullptr, &data, -22, SEEK_END));
+    TEST_ASSERT_EQUAL(size - 22, zip->position());
+
+    TEST_ASSERT_EQUAL(ARCHIVE_FATAL, cb_seek(nullptr, &data, -1, SEEK_SET));
+    TEST_ASSERT_EQUAL(ARCHIVE_FATAL, cb_seek(nullptr, &data, 1, SEEK_END));
+    TEST_ASSERT_EQUAL(size - 22, zip->position());
+
+    TEST_ASSERT_EQUAL(100, cb_seek(nullptr, &data, 100, SEEK_SET));
+    TEST_ASSERT_EQUAL(1000, cb_skip(nullptr, &data, 1000));
+    TEST_ASSERT_EQUAL(1100, zip->position());
+    TEST_ASSERT_EQUAL(size - 1100, cb_skip(nullptr, &data, size));
+    TEST_ASSERT_EQUAL(size, zip->position());
+    TEST_ASSERT_EQUAL(0, cb_skip(nullptr, &data, 1));
+}
+
+// A member under the limit is decompressed once on the first seek, then
+// every seek is served from memory, backwards too
+void test_archive_seek_cached(void)
+{
+    auto &expected = members[1].second;
+    auto stream = openMember("two.d64");
+    TEST_ASSERT_EQUAL(SMALL_SIZE, stream->size());
+
+    readAt(stream.get(), expected, 0, 1000);
+    readAt(stream.get(), expected, 20000, 256);
+    TEST_ASSERT_NOT_NULL(ArchiveMemberCache::obtain(zip->url + "/two.d64").get());
+
+    uint32_t read = zip->bytes_read;
+    readAt(stream.get(), expected, 100, 256);
+    readAt(stream.get(), expected, SMALL_SIZE - 256, 256);
+    readAt(stream.get(), expected, 0, SMALL_SIZE);
+    TEST_ASSERT_EQUAL(read, zip->bytes_read);
+
+    TEST_ASSERT_FALSE(stream->seek(SMALL_SIZE + 1));
+
+    // Opened again, it is already decompressed
+    stream = openMember("two.d64");
+    read = zip->bytes_read;
+    readAt(stream.get(), expected, 5000, 256);
+    readAt(stream.get(), expected, 10, 256);
+    TEST_ASSERT_EQUAL(read, zip->bytes_read);
+}
+
+// Over the limit it can't be kept, a backwards seek starts the archive over
+// at the member and decompresses up to the position again
+void test_archive_seek_streamed(void)
+{
+    auto &expected = members[3].second;
+    auto stream = openMember("big.d64");
+    TEST_ASSERT_EQUAL(BIG_SIZE, stream->size());
+
+    readAt(stream.get(), expected, 0, 256);
+    readAt(stream.get(), expected, 91392, 256);     // 18/0, the BAM
+    TEST_ASSERT_NULL(ArchiveMemberCache::obtain(zip->url + "/big.d64").get());
+
+    uint32_t seeks = zip->seeks;
+    readAt(stream.get(), expected, 91648, 256);     // 18/1, straight after
+    readAt(stream.get(), expected, 256, 256);       // back to 1/1
+    TEST_ASSERT_GREATER_THAN(seeks, zip->seeks);
+    readAt(stream.get(), expected, BIG_SIZE - 256, 256);
+    readAt(stream.get(), expected, 91392, 512);
+
+    TEST_ASSERT_FALSE(stream->seek(BIG_SIZE + 1));
+    readAt(stream.get(), expected, 1000, 100);
+
+    // Random seeks, the way a directory listing then a load goes about a D64
+    std::mt19937 rng(64);
+    for (int i = 0; i < 20; i++)
+    {
+        uint32_t pos = rng() % (BIG_SIZE - 256);
+        readAt(stream.get(), expected, pos, 256);
+    }
+}
+
+// The least recently used member goes once the total is over the limit, a
+// stream still reading it keeps its own copy
+void test_archive_cache_eviction(void)
+{
+    auto one = openMember("one.d64");
+    readAt(one.get(), members[0].second, 100, 256);
+    readAt(one.get(), members[0].second, 0, 256);
+
+    auto two = openMember("two.d64");
+    readAt(two.get(), members[1].second, 100, 256);
+    readAt(two.get(), members[1].second, 0, 256);
+    TEST_ASSERT_NOT_NULL(ArchiveMemberCache::obtain(zip->url + "/two.d64").get());
+    TEST_ASSERT_NOT_NULL(ArchiveMemberCache::obtain(zip->url + "/one.d64").get());
+
+    // one.d64 was looked up last, so two.d64 is the one to go
+    auto three = openMember("three.d64");
+    readAt(three.get(), members[2].second, 100, 256);
+    TEST_ASSERT_NOT_NULL(ArchiveMemberCache::obtain(zip->url + "/one.d64").get());
+    TEST_ASSERT_NULL(ArchiveMemberCache::obtain(zip->url + "/two.d64").get());
+    TEST_ASSERT_NOT_NULL(ArchiveMemberCache::obtain(zip->url + "/three.d64").get());
+
+    uint32_t read = zip->bytes_read;
+    readAt(two.get(), members[1].second, 20000, 256);
+    readAt(two.get(), members[1].second, 50, 256);
+    TEST_ASSERT_EQUAL(read, zip->bytes_read);
+
+    // Evicted members are decompressed again the next time
+    two = openMember("two.d64");
+    readAt(two.get(), members[1].second, 100, 256);
+    readAt(two.get(), members[1].second, 0, 256);
+    TEST_ASSERT_NOT_NULL(ArchiveMemberCache::obtain(zip->url + "/two.d64").get());
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_archive_callbacks);
+    RUN_TEST(test_archive_seek_cached);
+    RUN_TEST(test_archive_seek_streamed);
+    RUN_TEST(test_archive_cache_eviction);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
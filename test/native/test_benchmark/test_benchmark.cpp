@@ -0,0 +1,858 @@
+// Host side benchmarks for the MStream stack
+//
+// Builds lib/meatloaf against the POSIX flash filesystem, generates disk,
+// tape and file images under BENCH_DIR and times the operations the drive
+// does most: directory listing, LOAD by name, random sector access and
+// opening a file in an image inside another image. HTTP is measured with
+// the real HttpIStream against the host esp_http_client stand-in (a
+// request costs a fixed round trip), and a D64 in a ZIP through
+// ArchiveMStream, written with the host's libarchive.
+//
+// Every result is printed as one line
+//
+//   BENCH {"bench":"load","image":"d64",...}
+//
+// and appended to $MEATLOAF_BENCH_OUT as JSON lines when that is set, so
+// runs can be compared over time.
+//
+
+#include "unity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../lib/utils/string_utils.cpp"
+#include "../lib/utils/U8Char.cpp"
+#include "../lib/utils/peoples_url_parser.cpp"
+#include "../lib/utils/utils.cpp"
+#include "../lib/compat/strlcpy.c"
+#include "../lib/compat/compat_gettimeofday.c"
+
+// A D64 is kept decompressed, as on a PSRAM board
+#define ARCHIVE_MEMBER_CACHE_SIZE (1024 * 1024)
+
+#include "../lib/meatloaf/meatloaf.cpp"
+#include "../lib/meatloaf/meat_media.cpp"
+#include "../lib/meatloaf/meat_resolver.cpp"
+#include "../lib/meatloaf/device/flash.cpp"
+#include "../lib/meatloaf/disk/d64.cpp"
+#include "../lib/meatloaf/file/p00.cpp"
+#include "../lib/meatloaf/tape/t64.cpp"
+#include "../lib/meatloaf/tape/tcrt.cpp"
+#include "../lib/meatloaf/archive/lbr.cpp"
+#include "../lib/meatloaf/wrappers/page_cache.cpp"
+#include "../lib/meatloaf/network/http.cpp"
+#include "../lib/meatloaf/archive/archive_ml.cpp"
+
+#include "../lib/utils/punycode.cpp"
+#undef min // punycode.cpp's own, would get in the way of std::min
+
+// MeatHttpClient talks to http_stand_in through the host esp_http_client
+#include "../stubs/esp_http_client.cpp"
+
+#define BENCH_DIR "/tmp/meatloaf_bench"
+
+#define BENCH_FILES 40          // files on each disk image
+#define BENCH_FILE_BLOCKS 16    // data blocks in each of them
+
+#define HTTP_ROUND_TRIP 200     // microseconds per request to the stand-in server
+#define HTTP_URL "http://stand-in/bench.d64"
+
+
+/********************************************************
+ * Results
+ ********************************************************/
+
+class Bench
+{
+    std::string _bench;
+    std::string _image;
+    std::vector<double> _times;
+    uint64_t _bytes = 0;
+
+public:
+    Bench(std::string bench, std::string image) : _bench(bench), _image(image) {}
+
+    // Time one operation, f() returns the bytes it moved
+    template<typename F>
+    void run(F f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        _bytes += f();
+        _times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    void report(std::string extra = "")
+    {
+        std::vector<double> sorted(_times);
+        std::sort(sorted.begin(), sorted.end());
+
+        double total = 0;
+        for (auto t : _times)
+            total += t;
+
+        auto percentile = [&sorted](double p) {
+            return sorted[std::min<size_t>(sorted.size() - 1, sorted.size() * p)] * 1e6;
+        };
+
+        std::string line = mstr::format(
+            "{\"bench\":\"%s\",\"image\":\"%s\",\"ops\":%d,\"ops_per_sec\":%.1f,"
+            "\"us_per_op\":%.2f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"bytes\":%llu,\"bytes_per_sec\":%.0f%s}",
+            _bench.c_str(), _image.c_str(), (int)_times.size(), _times.size() / total,
+            total * 1e6 / _times.size(), percentile(0.5), percentile(0.99),
+            (unsigned long long)_bytes, _bytes / total, extra.c_str());
+
+        printf("BENCH %s\r\n", line.c_str());
+
+        if (auto out = getenv("MEATLOAF_BENCH_OUT"))
+        {
+            if (FILE *f = fopen(out, "a"))
+            {
+                fprintf(f, "%s\n", line.c_str());
+                fclose(f);
+            }
+        }
+    }
+};
+
+
+/********************************************************
+ * Fixtures
+ ********************************************************/
+
+// Contents of file n, load address first
+static std::vector<uint8_t> fileData(int n, size_t size)
+{
+    std::vector<uint8_t> data(size);
+    data[0] = 0x01;
+    data[1] = 0x08;
+    for (size_t i = 2; i < size; i++)
+        data[i] = (uint8_t)(i * 7 + n * 31 + (i >> 8));
+    return data;
+}
+
+static std::string fileName(int n)
+{
+    return mstr::format("FILE%02d", n);
+}
+
+// The same name as it appears in a url, PETSCII decoded
+static std::string urlName(int n)
+{
+    return mstr::format("file%02d", n);
+}
+
+static std::vector<std::pair<std::string, std::vector<uint8_t>>> benchFiles()
+{
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> files;
+    for (int n = 0; n < BENCH_FILES; n++)
+        files.push_back({ fileName(n), fileData(n, BENCH_FILE_BLOCKS * 254) });
+    return files;
+}
+
+static void writeFile(std::string path, const std::vector<uint8_t> &data)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+}
+
+// A formatted CBM disk with files on it, laid out the way the drive
+// would write them
+struct Disk
+{
+    std::vector<uint16_t> sectors;  // per track, from track 1
+    std::vector<uint32_t> offsets;
+    std::vector<std::vector<bool>> used;
+    std::vector<uint8_t> data;
+
+    uint8_t dir_track;
+    uint8_t dir_interleave;
+    uint8_t file_interleave;
+
+    Disk(std::vector<uint16_t> sectors, uint8_t dir_track, uint8_t dir_interleave, uint8_t file_interleave)
+        : sectors(sectors), dir_track(dir_track), dir_interleave(dir_interleave), file_interleave(file_interleave)
+    {
+        uint32_t total = 0;
+        for (auto count : sectors)
+        {
+            offsets.push_back(total);
+            used.push_back(std::vector<bool>(count, false));
+            total += count;
+        }
+        data.assign(total * 256, 0);
+    }
+
+    uint8_t *block(uint8_t track, uint8_t sector)
+    {
+        return &data[(offsets[track - 1] + sector) * 256];
+    }
+
+    void use(uint8_t track, uint8_t sector)
+    {
+        used[track - 1][sector] = true;
+    }
+
+    // Next free sector interleave away, on this track or the next one
+    bool next(uint8_t &track, int &sector, uint8_t interleave)
+    {
+        while (track <= sectors.size())
+        {
+            if (track != dir_track)
+            {
+                uint16_t count = sectors[track - 1];
+                for (uint16_t i = 0; i < count; i++)
+                {
+                    uint16_t s = (sector + interleave + i) % count;
+                    if (!used[track - 1][s])
+                    {
+                        sector = s;
+                        use(track, sector);
+                        return true;
+                    }
+                }
+            }
+            track++;
+            sector = -interleave; // start a new track at sector 0
+        }
+        return false;
+    }
+
+    // Directory sectors, then the files, 8 entries to a directory sector
+    void build(uint8_t first_dir_sector, std::vector<std::pair<std::string, std::vector<uint8_t>>> files)
+    {
+        std::vector<uint8_t> dir_sectors;
+        uint16_t count = sectors[dir_track - 1];
+        for (uint8_t i = 0, s = first_dir_sector; i < (files.size() + 7) / 8; i++)
+        {
+            while (used[dir_track - 1][s])
+                s = (s + 1) % count;
+            use(dir_track, s);
+            dir_sectors.push_back(s);
+            s = (s + dir_interleave) % count;
+        }
+
+        uint8_t track = 1;
+        int sector = -file_interleave;
+        for (size_t n = 0; n < files.size(); n++)
+        {
+            auto &contents = files[n].second;
+            uint16_t blocks = (contents.size() + 253) / 254;
+
+            uint8_t *entry = block(dir_track, dir_sectors[n / 8]) + (n % 8) * 32;
+            if (n % 8 == 0)
+            {
+                bool more = (n / 8 + 1 < dir_sectors.size());
+                entry[0] = more ? dir_track : 0;
+                entry[1] = more ? dir_sectors[n / 8 + 1] : 0xFF;
+            }
+            entry[2] = 0x82;
+            memset(entry + 5, 0xA0, 16);
+            memcpy(entry + 5, files[n].first.c_str(), files[n].first.size());
+            entry[30] = blocks & 0xFF;
+            entry[31] = blocks >> 8;
+
+            uint8_t *previous = nullptr;
+            for (uint16_t b = 0; b < blocks; b++)
+            {
+                TEST_ASSERT_TRUE(next(track, sector, file_interleave));
+                if (b == 0)
+                {
+                    entry[3] = track;
+                    entry[4] = sector;
+                }
+                else
+                {
+                    previous[0] = track;
+                    previous[1] = sector;
+                }
+
+                uint32_t length = std::min<uint32_t>(254, contents.size() - b * 254);
+                uint8_t *data = block(track, sector);
+                memcpy(data + 2, &contents[b * 254], length);
+                data[0] = 0;
+                data[1] = length + 1;
+                previous = data;
+            }
+        }
+    }
+
+    // Free count and bitmap for each track in [first, last]
+    void bam(uint8_t *at, uint8_t first, uint8_t last, uint8_t byte_count, bool counts = true)
+    {
+        for (uint8_t track = first; track <= last; track++, at += byte_count)
+        {
+            uint8_t *bits = counts ? at + 1 : at;
+            uint8_t free = 0;
+            for (uint16_t s = 0; s < sectors[track - 1]; s++)
+            {
+                if (!used[track - 1][s])
+                {
+                    bits[s / 8] |= (1 << (s % 8));
+                    free++;
+                }
+            }
+            if (counts)
+                at[0] = free;
+        }
+    }
+
+    void name(uint8_t *at, std::string disk_name, std::string id)
+    {
+        memset(at, 0xA0, 27);
+        memcpy(at, disk_name.c_str(), disk_name.size());
+        memcpy(at + 18, id.c_str(), id.size());
+    }
+};
+
+static std::vector<uint16_t> cbmSectors(uint8_t tracks)
+{
+    std::vector<uint16_t> sectors;
+    for (uint8_t t = 1; t <= tracks; t++)
+    {
+        uint8_t side = (t > 35) ? t - 35 : t;
+        sectors.push_back((side < 18) ? 21 : (side < 25) ? 19 : (side < 31) ? 18 : 17);
+    }
+    return sectors;
+}
+
+static Disk makeD64(std::vector<std::pair<std::string, std::vector<uint8_t>>> files = benchFiles())
+{
+    Disk disk(cbmSectors(35), 18, 3, 10);
+    disk.use(18, 0);
+    disk.build(1, files);
+
+    uint8_t *header = disk.block(18, 0);
+    header[0] = 18;
+    header[1] = 1;
+    header[2] = 0x41;
+    disk.bam(header + 0x04, 1, 35, 4);
+    disk.name(header + 0x90, "MEATLOAF BENCH", "ML 2A");
+    return disk;
+}
+
+static Disk makeD71(std::vector<std::pair<std::string, std::vector<uint8_t>>> files = benchFiles())
+{
+    Disk disk(cbmSectors(70), 18, 3, 6);
+    disk.use(18, 0);
+    disk.use(53, 0);
+    disk.build(1, files);
+
+    uint8_t *header = disk.block(18, 0);
+    header[0] = 18;
+    header[1] = 1;
+    header[2] = 0x41;
+    header[3] = 0x80;   // double sided
+    disk.bam(header + 0x04, 1, 35, 4);
+    disk.name(header + 0x90, "MEATLOAF BENCH", "ML 2A");
+
+    // Side 2, bitmaps on 53/0 and free counts back on 18/0
+    disk.bam(disk.block(53, 0), 36, 70, 3, false);
+    for (uint8_t track = 36; track <= 70; track++)
+        header[0xDD + track - 36] = std::count(disk.used[track - 1].begin(), disk.used[track - 1].end(), false);
+    return disk;
+}
+
+static Disk makeD81(std::vector<std::pair<std::string, std::vector<uint8_t>>> files = benchFiles())
+{
+    Disk disk(std::vector<uint16_t>(80, 40), 40, 1, 1);
+    for (uint8_t s = 0; s < 3; s++)
+        disk.use(40, s);
+    disk.build(3, files);
+
+    uint8_t *header = disk.block(40, 0);
+    header[0] = 40;
+    header[1] = 3;
+    header[2] = 0x44;
+    disk.name(header + 0x04, "MEATLOAF BENCH", "ML 3D");
+
+    for (uint8_t s = 1; s <= 2; s++)
+    {
+        uint8_t *bam = disk.block(40, s);
+        bam[0] = (s == 1) ? 40 : 0;
+        bam[1] = (s == 1) ? 2 : 0xFF;
+        bam[2] = 0x44;
+        bam[3] = 0xBB;
+        bam[4] = 'M';
+        bam[5] = 'L';
+        disk.bam(bam + 0x10, (s == 1) ? 1 : 41, (s == 1) ? 40 : 80, 6);
+    }
+    return disk;
+}
+
+static std::vector<uint8_t> makeT64()
+{
+    std::vector<uint8_t> t64(0x40 + BENCH_FILES * 32, 0);
+    memcpy(&t64[0], "C64S tape image file", 20);
+    t64[0x20] = 0x01;
+    t64[0x21] = 0x01;
+    t64[0x22] = BENCH_FILES;
+    t64[0x24] = BENCH_FILES;
+    memset(&t64[0x28], 0x20, 24);
+    memcpy(&t64[0x28], "MEATLOAF BENCH", 14);
+
+    for (int n = 0; n < BENCH_FILES; n++)
+    {
+        auto contents = fileData(n, BENCH_FILE_BLOCKS * 254);
+        uint32_t offset = t64.size();
+        uint16_t end = 0x0801 + contents.size() - 2;
+
+        uint8_t *entry = &t64[0x40 + n * 32];
+        entry[0] = 1;
+        entry[1] = 0x82;
+        entry[2] = contents[0];
+        entry[3] = contents[1];
+        entry[4] = end & 0xFF;
+        entry[5] = end >> 8;
+        memcpy(entry + 8, &offset, 4);
+        memset(entry + 16, 0x20, 16);
+        auto name = fileName(n);
+        memcpy(entry + 16, name.c_str(), name.size());
+
+        t64.insert(t64.end(), contents.begin() + 2, contents.end());
+    }
+    return t64;
+}
+
+static std::vector<uint8_t> makeP00(int n)
+{
+    std::vector<uint8_t> p00(26, 0);
+    memcpy(&p00[0], "C64File", 7);
+    auto name = fileName(n);
+    memcpy(&p00[8], name.c_str(), name.size());
+
+    auto contents = fileData(n, BENCH_FILE_BLOCKS * 254);
+    p00.insert(p00.end(), contents.begin(), contents.end());
+    return p00;
+}
+
+
+/********************************************************
+ * Operations
+ ********************************************************/
+
+static std::string path(std::string name)
+{
+    return std::string(BENCH_DIR "/") + name;
+}
+
+// $ through MFile, the way the drive lists a directory
+static uint64_t listing(std::string url, int expected)
+{
+    auto dir = std::unique_ptr<MFile>(MFSOwner::File(url));
+    TEST_ASSERT_NOT_NULL(dir.get());
+    TEST_ASSERT_TRUE(dir->rewindDirectory());
+
+    int entries = 0;
+    uint64_t bytes = 0;
+    while (auto entry = std::unique_ptr<MFile>(dir->getNextFileInDir()))
+    {
+        bytes += entry->name.size() + 32;
+        entries++;
+    }
+    TEST_ASSERT_EQUAL(expected, entries);
+    return bytes;
+}
+
+// $ through MFile::readEntry(), one entry for the whole directory
+static uint64_t entries(std::string url, int expected)
+{
+    auto dir = std::unique_ptr<MFile>(MFSOwner::File(url));
+    TEST_ASSERT_NOT_NULL(dir.get());
+    TEST_ASSERT_TRUE(dir->rewindDirectory());
+
+    int count = 0;
+    uint64_t bytes = 0;
+    MDirEntry entry;
+    while (dir->readEntry(entry))
+    {
+        bytes += entry.name_length + 32;
+        count++;
+    }
+    TEST_ASSERT_EQUAL(expected, count);
+    return bytes;
+}
+
+// LOAD"name",8 through MFile, checking what comes back
+static uint64_t load(std::string url, int n)
+{
+    auto file = std::unique_ptr<MFile>(MFSOwner::File(url));
+    TEST_ASSERT_NOT_NULL(file.get());
+    auto stream = std::unique_ptr<MStream>(file->getSourceStream());
+    TEST_ASSERT_NOT_NULL(stream.get());
+
+    auto expected = fileData(n, BENCH_FILE_BLOCKS * 254);
+    std::vector<uint8_t> got;
+    uint8_t buf[256];
+    while (uint32_t r = stream->read(buf, sizeof(buf)))
+        got.insert(got.end(), buf, buf + r);
+
+    TEST_ASSERT_EQUAL(expected.size(), got.size());
+    TEST_ASSERT_EQUAL(0, memcmp(expected.data(), got.data(), got.size()));
+    return got.size();
+}
+
+
+// A ZIP with the image in it, deflated
+static std::vector<uint8_t> makeZip(const std::vector<uint8_t> &image)
+{
+    std::vector<uint8_t> zip(image.size() + 4096);
+    size_t used = 0;
+
+    struct archive *a = archive_write_new();
+    archive_write_set_format_zip(a);
+    TEST_ASSERT_EQUAL(ARCHIVE_OK, archive_write_open_memory(a, zip.data(), zip.size(), &used));
+
+    struct archive_entry *entry = archive_entry_new();
+    archive_entry_set_pathname(entry, "bench.d64");
+    archive_entry_set_size(entry, image.size());
+    archive_entry_set_filetype(entry, AE_IFREG);
+    archive_entry_set_perm(entry, 0644);
+    TEST_ASSERT_EQUAL(ARCHIVE_OK, archive_write_header(a, entry));
+    TEST_ASSERT_EQUAL(image.size(), archive_write_data(a, image.data(), image.size()));
+    archive_entry_free(entry);
+
+    archive_write_close(a);
+    archive_write_free(a);
+
+    zip.resize(used);
+    return zip;
+}
+
+
+/********************************************************
+ * Streams
+ ********************************************************/
+
+// HttpIStream either seeking on the connection, or through MPageCache
+class BenchHttpIStream : public HttpIStream
+{
+public:
+    BenchHttpIStream(bool cached) : HttpIStream(HTTP_URL)
+    {
+        _no_cache = !cached;
+    }
+};
+
+// D64MStream is given its container directly here, this reaches the part
+// of it the drive would go through MFile for
+class BenchD64MStream : public D64MStream
+{
+public:
+    using D64MStream::D64MStream;
+    using D64MStream::seekNextImageEntry;
+};
+
+
+/********************************************************
+ * Benchmarks
+ ********************************************************/
+
+struct Image
+{
+    const char *name;
+    std::string file;
+    int entries;
+    Disk *disk;     // for track/sector access
+};
+
+static std::vector<Image> images;
+static Disk *d64 = nullptr;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_benchmark_fixtures(void)
+{
+    mkdir(BENCH_DIR, 0755);
+
+    static Disk d64_disk = makeD64();
+    static Disk d71_disk = makeD71();
+    static Disk d81_disk = makeD81();
+    d64 = &d64_disk;
+
+    writeFile(path("bench.d64"), d64_disk.data);
+    writeFile(path("bench.d71"), d71_disk.data);
+    writeFile(path("bench.d81"), d81_disk.data);
+    writeFile(path("bench.t64"), makeT64());
+    writeFile(path("bench.zip"), makeZip(d64_disk.data));
+    for (int n = 0; n < BENCH_FILES; n++)
+        writeFile(path(mstr::format("file%02d.p00", n)), makeP00(n));
+
+    images = {
+        { "d64", path("bench.d64"), BENCH_FILES, &d64_disk },
+        { "d71", path("bench.d71"), BENCH_FILES, &d71_disk },
+        { "d81", path("bench.d81"), BENCH_FILES, &d81_disk },
+        { "t64", path("bench.t64"), BENCH_FILES, nullptr },
+    };
+}
+
+void test_benchmark_listing(void)
+{
+    for (auto &image : images)
+    {
+        // T64MFile has no directory iteration yet
+        if (image.disk == nullptr)
+            continue;
+
+        Bench bench("listing", image.name);
+        for (int i = 0; i < 200; i++)
+            bench.run([&]() { return listing(image.file, image.entries); });
+        bench.report();
+    }
+}
+
+// readEntry() has to list exactly what getNextFileInDir() does
+void test_benchmark_entries_match(void)
+{
+    std::vector<std::string> urls = { BENCH_DIR };
+    for (auto &image : images)
+        if (image.disk != nullptr)
+            urls.push_back(image.file);
+
+    for (auto &url : urls)
+    {
+        // What the listing used to read from each MFile, while it was the current entry
+        std::vector<MDirEntry> expected;
+        auto dir = std::unique_ptr<MFile>(MFSOwner::File(url));
+        TEST_ASSERT_TRUE(dir->rewindDirectory());
+        while (auto file = std::unique_ptr<MFile>(dir->getNextFileInDir()))
+        {
+            // Image entries come back with their name as it is in the directory
+            std::string name = file->name;
+            if (file->isPETSCII)
+                mstr::replaceAll(name, "\\", "/");
+
+            MDirEntry e;
+            e.setName(name.data(), name.size());
+            e.setExtension(file->extension.data(), file->extension.size());
+            e.flags = (file->isDirectory() ? MDirEntry::DIRECTORY : 0) | (file->isPETSCII ? MDirEntry::PETSCII : 0);
+            e.size = file->size();
+            e.blocks = file->blocks();
+            expected.push_back(e);
+        }
+        TEST_ASSERT_TRUE(expected.size() > 0);
+
+        dir.reset(MFSOwner::File(url));
+        TEST_ASSERT_TRUE(dir->rewindDirectory());
+        MDirEntry entry;
+        for (auto &e : expected)
+        {
+            TEST_ASSERT_TRUE(dir->readEntry(entry));
+            TEST_ASSERT_EQUAL_STRING(e.name, entry.name);
+            TEST_ASSERT_EQUAL(e.name_length, entry.name_length);
+            TEST_ASSERT_EQUAL_STRING(e.extension, entry.extension);
+            TEST_ASSERT_EQUAL(e.flags, entry.flags);
+            TEST_ASSERT_EQUAL(e.blocks, entry.blocks);
+            if (!e.isPETSCII())
+                TEST_ASSERT_EQUAL(e.size, entry.size);
+        }
+        TEST_ASSERT_FALSE(dir->readEntry(entry));
+    }
+}
+
+void test_benchmark_entries(void)
+{
+    for (auto &image : images)
+    {
+        if (image.disk == nullptr)
+            continue;
+
+        Bench bench("entries", image.name);
+        for (int i = 0; i < 200; i++)
+            bench.run([&]() { return entries(image.file, image.entries); });
+        bench.report();
+    }
+
+    // The folder the images are in
+    int count = 0;
+    auto dir = std::unique_ptr<MFile>(MFSOwner::File(BENCH_DIR));
+    MDirEntry entry;
+    while (dir->readEntry(entry))
+        count++;
+
+    Bench before("listing", "dir");
+    for (int i = 0; i < 200; i++)
+        before.run([&]() { return listing(BENCH_DIR, count); });
+    before.report();
+
+    Bench after("entries", "dir");
+    for (int i = 0; i < 200; i++)
+        after.run([&]() { return entries(BENCH_DIR, count); });
+    after.report();
+}
+
+void test_benchmark_load(void)
+{
+    for (auto &image : images)
+    {
+        Bench bench("load", image.name);
+        for (int i = 0; i < 200; i++)
+        {
+            int n = (i * 7) % BENCH_FILES;
+            bench.run([&]() { return load(image.file + "/" + urlName(n), n); });
+        }
+        bench.report();
+    }
+
+    Bench bench("load", "p00");
+    for (int i = 0; i < 200; i++)
+    {
+        int n = (i * 7) % BENCH_FILES;
+        bench.run([&]() { return load(path(mstr::format("file%02d.p00", n)), n); });
+    }
+    bench.report();
+}
+
+void test_benchmark_sectors(void)
+{
+    for (auto &image : images)
+    {
+        if (image.disk == nullptr)
+            continue;
+
+        // The "#" channel a U1 command reads through
+        auto file = std::unique_ptr<MFile>(MFSOwner::File(image.file + "/#"));
+        auto stream = std::unique_ptr<MStream>(file->getSourceStream());
+        TEST_ASSERT_NOT_NULL(stream.get());
+
+        auto &disk = *image.disk;
+        std::mt19937 rng(1541);
+        uint8_t buf[256];
+        Bench bench("sector", image.name);
+        for (int i = 0; i < 20000; i++)
+        {
+            uint8_t track = 1 + (rng() % disk.sectors.size());
+            uint8_t sector = rng() % disk.sectors[track - 1];
+            bench.run([&]() -> uint64_t {
+                TEST_ASSERT_TRUE(stream->blockRead(track, sector));
+                return stream->read(buf, sizeof(buf));
+            });
+            TEST_ASSERT_EQUAL(0, memcmp(buf, disk.block(track, sector), sizeof(buf)));
+        }
+        bench.report();
+    }
+}
+
+void test_benchmark_nested(void)
+{
+    // A D64 saved onto a D81 as a file, then a file in that
+    auto files = benchFiles();
+    files.push_back({ "INNER.D64", d64->data });
+    writeFile(path("nested.d81"), makeD81(files).data);
+
+    std::string url = path("nested.d81/inner.d64/") + urlName(3);
+    Bench bench("nested_open", "d81/d64");
+    for (int i = 0; i < 50; i++)
+    {
+        ImageBroker::dispose(path("nested.d81"));
+        ImageBroker::dispose(path("nested.d81/inner.d64"));
+        bench.run([&]() { return load(url, 3); });
+    }
+    bench.report();
+}
+
+// A listing and a LOAD, with the image read from container
+static uint64_t listAndLoad(std::shared_ptr<MStream> container, int n)
+{
+    BenchD64MStream image(container);
+
+    uint64_t bytes = 0;
+    while (image.seekNextImageEntry())
+        bytes += 32;
+    TEST_ASSERT_TRUE(image.seekPath(urlName(n)));
+
+    uint8_t buf[256];
+    while (uint32_t r = image.read(buf, sizeof(buf)))
+        bytes += r;
+    return bytes;
+}
+
+void test_benchmark_http(void)
+{
+    for (bool cached : { false, true })
+    {
+        http_stand_in.reset();
+        http_stand_in.resources[HTTP_URL] = d64->data;
+        http_stand_in.on_request = []() { usleep(HTTP_ROUND_TRIP); };
+
+        Bench bench("http_load", "d64");
+        for (int i = 0; i < 20; i++)
+        {
+            int n = (i * 7) % BENCH_FILES;
+            bench.run([&]() -> uint64_t {
+                // Every LOAD starts with a fresh connection and cache
+                auto http = std::make_shared<BenchHttpIStream>(cached);
+                TEST_ASSERT_TRUE(http->open());
+                return listAndLoad(http, n);
+            });
+        }
+        bench.report(mstr::format(",\"page_cache\":%s,\"requests_per_op\":%.1f",
+            cached ? "true" : "false", http_stand_in.requests.size() / 20.0));
+    }
+    http_stand_in.reset();
+}
+
+void test_benchmark_archive(void)
+{
+    // Decompressed for every LOAD, or once and then kept
+    for (bool kept : { false, true })
+    {
+        ArchiveMemberCache::clear();
+
+        Bench bench("archive_load", "zip/d64");
+        for (int i = 0; i < 20; i++)
+        {
+            int n = (i * 7) % BENCH_FILES;
+            if (!kept)
+                ArchiveMemberCache::clear();
+
+            bench.run([&]() -> uint64_t {
+                auto file = std::unique_ptr<MFile>(MFSOwner::File(path("bench.zip")));
+                auto zip = std::shared_ptr<MStream>(file->getSourceStream());
+                auto archive = std::make_shared<ArchiveMStream>(zip);
+                TEST_ASSERT_TRUE(archive->seekPath("bench.d64"));
+                return listAndLoad(archive, n);
+            });
+        }
+        bench.report(mstr::format(",\"member_cache\":%s", kept ? "true" : "false"));
+    }
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_benchmark_fixtures);
+    RUN_TEST(test_benchmark_listing);
+    RUN_TEST(test_benchmark_entries_match);
+    RUN_TEST(test_benchmark_entries);
+    RUN_TEST(test_benchmark_load);
+    RUN_TEST(test_benchmark_sectors);
+    RUN_TEST(test_benchmark_nested);
+    RUN_TEST(test_benchmark_http);
+    RUN_TEST(test_benchmark_archive);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
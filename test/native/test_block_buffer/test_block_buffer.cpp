@@ -0,0 +1,329 @@
+#include "unity.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+
+#include "../lib/meatloaf/wrappers/block_buffer.cpp"
+
+// In-memory source standing in for an HTTP or archive backed MStream
+class MemoryStream : public MStream
+{
+    std::vector<uint8_t> _data;
+    std::atomic<bool> dried{false};
+
+public:
+    useconds_t latency = 0; // per read, to stand in for a slow network
+    bool blocking = true;
+    std::atomic<bool> hold{false};      // reads wait until this is cleared
+    std::atomic<bool> reading{false};
+    std::atomic<bool> closed{false};
+    std::atomic<int> dry{0};            // reads every so often with no data available yet
+
+    MemoryStream(size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            _data.push_back((uint8_t)(i * 7 + (i >> 8)));
+        _size = size;
+    }
+
+    const std::vector<uint8_t> &data() { return _data; }
+
+    bool isOpen() override { return true; };
+    void close() override { closed = true; };
+    bool open() override { return true; };
+    bool canBlock() override { return blocking; };
+
+    uint32_t write(const uint8_t *buf, uint32_t size) override { return 0; };
+    uint32_t read(uint8_t *buf, uint32_t size) override
+    {
+        reading = true;
+        while (hold)
+            usleep(100);
+        if (latency)
+            usleep(latency);
+        if (dry && (_position / 100) % dry == 1 && !dried.exchange(true))
+            return 0;
+        dried = false;
+        if (size > available())
+            size = available();
+        memcpy(buf, _data.data() + _position, size);
+        _position += size;
+        return size;
+    };
+
+    bool seek(uint32_t pos) override
+    {
+        _position = pos;
+        return true;
+    };
+};
+
+// Records what a C64 would have received, optionally pulling ATN after n bytes
+class MockBus
+{
+public:
+    std::vector<uint8_t> received;
+    size_t eoi_count = 0;
+    bool eoi_last = false;
+    size_t atn_at = 0;
+    bool atn = false;
+
+    bool sendByte(uint8_t b, bool eoi)
+    {
+        if (atn_at && received.size() == atn_at)
+        {
+            atn = true;
+            atn_at = 0;
+            return true;
+        }
+        received.push_back(b);
+        eoi_count += eoi;
+        eoi_last = eoi;
+        return true;
+    }
+};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// Same shape as the iecDrive::sendFile loop
+static bool sendBlocks(MBlockBuffer &buffer, MockBus &bus)
+{
+    bool eoi = false;
+    bus.atn = false;
+
+    while (!eoi)
+    {
+        buffer.fill();
+
+        const uint8_t *data;
+        size_t len = buffer.peek(&data);
+        if (len == 0)
+        {
+            if (!buffer.eos() && !buffer.error())
+                continue;
+            return false;
+        }
+
+        size_t i = 0;
+        for (; i < len; i++)
+        {
+            eoi = buffer.isLast(i);
+            bus.sendByte(data[i], eoi);
+            if (!eoi && bus.atn)
+                break;
+        }
+        buffer.consume(i);
+
+        if (bus.atn)
+            return false;
+    }
+
+    return true;
+}
+
+// The old iecDrive::sendFile loop
+static void sendBytes(MStream &stream, MockBus &bus)
+{
+    uint8_t b;
+    while (stream.read(&b, 1))
+    {
+        stream.position();
+        stream.available();
+        bus.sendByte(b, stream.eos());
+        if (stream.eos())
+            break;
+    }
+}
+
+void test_block_buffer_sends_whole_stream(void)
+{
+    for (size_t size : {1, 2, 255, 256, 257, 1024, 174848})
+    {
+        auto stream = std::make_shared<MemoryStream>(size);
+        MBlockBuffer buffer(stream);
+        MockBus bus;
+
+        TEST_ASSERT_TRUE(sendBlocks(buffer, bus));
+        TEST_ASSERT_TRUE(bus.received == stream->data());
+        TEST_ASSERT_EQUAL(1, bus.eoi_count);
+        TEST_ASSERT_TRUE(bus.eoi_last);
+    }
+}
+
+void test_block_buffer_resumes_after_atn(void)
+{
+    auto stream = std::make_shared<MemoryStream>(4000);
+    MBlockBuffer buffer(stream);
+    MockBus bus;
+
+    bus.atn_at = 1500;
+    TEST_ASSERT_FALSE(sendBlocks(buffer, bus));
+    TEST_ASSERT_EQUAL(1500, buffer.position());
+
+    TEST_ASSERT_TRUE(sendBlocks(buffer, bus));
+    TEST_ASSERT_TRUE(bus.received == stream->data());
+    TEST_ASSERT_EQUAL(1, bus.eoi_count);
+}
+
+void test_block_buffer_prefetch(void)
+{
+    auto stream = std::make_shared<MemoryStream>(64 * 1024);
+    stream->latency = 200;
+    auto buffer = std::make_shared<MBlockBuffer>(stream, BLOCK_BUFFER_BLOCK_SIZE, BLOCK_BUFFER_PREFETCH_BLOCKS);
+    MockBus bus;
+
+    TEST_ASSERT_TRUE(buffer->startPrefetch());
+
+    // Interrupt once, then finish while the task keeps reading ahead
+    bus.atn_at = 10000;
+    TEST_ASSERT_FALSE(sendBlocks(*buffer, bus));
+    TEST_ASSERT_TRUE(sendBlocks(*buffer, bus));
+
+    TEST_ASSERT_TRUE(bus.received == stream->data());
+    TEST_ASSERT_EQUAL(1, bus.eoi_count);
+
+    // The consumer is faster than this source, so it must have waited on it
+    printf("prefetch depth[%d] level[%d] underruns[%d]\r\n", (int)buffer->depth(), (int)buffer->buffered(), buffer->underruns());
+    TEST_ASSERT_TRUE(buffer->underruns() > 0);
+}
+
+void test_block_buffer_no_data_yet(void)
+{
+    // A source that has nothing yet isn't at its end, inline and prefetched
+    for (bool prefetch : { false, true })
+    {
+        auto stream = std::make_shared<MemoryStream>(5000);
+        stream->dry = 3;
+        auto buffer = std::make_shared<MBlockBuffer>(stream, BLOCK_BUFFER_BLOCK_SIZE, BLOCK_BUFFER_PREFETCH_BLOCKS);
+        MockBus bus;
+
+        if (prefetch)
+            TEST_ASSERT_TRUE(buffer->startPrefetch());
+
+        TEST_ASSERT_TRUE(sendBlocks(*buffer, bus));
+        TEST_ASSERT_TRUE(bus.received == stream->data());
+        TEST_ASSERT_EQUAL(1, bus.eoi_count);
+        TEST_ASSERT_TRUE(buffer->eos());
+        buffer->stopPrefetch();
+    }
+}
+
+void test_block_buffer_prefetch_only_when_it_helps(void)
+{
+    // Not owned by a shared_ptr, the task would have nothing to hold on to
+    auto stream = std::make_shared<MemoryStream>(1024);
+    MBlockBuffer local(stream);
+    TEST_ASSERT_FALSE(local.startPrefetch());
+
+    // A source that never stalls is read inline
+    stream->blocking = false;
+    auto buffer = std::make_shared<MBlockBuffer>(stream);
+    TEST_ASSERT_FALSE(buffer->startPrefetch());
+
+    MockBus bus;
+    TEST_ASSERT_TRUE(sendBlocks(*buffer, bus));
+    TEST_ASSERT_TRUE(bus.received == stream->data());
+}
+
+void test_block_buffer_stop_does_not_wait(void)
+{
+    auto stream = std::make_shared<MemoryStream>(64 * 1024);
+    auto buffer = std::make_shared<MBlockBuffer>(stream, BLOCK_BUFFER_BLOCK_SIZE, BLOCK_BUFFER_PREFETCH_BLOCKS);
+    std::weak_ptr<MBlockBuffer> held = buffer;
+
+    // The task gets stuck in a read, like a stalled network
+    stream->hold = true;
+    TEST_ASSERT_TRUE(buffer->startPrefetch());
+    while (!stream->reading)
+        usleep(100);
+
+    // The channel is closed, nothing waits on the read
+    auto start = std::chrono::steady_clock::now();
+    buffer->stopPrefetch();
+    TEST_ASSERT_TRUE(buffer->busy());
+    buffer->closeSource();
+    buffer.reset();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_TRUE(elapsed < 0.01);
+
+    // The task still holds the buffer and closes the stream once the read returns
+    TEST_ASSERT_FALSE(held.expired());
+    TEST_ASSERT_FALSE(stream->closed);
+
+    stream->hold = false;
+    for (int i = 0; i < 1000 && !held.expired(); i++)
+        usleep(1000);
+    TEST_ASSERT_TRUE(held.expired());
+    TEST_ASSERT_TRUE(stream->closed);
+}
+
+void test_block_buffer_close_when_idle(void)
+{
+    auto stream = std::make_shared<MemoryStream>(100);
+    auto buffer = std::make_shared<MBlockBuffer>(stream);
+    TEST_ASSERT_TRUE(buffer->startPrefetch());
+
+    // Short source, the task is done with it right away
+    for (int i = 0; i < 1000 && buffer->busy(); i++)
+        usleep(1000);
+    TEST_ASSERT_FALSE(buffer->busy());
+
+    buffer->stopPrefetch();
+    buffer->closeSource();
+    TEST_ASSERT_TRUE(stream->closed);
+}
+
+void test_block_buffer_benchmark(void)
+{
+    const size_t size = 4 * 1024 * 1024;
+    const size_t block_size = 256;
+
+    auto stream = std::make_shared<MemoryStream>(size);
+    MockBus byte_bus;
+    auto start = std::chrono::steady_clock::now();
+    sendBytes(*stream, byte_bus);
+    auto byte_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    stream->seek(0);
+    MBlockBuffer buffer(stream, block_size);
+    MockBus block_bus;
+    start = std::chrono::steady_clock::now();
+    sendBlocks(buffer, block_bus);
+    auto block_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("per byte : %10.0f bytes/sec\r\n", size / byte_time);
+    printf("per block: %10.0f bytes/sec (%d byte blocks)\r\n", size / block_time, (int)block_size);
+
+    TEST_ASSERT_TRUE(block_bus.received == byte_bus.received);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_block_buffer_sends_whole_stream);
+    RUN_TEST(test_block_buffer_resumes_after_atn);
+    RUN_TEST(test_block_buffer_prefetch);
+    RUN_TEST(test_block_buffer_no_data_yet);
+    RUN_TEST(test_block_buffer_prefetch_only_when_it_helps);
+    RUN_TEST(test_block_buffer_stop_does_not_wait);
+    RUN_TEST(test_block_buffer_close_when_idle);
+    RUN_TEST(test_block_buffer_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
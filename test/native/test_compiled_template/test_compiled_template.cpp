@@ -0,0 +1,216 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "../lib/www/compiled_template.cpp"
+
+static const char *tags[] = { "DEVICE_HOSTNAME", "DEVICE_VERSION", "DEVICE_IPADDRESS", "DEVICE_UPTIME" };
+
+static int lookup(const std::string &tag)
+{
+    for (int i = 0; i < (int)(sizeof(tags) / sizeof(tags[0])); i++)
+        if (tag == tags[i])
+            return i;
+    return TEMPLATE_TAG_UNKNOWN;
+}
+
+static std::string substitute(int tag)
+{
+    static const char *values[] = { "meatloaf", "1.2.3", "192.168.1.64", "86400" };
+    return values[tag];
+}
+
+// parse_contents() and substitute_tag() as they were, what the compiled template must match
+static std::string parse_contents(const std::string &contents)
+{
+    std::stringstream ss;
+    size_t pos = 0, x, y;
+    do
+    {
+        x = contents.find("{{", pos);
+        if (x == std::string::npos)
+        {
+            ss << contents.substr(pos);
+            break;
+        }
+        y = contents.find("}}", x + 2);
+        if (y == std::string::npos)
+        {
+            ss << contents.substr(pos);
+            break;
+        }
+        if (x > 0)
+            ss << contents.substr(pos, x - pos);
+        std::string tag = contents.substr(x + 2, y - x - 2);
+        int id = lookup(tag);
+        ss << ((id == TEMPLATE_TAG_UNKNOWN) ? tag : substitute(id));
+        pos = y + 2;
+    } while (true);
+
+    return ss.str();
+}
+
+static FILE *file_with(const std::string &contents)
+{
+    FILE *file = tmpfile();
+    fwrite(contents.data(), 1, contents.size(), file);
+    return file;
+}
+
+static std::string render(CompiledTemplate &compiled, FILE *file, size_t buffer_size, int *sends = nullptr)
+{
+    std::string out;
+    std::vector<char> buffer(buffer_size);
+    if (sends)
+        *sends = 0;
+    TEST_ASSERT_TRUE(compiled.render(file, substitute, [&](const char *data, size_t length) {
+        out.append(data, length);
+        if (sends)
+            (*sends)++;
+        return true;
+    }, buffer.data(), buffer.size()));
+    return out;
+}
+
+static std::string config_page()
+{
+    std::string page = "<html><head><title>{{DEVICE_HOSTNAME}}</title></head>\n<body>\n";
+    for (int i = 0; i < 120; i++)
+    {
+        page += "<tr><td class=\"label\">Setting " + std::to_string(i) + "</td><td>{{";
+        page += tags[i % 4];
+        page += "}}</td><td>{{NOT_A_TAG}}</td></tr>\n";
+    }
+    page += "</body></html>\n";
+    return page;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_compiled_template_matches(void)
+{
+    const char *pages[] = {
+        "",
+        "no tags at all",
+        "{{DEVICE_HOSTNAME}}",
+        "host {{DEVICE_HOSTNAME}} ip {{DEVICE_IPADDRESS}}.",
+        "{{DEVICE_VERSION}}{{DEVICE_UPTIME}}",
+        "unknown {{SOMETHING}} and empty {{}} tags",
+        "open {{ without close",
+        "a {{DEVICE_HOSTNAME}} then {{ unterminated",
+        "braces { } {x} }} {",
+        "triple {{{DEVICE_HOSTNAME}}} braces",
+        "split {{DEVICE_HOST}NAME}} close",
+        "last brace {",
+        "last tag {{DEVICE_UPTIME}}",
+        "function() { if (a) {{ return b; }} }",
+    };
+
+    for (auto page : pages)
+    {
+        FILE *file = file_with(page);
+        CompiledTemplate compiled;
+        TEST_ASSERT_TRUE(compiled.compile(file, lookup));
+
+        for (size_t buffer_size : { 1, 3, 512 })
+            TEST_ASSERT_EQUAL_STRING(parse_contents(page).c_str(), render(compiled, file, buffer_size).c_str());
+        fclose(file);
+    }
+
+    // Tags longer than any we know, and ones spanning the compile buffer
+    std::string page = "x{{" + std::string(300, 'A') + "}}y" + std::string(250, '.') + "{{DEVICE_VERSION}}z";
+    FILE *file = file_with(page);
+    CompiledTemplate compiled;
+    TEST_ASSERT_TRUE(compiled.compile(file, lookup));
+    TEST_ASSERT_EQUAL_STRING(parse_contents(page).c_str(), render(compiled, file, 64).c_str());
+    fclose(file);
+}
+
+void test_compiled_template_cache(void)
+{
+    std::string page = config_page();
+    FILE *file = file_with(page);
+
+    CompiledTemplateCache cache;
+    auto first = cache.get("/.www/index.html", file, 100, page.size(), lookup);
+    TEST_ASSERT_NOT_NULL(first.get());
+    TEST_ASSERT_EQUAL_PTR(first.get(), cache.get("/.www/index.html", file, 100, page.size(), lookup).get());
+    TEST_ASSERT_EQUAL(1, cache.compiles());
+
+    // Changed on flash
+    auto second = cache.get("/.www/index.html", file, 101, page.size(), lookup);
+    TEST_ASSERT_TRUE(first.get() != second.get());
+    TEST_ASSERT_EQUAL(2, cache.compiles());
+
+    // Oldest goes once there are more pages than entries
+    for (int i = 0; i < TEMPLATE_CACHE_ENTRIES; i++)
+        cache.get("/.www/page" + std::to_string(i) + ".html", file, 100, page.size(), lookup);
+    cache.get("/.www/index.html", file, 101, page.size(), lookup);
+    TEST_ASSERT_EQUAL(3 + TEMPLATE_CACHE_ENTRIES, cache.compiles());
+
+    TEST_ASSERT_EQUAL_STRING(parse_contents(page).c_str(), render(*second, file, 512).c_str());
+    fclose(file);
+}
+
+void test_compiled_template_benchmark(void)
+{
+    const int rounds = 500;
+    std::string page = config_page();
+    FILE *file = file_with(page);
+    size_t bytes = 0;
+
+    // Old path: whole file into memory, then parsed into a second copy
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        fseek(file, 0, SEEK_SET);
+        char *buf = (char *)calloc(page.size() + 1, 1);
+        fread(buf, 1, page.size(), file);
+        std::string contents(buf);
+        free(buf);
+        bytes += parse_contents(contents).size();
+    }
+    auto parse_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    CompiledTemplateCache cache;
+    int sends = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        auto compiled = cache.get("/.www/index.html", file, 100, page.size(), lookup);
+        bytes += render(*compiled, file, 512, &sends).size();
+    }
+    auto compiled_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%d byte page, %d ops: parse %8.0f/sec  compiled %8.0f/sec, %d chunks, heap ~%d vs 512 bytes (%d)\r\n",
+        (int)page.size(), (int)cache.get("/.www/index.html", file, 100, page.size(), lookup)->ops(),
+        rounds / parse_time, rounds / compiled_time, sends, (int)(page.size() * 3), (int)bytes);
+    TEST_ASSERT_EQUAL(1, cache.compiles());
+    fclose(file);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_compiled_template_matches);
+    RUN_TEST(test_compiled_template_cache);
+    RUN_TEST(test_compiled_template_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
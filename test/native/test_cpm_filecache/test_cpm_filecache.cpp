@@ -0,0 +1,293 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../lib/runcpm/globals.h"
+#include "../lib/runcpm/filecache.h"
+
+// Files are opened the way abstraction_posix.h does, counting the opens
+static int opens = 0;
+
+FILE* _fc_fopen(uint8* filename, const char* mode)
+{
+    opens++;
+    return fopen((const char*)filename, mode);
+}
+
+// Record I/O as abstraction_posix.h did it before the cache, one open per record
+static int uncached_read(uint8 *filename, long fpos, uint8 *buffer)
+{
+    int bytesread = -1;
+
+    opens++;
+    FILE* file = fopen((const char*)filename, "rb");
+    if (file != NULL) {
+        bytesread = 0;
+        if (!fseek(file, fpos, 0)) {
+            memset(buffer, 0x1a, BlkSZ);
+            bytesread = fread(buffer, 1, BlkSZ, file);
+        }
+        fclose(file);
+    }
+    return bytesread;
+}
+
+static int uncached_write(uint8 *filename, long fpos, uint8 *buffer)
+{
+    int result = -1;
+
+    opens++;
+    FILE* file = fopen((const char*)filename, "r+b");
+    if (file == NULL)
+    {
+        // _MakeFile creates them first
+        file = fopen((const char*)filename, "a");
+        fclose(file);
+        file = fopen((const char*)filename, "r+b");
+    }
+    if (file != NULL) {
+        result = 0;
+        if (!fseek(file, fpos, 0))
+            result = fwrite(buffer, 1, BlkSZ, file) == BlkSZ;
+        fclose(file);
+    }
+    return result;
+}
+
+static std::string workdir;
+
+static void make_file(const char *name, size_t size, uint32_t seed)
+{
+    FILE *f = fopen(name, "wb");
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        fputc((seed >> 16) & 0x7f, f);
+    }
+    fclose(f);
+}
+
+static std::string contents(const char *name)
+{
+    std::string data;
+    FILE *f = fopen(name, "rb");
+    if (f == NULL)
+        return data;
+    int c;
+    while ((c = fgetc(f)) != EOF)
+        data += (char)c;
+    fclose(f);
+    return data;
+}
+
+static long host_size(const char *name)
+{
+    struct stat st;
+    return stat(name, &st) ? -1 : st.st_size;
+}
+
+void setUp(void)
+{
+    char path[] = "/tmp/cpmcacheXXXXXX";
+    workdir = mkdtemp(path);
+    TEST_ASSERT_EQUAL(0, chdir(workdir.c_str()));
+    mkdir("A", 0755);
+    mkdir("A/0", 0755);
+    opens = 0;
+}
+
+void tearDown(void)
+{
+    _fc_closeall();
+    TEST_ASSERT_EQUAL(0, chdir("/tmp"));
+    std::string command = "rm -rf " + workdir;
+    TEST_ASSERT_EQUAL(0, system(command.c_str()));
+}
+
+void test_filecache_read(void)
+{
+    make_file("A/0/TEXT.TXT", 5000, 1);
+    std::string text = contents("A/0/TEXT.TXT");
+    uint8 record[BlkSZ];
+
+    long fpos = 0;
+    int count;
+    while ((count = _fc_read((uint8 *)"A/0/TEXT.TXT", fpos, record)) > 0)
+    {
+        TEST_ASSERT_EQUAL_MEMORY(text.data() + fpos, record, count);
+        fpos += BlkSZ;
+    }
+
+    // The last record is filled up with ^Z
+    TEST_ASSERT_EQUAL(40 * BlkSZ, fpos);
+    _fc_read((uint8 *)"A/0/TEXT.TXT", 39 * BlkSZ, record);
+    TEST_ASSERT_EQUAL(0x1a, record[5000 - 39 * BlkSZ]);
+    TEST_ASSERT_EQUAL(0x1a, record[BlkSZ - 1]);
+
+    // Random reads back and forth, all from the one open
+    TEST_ASSERT_EQUAL(BlkSZ, _fc_read((uint8 *)"A/0/TEXT.TXT", 3 * BlkSZ, record));
+    TEST_ASSERT_EQUAL_MEMORY(text.data() + 3 * BlkSZ, record, BlkSZ);
+    TEST_ASSERT_EQUAL(1, opens);
+
+    TEST_ASSERT_EQUAL(-1, _fc_read((uint8 *)"A/0/NONE.TXT", 0, record));
+}
+
+void test_filecache_write(void)
+{
+    uint8 record[BlkSZ];
+    uint8 back[BlkSZ];
+
+    for (int i = 0; i < 10; i++)
+    {
+        memset(record, 'A' + i, BlkSZ);
+        TEST_ASSERT_EQUAL(TRUE, _fc_write((uint8 *)"A/0/OUT.REL", i * BlkSZ, record));
+    }
+
+    // Held back, but read back and sized with what was written
+    TEST_ASSERT_EQUAL(0, host_size("A/0/OUT.REL"));
+    TEST_ASSERT_EQUAL(BlkSZ, _fc_read((uint8 *)"A/0/OUT.REL", 4 * BlkSZ, back));
+    TEST_ASSERT_EQUAL('E', back[0]);
+    TEST_ASSERT_EQUAL(10 * BlkSZ, _fc_size((uint8 *)"A/0/OUT.REL"));
+
+    // Rewriting a record in the middle, then one past a gap
+    memset(record, 'z', BlkSZ);
+    _fc_write((uint8 *)"A/0/OUT.REL", 2 * BlkSZ, record);
+    _fc_write((uint8 *)"A/0/OUT.REL", 12 * BlkSZ, record);
+    TEST_ASSERT_EQUAL(TRUE, _fc_close((uint8 *)"A/0/OUT.REL"));
+
+    std::string out = contents("A/0/OUT.REL");
+    TEST_ASSERT_EQUAL(13 * BlkSZ, out.size());
+    TEST_ASSERT_EQUAL('B', out[1 * BlkSZ]);
+    TEST_ASSERT_EQUAL('z', out[2 * BlkSZ]);
+    TEST_ASSERT_EQUAL('J', out[9 * BlkSZ + BlkSZ - 1]);
+    TEST_ASSERT_EQUAL(0, out[10 * BlkSZ]);
+    TEST_ASSERT_EQUAL('z', out[12 * BlkSZ]);
+}
+
+void test_filecache_handles(void)
+{
+    uint8 record[BlkSZ];
+    char name[FC_NAMESZ];
+
+    // More files than handles, the least recently used ones are written out and closed
+    for (int i = 0; i < FC_HANDLES + 2; i++)
+    {
+        snprintf(name, sizeof(name), "A/0/F%d.TXT", i);
+        memset(record, '0' + i, BlkSZ);
+        TEST_ASSERT_EQUAL(TRUE, _fc_write((uint8 *)name, 0, record));
+    }
+    TEST_ASSERT_EQUAL(BlkSZ, host_size("A/0/F0.TXT"));
+    TEST_ASSERT_EQUAL(BlkSZ, host_size("A/0/F1.TXT"));
+    TEST_ASSERT_EQUAL(0, host_size("A/0/F2.TXT"));
+
+    _fc_closeall();
+    for (int i = 0; i < FC_HANDLES + 2; i++)
+    {
+        snprintf(name, sizeof(name), "A/0/F%d.TXT", i);
+        TEST_ASSERT_EQUAL('0' + i, contents(name)[0]);
+    }
+}
+
+// A program assembling many sources: each one read through, looking up
+// symbols in a library now and then, writing object and listing records.
+// Returns the microseconds it took.
+template <typename R, typename W, typename C>
+static long compile(const char *prefix, R read, W write, C close)
+{
+    uint8 record[BlkSZ];
+    uint8 out[BlkSZ];
+    char source[FC_NAMESZ];
+    char object[FC_NAMESZ];
+    char listing[FC_NAMESZ];
+    long opos = 0;
+    long lpos = 0;
+
+    snprintf(object, sizeof(object), "A/0/%sOUT.REL", prefix);
+    snprintf(listing, sizeof(listing), "A/0/%sOUT.PRN", prefix);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int file = 0; file < 24; file++)
+    {
+        snprintf(source, sizeof(source), "A/0/SRC%02d.MAC", file);
+        uint32_t symbol = file;
+        for (long fpos = 0; read((uint8 *)source, fpos, record) > 0; fpos += BlkSZ)
+        {
+            memcpy(out, record, BlkSZ);
+            if ((fpos / BlkSZ) % 8 == 7)
+            {
+                symbol = symbol * 2654435761u + record[0];
+                uint8 lib[BlkSZ];
+                read((uint8 *)"A/0/SYSLIB.REL", (symbol % 512) * BlkSZ, lib);
+                out[0] ^= lib[1];
+            }
+
+            write((uint8 *)listing, lpos, out);
+            lpos += BlkSZ;
+            if ((fpos / BlkSZ) % 2)
+            {
+                write((uint8 *)object, opos, out);
+                opos += BlkSZ;
+            }
+        }
+        close((uint8 *)source);
+    }
+    close((uint8 *)object);
+    close((uint8 *)listing);
+    close((uint8 *)"A/0/SYSLIB.REL");
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void test_filecache_benchmark(void)
+{
+    for (int file = 0; file < 24; file++)
+    {
+        char source[FC_NAMESZ];
+        snprintf(source, sizeof(source), "A/0/SRC%02d.MAC", file);
+        make_file(source, 6000 + file * 1000, file);
+    }
+    make_file("A/0/SYSLIB.REL", 512 * BlkSZ, 99);
+
+    opens = 0;
+    long uncached = compile("U", uncached_read, uncached_write, [](uint8 *) { return TRUE; });
+    int uncached_opens = opens;
+
+    opens = 0;
+    long cached = compile("C", _fc_read, _fc_write, _fc_close);
+    int cached_opens = opens;
+
+    // Same output either way
+    TEST_ASSERT_TRUE(contents("A/0/UOUT.REL") == contents("A/0/COUT.REL"));
+    TEST_ASSERT_TRUE(contents("A/0/UOUT.PRN") == contents("A/0/COUT.PRN"));
+    TEST_ASSERT_TRUE(contents("A/0/COUT.PRN").size() > 400 * 1024);
+
+    // Each source once, the library and outputs once or twice
+    TEST_ASSERT_TRUE(cached_opens < 24 + 8);
+
+    printf("uncached %ld us, %d opens\n", uncached, uncached_opens);
+    printf("cached   %ld us, %d opens, %.1fx\n", cached, cached_opens, (double)uncached / (cached ? cached : 1));
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_filecache_read);
+    RUN_TEST(test_filecache_write);
+    RUN_TEST(test_filecache_handles);
+    RUN_TEST(test_filecache_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
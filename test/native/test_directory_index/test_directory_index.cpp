@@ -0,0 +1,336 @@
+// The directory index a D64 stream builds on its first listing, so later
+// listings and lookups by name are answered without reading the image again
+
+#include "unity.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "../lib/utils/string_utils.cpp"
+#include "../lib/utils/U8Char.cpp"
+#include "../lib/utils/peoples_url_parser.cpp"
+
+#include "../lib/meatloaf/meatloaf.cpp"
+#include "../lib/meatloaf/meat_media.cpp"
+#include "../lib/meatloaf/meat_resolver.cpp"
+#include "../lib/meatloaf/device/flash.cpp"
+#include "../lib/meatloaf/disk/d64.cpp"
+#include "../lib/meatloaf/disk/dnp.h"
+#include "../lib/meatloaf/file/p00.cpp"
+#include "../lib/meatloaf/tape/t64.cpp"
+#include "../lib/meatloaf/tape/tcrt.cpp"
+#include "../lib/meatloaf/archive/lbr.cpp"
+
+#include "../lib/utils/punycode.cpp"
+#undef min // punycode.cpp's own, would get in the way of std::min
+
+#define MEDIA_DIR "/tmp/meatloaf_index"
+#define FILE_COUNT 11   // two directory sectors
+
+// An image in memory, counting how much of it is read
+class MemoryMStream: public MStream {
+public:
+    MemoryMStream(std::vector<uint8_t> data) : data(data) {
+        _size = data.size();
+    }
+
+    bool isOpen() override { return true; };
+    bool open() override { return true; };
+    void close() override {};
+
+    uint32_t read(uint8_t* buf, uint32_t size) override {
+        uint32_t length = std::min<uint32_t>(size, _size - _position);
+        memcpy(buf, data.data() + _position, length);
+        _position += length;
+        bytes_read += length;
+        return length;
+    }
+    uint32_t write(const uint8_t *buf, uint32_t size) override {
+        uint32_t length = std::min<uint32_t>(size, _size - _position);
+        memcpy(data.data() + _position, buf, length);
+        _position += length;
+        return length;
+    }
+    bool seek(uint32_t pos) override {
+        _position = pos;
+        return pos <= _size;
+    }
+
+    std::vector<uint8_t> data;
+    uint32_t bytes_read = 0;
+};
+
+// The index is only kept for the image's own use
+class IndexedD64MStream: public D64MStream {
+public:
+    using D64MStream::D64MStream;
+    using D64MStream::resetEntryCounter;
+    MMediaIndex &index() { return directory_index; }
+
+    // Name of the current entry, as it is in the directory sector
+    std::string entryFilename() {
+        std::string name(entry.filename, sizeof(entry.filename));
+        return name.substr(0, name.find('\xA0'));
+    }
+};
+
+static std::string fileName(int n)
+{
+    return "FILE" + std::to_string(n);
+}
+
+// A D64 with FILE_COUNT files of n + 1 blocks, every block free in the BAM
+static std::vector<uint8_t> makeD64()
+{
+    const uint32_t dir_block = 357;    // 18/0
+    std::vector<uint8_t> d64(174848, 0);
+
+    uint8_t *header = &d64[dir_block * 256];
+    header[0] = 18;
+    header[1] = 1;
+    header[2] = 0x41;
+    for (uint8_t t = 1; t <= 35; t++)
+    {
+        uint8_t sectors = (t < 18) ? 21 : (t < 25) ? 19 : (t < 31) ? 18 : 17;
+        uint8_t *bam = header + 4 * t;
+        bam[0] = sectors;
+        bam[1] = bam[2] = 0xFF;
+        bam[3] = (1 << (sectors - 16)) - 1;
+    }
+    memset(header + 0x90, 0xA0, 27);
+    memcpy(header + 0x90, "INDEXED", 7);
+    memcpy(header + 0xA2, "ML", 2);
+
+    // Files are laid out a block after another from 1/0 on, tracks 1-17
+    // have 21 sectors each
+    uint32_t block = 0;
+    for (int n = 0; n < FILE_COUNT; n++)
+    {
+        uint8_t *entry = &d64[(dir_block + 1 + n / 8) * 256 + (n % 8) * 32];
+        if (n % 8 == 0)
+        {
+            bool more = (n / 8 + 1 < (FILE_COUNT + 7) / 8);
+            entry[0] = more ? 18 : 0;
+            entry[1] = more ? 1 + n / 8 + 1 : 0xFF;
+        }
+        entry[2] = 0x82;
+        entry[3] = 1 + block / 21;
+        entry[4] = block % 21;
+        memset(entry + 5, 0xA0, 16);
+        memcpy(entry + 5, fileName(n).c_str(), fileName(n).size());
+        entry[30] = n + 1;
+
+        for (int b = 0; b <= n; b++, block++)
+        {
+            uint8_t *data = &d64[block * 256];
+            data[0] = (b < n) ? 1 + (block + 1) / 21 : 0;
+            data[1] = (b < n) ? (block + 1) % 21 : 101;
+        }
+    }
+    return d64;
+}
+
+static std::shared_ptr<MemoryMStream> container;
+static std::shared_ptr<IndexedD64MStream> image;
+
+// Walks the directory the way a listing does, skipping the empty entries
+static std::vector<std::string> list(IndexedD64MStream *stream)
+{
+    std::vector<std::string> names;
+    stream->resetEntryCounter();
+    while (stream->seekNextImageEntry())
+    {
+        if (stream->entry.file_type & 0b00000111)
+            names.push_back(stream->entryFilename());
+    }
+    return names;
+}
+
+void setUp(void)
+{
+    container = std::make_shared<MemoryMStream>(makeD64());
+    image = std::make_shared<IndexedD64MStream>(container);
+}
+
+void tearDown(void)
+{
+    image.reset();
+    container.reset();
+}
+
+// The first pass reads every directory sector, the next ones nothing at all
+void test_index_listing(void)
+{
+    TEST_ASSERT_EQUAL(0, image->index().count());
+    TEST_ASSERT_FALSE(image->index().complete);
+
+    auto names = list(image.get());
+    TEST_ASSERT_EQUAL(FILE_COUNT, names.size());
+    TEST_ASSERT_TRUE(image->index().complete);
+
+    // Every slot of both sectors, the empty ones too
+    TEST_ASSERT_EQUAL(16, image->index().count());
+    uint32_t block = 0;
+    for (int n = 0; n < FILE_COUNT; n++)
+    {
+        TEST_ASSERT_EQUAL_STRING(fileName(n).c_str(), names[n].c_str());
+        TEST_ASSERT_EQUAL_STRING(("file" + std::to_string(n)).c_str(), image->index().names[n].c_str());
+        TEST_ASSERT_EQUAL(1 + block / 21, image->index().files[n].start_track);
+        TEST_ASSERT_EQUAL(block % 21, image->index().files[n].start_sector);
+        TEST_ASSERT_EQUAL(0, image->index().files[n].size);
+        block += n + 1;
+    }
+    TEST_ASSERT_EQUAL_STRING("", image->index().names[FILE_COUNT].c_str());
+
+    uint32_t read = container->bytes_read;
+    TEST_ASSERT_TRUE(list(image.get()) == names);
+    TEST_ASSERT_EQUAL(read, container->bytes_read);
+}
+
+// Header and blocks free are read once, an allocation counts them again
+void test_index_header_blocks_free(void)
+{
+    image->seekHeader();
+    uint16_t free = image->blocksFree();
+    TEST_ASSERT_EQUAL(664, free);
+    TEST_ASSERT_EQUAL_MEMORY("INDEXED", image->header.disk_name, 7);
+
+    uint32_t read = container->bytes_read;
+    memset(&image->header, 0, sizeof(image->header));
+    image->seekHeader();
+    TEST_ASSERT_EQUAL_MEMORY("INDEXED", image->header.disk_name, 7);
+    TEST_ASSERT_EQUAL(free, image->blocksFree());
+    TEST_ASSERT_EQUAL(read, container->bytes_read);
+
+    TEST_ASSERT_TRUE(image->blockAllocate(35, 0));
+    TEST_ASSERT_EQUAL(free - 1, image->blocksFree());
+}
+
+// A name seen on the way is found without walking the directory again, the
+// size of a file is worked out the first time it is opened only
+void test_index_seek_by_name(void)
+{
+    // Only part of the directory has been seen so far
+    TEST_ASSERT_TRUE(image->seekPath("file2"));
+    TEST_ASSERT_FALSE(image->index().complete);
+    TEST_ASSERT_EQUAL(3, image->index().count());
+    TEST_ASSERT_EQUAL(3 * 254 - 154, image->size());
+
+    TEST_ASSERT_FALSE(image->seekPath("nothing"));
+    TEST_ASSERT_TRUE(image->index().complete);
+
+    TEST_ASSERT_TRUE(image->seekPath("file9"));
+    TEST_ASSERT_EQUAL(10 * 254 - 154, image->size());
+    TEST_ASSERT_EQUAL(10 * 254 - 154, image->index().files[9].size);
+
+    uint32_t read = container->bytes_read;
+    TEST_ASSERT_TRUE(image->seekPath("file9"));
+    TEST_ASSERT_EQUAL(10 * 254 - 154, image->size());
+    TEST_ASSERT_TRUE(image->seekPath("file2"));
+    TEST_ASSERT_EQUAL(3 * 254 - 154, image->size());
+    TEST_ASSERT_FALSE(image->seekPath("nothing"));
+    TEST_ASSERT_EQUAL(read, container->bytes_read);
+
+    // Wildcards go through the entries in order, from memory too
+    TEST_ASSERT_TRUE(image->seekPath("file?0"));
+    TEST_ASSERT_EQUAL_STRING("FILE10", image->entryFilename().c_str());
+    TEST_ASSERT_EQUAL(11 * 254 - 154, image->size());
+
+    read = container->bytes_read;
+    TEST_ASSERT_TRUE(image->seekPath("file?0"));
+    TEST_ASSERT_EQUAL_STRING("FILE10", image->entryFilename().c_str());
+    TEST_ASSERT_EQUAL(read, container->bytes_read);
+
+    // And the file is read from where the index says it starts
+    uint8_t buf[254];
+    TEST_ASSERT_EQUAL(sizeof(buf), image->read(buf, sizeof(buf)));
+}
+
+// Writing a sector drops the index, the next listing sees the change
+void test_index_cleared_on_write(void)
+{
+    list(image.get());
+    image->seekHeader();
+    image->blocksFree();
+    TEST_ASSERT_TRUE(image->index().complete);
+
+    TEST_ASSERT_TRUE(image->seekPath("#"));
+    TEST_ASSERT_TRUE(image->blockRead(18, 1));
+    memcpy(image->direct_buffer.data() + 5, "RENAMED", 7);
+    TEST_ASSERT_TRUE(image->blockWrite(18, 1));
+
+    TEST_ASSERT_FALSE(image->index().complete);
+    TEST_ASSERT_EQUAL(0, image->index().count());
+    TEST_ASSERT_TRUE(image->index().header.empty());
+    TEST_ASSERT_EQUAL(-1, image->index().blocks_free);
+
+    uint32_t read = container->bytes_read;
+    auto names = list(image.get());
+    TEST_ASSERT_GREATER_THAN(read, container->bytes_read);
+    TEST_ASSERT_EQUAL(FILE_COUNT, names.size());
+    TEST_ASSERT_EQUAL_STRING("RENAMED", names[0].c_str());
+    TEST_ASSERT_TRUE(image->index().complete);
+}
+
+// A D64MFile listing uses the index of the image ImageBroker keeps, which
+// invalidate() clears after the image is written some other way
+void test_index_brokered(void)
+{
+    mkdir(MEDIA_DIR, 0755);
+    FILE *f = fopen(MEDIA_DIR "/index.d64", "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite(container->data.data(), 1, container->data.size(), f);
+    fclose(f);
+
+    auto dir = std::unique_ptr<MFile>(MFSOwner::File(MEDIA_DIR "/index.d64"));
+    TEST_ASSERT_NOT_NULL(dir.get());
+    std::string url = dir->streamFile->url;
+    ImageBroker::store(url, image);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        uint32_t read = container->bytes_read;
+        TEST_ASSERT_TRUE(dir->rewindDirectory());
+        TEST_ASSERT_EQUAL(664, dir->media_blocks_free);
+
+        int entries = 0;
+        while (auto entry = std::unique_ptr<MFile>(dir->getNextFileInDir()))
+            entries++;
+        TEST_ASSERT_EQUAL(FILE_COUNT, entries);
+
+        if (pass == 0)
+            TEST_ASSERT_GREATER_THAN(read, container->bytes_read);
+        else
+            TEST_ASSERT_EQUAL(read, container->bytes_read);
+    }
+    TEST_ASSERT_TRUE(image->index().complete);
+
+    ImageBroker::invalidate(url);
+    TEST_ASSERT_FALSE(image->index().complete);
+    TEST_ASSERT_EQUAL(0, image->index().count());
+
+    ImageBroker::dispose(url);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_index_listing);
+    RUN_TEST(test_index_header_blocks_free);
+    RUN_TEST(test_index_seek_by_name);
+    RUN_TEST(test_index_cleared_on_write);
+    RUN_TEST(test_index_brokered);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
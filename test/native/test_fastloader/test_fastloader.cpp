@@ -0,0 +1,133 @@
+#include "unity.h"
+
+#include <string>
+#include <vector>
+
+#include "../lib/device/iec/fastloader.cpp"
+
+// Epyx Fastload cartridge upload as sent over the bus (epyxfastload.h),
+// M-W address, length, code
+static const std::vector<std::vector<uint8_t>> epyx_upload = {
+    { 0x80, 0x01, 0x19, 0xA0, 0x04, 0xA9, 0x04, 0x2C, 0x00, 0x18, 0x30, 0x1D, 0xF0, 0xF9, 0xAD, 0x00,
+      0x18, 0x4A, 0x66, 0x14, 0xA9, 0x04, 0x2C, 0x00, 0x18, 0x30, 0x0E, 0xD0, 0x0D },
+    { 0x99, 0x01, 0x19, 0xF9, 0xAD, 0x00, 0x18, 0x4A, 0x66, 0x14, 0x88, 0xD0, 0xDF, 0xA5, 0x14, 0x60,
+      0x68, 0x68, 0x60, 0x78, 0xA9, 0x08, 0x8D, 0x00, 0x18, 0xA9, 0x01, 0x2C, 0x0D },
+    { 0xB2, 0x01, 0x19, 0x00, 0x18, 0xF0, 0xFB, 0x8D, 0x00, 0x18, 0xA2, 0x00, 0x20, 0x80, 0x01, 0x9D,
+      0x00, 0x05, 0xE8, 0xD0, 0xF7, 0xE8, 0x86, 0x1C, 0x4C, 0x00, 0x05, 0x78, 0x0D },
+};
+
+static void upload(DriveMemory &memory, const std::vector<std::vector<uint8_t>> &packets)
+{
+    for (auto &packet : packets)
+        TEST_ASSERT_TRUE(memory.write(packet[0] | packet[1] << 8, packet.data() + 3, packet[2]));
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_fastloader_epyx(void)
+{
+    DriveMemory memory;
+    upload(memory, epyx_upload);
+    TEST_ASSERT_EQUAL_HEX32(0x5a01, memory.crc());
+    TEST_ASSERT_EQUAL(FL_EPYXCART, memory.detected());
+
+    // The code is in the shadow RAM where it was written
+    std::string code = memory.read(0x0180, 0x19 * 3);
+    TEST_ASSERT_EQUAL(0x19 * 3, code.size());
+    TEST_ASSERT_EQUAL_HEX8(0xA0, (uint8_t)code[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x78, (uint8_t)code[0x19 * 3 - 1]);
+
+    TEST_ASSERT_EQUAL(FL_EPYXCART, memory.execute(0x01a9));
+
+    // Started again, nothing has been uploaded since
+    TEST_ASSERT_EQUAL(FL_NONE, memory.execute(0x01a9));
+    TEST_ASSERT_EQUAL_HEX32(0xFFFF, memory.crc());
+}
+
+void test_fastloader_not_matched(void)
+{
+    DriveMemory memory;
+
+    // Right code, started somewhere it doesn't start
+    upload(memory, epyx_upload);
+    TEST_ASSERT_EQUAL(FL_NONE, memory.execute(0x0500));
+
+    // Part of it, then another command
+    upload(memory, { epyx_upload[0], epyx_upload[1] });
+    memory.command();
+    upload(memory, { epyx_upload[2] });
+    TEST_ASSERT_EQUAL(FL_NONE, memory.detected());
+    TEST_ASSERT_EQUAL(FL_NONE, memory.execute(0x01a9));
+
+    // Device number change and VIA timer writes aren't part of an upload
+    upload(memory, { epyx_upload[0], epyx_upload[1] });
+    const uint8_t device = 0x29;
+    TEST_ASSERT_FALSE(memory.write(119, &device, 1));
+    TEST_ASSERT_FALSE(memory.write(0x1c06, &device, 1));
+    upload(memory, { epyx_upload[2] });
+    TEST_ASSERT_EQUAL(FL_EPYXCART, memory.execute(0x01a9));
+}
+
+void test_fastloader_read(void)
+{
+    DriveMemory memory;
+
+    // ROM checks DreamLoad and ULoad make
+    std::string rom = memory.read(0xfea0, 2);
+    TEST_ASSERT_EQUAL_HEX8(0x0d, (uint8_t)rom[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xed, (uint8_t)rom[1]);
+    rom = memory.read(0xe5c6, 2);
+    TEST_ASSERT_EQUAL_HEX8(0x34, (uint8_t)rom[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xb1, (uint8_t)rom[1]);
+
+    // Writes past the end of RAM are dropped, ROM without a magic value reads 0
+    const uint8_t data[] = { 1, 2, 3, 4 };
+    memory.write(DRIVE_RAM_SIZE - 2, data, 4);
+    std::string ram = memory.read(DRIVE_RAM_SIZE - 2, 4);
+    TEST_ASSERT_EQUAL(1, ram[0]);
+    TEST_ASSERT_EQUAL(2, ram[1]);
+    TEST_ASSERT_EQUAL(0, ram[2]);
+    TEST_ASSERT_EQUAL(0xed, (uint8_t)memory.read(0xfea1, 1)[0]);
+    TEST_ASSERT_EQUAL(0, (uint8_t)memory.read(0xffff, 2)[1]);
+
+    memory.reset();
+    TEST_ASSERT_EQUAL(0, memory.read(DRIVE_RAM_SIZE - 2, 1)[0]);
+}
+
+void test_fastloader_names(void)
+{
+    for (auto &entry : fl_crc_table)
+    {
+        TEST_ASSERT_TRUE(std::string(DriveMemory::name(entry.loader)) != "none");
+
+        // Every loader we can recognise can also be started
+        bool started = false;
+        for (auto &exec : fl_exec_table)
+            started |= (exec.loader == entry.loader);
+        TEST_ASSERT_TRUE(started);
+    }
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_fastloader_epyx);
+    RUN_TEST(test_fastloader_not_matched);
+    RUN_TEST(test_fastloader_read);
+    RUN_TEST(test_fastloader_names);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -0,0 +1,261 @@
+#include "unity.h"
+
+#include <chrono>
+#include <algorithm>
+
+#include "../lib/utils/string_utils.cpp"
+#include "../lib/meatloaf/meat_resolver.cpp"
+
+MFileSystem::MFileSystem(const char* s)
+{
+    symbol = s;
+}
+
+MFileSystem::~MFileSystem() {}
+
+// Stand-ins with the same handles() as the registered filesystems
+class MockFileSystem : public MFileSystem
+{
+    std::vector<std::string> _ext;
+    std::vector<std::string> _schemes;
+
+public:
+    MockFileSystem(const char* symbol, std::vector<std::string> ext, std::vector<std::string> schemes = {})
+        : MFileSystem(symbol), _ext(ext), _schemes(schemes) {};
+
+    bool handles(std::string name) override
+    {
+        if (_ext.empty() && _schemes.empty())
+            return true; // default fs
+
+        for (auto &s : _schemes)
+            if (mstr::equals(name, s, false))
+                return true;
+
+        return byExtension(_ext, name);
+    }
+
+    MFile* getFile(std::string path) override { return nullptr; };
+
+    const char* name() { return symbol; }
+};
+
+class MockPrefixFileSystem : public MockFileSystem
+{
+    std::string _prefix;
+
+public:
+    MockPrefixFileSystem(const char* symbol, std::string prefix)
+        : MockFileSystem(symbol, {}, {prefix}), _prefix(prefix) {};
+
+    bool handles(std::string name) override
+    {
+        return mstr::startsWith(name, _prefix.c_str(), false);
+    }
+};
+
+MockFileSystem flashFS("FlashFS", {});
+MockFileSystem archiveFS("archive", {".7z", ".arc", ".ark", ".bz2", ".gz", ".lha", ".lzh", ".lzx", ".rar", ".tar", ".tgz", ".xar", ".zip"});
+MockFileSystem lbrFS("lbr", {".lbr"});
+MockFileSystem d64FS("d64", {".d64", ".d41"});
+MockFileSystem d71FS("d71", {".d71"});
+MockFileSystem d80FS("d80", {".d80"});
+MockFileSystem d81FS("d81", {".d81"});
+MockFileSystem d82FS("d82", {".d82"});
+MockFileSystem d90FS("d90", {".d90", ".d60"});
+MockFileSystem dnpFS("dnp", {".dnp"});
+MockFileSystem d8bFS("d8b", {".d8b"});
+MockFileSystem dfiFS("dfi", {".dfi"});
+MockFileSystem p00FS("p00", {".p00"});
+MockFileSystem httpFS("http", {}, {"http:", "https:"});
+MockFileSystem tnfsFS("tnfs", {}, {"tnfs:"});
+MockPrefixFileSystem mlFS("meatloaf", "ml:");
+MockFileSystem t64FS("t64", {".t64"});
+MockFileSystem tcrtFS("tcrt", {".tcrt"});
+
+std::vector<MFileSystem*> availableFS {
+    &flashFS,
+    &archiveFS, &lbrFS,
+    &d64FS, &d71FS, &d80FS, &d81FS, &d82FS, &d90FS, &dnpFS,
+    &d8bFS, &dfiFS,
+    &p00FS,
+    &httpFS, &tnfsFS,
+    &mlFS,
+    &t64FS, &tcrtFS
+};
+
+// The old MFSOwner::testScan
+static MFileSystem* testScan(std::vector<std::string>::iterator &begin, std::vector<std::string>::iterator &pathIterator)
+{
+    while (pathIterator != begin) {
+        pathIterator--;
+
+        auto part = *pathIterator;
+        mstr::toLower(part);
+
+        auto foundIter = std::find_if(availableFS.begin() + 1, availableFS.end(), [&part](MFileSystem* fs) {
+            return fs->handles(part);
+        });
+
+        if (foundIter != availableFS.end())
+            return (*foundIter);
+    }
+
+    return *availableFS.begin();
+}
+
+// The old MFSOwner::File split, without creating any files
+static MPathResolution scanPath(const std::string &path)
+{
+    std::vector<std::string> paths = mstr::split(path, '/');
+    auto begin = paths.begin();
+    auto pathIterator = paths.end();
+
+    MPathResolution resolution;
+    resolution.fs = testScan(begin, pathIterator);
+    resolution.boundary = pathIterator - begin;
+    resolution.upperFS = availableFS.front();
+    if (pathIterator != begin)
+        resolution.upperFS = testScan(begin, pathIterator);
+
+    return resolution;
+}
+
+static MPathResolution resolvePath(MPathResolver &resolver, const std::string &path)
+{
+    std::vector<std::string> paths = mstr::split(path, '/');
+    return resolver.resolve(path, paths);
+}
+
+static std::vector<std::string> listing(const std::string &dir, size_t count)
+{
+    std::vector<std::string> entries;
+    for (size_t i = 0; i < count; i++)
+        entries.push_back(dir + "/GAME " + std::to_string(i) + ".PRG");
+    return entries;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_resolver_matches_scan(void)
+{
+    MPathResolver resolver(availableFS, 4);
+
+    std::vector<std::string> paths {
+        "",
+        "/",
+        "/sd",
+        "/games/disk.d64",
+        "/games/disk.d64/FILE",
+        "/games/DISK.D64/FILE.PRG",
+        "/games/collection.zip/disk.d81/FILE",
+        "http://c64.meatloaf.cc/games/collection.zip/disk.d81/FILE",
+        "HTTPS://c64.meatloaf.cc:8080/t/tape.t64/",
+        "tnfs://host/foo.tar.gz/x.p00",
+        "http:foo/bar",
+        "ml:game.d64/FILE",
+        "ml:/search/x",
+        "/a/b.lbr/c.d71/d.d82/e",
+        "/no/extension/here",
+        "/trailing.d90/",
+    };
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (auto &path : paths)
+        {
+            auto expected = scanPath(path);
+            auto resolved = resolvePath(resolver, path);
+
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(((MockFileSystem*)expected.fs)->name(), ((MockFileSystem*)resolved.fs)->name(), path.c_str());
+            TEST_ASSERT_EQUAL_MESSAGE(expected.boundary, resolved.boundary, path.c_str());
+            if (expected.boundary > 0)
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(((MockFileSystem*)expected.upperFS)->name(), ((MockFileSystem*)resolved.upperFS)->name(), path.c_str());
+        }
+    }
+}
+
+void test_resolver_caches_prefix(void)
+{
+    MPathResolver resolver(availableFS);
+
+    auto entries = listing("http://c64.meatloaf.cc/games/collection.zip/disk.d81", 144);
+    for (auto &entry : entries)
+    {
+        auto resolved = resolvePath(resolver, entry);
+        TEST_ASSERT_TRUE(resolved.fs == &d81FS);
+        TEST_ASSERT_TRUE(resolved.upperFS == &archiveFS);
+    }
+
+    // Only the first entry had to work out the prefixes
+    TEST_ASSERT_EQUAL(143, resolver.hits());
+    TEST_ASSERT_EQUAL(6, resolver.misses());
+}
+
+void test_resolver_evicts_oldest(void)
+{
+    MPathResolver resolver(availableFS, 2);
+
+    resolvePath(resolver, "a.d64/FILE");
+    resolvePath(resolver, "b.d64/FILE");
+    resolvePath(resolver, "c.d64/FILE");
+    TEST_ASSERT_EQUAL(0, resolver.hits());
+
+    resolvePath(resolver, "c.d64/FILE");
+    TEST_ASSERT_EQUAL(1, resolver.hits());
+
+    // "a.d64" has been pushed out
+    uint32_t misses = resolver.misses();
+    resolvePath(resolver, "a.d64/FILE");
+    TEST_ASSERT_EQUAL(misses + 1, resolver.misses());
+}
+
+void test_resolver_benchmark(void)
+{
+    const int rounds = 200;
+    auto entries = listing("http://c64.meatloaf.cc/games/collection.zip/disk.d81", 144);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t scanned = 0;
+    for (int i = 0; i < rounds; i++)
+        for (auto &entry : entries)
+            scanned += scanPath(entry).boundary;
+    auto scan_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    MPathResolver resolver(availableFS);
+    start = std::chrono::steady_clock::now();
+    size_t resolved = 0;
+    for (int i = 0; i < rounds; i++)
+        for (auto &entry : entries)
+            resolved += resolvePath(resolver, entry).boundary;
+    auto resolve_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("scan    : %10.0f entries/sec\r\n", rounds * entries.size() / scan_time);
+    printf("resolver: %10.0f entries/sec (hits[%d] misses[%d])\r\n", rounds * entries.size() / resolve_time, resolver.hits(), resolver.misses());
+
+    TEST_ASSERT_EQUAL(scanned, resolved);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_resolver_matches_scan);
+    RUN_TEST(test_resolver_caches_prefix);
+    RUN_TEST(test_resolver_evicts_oldest);
+    RUN_TEST(test_resolver_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
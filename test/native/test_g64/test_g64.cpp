@@ -0,0 +1,311 @@
+#include "unity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../lib/utils/string_utils.cpp"
+#include "../lib/utils/U8Char.cpp"
+#include "../lib/utils/peoples_url_parser.cpp"
+
+#include "../lib/meatloaf/meatloaf.cpp"
+#include "../lib/meatloaf/meat_media.cpp"
+#include "../lib/meatloaf/meat_resolver.cpp"
+#include "../lib/meatloaf/device/flash.cpp"
+#include "../lib/meatloaf/disk/d64.cpp"
+#include "../lib/meatloaf/disk/dnp.h"
+#include "../lib/meatloaf/file/p00.cpp"
+#include "../lib/meatloaf/tape/t64.cpp"
+#include "../lib/meatloaf/tape/tcrt.cpp"
+#include "../lib/meatloaf/archive/lbr.cpp"
+
+#include "../lib/meatloaf/disk/gcr/gcr.cpp"
+#include "../lib/meatloaf/disk/gcr/prot.cpp"
+#include "../lib/meatloaf/disk/g64.cpp"
+
+#include "../lib/utils/punycode.cpp"
+#undef min // punycode.cpp's own, would get in the way of std::min
+
+#define D64_SIZE 174848
+#define SECTOR_GAP 8    // 0x55 bytes after each sector
+
+// An image in memory, counting how much of it is read
+class MemoryMStream: public MStream {
+public:
+    MemoryMStream(std::vector<uint8_t> data) : data(data) {
+        _size = data.size();
+    }
+
+    bool isOpen() override { return true; };
+    bool open() override { return true; };
+    void close() override {};
+
+    uint32_t read(uint8_t* buf, uint32_t size) override {
+        uint32_t length = std::min<uint32_t>(size, _size - _position);
+        memcpy(buf, data.data() + _position, length);
+        _position += length;
+        bytes_read += length;
+        return length;
+    }
+    uint32_t write(const uint8_t *buf, uint32_t size) override { return 0; };
+    bool seek(uint32_t pos) override {
+        _position = pos;
+        return pos <= _size;
+    }
+
+    std::vector<uint8_t> data;
+    uint32_t bytes_read = 0;
+};
+
+static uint8_t disk_id[3] = { 'M', 'L', 0 };
+
+// GCR of one track as a 1541 writes it, started rotate bytes in so sectors wrap around the end
+static std::vector<uint8_t> encodeTrack(const uint8_t *d64_track, uint8_t track, const std::vector<int> &errors, size_t rotate)
+{
+    std::vector<uint8_t> gcr;
+    uint8_t ptr[GCR_BLOCK_LEN];
+
+    for (uint8_t sector = 0; sector < sector_map_1541[track]; sector++)
+    {
+        convert_sector_to_GCR((uint8_t *)d64_track + sector * 256, ptr, track, sector, disk_id, errors[sector], GCR_BLOCK_LEN);
+        gcr.insert(gcr.end(), ptr, ptr + GCR_BLOCK_LEN);
+        gcr.insert(gcr.end(), SECTOR_GAP, 0x55);
+    }
+
+    std::rotate(gcr.begin(), gcr.begin() + rotate, gcr.end());
+    return gcr;
+}
+
+// G64 of a 35 track D64, errors[track] is the error to write for each sector,
+// a track not in it has no data at all
+static std::vector<uint8_t> makeG64(const std::vector<uint8_t> &d64, std::map<uint8_t, std::vector<int>> errors = {}, std::vector<uint8_t> missing = {})
+{
+    const uint8_t half_tracks = 84;
+    std::vector<uint8_t> g64 = { 'G', 'C', 'R', '-', '1', '5', '4', '1', 0, half_tracks,
+                                 G64_TRACK_MAXLEN & 0xff, G64_TRACK_MAXLEN >> 8 };
+    size_t table = g64.size();
+    g64.resize(table + half_tracks * 8, 0);
+
+    uint32_t block = 0;
+    for (uint8_t track = 1; track <= 35; track++)
+    {
+        uint8_t sectors = sector_map_1541[track];
+        std::vector<int> e = errors.count(track) ? errors[track] : std::vector<int>(sectors, SECTOR_OK);
+        auto gcr = encodeTrack(d64.data() + block * 256, track, e, (track * 97) % (sectors * (GCR_BLOCK_LEN + SECTOR_GAP)));
+        block += sectors;
+
+        if (std::find(missing.begin(), missing.end(), track) != missing.end())
+            continue;
+
+        uint32_t offset = g64.size();
+        for (int i = 0; i < 4; i++)
+            g64[table + (track - 1) * 2 * 4 + i] = offset >> (i * 8);
+
+        g64.push_back(gcr.size() & 0xff);
+        g64.push_back(gcr.size() >> 8);
+        g64.insert(g64.end(), gcr.begin(), gcr.end());
+        g64.resize(offset + 2 + G64_TRACK_MAXLEN, 0x55);
+    }
+    return g64;
+}
+
+static std::vector<uint8_t> randomD64()
+{
+    std::mt19937 rng(64);
+    std::vector<uint8_t> d64(D64_SIZE);
+    for (auto &b : d64)
+        b = rng();
+    return d64;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_g64_sectors(void)
+{
+    auto d64 = randomD64();
+    auto memory = std::make_shared<MemoryMStream>(makeG64(d64));
+    G64SectorStream stream(memory);
+
+    TEST_ASSERT_EQUAL(35, stream.end_track);
+    TEST_ASSERT_EQUAL(D64_SIZE, stream.size());
+
+    // Read in odd sized pieces so they cross sectors and tracks
+    std::vector<uint8_t> decoded(D64_SIZE);
+    uint32_t count = 0;
+    while (count < D64_SIZE)
+    {
+        uint32_t r = stream.read(decoded.data() + count, 1000);
+        TEST_ASSERT_TRUE(r > 0);
+        count += r;
+    }
+    TEST_ASSERT_EQUAL(0, stream.read(decoded.data(), 1));
+    TEST_ASSERT_EQUAL_MEMORY(d64.data(), decoded.data(), D64_SIZE);
+
+    for (uint8_t track = 1; track <= 35; track++)
+    {
+        for (uint8_t sector = 0; sector < sector_map_1541[track]; sector++)
+            TEST_ASSERT_EQUAL(SECTOR_OK, stream.sectorError(track, sector));
+    }
+
+    // Seek to 18/1 the way D64MStream does
+    uint8_t buf[256];
+    TEST_ASSERT_TRUE(stream.seek(358 * 256));
+    TEST_ASSERT_EQUAL(256, stream.read(buf, 256));
+    TEST_ASSERT_EQUAL_MEMORY(d64.data() + 358 * 256, buf, 256);
+}
+
+void test_g64_track_cache(void)
+{
+    auto d64 = randomD64();
+    auto memory = std::make_shared<MemoryMStream>(makeG64(d64));
+    G64SectorStream stream(memory);
+    uint8_t buf[256];
+
+    // Every sector of a track after the first comes from the decoded track
+    stream.seek(357 * 256);
+    stream.read(buf, 256);
+    uint32_t decoded = memory->bytes_read;
+    for (int sector = 0; sector < 19; sector++)
+    {
+        stream.seek((357 + sector) * 256);
+        stream.read(buf, 256);
+    }
+    TEST_ASSERT_EQUAL(decoded, memory->bytes_read);
+
+    // Until enough other tracks push it out
+    for (int track = 1; track <= G64_TRACK_CACHE; track++)
+    {
+        stream.seek((track - 1) * 21 * 256);
+        stream.read(buf, 1);
+    }
+    decoded = memory->bytes_read;
+    stream.seek(357 * 256);
+    stream.read(buf, 256);
+    TEST_ASSERT_TRUE(memory->bytes_read > decoded);
+    TEST_ASSERT_EQUAL_MEMORY(d64.data() + 357 * 256, buf, 256);
+}
+
+void test_g64_errors(void)
+{
+    auto d64 = randomD64();
+    std::vector<int> errors(21, SECTOR_OK);
+    errors[3] = BAD_DATA_CHECKSUM;
+    errors[7] = HEADER_NOT_FOUND;
+    errors[9] = DATA_NOT_FOUND;
+    errors[12] = BAD_HEADER_CHECKSUM;
+
+    auto memory = std::make_shared<MemoryMStream>(makeG64(d64, { { 2, errors } }, { 20 }));
+    G64SectorStream stream(memory);
+    uint8_t buf[256];
+    uint8_t zero[256] = { 0 };
+
+    for (uint8_t sector = 0; sector < 21; sector++)
+        TEST_ASSERT_EQUAL_MESSAGE(errors[sector], stream.sectorError(2, sector), std::to_string(sector).c_str());
+
+    // Data with a bad checksum is still there, sectors that weren't found are empty
+    stream.seek((21 + 3) * 256);
+    stream.read(buf, 256);
+    TEST_ASSERT_EQUAL_MEMORY(d64.data() + (21 + 3) * 256, buf, 256);
+    stream.seek((21 + 7) * 256);
+    stream.read(buf, 256);
+    TEST_ASSERT_EQUAL_MEMORY(zero, buf, 256);
+
+    // A track with no data
+    TEST_ASSERT_EQUAL(SYNC_NOT_FOUND, stream.sectorError(20, 0));
+    stream.seek(395 * 256);
+    stream.read(buf, 256);
+    TEST_ASSERT_EQUAL_MEMORY(zero, buf, 256);
+
+    // Not a G64
+    auto other = std::make_shared<MemoryMStream>(d64);
+    G64SectorStream none(other);
+    TEST_ASSERT_EQUAL(0, none.size());
+    TEST_ASSERT_EQUAL(0, none.read(buf, 256));
+}
+
+// Sectors read like a D64, but nothing can be written back to the GCR
+void test_g64_write_protected(void)
+{
+    auto d64 = randomD64();
+    auto memory = std::make_shared<MemoryMStream>(makeG64(d64));
+    G64MStream stream(memory);
+    uint8_t buf[256];
+
+    TEST_ASSERT_TRUE(stream.seekPath("#"));
+    TEST_ASSERT_TRUE(stream.blockRead(18, 1));
+    TEST_ASSERT_EQUAL(256, stream.read(buf, 256));
+    TEST_ASSERT_EQUAL_MEMORY(d64.data() + 358 * 256, buf, 256);
+
+    // U2 reports 26 write protect on, B-A and B-F 31 syntax error
+    TEST_ASSERT_TRUE(stream.isWriteProtected());
+    TEST_ASSERT_FALSE(stream.blockWrite(18, 1));
+    TEST_ASSERT_FALSE(stream.hasBAM());
+    TEST_ASSERT_FALSE(stream.blockAllocate(18, 1));
+    TEST_ASSERT_FALSE(stream.blockFree(18, 1));
+}
+
+void test_g64_benchmark(void)
+{
+    const int rounds = 20;
+    auto d64 = randomD64();
+    std::vector<int> errors(21, SECTOR_OK);
+    auto gcr = encodeTrack(d64.data(), 1, errors, 1000);
+    gcr.resize(gcr.size() + GCR_BLOCK_LEN);
+    size_t length = gcr.size() - GCR_BLOCK_LEN;
+
+    // A sector at a time, searching the track for each
+    std::vector<uint8_t> sector_decoded(21 * 256);
+    uint8_t sector[260];
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        for (int s = 0; s < 21; s++)
+        {
+            TEST_ASSERT_EQUAL(SECTOR_OK, convert_GCR_sector(gcr.data(), gcr.data() + length, sector, 1, s, disk_id));
+            memcpy(sector_decoded.data() + s * 256, sector + 1, 256);
+        }
+    }
+    auto sector_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The whole track in one pass
+    std::vector<uint8_t> track_decoded(21 * 256);
+    uint8_t track_errors[21];
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+        TEST_ASSERT_EQUAL(21, decode_GCR_track(gcr.data(), length, track_decoded.data(), track_errors, 1, 21));
+    auto track_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("track decode: per sector %8.0f/sec  whole track %8.0f/sec\r\n", rounds / sector_time, rounds / track_time);
+
+    TEST_ASSERT_EQUAL_MEMORY(d64.data(), sector_decoded.data(), 21 * 256);
+    TEST_ASSERT_EQUAL_MEMORY(d64.data(), track_decoded.data(), 21 * 256);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_g64_sectors);
+    RUN_TEST(test_g64_track_cache);
+    RUN_TEST(test_g64_errors);
+    RUN_TEST(test_g64_write_protected);
+    RUN_TEST(test_g64_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -0,0 +1,417 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../lib/meatloaf/disk/gcr/gcr.cpp"
+#include "../lib/meatloaf/disk/gcr/prot.cpp"
+
+// The byte and nibble at a time versions the word at a time ones replace
+namespace reference {
+
+int
+find_sync(uint8_t ** gcr_pptr, uint8_t * gcr_end)
+{
+	while (1)
+	{
+		if ((*gcr_pptr) + 1 >= gcr_end)
+		{
+			*gcr_pptr = gcr_end;
+			return 0;	/* not found */
+		}
+
+		// sync flag goes up after the 10th bit
+		if ( ((*gcr_pptr)[0] & 0x03) == 0x03 && (*gcr_pptr)[1] == 0xff)
+			break;
+
+		(*gcr_pptr)++;
+	}
+
+	(*gcr_pptr)++;
+	while (*gcr_pptr < gcr_end && **gcr_pptr == 0xff)
+		(*gcr_pptr)++;
+	return (*gcr_pptr < gcr_end);
+}
+
+void
+convert_4bytes_to_GCR(uint8_t * buffer, uint8_t * ptr)
+{
+	*ptr = GCR_conv_data[(*buffer) >> 4] << 3;
+	*ptr |= GCR_conv_data[(*buffer) & 0x0f] >> 2;
+	ptr++;
+
+	*ptr = GCR_conv_data[(*buffer) & 0x0f] << 6;
+	buffer++;
+	*ptr |= GCR_conv_data[(*buffer) >> 4] << 1;
+	*ptr |= GCR_conv_data[(*buffer) & 0x0f] >> 4;
+	ptr++;
+
+	*ptr = GCR_conv_data[(*buffer) & 0x0f] << 4;
+	buffer++;
+	*ptr |= GCR_conv_data[(*buffer) >> 4] >> 1;
+	ptr++;
+
+	*ptr = GCR_conv_data[(*buffer) >> 4] << 7;
+	*ptr |= GCR_conv_data[(*buffer) & 0x0f] << 2;
+	buffer++;
+	*ptr |= GCR_conv_data[(*buffer) >> 4] >> 3;
+	ptr++;
+
+	*ptr = GCR_conv_data[(*buffer) >> 4] << 5;
+	*ptr |= GCR_conv_data[(*buffer) & 0x0f];
+}
+
+int
+convert_4bytes_from_GCR(uint8_t * gcr, uint8_t * plain)
+{
+	uint8_t hnibble, lnibble;
+	int badGCR, nConverted;
+
+	badGCR = 0;
+
+	hnibble = GCR_decode_high[gcr[0] >> 3];
+	lnibble = GCR_decode_low[((gcr[0] << 2) | (gcr[1] >> 6)) & 0x1f];
+	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
+		badGCR = 1;
+	*plain++ = hnibble | lnibble;
+
+	hnibble = GCR_decode_high[(gcr[1] >> 1) & 0x1f];
+	lnibble = GCR_decode_low[((gcr[1] << 4) | (gcr[2] >> 4)) & 0x1f];
+	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
+		badGCR = 2;
+	*plain++ = hnibble | lnibble;
+
+	hnibble = GCR_decode_high[((gcr[2] << 1) | (gcr[3] >> 7)) & 0x1f];
+	lnibble = GCR_decode_low[(gcr[3] >> 2) & 0x1f];
+	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
+		badGCR = 3;
+	*plain++ = hnibble | lnibble;
+
+	hnibble = GCR_decode_high[((gcr[3] << 3) | (gcr[4] >> 5)) & 0x1f];
+	lnibble = GCR_decode_low[gcr[4] & 0x1f];
+	if ((hnibble == 0xff || lnibble == 0xff) && !badGCR)
+		badGCR = 4;
+	*plain++ = hnibble | lnibble;
+
+	nConverted = (badGCR == 0) ? 4 : (badGCR - 1);
+
+	return (nConverted);
+}
+
+int
+check_formatted(uint8_t * gcrdata)
+{
+	int i, run = 0;
+
+	/* try to find longest good gcr run */
+	for (i = 0; i < NIB_TRACK_LENGTH; i++)
+	{
+		if (is_bad_gcr(gcrdata, NIB_TRACK_LENGTH, i))
+			run = 0;
+		else
+			run++;
+
+		if (run >= GCR_MIN_FORMATTED)
+			return 1;
+
+	}
+	return 0;
+}
+
+int
+check_bad_gcr(uint8_t * gcrdata, int length, int fix)
+{
+	/* state machine definitions */
+	enum ebadgcr { S_BADGCR_OK, S_BADGCR_ONCE_BAD, S_BADGCR_LOST };
+
+	int i, lastpos;
+	enum ebadgcr sbadgcr;
+	int total, b_badgcr, n_badgcr;
+
+	i = 0;
+	total = 0;
+	lastpos = length - 1;
+
+	if (is_bad_gcr(gcrdata, length, length - 1))
+		sbadgcr = S_BADGCR_ONCE_BAD;
+	else
+		sbadgcr = S_BADGCR_OK;
+
+	for (i = 0; i < length - 1; i++)
+	{
+		b_badgcr = is_bad_gcr(gcrdata, length, i);
+		n_badgcr = is_bad_gcr(gcrdata, length, i + 1);
+
+		switch (sbadgcr)
+		{
+		case S_BADGCR_OK:
+			if (b_badgcr)
+			{
+				total++;
+				//sbadgcr = S_BADGCR_ONCE_BAD;
+				sbadgcr = S_BADGCR_LOST;
+			}
+			break;
+
+		case S_BADGCR_ONCE_BAD:
+			if (b_badgcr || n_badgcr)
+			{
+				sbadgcr = S_BADGCR_LOST;
+				//if(fix) fix_first_gcr(gcrdata, length, lastpos);
+				if (fix)
+					gcrdata[lastpos] = 0x00;
+				total++;
+			}
+			else
+				sbadgcr = S_BADGCR_OK;
+			break;
+
+		case S_BADGCR_LOST:
+			if (b_badgcr || n_badgcr)
+			{
+				if (fix)
+					gcrdata[lastpos] = 0x00;
+			}
+			else
+			{
+				sbadgcr = S_BADGCR_OK;
+				//if(fix) fix_last_gcr(gcrdata, length, lastpos);
+				if (fix)
+					gcrdata[lastpos] = 0x00;
+			}
+			total++;
+			break;
+		}
+		lastpos = i;
+	}
+
+	// clean up after last byte; lastpos = length - 1
+	b_badgcr = is_bad_gcr(gcrdata, length, 0);
+	n_badgcr = is_bad_gcr(gcrdata, length, 1);
+	switch (sbadgcr)
+	{
+	case S_BADGCR_OK:
+		break;
+
+	case S_BADGCR_ONCE_BAD:
+		if (b_badgcr || n_badgcr)
+		{
+			//if(fix) fix_first_gcr(gcrdata, length, lastpos);
+			if (fix)
+				gcrdata[lastpos] = 0x00;
+			total++;
+		}
+		break;
+
+	case S_BADGCR_LOST:
+		if (b_badgcr || n_badgcr)
+			gcrdata[lastpos] = 0x00;
+		else
+		{
+			//if(fix) fix_last_gcr(gcrdata, length, lastpos);
+			if (fix)
+				gcrdata[lastpos] = 0x00;
+		}
+		total++;
+		break;
+	}
+	return total;
+}
+
+} // namespace reference
+
+// Random GCR-ish data: mostly good GCR with syncs, gaps and some bad bytes
+static std::vector<uint8_t> randomTrack(uint32_t seed, size_t length)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> track;
+    uint8_t plain[4], gcr[5];
+
+    while (track.size() < length)
+    {
+        switch (rng() % 8)
+        {
+        case 0:
+            track.insert(track.end(), 1 + rng() % 6, 0xff);
+            break;
+        case 1:
+            track.insert(track.end(), 1 + rng() % 10, 0x55);
+            break;
+        case 2:
+            track.push_back(rng() & (rng() | 0x0f));  // likely bad
+            break;
+        default:
+            for (auto &b : plain)
+                b = rng();
+            reference::convert_4bytes_to_GCR(plain, gcr);
+            track.insert(track.end(), gcr, gcr + 5);
+            break;
+        }
+    }
+    track.resize(length);
+    return track;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_gcr_encode_decode(void)
+{
+    std::mt19937 rng(4);
+    uint8_t plain[4], gcr[5], expected_gcr[5], decoded[4], expected[4];
+
+    for (int i = 0; i < 100000; i++)
+    {
+        for (auto &b : plain)
+            b = rng();
+        convert_4bytes_to_GCR(plain, gcr);
+        reference::convert_4bytes_to_GCR(plain, expected_gcr);
+        TEST_ASSERT_EQUAL_MEMORY(expected_gcr, gcr, 5);
+
+        // Any 5 bytes, good GCR or not
+        for (auto &b : gcr)
+            b = rng();
+        TEST_ASSERT_EQUAL(reference::convert_4bytes_from_GCR(gcr, expected), convert_4bytes_from_GCR(gcr, decoded));
+        TEST_ASSERT_EQUAL_MEMORY(expected, decoded, 4);
+    }
+
+    // A whole block, and one bad nibble in it
+    std::vector<uint8_t> data(260), block(325), back(260);
+    for (auto &b : data)
+        b = rng();
+    encode_GCR_block(data.data(), block.data(), 65);
+    TEST_ASSERT_TRUE(decode_GCR_block(block.data(), back.data(), 65));
+    TEST_ASSERT_EQUAL_MEMORY(data.data(), back.data(), 260);
+
+    block[200] = 0x00;
+    TEST_ASSERT_FALSE(decode_GCR_block(block.data(), back.data(), 65));
+}
+
+void test_gcr_find_sync(void)
+{
+    for (uint32_t seed = 0; seed < 50; seed++)
+    {
+        auto track = randomTrack(seed, 2000 + seed);
+        uint8_t *end = track.data() + track.size();
+        uint8_t *p = track.data(), *q = track.data();
+
+        while (true)
+        {
+            int found = find_sync(&p, end);
+            TEST_ASSERT_EQUAL(reference::find_sync(&q, end), found);
+            TEST_ASSERT_EQUAL_PTR(q, p);
+            if (!found)
+                break;
+        }
+    }
+}
+
+void test_gcr_bad_gcr(void)
+{
+    for (uint32_t seed = 0; seed < 50; seed++)
+    {
+        auto track = randomTrack(seed, NIB_TRACK_LENGTH);
+        TEST_ASSERT_EQUAL(reference::check_formatted(track.data()), check_formatted(track.data()));
+
+        for (int fix = 0; fix < 2; fix++)
+        {
+            auto fixed = track, expected = track;
+            TEST_ASSERT_EQUAL(reference::check_bad_gcr(expected.data(), expected.size(), fix), check_bad_gcr(fixed.data(), fixed.size(), fix));
+            TEST_ASSERT_TRUE(expected == fixed);
+        }
+    }
+
+    // Nothing but good GCR and nothing at all
+    std::vector<uint8_t> good(NIB_TRACK_LENGTH, 0x55), none(NIB_TRACK_LENGTH, 0x00);
+    TEST_ASSERT_EQUAL(0, check_bad_gcr(good.data(), good.size(), 0));
+    TEST_ASSERT_EQUAL(1, check_formatted(good.data()));
+    TEST_ASSERT_EQUAL(reference::check_bad_gcr(none.data(), none.size(), 0), check_bad_gcr(none.data(), none.size(), 0));
+    TEST_ASSERT_EQUAL(0, check_formatted(none.data()));
+}
+
+void test_gcr_benchmark(void)
+{
+    const int rounds = 200;
+    const size_t groups = 65 * 21;
+    std::mt19937 rng(1541);
+    std::vector<uint8_t> plain(groups * 4), gcr(groups * 5), decoded(groups * 4);
+    for (auto &b : plain)
+        b = rng();
+
+    auto mbs = [](double seconds, size_t bytes) { return bytes / seconds / (1024 * 1024); };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < groups; i++)
+            reference::convert_4bytes_to_GCR(plain.data() + i * 4, gcr.data() + i * 5);
+    double encode_nibble = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        encode_GCR_block(plain.data(), gcr.data(), groups);
+    double encode_block = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < groups; i++)
+            reference::convert_4bytes_from_GCR(gcr.data() + i * 5, decoded.data() + i * 4);
+    double decode_nibble = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    int good = 0;
+    for (int r = 0; r < rounds; r++)
+        good += decode_GCR_block(gcr.data(), decoded.data(), groups);
+    double decode_block = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_EQUAL(rounds, good);
+    TEST_ASSERT_TRUE(plain == decoded);
+
+    // Sync search over a track of data with a few syncs
+    auto track = randomTrack(7, NIB_TRACK_LENGTH);
+    for (size_t i = 0; i < track.size(); i++)
+        if (track[i] == 0xff && (i % 1000))
+            track[i] = 0x55;
+    uint8_t *end = track.data() + track.size();
+    int syncs = 0, expected_syncs = 0;
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (uint8_t *p = track.data(); reference::find_sync(&p, end);)
+            expected_syncs++;
+    double sync_byte = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (uint8_t *p = track.data(); find_sync(&p, end);)
+            syncs++;
+    double sync_word = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_EQUAL(expected_syncs, syncs);
+
+    printf("encode     : nibble %7.1f MB/s  block %7.1f MB/s\r\n", mbs(encode_nibble, rounds * plain.size()), mbs(encode_block, rounds * plain.size()));
+    printf("decode     : nibble %7.1f MB/s  block %7.1f MB/s\r\n", mbs(decode_nibble, rounds * gcr.size()), mbs(decode_block, rounds * gcr.size()));
+    printf("sync search: byte   %7.1f MB/s  word  %7.1f MB/s\r\n", mbs(sync_byte, rounds * track.size()), mbs(sync_word, rounds * track.size()));
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_gcr_encode_decode);
+    RUN_TEST(test_gcr_find_sync);
+    RUN_TEST(test_gcr_bad_gcr);
+    RUN_TEST(test_gcr_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -0,0 +1,157 @@
+#include "unity.h"
+
+#include <string>
+
+#include "../lib/www/http_cache.cpp"
+
+// Sun, 06 Nov 1994 08:49:37 GMT
+static const time_t rfc_date = 784111777;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_http_date(void)
+{
+    TEST_ASSERT_EQUAL_STRING("Sun, 06 Nov 1994 08:49:37 GMT", http_date(rfc_date).c_str());
+    TEST_ASSERT_EQUAL_STRING("Thu, 01 Jan 1970 00:00:00 GMT", http_date(0).c_str());
+
+    // The three formats RFC 9110 makes recipients accept
+    TEST_ASSERT_EQUAL(rfc_date, http_parse_date("Sun, 06 Nov 1994 08:49:37 GMT"));
+    TEST_ASSERT_EQUAL(rfc_date, http_parse_date("Sunday, 06-Nov-94 08:49:37 GMT"));
+    TEST_ASSERT_EQUAL(rfc_date, http_parse_date("Sun Nov  6 08:49:37 1994"));
+
+    TEST_ASSERT_EQUAL(951782400, http_parse_date("Tue, 29 Feb 2000 00:00:00 GMT"));
+    TEST_ASSERT_EQUAL(-1, http_parse_date("yesterday"));
+    TEST_ASSERT_EQUAL(-1, http_parse_date("Sun, 06 Nox 1994 08:49:37 GMT"));
+
+    for (time_t t : { (time_t)0, rfc_date, (time_t)1700000000, (time_t)2147483647 })
+        TEST_ASSERT_EQUAL(t, http_parse_date(http_date(t).c_str()));
+}
+
+void test_http_etag(void)
+{
+    std::string etag = http_etag(174848, rfc_date);
+    TEST_ASSERT_EQUAL_STRING("\"2ab00-2ebc98a1\"", etag.c_str());
+    TEST_ASSERT_EQUAL_STRING("W/\"2ab00-2ebc98a1\"", http_etag(174848, rfc_date, true).c_str());
+
+    // Size or time changing changes the tag
+    TEST_ASSERT_TRUE(etag != http_etag(174849, rfc_date));
+    TEST_ASSERT_TRUE(etag != http_etag(174848, rfc_date + 1));
+
+    TEST_ASSERT_TRUE(http_etag_matches(etag, etag));
+    TEST_ASSERT_TRUE(http_etag_matches("*", etag));
+    TEST_ASSERT_TRUE(http_etag_matches("\"x\", " + etag, etag));
+    TEST_ASSERT_TRUE(http_etag_matches("W/" + etag, etag));
+    TEST_ASSERT_TRUE(http_etag_matches(etag, "W/" + etag));
+    TEST_ASSERT_FALSE(http_etag_matches("\"x\", \"y\"", etag));
+    TEST_ASSERT_FALSE(http_etag_matches("", etag));
+}
+
+void test_http_not_modified(void)
+{
+    std::string etag = http_etag(1000, rfc_date);
+
+    TEST_ASSERT_FALSE(http_not_modified("", "", etag, rfc_date));
+    TEST_ASSERT_TRUE(http_not_modified(etag, "", etag, rfc_date));
+    TEST_ASSERT_FALSE(http_not_modified("\"other\"", "", etag, rfc_date));
+
+    TEST_ASSERT_TRUE(http_not_modified("", http_date(rfc_date), etag, rfc_date));
+    TEST_ASSERT_TRUE(http_not_modified("", http_date(rfc_date + 60), etag, rfc_date));
+    TEST_ASSERT_FALSE(http_not_modified("", http_date(rfc_date - 1), etag, rfc_date));
+    TEST_ASSERT_FALSE(http_not_modified("", "garbage", etag, rfc_date));
+
+    // If-None-Match decides when both are sent
+    TEST_ASSERT_FALSE(http_not_modified("\"other\"", http_date(rfc_date), etag, rfc_date));
+}
+
+void test_http_range(void)
+{
+    const size_t size = 819200;     // D81
+    std::string etag = http_etag(size, rfc_date);
+
+    auto range = [&](const char *header, const std::string &if_range = "") {
+        return http_parse_range(header, if_range, size, etag, rfc_date);
+    };
+
+    TEST_ASSERT_EQUAL(200, range("").status);
+
+    http_range_t r = range("bytes=0-255");
+    TEST_ASSERT_EQUAL(206, r.status);
+    TEST_ASSERT_EQUAL(0, r.start);
+    TEST_ASSERT_EQUAL(256, r.length);
+    TEST_ASSERT_EQUAL_STRING("bytes 0-255/819200", http_content_range(r, size).c_str());
+
+    r = range("bytes=409600-");
+    TEST_ASSERT_EQUAL(206, r.status);
+    TEST_ASSERT_EQUAL(409600, r.start);
+    TEST_ASSERT_EQUAL(409600, r.length);
+
+    r = range("bytes=-256");
+    TEST_ASSERT_EQUAL(206, r.status);
+    TEST_ASSERT_EQUAL(size - 256, r.start);
+    TEST_ASSERT_EQUAL(256, r.length);
+
+    // Clamped to the end
+    r = range("bytes=819000-999999");
+    TEST_ASSERT_EQUAL(206, r.status);
+    TEST_ASSERT_EQUAL(200, r.length);
+    r = range("bytes=-1000000");
+    TEST_ASSERT_EQUAL(206, r.status);
+    TEST_ASSERT_EQUAL(0, r.start);
+    TEST_ASSERT_EQUAL(size, r.length);
+
+    // Not satisfiable
+    r = range("bytes=819200-");
+    TEST_ASSERT_EQUAL(416, r.status);
+    TEST_ASSERT_EQUAL_STRING("bytes */819200", http_content_range(r, size).c_str());
+    TEST_ASSERT_EQUAL(416, range("bytes=-0").status);
+    TEST_ASSERT_EQUAL(416, http_parse_range("bytes=0-", "", 0, etag, rfc_date).status);
+
+    // Ignored, the whole file goes out
+    TEST_ASSERT_EQUAL(200, range("bytes=0-1,5-6").status);
+    TEST_ASSERT_EQUAL(200, range("lines=0-1").status);
+    TEST_ASSERT_EQUAL(200, range("bytes=10-5").status);
+    TEST_ASSERT_EQUAL(200, range("bytes=a-b").status);
+    TEST_ASSERT_EQUAL(200, range("bytes=-").status);
+
+    // If-Range
+    TEST_ASSERT_EQUAL(206, range("bytes=0-1", etag).status);
+    TEST_ASSERT_EQUAL(200, range("bytes=0-1", "\"stale\"").status);
+    TEST_ASSERT_EQUAL(200, range("bytes=0-1", "W/" + etag).status);
+    TEST_ASSERT_EQUAL(206, range("bytes=0-1", http_date(rfc_date)).status);
+    TEST_ASSERT_EQUAL(200, range("bytes=0-1", http_date(rfc_date + 1)).status);
+}
+
+void test_http_accepts_gzip(void)
+{
+    TEST_ASSERT_TRUE(http_accepts_gzip("gzip, deflate, br"));
+    TEST_ASSERT_TRUE(http_accepts_gzip("deflate,gzip;q=1.0"));
+    TEST_ASSERT_TRUE(http_accepts_gzip("*"));
+    TEST_ASSERT_FALSE(http_accepts_gzip(""));
+    TEST_ASSERT_FALSE(http_accepts_gzip("identity"));
+    TEST_ASSERT_FALSE(http_accepts_gzip("br, gzip;q=0"));
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_http_date);
+    RUN_TEST(test_http_etag);
+    RUN_TEST(test_http_not_modified);
+    RUN_TEST(test_http_range);
+    RUN_TEST(test_http_accepts_gzip);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -0,0 +1,197 @@
+#include "unity.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#define IMAGE_BROKER_BUDGET (3 * 1024)  // three empty images
+
+#include "../lib/meatloaf/meat_media.cpp"
+
+static std::atomic<int> alive{0};
+static std::atomic<int> opened{0};
+
+// An image with nothing in it but a directory index of some size
+class TestMStream: public MMediaStream {
+public:
+    TestMStream(size_t files = 0, useconds_t latency = 0) : MMediaStream(nullptr) {
+        alive++;
+        opened++;
+        index(files);
+        usleep(latency);
+    }
+    ~TestMStream() {
+        alive--;
+    }
+
+    void index(size_t files) {
+        uint8_t entry[32] = { 0 };
+        for (size_t i = 0; i < files; i++)
+            directory_index.add(entry, sizeof(entry), "FILE" + std::to_string(directory_index.count()), 1, 0);
+    }
+    size_t indexed() {
+        return directory_index.count();
+    }
+
+    // Whatever the object itself takes, 1KB and the index
+    size_t footprint() override {
+        return 1024 + directory_index.bytes();
+    }
+
+protected:
+    void seekHeader() override {};
+    bool seekNextImageEntry() override { return false; };
+    uint16_t readFile(uint8_t* buf, uint16_t size) override { return 0; };
+};
+
+// ImageBroker::obtain<T>() without MFSOwner
+static std::shared_ptr<TestMStream> obtain(const std::string &url, size_t files = 0, useconds_t latency = 0)
+{
+    auto found = ImageBroker::find(url);
+    if (found != nullptr)
+        return std::static_pointer_cast<TestMStream>(found);
+
+    auto stream = std::make_shared<TestMStream>(files, latency);
+    stream->url = url;
+    return std::static_pointer_cast<TestMStream>(ImageBroker::store(url, stream));
+}
+
+void setUp(void)
+{
+    ImageBroker::clear();
+    opened = 0;
+}
+
+void tearDown(void)
+{
+    ImageBroker::clear();
+    TEST_ASSERT_EQUAL(0, alive);
+}
+
+void test_image_broker_shared(void)
+{
+    auto first = obtain("/games.d64");
+    auto second = obtain("/games.d64");
+    TEST_ASSERT_EQUAL_PTR(first.get(), second.get());
+    TEST_ASSERT_EQUAL(1, alive);
+    TEST_ASSERT_EQUAL(1, opened);
+
+    // Still there when the callers are done with it
+    first.reset();
+    second.reset();
+    TEST_ASSERT_EQUAL(1, alive);
+    TEST_ASSERT_NOT_NULL(ImageBroker::find("/games.d64"));
+}
+
+void test_image_broker_budget(void)
+{
+    obtain("/a.d64");
+    obtain("/b.d64");
+    obtain("/c.d64");
+    TEST_ASSERT_EQUAL(3, alive);
+
+    // a was used last, so b goes first
+    obtain("/a.d64");
+    obtain("/d.d64");
+    TEST_ASSERT_EQUAL(3, alive);
+    TEST_ASSERT_NULL(ImageBroker::find("/b.d64"));
+    TEST_ASSERT_NOT_NULL(ImageBroker::find("/a.d64"));
+
+    // Images still held aren't let go, even over budget
+    auto c = obtain("/c.d64");
+    auto d = obtain("/d.d64");
+    auto a = obtain("/a.d64");
+    obtain("/e.d64");
+    TEST_ASSERT_EQUAL(4, alive);
+
+    // A directory index that grows counts against the budget
+    a->index(200);
+    a.reset();
+    obtain("/a.d64");
+    TEST_ASSERT_NULL(ImageBroker::find("/e.d64"));
+    TEST_ASSERT_EQUAL(3, alive);
+
+    // Once let go, a is over budget on its own and goes with c and d
+    c.reset();
+    d.reset();
+    auto f = obtain("/f.d64");
+    TEST_ASSERT_EQUAL(1, alive);
+    TEST_ASSERT_NULL(ImageBroker::find("/a.d64"));
+    TEST_ASSERT_NOT_NULL(ImageBroker::find("/f.d64"));
+}
+
+// Tasks opening the same image at once end up sharing one of them
+void test_image_broker_concurrent(void)
+{
+    const int tasks = 8;
+    std::vector<std::shared_ptr<TestMStream>> images(tasks);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < tasks; i++)
+        threads.emplace_back([&images, i] { images[i] = obtain("/games.d64", 0, 10000); });
+    for (auto &thread : threads)
+        thread.join();
+
+    TEST_ASSERT_TRUE(opened > 1);
+    for (auto &image : images)
+        TEST_ASSERT_EQUAL_PTR(images[0].get(), image.get());
+
+    // The ones opened in vain go without taking the kept one along
+    TEST_ASSERT_EQUAL(1, alive);
+    images.clear();
+    TEST_ASSERT_EQUAL(1, alive);
+    TEST_ASSERT_NOT_NULL(ImageBroker::find("/games.d64"));
+}
+
+void test_image_broker_dispose(void)
+{
+    // Disposing an image someone is still listing doesn't pull it from under them
+    auto listing = obtain("/games.d64", 10);
+    ImageBroker::dispose("/games.d64");
+    TEST_ASSERT_NULL(ImageBroker::find("/games.d64"));
+    TEST_ASSERT_EQUAL(10, listing->indexed());
+
+    // The next one is a fresh open, and the old one going doesn't take it along
+    auto fresh = obtain("/games.d64");
+    TEST_ASSERT_TRUE(fresh.get() != listing.get());
+    listing.reset();
+    TEST_ASSERT_EQUAL(1, alive);
+    TEST_ASSERT_NOT_NULL(ImageBroker::find("/games.d64"));
+
+    // Closing a stream of the same image that isn't the broker's lets it go
+    fresh.reset();
+    {
+        TestMStream other;
+        other.url = "/games.d64";
+        other.close();
+    }
+    TEST_ASSERT_EQUAL(0, alive);
+}
+
+void test_image_broker_invalidate(void)
+{
+    auto image = obtain("/games.d64", 10);
+    ImageBroker::invalidate("/games.d64");
+    TEST_ASSERT_EQUAL(0, image->indexed());
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_image_broker_shared);
+    RUN_TEST(test_image_broker_budget);
+    RUN_TEST(test_image_broker_concurrent);
+    RUN_TEST(test_image_broker_dispose);
+    RUN_TEST(test_image_broker_invalidate);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
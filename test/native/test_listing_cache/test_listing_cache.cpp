@@ -0,0 +1,268 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../lib/meatloaf/wrappers/listing_cache.cpp"
+#include "../lib/meatloaf/wrappers/block_buffer.cpp"
+
+// Renders a listing the way iecDrive::renderListing() lays it out
+static std::shared_ptr<MListing> render(const std::vector<std::pair<std::string, std::string>> &entries)
+{
+    auto listing = std::make_shared<MListing>(0x0401);
+    listing->line(0, "\x12\"MEATLOAF DISK   \" 08 2A", 25);
+    listing->line(0, "\"[URL]              \" NFO", 25);
+
+    listing->beginEntries();
+    for (auto &entry : entries)
+    {
+        char text[40];
+        int length = snprintf(text, sizeof(text), "  \"%s\"%*s %s", entry.first.c_str(), (int)(16 - entry.first.size()), "", entry.second.c_str());
+        listing->line(16, text, length);
+    }
+    listing->endEntries();
+
+    listing->line(664, "BLOCKS FREE.", 12);
+    listing->finish();
+    return listing;
+}
+
+// Names of the entries in a rendered listing, header and footer lines included
+static std::vector<std::string> lines(const MListing &listing)
+{
+    std::vector<std::string> found;
+    size_t offset = 2;
+    while (offset + 4 <= listing.size())
+    {
+        const uint8_t *line = listing.data() + offset;
+        if (line[0] == 0 && line[1] == 0)
+            break;
+
+        std::string text((const char *)line + 4);
+        found.push_back(text);
+        offset += 4 + text.size() + 1;
+    }
+    return found;
+}
+
+static const std::vector<std::pair<std::string, std::string>> disk = {
+    { "GAME", "PRG" },
+    { "GAME DOCS", "SEQ" },
+    { "GAMMA", "PRG" },
+    { "INTRO", "PRG" },
+    { "HIGH SCORES", "*SEQ" },
+};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_listing_layout(void)
+{
+    auto listing = render({ { "GAME", "PRG" } });
+    const uint8_t *data = listing->data();
+
+    // Load address, then the first line's link and blocks
+    TEST_ASSERT_EQUAL_HEX8(0x01, data[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x04, data[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, data[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, data[3]);
+    TEST_ASSERT_EQUAL(0, data[4] | data[5] << 8);
+
+    auto found = lines(*listing);
+    TEST_ASSERT_EQUAL(4, found.size());
+    TEST_ASSERT_EQUAL_STRING("BLOCKS FREE.", found[3].c_str());
+
+    // "BLOCKS FREE." line with 664 blocks, then the end of program
+    size_t end = listing->size();
+    TEST_ASSERT_EQUAL_HEX8(0, data[end - 1]);
+    TEST_ASSERT_EQUAL_HEX8(0, data[end - 2]);
+    TEST_ASSERT_EQUAL_HEX8(0, data[end - 3]);
+    TEST_ASSERT_EQUAL(664, data[end - 3 - 12 - 2] | data[end - 3 - 12 - 1] << 8);
+}
+
+void test_listing_filter(void)
+{
+    auto listing = render(disk);
+    TEST_ASSERT_EQUAL(2 + disk.size() + 1, lines(*listing).size());
+
+    auto count = [&listing](const char *filter) {
+        return (int)lines(*listing->filter(filter)).size() - 3;
+    };
+
+    TEST_ASSERT_EQUAL(5, count(""));
+    TEST_ASSERT_EQUAL(5, count("*"));
+    TEST_ASSERT_EQUAL(3, count("GA*"));
+    TEST_ASSERT_EQUAL(1, count("GAME"));
+    TEST_ASSERT_EQUAL(0, count("GAM"));
+    TEST_ASSERT_EQUAL(1, count("GA?MA"));
+    TEST_ASSERT_EQUAL(3, count("*=P"));
+    TEST_ASSERT_EQUAL(2, count("*=S"));
+    TEST_ASSERT_EQUAL(1, count("GA*=S"));
+    TEST_ASSERT_EQUAL(0, count("NOPE*"));
+
+    // Header and footer stay, the original is untouched
+    auto filtered = listing->filter("INTRO");
+    auto found = lines(*filtered);
+    TEST_ASSERT_EQUAL(4, found.size());
+    TEST_ASSERT_EQUAL_STRING(lines(*listing)[0].c_str(), found[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("  \"INTRO\"            PRG", found[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("BLOCKS FREE.", found[3].c_str());
+    TEST_ASSERT_EQUAL_HEX8(0x01, filtered->data()[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x04, filtered->data()[1]);
+    TEST_ASSERT_EQUAL(0, filtered->data()[filtered->size() - 1]);
+    TEST_ASSERT_EQUAL(0, filtered->data()[filtered->size() - 2]);
+    TEST_ASSERT_EQUAL(2 + disk.size() + 1, lines(*listing).size());
+}
+
+void test_listing_cache_stamp_and_age(void)
+{
+    MListingCache cache(LISTING_CACHE_BUDGET, 60);
+    auto listing = render(disk);
+
+    TEST_ASSERT_NULL(cache.find("/games", 100, 1000).get());
+    cache.store("/games", 100, 1000, listing);
+
+    TEST_ASSERT_EQUAL_PTR(listing.get(), cache.find("/games", 100, 1030).get());
+    TEST_ASSERT_NULL(cache.find("/other", 100, 1030).get());
+
+    // Changed since
+    TEST_ASSERT_NULL(cache.find("/games", 101, 1030).get());
+    TEST_ASSERT_NULL(cache.find("/games", 100, 1030).get());
+    TEST_ASSERT_EQUAL(0, cache.bytes());
+
+    // Too old, or the clock went back
+    cache.store("/games", 100, 1000, listing);
+    TEST_ASSERT_NULL(cache.find("/games", 100, 1060).get());
+    cache.store("/games", 100, 1000, listing);
+    TEST_ASSERT_NULL(cache.find("/games", 100, 999).get());
+
+    cache.store("/games", 100, 1000, listing);
+    cache.clear();
+    TEST_ASSERT_NULL(cache.find("/games", 100, 1000).get());
+    TEST_ASSERT_EQUAL(1, cache.hits());
+}
+
+void test_listing_cache_budget(void)
+{
+    auto listing = render(disk);
+    MListingCache cache(listing->size() * 3, 60);
+
+    for (auto url : { "/a", "/b", "/c" })
+        cache.store(url, 0, 0, listing);
+    TEST_ASSERT_EQUAL(listing->size() * 3, cache.bytes());
+
+    // "/a" used again, so "/b" is the oldest when "/d" comes in
+    TEST_ASSERT_NOT_NULL(cache.find("/a", 0, 0).get());
+    cache.store("/d", 0, 0, listing);
+    TEST_ASSERT_NULL(cache.find("/b", 0, 0).get());
+    TEST_ASSERT_NOT_NULL(cache.find("/a", 0, 0).get());
+    TEST_ASSERT_NOT_NULL(cache.find("/c", 0, 0).get());
+    TEST_ASSERT_NOT_NULL(cache.find("/d", 0, 0).get());
+
+    // Storing the same url again replaces it
+    cache.store("/d", 0, 0, listing);
+    TEST_ASSERT_EQUAL(listing->size() * 3, cache.bytes());
+
+    // Too big to keep at all
+    MListingCache small(10, 60);
+    small.store("/a", 0, 0, listing);
+    TEST_ASSERT_EQUAL(0, small.bytes());
+    TEST_ASSERT_NULL(small.find("/a", 0, 0).get());
+}
+
+void test_listing_stream(void)
+{
+    // A 296 entry D81 sized listing, through the block buffer sendFile() uses
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 296; i++)
+        entries.push_back({ mstr::format("FILE %03d", i), "PRG" });
+    auto listing = render(entries);
+
+    auto stream = std::make_shared<MListingStream>(listing);
+    TEST_ASSERT_EQUAL(listing->size(), stream->size());
+
+    MBlockBuffer buffer(stream, 256, 4);
+    std::vector<uint8_t> sent;
+    bool eoi = false;
+    while (!eoi)
+    {
+        buffer.fill();
+        const uint8_t *data;
+        size_t length = buffer.peek(&data);
+        TEST_ASSERT_TRUE(length > 0);
+        for (size_t i = 0; i < length && !eoi; i++)
+        {
+            sent.push_back(data[i]);
+            eoi = buffer.isLast(i);
+        }
+        buffer.consume(length);
+    }
+
+    TEST_ASSERT_EQUAL(listing->size(), sent.size());
+    TEST_ASSERT_EQUAL(0, memcmp(listing->data(), sent.data(), sent.size()));
+
+    TEST_ASSERT_TRUE(stream->seek(10));
+    uint8_t b;
+    TEST_ASSERT_EQUAL(1, stream->read(&b, 1));
+    TEST_ASSERT_EQUAL(listing->data()[10], b);
+    TEST_ASSERT_FALSE(stream->seek(listing->size() + 1));
+}
+
+void test_listing_benchmark(void)
+{
+    const int rounds = 200;
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 296; i++)
+        entries.push_back({ mstr::format("FILE %03d", i), (i % 3) ? "PRG" : "SEQ" });
+    auto listing = render(entries);
+
+    MListingCache cache;
+    cache.store("/big.d81", 1, 0, listing);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    for (int i = 0; i < rounds; i++)
+        bytes += render(entries)->size();
+    auto render_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+        bytes += cache.find("/big.d81", 1, 0)->size();
+    auto cached_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+        bytes += cache.find("/big.d81", 1, 0)->filter("*=S")->size();
+    auto filter_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("296 entries: render %8.0f/sec  cached %8.0f/sec  cached + filter %8.0f/sec (%d bytes)\r\n",
+        rounds / render_time, rounds / cached_time, rounds / filter_time, (int)bytes);
+    TEST_ASSERT_EQUAL(rounds * 2, cache.hits());
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_listing_layout);
+    RUN_TEST(test_listing_filter);
+    RUN_TEST(test_listing_cache_stamp_and_age);
+    RUN_TEST(test_listing_cache_budget);
+    RUN_TEST(test_listing_stream);
+    RUN_TEST(test_listing_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -0,0 +1,412 @@
+// Reads files back out of images built here, through MFSOwner::File the
+// way the drive opens them, on top of the POSIX flash filesystem
+
+#include "unity.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "../lib/utils/string_utils.cpp"
+#include "../lib/utils/U8Char.cpp"
+#include "../lib/utils/peoples_url_parser.cpp"
+
+#include "../lib/meatloaf/meatloaf.cpp"
+#include "../lib/meatloaf/meat_media.cpp"
+#include "../lib/meatloaf/meat_resolver.cpp"
+#include "../lib/meatloaf/device/flash.cpp"
+#include "../lib/meatloaf/disk/d64.cpp"
+#include "../lib/meatloaf/disk/dnp.h"
+#include "../lib/meatloaf/file/p00.cpp"
+#include "../lib/meatloaf/tape/t64.cpp"
+#include "../lib/meatloaf/tape/tcrt.cpp"
+#include "../lib/meatloaf/archive/lbr.cpp"
+
+#include "../lib/utils/punycode.cpp"
+#undef min // punycode.cpp's own, would get in the way of std::min
+
+#define MEDIA_DIR "/tmp/meatloaf_media"
+
+
+typedef std::vector<std::pair<std::string, std::vector<uint8_t>>> Files;
+
+static std::string path(std::string name)
+{
+    return std::string(MEDIA_DIR "/") + name;
+}
+
+static void writeFile(std::string name, const std::vector<uint8_t> &data)
+{
+    FILE *f = fopen(path(name).c_str(), "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+}
+
+// Contents of file n, load address first
+static std::vector<uint8_t> fileData(int n, size_t size)
+{
+    std::vector<uint8_t> data(size);
+    data[0] = 0x01;
+    data[1] = 0x08;
+    for (size_t i = 2; i < size; i++)
+        data[i] = (uint8_t)(i * 7 + n * 31 + (i >> 8));
+    return data;
+}
+
+// A CBM disk. The directory is a chain of sectors on the directory track,
+// the files are laid out a block after another from their first track on.
+struct Disk
+{
+    std::vector<uint16_t> sectors;  // per track, from track 1
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t> data;
+
+    Disk(std::vector<uint16_t> sectors) : sectors(sectors)
+    {
+        uint32_t total = 0;
+        for (auto count : sectors)
+        {
+            offsets.push_back(total);
+            total += count;
+        }
+        data.assign(total * 256, 0);
+    }
+
+    uint8_t *block(uint8_t track, uint8_t sector)
+    {
+        return &data[(offsets[track - 1] + sector) * 256];
+    }
+
+    void build(uint8_t dir_track, uint8_t dir_sector, uint8_t track, const Files &files)
+    {
+        uint8_t sector = 0;
+        for (size_t n = 0; n < files.size(); n++)
+        {
+            auto &contents = files[n].second;
+            uint16_t blocks = (contents.size() + 253) / 254;
+
+            uint8_t *entry = block(dir_track, dir_sector + n / 8) + (n % 8) * 32;
+            if (n % 8 == 0)
+            {
+                bool more = (n / 8 + 1 < (files.size() + 7) / 8);
+                entry[0] = more ? dir_track : 0;
+                entry[1] = more ? dir_sector + n / 8 + 1 : 0xFF;
+            }
+            entry[2] = 0x82;
+            memset(entry + 5, 0xA0, 16);
+            memcpy(entry + 5, files[n].first.c_str(), files[n].first.size());
+            entry[3] = track;
+            entry[4] = sector;
+            entry[30] = blocks & 0xFF;
+            entry[31] = blocks >> 8;
+
+            for (uint16_t b = 0; b < blocks; b++)
+            {
+                uint8_t *data = block(track, sector);
+                uint32_t length = std::min<uint32_t>(254, contents.size() - b * 254);
+                memcpy(data + 2, &contents[b * 254], length);
+
+                if (++sector == sectors[track - 1])
+                {
+                    sector = 0;
+                    if (++track == dir_track)
+                        track++;
+                }
+                data[0] = (b + 1 < blocks) ? track : 0;
+                data[1] = (b + 1 < blocks) ? sector : length + 1;
+            }
+        }
+    }
+};
+
+static std::vector<uint16_t> cbmSectors(uint8_t tracks)
+{
+    std::vector<uint16_t> sectors;
+    for (uint8_t t = 1; t <= tracks; t++)
+    {
+        uint8_t side = (t > 35) ? t - 35 : t;
+        sectors.push_back((side < 18) ? 21 : (side < 25) ? 19 : (side < 31) ? 18 : 17);
+    }
+    return sectors;
+}
+
+static std::vector<uint8_t> makeD64(const Files &files)
+{
+    Disk disk(cbmSectors(35));
+    disk.build(18, 1, 1, files);
+
+    uint8_t *header = disk.block(18, 0);
+    header[0] = 18;
+    header[1] = 1;
+    header[2] = 0x41;
+    memset(header + 0x90, 0xA0, 27);
+    memcpy(header + 0x90, "MEATLOAF", 8);
+    return disk.data;
+}
+
+// Files from track 34, so they run on through track 35 onto the second side
+static std::vector<uint8_t> makeD71(const Files &files)
+{
+    Disk disk(cbmSectors(70));
+    disk.build(18, 1, 34, files);
+
+    uint8_t *header = disk.block(18, 0);
+    header[0] = 18;
+    header[1] = 1;
+    header[2] = 0x41;
+    header[3] = 0x80;   // double sided
+    memset(header + 0x90, 0xA0, 27);
+    memcpy(header + 0x90, "MEATLOAF", 8);
+    return disk.data;
+}
+
+static std::vector<uint8_t> makeD81(const Files &files)
+{
+    Disk disk(std::vector<uint16_t>(80, 40));
+    disk.build(40, 3, 1, files);
+
+    uint8_t *header = disk.block(40, 0);
+    header[0] = 40;
+    header[1] = 3;
+    header[2] = 0x44;
+    memset(header + 0x04, 0xA0, 27);
+    memcpy(header + 0x04, "MEATLOAF", 8);
+    return disk.data;
+}
+
+static std::vector<uint8_t> makeT64(const Files &files)
+{
+    std::vector<uint8_t> t64(0x40 + files.size() * 32, 0);
+    memcpy(&t64[0], "C64S tape image file", 20);
+    t64[0x20] = 0x01;
+    t64[0x21] = 0x01;
+    t64[0x22] = files.size();
+    t64[0x24] = files.size();
+    memset(&t64[0x28], 0x20, 24);
+    memcpy(&t64[0x28], "MEATLOAF", 8);
+
+    for (size_t n = 0; n < files.size(); n++)
+    {
+        auto &contents = files[n].second;
+        uint32_t offset = t64.size();
+        uint16_t end = 0x0801 + contents.size() - 2;
+
+        uint8_t *entry = &t64[0x40 + n * 32];
+        entry[0] = 1;
+        entry[1] = 0x82;
+        entry[2] = contents[0];
+        entry[3] = contents[1];
+        entry[4] = end & 0xFF;
+        entry[5] = end >> 8;
+        memcpy(entry + 8, &offset, 4);
+        memset(entry + 16, 0x20, 16);
+        memcpy(entry + 16, files[n].first.c_str(), files[n].first.size());
+
+        t64.insert(t64.end(), contents.begin() + 2, contents.end());
+    }
+    return t64;
+}
+
+static std::vector<uint8_t> makeP00(std::string name, const std::vector<uint8_t> &contents)
+{
+    std::vector<uint8_t> p00(26, 0);
+    memcpy(&p00[0], "C64File", 7);
+    memcpy(&p00[8], name.c_str(), name.size());
+    p00.insert(p00.end(), contents.begin(), contents.end());
+    return p00;
+}
+
+static std::vector<uint8_t> readFile(std::string name)
+{
+    std::vector<uint8_t> data;
+    FILE *f = fopen(path(name).c_str(), "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    int c;
+    while ((c = fgetc(f)) != EOF)
+        data.push_back(c);
+    fclose(f);
+    return data;
+}
+
+// OPEN 2,8,2,"#" on the image
+static std::unique_ptr<MStream> openDirect(std::string name)
+{
+    auto file = std::unique_ptr<MFile>(MFSOwner::File(path(name + "/#")));
+    TEST_ASSERT_NOT_NULL(file.get());
+    auto stream = std::unique_ptr<MStream>(file->getSourceStream(std::ios_base::in | std::ios_base::out));
+    TEST_ASSERT_NOT_NULL(stream.get());
+    return stream;
+}
+
+// LOAD"name",8 in reads of size bytes
+static std::vector<uint8_t> load(std::string url, size_t size = 256)
+{
+    auto file = std::unique_ptr<MFile>(MFSOwner::File(url));
+    TEST_ASSERT_NOT_NULL(file.get());
+    auto stream = std::unique_ptr<MStream>(file->getSourceStream());
+    TEST_ASSERT_NOT_NULL(stream.get());
+
+    std::vector<uint8_t> got;
+    std::vector<uint8_t> buf(size);
+    while (uint32_t r = stream->read(buf.data(), size))
+        got.insert(got.end(), buf.data(), buf.data() + r);
+    return got;
+}
+
+void setUp(void)
+{
+    mkdir(MEDIA_DIR, 0755);
+}
+
+void tearDown(void)
+{
+}
+
+// Whether the path was valid is only kept in m_isNull
+class TestFlashMFile : public FlashMFile
+{
+public:
+    using FlashMFile::FlashMFile;
+    bool isNull() { return m_isNull; }
+};
+
+void test_flash_path_valid(void)
+{
+    // Past what std::string keeps in place, so the full path is on the heap
+    std::string dir = path("a_directory_with_a_long_name/and_another_one");
+    auto file = std::unique_ptr<TestFlashMFile>(new TestFlashMFile(dir + "/file.prg"));
+    TEST_ASSERT_FALSE(file->isNull());
+
+    std::string too_long(FILENAME_MAX, 'x');
+    file.reset(new TestFlashMFile(dir + "/" + too_long));
+    TEST_ASSERT_TRUE(file->isNull());
+    file.reset(new TestFlashMFile(dir + "/" + too_long + "/file.prg"));
+    TEST_ASSERT_TRUE(file->isNull());
+}
+
+void test_d64_read_file(void)
+{
+    // One block, whole blocks and a short last block
+    Files files = { { "ONE", fileData(1, 100) }, { "TWO", fileData(2, 254 * 2) }, { "THREE", fileData(3, 254 * 2 + 77) } };
+    writeFile("read.d64", makeD64(files));
+
+    for (size_t size : { 256, 254, 7, 1000 })
+    {
+        TEST_ASSERT_TRUE(load(path("read.d64/one"), size) == files[0].second);
+        TEST_ASSERT_TRUE(load(path("read.d64/two"), size) == files[1].second);
+        TEST_ASSERT_TRUE(load(path("read.d64/three"), size) == files[2].second);
+    }
+}
+
+void test_t64_read_file(void)
+{
+    Files files = { { "ONE", fileData(1, 300) }, { "TWO", fileData(2, 1000) } };
+    writeFile("read.t64", makeT64(files));
+
+    // The load address comes from the directory entry, the rest from the tape
+    for (size_t size : { 1, 2, 3, 256 })
+    {
+        TEST_ASSERT_TRUE(load(path("read.t64/one"), size) == files[0].second);
+        TEST_ASSERT_TRUE(load(path("read.t64/two"), size) == files[1].second);
+    }
+}
+
+void test_p00_read_file(void)
+{
+    auto contents = fileData(1, 1000);
+    writeFile("one.p00", makeP00("ONE", contents));
+
+    for (size_t size : { 7, 256, 2000 })
+        TEST_ASSERT_TRUE(load(path("one.p00"), size) == contents);
+}
+
+void test_d71_layout(void)
+{
+    Files files = { { "ONE", fileData(1, 100) }, { "TWO", fileData(2, 254 * 60) } };
+    writeFile("read.d71", makeD71(files));
+
+    auto dir = std::unique_ptr<MFile>(MFSOwner::File(path("read.d71")));
+    TEST_ASSERT_TRUE(dir->rewindDirectory());
+    int entries = 0;
+    while (auto entry = std::unique_ptr<MFile>(dir->getNextFileInDir()))
+        entries++;
+    TEST_ASSERT_EQUAL(2, entries);
+
+    TEST_ASSERT_TRUE(load(path("read.d71/one")) == files[0].second);
+    TEST_ASSERT_TRUE(load(path("read.d71/two")) == files[1].second);
+}
+
+void test_nested_image(void)
+{
+    Files files = { { "ONE", fileData(1, 100) }, { "TWO", fileData(2, 254 * 30 + 11) } };
+    writeFile("nest.d81", makeD81({ { "README", fileData(3, 500) }, { "INNER.D64", makeD64(files) } }));
+
+    TEST_ASSERT_TRUE(load(path("nest.d81/inner.d64/one")) == files[0].second);
+    TEST_ASSERT_TRUE(load(path("nest.d81/inner.d64/two"), 100) == files[1].second);
+    TEST_ASSERT_TRUE(load(path("nest.d81/readme")) == fileData(3, 500));
+}
+
+void test_bam_layout(void)
+{
+    // Track 1 all free
+    auto d64 = makeD64({});
+    uint8_t *bam = &d64[(357 + 0) * 256 + 0x04];
+    bam[0] = 21;
+    bam[1] = bam[2] = 0xFF;
+    bam[3] = 0x1F;
+    writeFile("bam.d64", d64);
+
+    auto stream = openDirect("bam.d64");
+    TEST_ASSERT_TRUE(stream->hasBAM());
+    TEST_ASSERT_TRUE(stream->blockAllocate(1, 9));
+    TEST_ASSERT_FALSE(stream->blockAllocate(1, 9));
+    stream.reset();
+
+    d64 = readFile("bam.d64");
+    bam = &d64[(357 + 0) * 256 + 0x04];
+    TEST_ASSERT_EQUAL(20, bam[0]);
+    TEST_ASSERT_EQUAL(0xFF, bam[1]);
+    TEST_ASSERT_EQUAL(0xFD, bam[2]);
+    TEST_ASSERT_EQUAL(0x1F, bam[3]);
+
+    // DNP keeps 32 bytes a track MSB first, none of it may be touched
+    std::vector<uint8_t> dnp(2 * 256 * 256, 0);
+    dnp[0] = 1;
+    dnp[1] = 1;
+    dnp[2] = 0x48;
+    memset(&dnp[2 * 256], 0xFF, 256);
+    writeFile("bam.dnp", dnp);
+
+    stream = openDirect("bam.dnp");
+    TEST_ASSERT_FALSE(stream->hasBAM());
+    TEST_ASSERT_FALSE(stream->blockAllocate(1, 40));
+    TEST_ASSERT_FALSE(stream->blockFree(1, 0));
+    stream.reset();
+
+    TEST_ASSERT_TRUE(readFile("bam.dnp") == dnp);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_flash_path_valid);
+    RUN_TEST(test_d64_read_file);
+    RUN_TEST(test_t64_read_file);
+    RUN_TEST(test_p00_read_file);
+    RUN_TEST(test_d71_layout);
+    RUN_TEST(test_nested_image);
+    RUN_TEST(test_bam_layout);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
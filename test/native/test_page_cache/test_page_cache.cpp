@@ -0,0 +1,361 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+#include "../lib/utils/string_utils.cpp"
+#include "../lib/utils/U8Char.cpp"
+#include "../lib/utils/peoples_url_parser.cpp"
+#include "../lib/utils/utils.cpp"
+#include "../lib/compat/strlcpy.c"
+#include "../lib/compat/compat_gettimeofday.c"
+
+#include "../lib/meatloaf/meatloaf.cpp"
+#include "../lib/meatloaf/meat_media.cpp"
+#include "../lib/meatloaf/meat_resolver.cpp"
+#include "../lib/meatloaf/device/flash.cpp"
+#include "../lib/meatloaf/disk/d64.cpp"
+#include "../lib/meatloaf/file/p00.cpp"
+#include "../lib/meatloaf/tape/t64.cpp"
+#include "../lib/meatloaf/tape/tcrt.cpp"
+#include "../lib/meatloaf/archive/lbr.cpp"
+#include "../lib/meatloaf/wrappers/page_cache.cpp"
+#include "../lib/meatloaf/network/http.cpp"
+
+#include "../lib/utils/punycode.cpp"
+#undef min // punycode.cpp's own, would get in the way of std::min
+
+// MeatHttpClient talks to http_stand_in through the host esp_http_client
+#include "../stubs/esp_http_client.cpp"
+
+#define IMAGE_URL "http://stand-in/image.d64"
+#define SPILL_PATH "/tmp/test_page_cache.tmp"
+
+static const std::vector<uint8_t> &serve(size_t size)
+{
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < size; i++)
+        data.push_back((uint8_t)(i * 13 + (i >> 9)));
+
+    http_stand_in.resources[IMAGE_URL] = data;
+    return http_stand_in.resources[IMAGE_URL];
+}
+
+// A cache fetching through the client the way HttpIStream::startCache sets it up
+static MPageCache *rangeCache(MeatHttpClient &client, size_t pages)
+{
+    TEST_ASSERT_TRUE(client.GET(IMAGE_URL));
+    client._range_end = client._size;
+    return new MPageCache(client._size, [&client](uint32_t offset, uint8_t *buf, uint32_t length, uint32_t run) {
+        return client.readRange(offset, buf, length, run);
+    }, pages);
+}
+
+// Sector reads of a D64 listing and LOAD: header and BAM on 18/0, the
+// directory chain on track 18, then a file chained with interleave 10
+static std::vector<uint32_t> d64Pattern()
+{
+    std::vector<uint32_t> sectors;
+    auto block = [](uint8_t track, uint8_t sector) {
+        uint32_t offset = 0;
+        for (uint8_t t = 1; t < track; t++)
+            offset += (t < 18) ? 21 : (t < 25) ? 19 : (t < 31) ? 18 : 17;
+        return (offset + sector) * 256;
+    };
+
+    sectors.push_back(block(18, 0));
+    for (uint8_t s : { 1, 4, 7, 10, 13, 16, 2, 5, 8, 11, 14, 17, 3, 6, 9, 12, 15, 18 })
+    {
+        // every directory entry seeks back to its sector
+        for (int e = 0; e < 8; e++)
+            sectors.push_back(block(18, s) + (e * 32));
+        sectors.push_back(block(18, 0)); // blocks free
+    }
+
+    for (uint8_t t = 17; t > 10; t--)
+        for (uint8_t i = 0, s = 0; i < 21; i++, s = (s + 10) % 21)
+            sectors.push_back(block(t, s));
+
+    return sectors;
+}
+
+void setUp(void)
+{
+    http_stand_in.reset();
+}
+
+void tearDown(void)
+{
+    unlink(SPILL_PATH);
+}
+
+void test_page_cache_reads_match(void)
+{
+    auto &data = serve(174848);
+
+    HttpIStream stream(IMAGE_URL);
+    TEST_ASSERT_TRUE(stream.open());
+    TEST_ASSERT_EQUAL(data.size(), stream.size());
+
+    std::mt19937 rng(64);
+    uint8_t buf[10000];
+    for (int i = 0; i < 2000; i++)
+    {
+        uint32_t offset = rng() % data.size();
+        uint32_t length = 1 + (rng() % sizeof(buf));
+
+        uint32_t expected = std::min<uint32_t>(length, data.size() - offset);
+        TEST_ASSERT_TRUE(stream.seek(offset));
+        TEST_ASSERT_EQUAL(expected, stream.read(buf, length));
+        TEST_ASSERT_EQUAL(0, memcmp(buf, data.data() + offset, expected));
+    }
+
+    // Past the end
+    TEST_ASSERT_TRUE(stream.seek(data.size()));
+    TEST_ASSERT_EQUAL(0, stream.read(buf, 1));
+}
+
+void test_page_cache_range_requests(void)
+{
+    serve(65536);
+
+    HttpIStream stream(IMAGE_URL);
+    TEST_ASSERT_TRUE(stream.open());
+    TEST_ASSERT_EQUAL(1, http_stand_in.requests.size());
+    TEST_ASSERT_TRUE(http_stand_in.requests[0].range.empty());
+
+    // A page at a time, each on the connection the last response came on
+    uint8_t buf[100];
+    TEST_ASSERT_TRUE(stream.seek(5 * PAGE_CACHE_PAGE_SIZE + 10));
+    TEST_ASSERT_EQUAL(sizeof(buf), stream.read(buf, sizeof(buf)));
+    TEST_ASSERT_TRUE(stream.seek(PAGE_CACHE_PAGE_SIZE));
+    TEST_ASSERT_EQUAL(sizeof(buf), stream.read(buf, sizeof(buf)));
+
+    TEST_ASSERT_EQUAL(3, http_stand_in.requests.size());
+    TEST_ASSERT_EQUAL_STRING("bytes=20480-24575", http_stand_in.requests[1].range.c_str());
+    TEST_ASSERT_EQUAL_STRING("bytes=4096-8191", http_stand_in.requests[2].range.c_str());
+    TEST_ASSERT_TRUE(http_stand_in.requests[1].reused);
+    TEST_ASSERT_TRUE(http_stand_in.requests[2].reused);
+    TEST_ASSERT_EQUAL(1, http_stand_in.connections);
+
+    // Both pages are cached now
+    TEST_ASSERT_TRUE(stream.seek(5 * PAGE_CACHE_PAGE_SIZE));
+    TEST_ASSERT_EQUAL(sizeof(buf), stream.read(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(3, http_stand_in.requests.size());
+
+    // A server that lets every connection go still gets the same ranges
+    http_stand_in.keep_alive = false;
+    TEST_ASSERT_TRUE(stream.seek(9 * PAGE_CACHE_PAGE_SIZE));
+    TEST_ASSERT_EQUAL(sizeof(buf), stream.read(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(4, http_stand_in.requests.size());
+    TEST_ASSERT_EQUAL_STRING("bytes=36864-40959", http_stand_in.requests[3].range.c_str());
+    TEST_ASSERT_EQUAL(2, http_stand_in.connections);
+}
+
+void test_page_cache_coalesces(void)
+{
+    serve(65536);
+    MeatHttpClient client;
+    std::unique_ptr<MPageCache> cache(rangeCache(client, 16));
+
+    // Three missing pages, one request
+    uint8_t buf[3 * PAGE_CACHE_PAGE_SIZE];
+    TEST_ASSERT_EQUAL(sizeof(buf) - 100, cache->read(PAGE_CACHE_PAGE_SIZE + 50, buf, sizeof(buf) - 100));
+    TEST_ASSERT_EQUAL(2, http_stand_in.requests.size());
+    TEST_ASSERT_EQUAL_STRING("bytes=4096-16383", http_stand_in.requests[1].range.c_str());
+
+    // All cached now
+    cache->read(PAGE_CACHE_PAGE_SIZE, buf, 3 * PAGE_CACHE_PAGE_SIZE);
+    TEST_ASSERT_EQUAL(2, http_stand_in.requests.size());
+}
+
+void test_page_cache_evicts_oldest(void)
+{
+    serve(65536);
+    MeatHttpClient client;
+    std::unique_ptr<MPageCache> cache(rangeCache(client, 4));
+
+    uint8_t b;
+    for (uint32_t page : { 1, 3, 5, 7 })
+        cache->read(page * PAGE_CACHE_PAGE_SIZE, &b, 1);
+    TEST_ASSERT_EQUAL(4, cache->misses());
+
+    // Page 1 used again, so page 3 is the oldest when page 9 comes in
+    cache->read(PAGE_CACHE_PAGE_SIZE, &b, 1);
+    cache->read(9 * PAGE_CACHE_PAGE_SIZE, &b, 1);
+    TEST_ASSERT_EQUAL(1, cache->hits());
+
+    cache->read(PAGE_CACHE_PAGE_SIZE, &b, 1);
+    TEST_ASSERT_EQUAL(2, cache->hits());
+    cache->read(3 * PAGE_CACHE_PAGE_SIZE, &b, 1);
+    TEST_ASSERT_EQUAL(6, cache->misses());
+}
+
+void test_page_cache_spill(void)
+{
+    auto &data = serve(100000);
+    http_stand_in.ranges = false;
+
+    MeatHttpClient client;
+    TEST_ASSERT_TRUE(client.GET(IMAGE_URL));
+    TEST_ASSERT_FALSE(client.isFriendlySkipper);
+
+    MPageCache cache(client._size, nullptr, 4);
+    TEST_ASSERT_TRUE(cache.spill(SPILL_PATH, [&client](uint8_t *buf, uint32_t length) {
+        return (int32_t)client.read(buf, length);
+    }));
+
+    // Backwards and forwards, only what has been reached is downloaded
+    uint8_t buf[5000];
+    for (uint32_t offset : { 20000, 100, 50000, 8000, 99000, 30000, 0 })
+    {
+        uint32_t expected = std::min<uint32_t>(sizeof(buf), data.size() - offset);
+        TEST_ASSERT_EQUAL(expected, cache.read(offset, buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL(0, memcmp(buf, data.data() + offset, expected));
+
+        if (offset == 20000)
+            TEST_ASSERT_TRUE(cache.spilled() < 50000);
+    }
+
+    TEST_ASSERT_EQUAL(1, http_stand_in.requests.size());
+    TEST_ASSERT_EQUAL(data.size(), http_stand_in.transferred);
+    TEST_ASSERT_EQUAL(0, access(SPILL_PATH, F_OK));
+}
+
+void test_page_cache_removes_spill(void)
+{
+    {
+        MPageCache cache(1000, nullptr);
+        TEST_ASSERT_TRUE(cache.spill(SPILL_PATH, [](uint8_t *buf, uint32_t length) {
+            return (int32_t)0;
+        }));
+    }
+    TEST_ASSERT_NOT_EQUAL(0, access(SPILL_PATH, F_OK));
+}
+
+void test_page_cache_without_cache(void)
+{
+    // More pages than there is memory for, the stream has to do without.
+    // Under ASan this needs allocator_may_return_null=1.
+    MPageCache cache(1000, nullptr, (size_t)1 << 34);
+    uint8_t b;
+    TEST_ASSERT_FALSE(cache.valid());
+    TEST_ASSERT_EQUAL(0, cache.read(0, &b, 1));
+
+    // No ranges and no spill file on the host either, seeks reopen and skip
+    auto &data = serve(30000);
+    http_stand_in.ranges = false;
+
+    HttpIStream stream(IMAGE_URL);
+    TEST_ASSERT_TRUE(stream.open());
+
+    uint8_t buf[1000];
+    for (uint32_t offset : { 20000, 100, 25000, 24500 })
+    {
+        TEST_ASSERT_TRUE(stream.seek(offset));
+        TEST_ASSERT_EQUAL(sizeof(buf), stream.read(buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL(0, memcmp(buf, data.data() + offset, sizeof(buf)));
+    }
+}
+
+void test_page_cache_d64_pattern(void)
+{
+    auto pattern = d64Pattern();
+    auto &data = serve(174848);
+    uint8_t buf[256];
+
+    // A seek on the connection for every read
+    MeatHttpClient client;
+    TEST_ASSERT_TRUE(client.GET(IMAGE_URL));
+    for (auto offset : pattern)
+    {
+        client.seek(offset);
+        client.read(buf, (offset % 256) ? 32 : 256);
+    }
+    size_t before = http_stand_in.requests.size();
+
+    http_stand_in.requests.clear();
+    HttpIStream stream(IMAGE_URL);
+    TEST_ASSERT_TRUE(stream.open());
+    for (auto offset : pattern)
+    {
+        uint32_t length = (offset % 256) ? 32 : 256;
+        TEST_ASSERT_TRUE(stream.seek(offset));
+        TEST_ASSERT_EQUAL(length, stream.read(buf, length));
+        TEST_ASSERT_EQUAL(0, memcmp(buf, data.data() + offset, length));
+    }
+    size_t after = http_stand_in.requests.size();
+
+    printf("d64 listing + load (%d reads): seek per read %4d requests  page cache %4d requests\r\n",
+        (int)pattern.size(), (int)before, (int)after);
+
+    TEST_ASSERT_TRUE(after * 5 < before);
+}
+
+void test_page_cache_benchmark(void)
+{
+    const int rounds = 50;
+    auto pattern = d64Pattern();
+    serve(174848);
+    uint8_t buf[256];
+
+    // A request costs a round trip, stand in for it with a short sleep
+    http_stand_in.on_request = []() { usleep(20); };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        MeatHttpClient client;
+        client.GET(IMAGE_URL);
+        for (auto offset : pattern)
+        {
+            client.seek(offset);
+            client.read(buf, (offset % 256) ? 32 : 256);
+        }
+    }
+    auto before_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto before_transferred = http_stand_in.transferred;
+
+    http_stand_in.transferred = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        HttpIStream stream(IMAGE_URL);
+        stream.open();
+        for (auto offset : pattern)
+        {
+            stream.seek(offset);
+            stream.read(buf, (offset % 256) ? 32 : 256);
+        }
+    }
+    auto after_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("seek per read: %8.0f reads/sec  %7d bytes/round\r\n", rounds * pattern.size() / before_time, (int)(before_transferred / rounds));
+    printf("page cache   : %8.0f reads/sec  %7d bytes/round\r\n", rounds * pattern.size() / after_time, (int)(http_stand_in.transferred / rounds));
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_page_cache_reads_match);
+    RUN_TEST(test_page_cache_range_requests);
+    RUN_TEST(test_page_cache_coalesces);
+    RUN_TEST(test_page_cache_evicts_oldest);
+    RUN_TEST(test_page_cache_spill);
+    RUN_TEST(test_page_cache_removes_spill);
+    RUN_TEST(test_page_cache_without_cache);
+    RUN_TEST(test_page_cache_d64_pattern);
+    RUN_TEST(test_page_cache_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
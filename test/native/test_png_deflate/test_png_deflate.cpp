@@ -0,0 +1,501 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../lib/printer-emulator/png_deflate.cpp"
+
+/********************************************************
+ * Reference checksums and a small inflate to check against
+ ********************************************************/
+
+static uint32_t crc32_bitwise(const uint8_t *buf, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= buf[i];
+        for (int j = 0; j < 8; j++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+    return ~crc;
+}
+
+static uint32_t adler32_bytewise(const uint8_t *buf, size_t len)
+{
+    uint32_t s1 = 1, s2 = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        s1 = (s1 + buf[i]) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    return (s2 << 16) | s1;
+}
+
+struct Inflate
+{
+    const std::vector<uint8_t> &in;
+    size_t pos = 2;
+    uint32_t bits = 0;
+    int count = 0;
+    std::vector<uint8_t> out;
+    bool failed = false;
+
+    struct Huffman
+    {
+        uint16_t counts[16];
+        uint16_t symbols[288];
+    };
+
+    Inflate(const std::vector<uint8_t> &in) : in(in) {}
+
+    uint32_t get(int n)
+    {
+        while (count < n)
+        {
+            if (pos >= in.size())
+            {
+                failed = true;
+                return 0;
+            }
+            bits |= (uint32_t)in[pos++] << count;
+            count += 8;
+        }
+        uint32_t v = bits & ((1u << n) - 1);
+        bits >>= n;
+        count -= n;
+        return v;
+    }
+
+    // Also checks the code is complete or a single code
+    bool build(Huffman &h, const uint8_t *lengths, int n)
+    {
+        memset(h.counts, 0, sizeof(h.counts));
+        for (int i = 0; i < n; i++)
+            h.counts[lengths[i]]++;
+
+        int left = 1;
+        for (int len = 1; len < 16; len++)
+        {
+            left = left * 2 - h.counts[len];
+            if (left < 0)
+                return false;
+        }
+
+        uint16_t offs[16] = { 0 };
+        for (int len = 1; len < 15; len++)
+            offs[len + 1] = offs[len] + h.counts[len];
+        for (int i = 0; i < n; i++)
+            if (lengths[i])
+                h.symbols[offs[lengths[i]]++] = i;
+        h.counts[0] = 0;
+        return true;
+    }
+
+    int decode(const Huffman &h)
+    {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++)
+        {
+            code |= get(1);
+            int c = h.counts[len];
+            if (code - c < first)
+                return h.symbols[index + (code - first)];
+            index += c;
+            first = (first + c) << 1;
+            code <<= 1;
+        }
+        failed = true;
+        return -1;
+    }
+
+    bool codes(const Huffman &lit, const Huffman &dist)
+    {
+        for (;;)
+        {
+            int symbol = decode(lit);
+            if (failed || symbol < 0)
+                return false;
+            if (symbol < 256)
+            {
+                out.push_back(symbol);
+                continue;
+            }
+            if (symbol == 256)
+                return true;
+
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            int length = length_base[symbol] + get(length_extra[symbol]);
+            int d = decode(dist);
+            if (d < 0 || d >= 30)
+                return false;
+            size_t distance = dist_base[d] + get(dist_extra[d]);
+            if (distance > out.size() || distance > DEFLATE_WINDOW_SIZE)
+                return false;
+            while (length--)
+                out.push_back(out[out.size() - distance]);
+        }
+    }
+
+    bool run()
+    {
+        if (in.size() < 6 || ((in[0] << 8) | in[1]) % 31 != 0 || (in[0] & 0x0F) != 8)
+            return false;
+
+        int last;
+        do
+        {
+            last = get(1);
+            int type = get(2);
+            Huffman lit, dist;
+            uint8_t lengths[288 + 30];
+
+            if (type == 1)
+            {
+                fixed_lengths(lengths, lengths + 288);
+                build(lit, lengths, 288);
+                build(dist, lengths + 288, 30);
+            }
+            else if (type == 2)
+            {
+                int hlit = get(5) + 257, hdist = get(5) + 1, hclen = get(4) + 4;
+                uint8_t cl[19] = { 0 };
+                for (int i = 0; i < hclen; i++)
+                    cl[cl_order[i]] = get(3);
+                Huffman clh;
+                if (!build(clh, cl, 19))
+                    return false;
+
+                int i = 0;
+                while (i < hlit + hdist)
+                {
+                    int symbol = decode(clh);
+                    if (symbol < 16)
+                        lengths[i++] = symbol;
+                    else
+                    {
+                        int repeat, value = 0;
+                        if (symbol == 16)
+                        {
+                            if (i == 0)
+                                return false;
+                            value = lengths[i - 1];
+                            repeat = 3 + get(2);
+                        }
+                        else if (symbol == 17)
+                            repeat = 3 + get(3);
+                        else
+                            repeat = 11 + get(7);
+                        if (i + repeat > hlit + hdist)
+                            return false;
+                        while (repeat--)
+                            lengths[i++] = value;
+                    }
+                    if (failed)
+                        return false;
+                }
+                if (lengths[256] == 0)
+                    return false;
+                if (!build(lit, lengths, hlit) || !build(dist, lengths + hlit, hdist))
+                    return false;
+            }
+            else
+                return false;
+
+            if (!codes(lit, dist))
+                return false;
+        } while (!last);
+
+        // Adler-32 after the last byte boundary
+        pos = in.size() - 4;
+        uint32_t adler = (uint32_t)in[pos] << 24 | in[pos + 1] << 16 | in[pos + 2] << 8 | in[pos + 3];
+        return !failed && adler == adler32_bytewise(out.data(), out.size());
+    }
+};
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t> &data, size_t piece, int *sinks = nullptr)
+{
+    std::vector<uint8_t> out;
+    if (sinks)
+        *sinks = 0;
+
+    pngDeflate *deflate = new pngDeflate([&](const uint8_t *d, size_t length) {
+        TEST_ASSERT_TRUE(length <= DEFLATE_OUT_SIZE);
+        out.insert(out.end(), d, d + length);
+        if (sinks)
+            (*sinks)++;
+    });
+    for (size_t i = 0; i < data.size(); i += piece)
+        deflate->write(data.data() + i, std::min(piece, data.size() - i));
+    deflate->finish();
+
+    TEST_ASSERT_EQUAL(data.size(), deflate->total_in());
+    TEST_ASSERT_EQUAL(out.size(), deflate->total_out());
+    delete deflate;
+    return out;
+}
+
+static void round_trip(const std::vector<uint8_t> &data, size_t piece)
+{
+    auto compressed = compress(data, piece);
+    Inflate inflate(compressed);
+    TEST_ASSERT_TRUE(inflate.run());
+    TEST_ASSERT_EQUAL(data.size(), inflate.out.size());
+    TEST_ASSERT_TRUE(inflate.out == data);
+}
+
+static uint32_t lcg = 12345;
+static uint8_t next_random()
+{
+    lcg = lcg * 1103515245 + 12345;
+    return lcg >> 16;
+}
+
+/********************************************************
+ * Reference print job: 192 palette lines of 320 pixels,
+ * text rows with blank space and repeated lines, the way
+ * the printer emulators send a page
+ ********************************************************/
+
+static std::vector<std::vector<uint8_t>> print_job()
+{
+    std::vector<std::vector<uint8_t>> lines;
+    for (int y = 0; y < 192; y++)
+    {
+        std::vector<uint8_t> line(320, 15);
+        int row = y / 8, scan = y % 8;
+        if (row % 3 != 2 && scan < 7)
+        {
+            // Glyph columns, 8 pixels a character
+            for (int x = 8; x < 312; x++)
+            {
+                int ch = (x / 8) * 7 + row * 13;
+                if ((ch % 11) == 0)
+                    continue;
+                if (((ch * 31 + scan * 7) >> ((x % 8) >> 1)) & 1)
+                    line[x] = 0;
+            }
+        }
+        if (y >= 176)
+            for (int x = 0; x < 320; x++)
+                line[x] = (x * 16 / 320) + 0x10 * ((y - 176) / 4);   // colour bars
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Filter the page the way pngPrinter::png_add_data() does
+static std::vector<uint8_t> filter_job(const std::vector<std::vector<uint8_t>> &lines, bool adaptive)
+{
+    std::vector<uint8_t> out;
+    uint8_t prev[320] = { 0 };
+    uint8_t filtered[3][321];
+
+    for (auto &line : lines)
+    {
+        uint32_t sums[3] = { 0, 0, 0 };
+        filtered[0][0] = 0;
+        filtered[1][0] = 1;
+        filtered[2][0] = 2;
+        for (int x = 0; x < 320; x++)
+        {
+            uint8_t none = line[x];
+            uint8_t sub = line[x] - (x ? line[x - 1] : 0);
+            uint8_t up = line[x] - prev[x];
+            filtered[0][x + 1] = none;
+            filtered[1][x + 1] = sub;
+            filtered[2][x + 1] = up;
+            sums[0] += (none < 128) ? none : 256 - none;
+            sums[1] += (sub < 128) ? sub : 256 - sub;
+            sums[2] += (up < 128) ? up : 256 - up;
+        }
+        int best = 0;
+        if (adaptive)
+            for (int f = 1; f < 3; f++)
+                if (sums[f] < sums[best])
+                    best = f;
+        out.insert(out.end(), filtered[best], filtered[best] + 321);
+        memcpy(prev, line.data(), 320);
+    }
+    return out;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_png_checksums(void)
+{
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, png_crc32(0, check, 9));
+    TEST_ASSERT_EQUAL_HEX32(0x091E01DE, png_adler32(1, check, 9));
+
+    // IEND's CRC, the one png_end() has precomputed
+    TEST_ASSERT_EQUAL_HEX32(0xAE426082, png_crc32(0, (const uint8_t *)"IEND", 4));
+
+    std::vector<uint8_t> data(20000);
+    for (auto &b : data)
+        b = next_random();
+    for (size_t len : { 0, 1, 3, 4, 5, 15, 16, 17, 5551, 5552, 5553, 20000 })
+    {
+        TEST_ASSERT_EQUAL_HEX32(crc32_bitwise(data.data(), len), png_crc32(0, data.data(), len));
+        TEST_ASSERT_EQUAL_HEX32(adler32_bytewise(data.data(), len), png_adler32(1, data.data(), len));
+    }
+
+    // All 0xFF is the worst case for the deferred modulo
+    std::vector<uint8_t> ones(20000, 0xFF);
+    TEST_ASSERT_EQUAL_HEX32(adler32_bytewise(ones.data(), ones.size()), png_adler32(1, ones.data(), ones.size()));
+
+    // Running values carry on across calls
+    uint32_t crc = png_crc32(0, data.data(), 777);
+    TEST_ASSERT_EQUAL_HEX32(crc32_bitwise(data.data(), 5000), png_crc32(crc, data.data() + 777, 5000 - 777));
+    uint32_t adler = png_adler32(1, data.data(), 777);
+    TEST_ASSERT_EQUAL_HEX32(adler32_bytewise(data.data(), 5000), png_adler32(adler, data.data() + 777, 5000 - 777));
+}
+
+void test_png_deflate_codes(void)
+{
+    for (int length = 3; length <= 258; length++)
+    {
+        int l = length_index(length);
+        TEST_ASSERT_TRUE(length >= length_base[l] && length - length_base[l] < (1 << length_extra[l]));
+    }
+    for (int distance = 1; distance <= 32768; distance++)
+    {
+        int d = dist_index(distance);
+        TEST_ASSERT_TRUE(distance >= dist_base[d] && distance - dist_base[d] < (1 << dist_extra[d]));
+    }
+}
+
+void test_png_deflate_round_trip(void)
+{
+    round_trip({}, 1);
+    round_trip({ 42 }, 1);
+    round_trip(std::vector<uint8_t>(100000, 7), 321);
+
+    std::vector<uint8_t> random(50000);
+    for (auto &b : random)
+        b = next_random();
+    round_trip(random, 321);
+    round_trip(random, 4096);
+
+    // Text like, mostly short matches
+    std::vector<uint8_t> text;
+    const char *words[] = { "LOAD", "\"$\"", ",8", "READY.", "PRINT", "GOTO", "10", " " };
+    while (text.size() < 30000)
+    {
+        const char *w = words[next_random() % 8];
+        text.insert(text.end(), w, w + strlen(w));
+    }
+    for (size_t piece : { 1, 7, 321, 30000 })
+        round_trip(text, piece);
+
+    // Few symbols, long runs and matches at the window's edge
+    std::vector<uint8_t> sparse;
+    for (int i = 0; i < 40000; i++)
+        sparse.push_back((i % (DEFLATE_WINDOW_SIZE + 1)) < 3 ? 1 : (next_random() & 1));
+    round_trip(sparse, 1000);
+
+    auto job = filter_job(print_job(), true);
+    round_trip(job, 321);
+}
+
+void test_png_deflate_benchmark(void)
+{
+    auto lines = print_job();
+    const int rounds = 100;
+
+    // Stored blocks as before: header, 5 bytes a block, the data, Adler-32
+    const uint32_t image = 321 * 192;
+    const uint32_t stored = 2 + ((image + 0xFFFE) / 0xFFFF) * 5 + image + 4 + 12;
+
+    // Old path, a byte at a time through the CRC, Adler and fputc
+    FILE *file = tmpfile();
+    auto start = std::chrono::steady_clock::now();
+    uint32_t checks = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        fseek(file, 0, SEEK_SET);
+        uint32_t crc = 0, adler = 1;
+        auto put = [&](uint8_t c) {
+            crc = ~crc;
+            crc = (crc >> 8) ^ crc32_tables.t[0][(crc ^ c) & 0xFF];
+            crc = ~crc;
+            uint32_t s1 = adler & 0xFFFF, s2 = adler >> 16;
+            s1 = (s1 + c) % 65521;
+            s2 = (s2 + s1) % 65521;
+            adler = (s2 << 16) | s1;
+            fputc(c, file);
+        };
+        for (auto &line : lines)
+        {
+            put(0);
+            for (auto b : line)
+                put(b);
+        }
+        checks += crc ^ adler;
+    }
+    auto stored_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t sizes[2] = { 0, 0 };
+    double times[2] = { 0, 0 };
+    for (int adaptive = 0; adaptive < 2; adaptive++)
+    {
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+        {
+            fseek(file, 0, SEEK_SET);
+            size_t written = 0;
+            pngDeflate *deflate = new pngDeflate([&](const uint8_t *data, size_t length) {
+                uint8_t chunk[8] = { 0 };
+                fwrite(chunk, 1, 8, file);
+                fwrite(data, 1, length, file);
+                uint32_t crc = png_crc32(png_crc32(0, (const uint8_t *)"IDAT", 4), data, length);
+                fwrite(&crc, 1, 4, file);
+                written += 12 + length;
+            });
+            auto job = filter_job(lines, adaptive);
+            for (size_t i = 0; i < job.size(); i += 321)
+                deflate->write(job.data() + i, 321);
+            deflate->finish();
+            delete deflate;
+            sizes[adaptive] = written;
+        }
+        times[adaptive] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    fclose(file);
+
+    printf("print job %u bytes: stored %u bytes %6.0f pages/sec, deflate %u bytes %6.0f pages/sec,"
+           " filtered %u bytes %6.0f pages/sec, encoder %u bytes (%x)\r\n",
+           image, stored, rounds / stored_time, (unsigned)sizes[0], rounds / times[0],
+           (unsigned)sizes[1], rounds / times[1], (unsigned)sizeof(pngDeflate), checks);
+
+    TEST_ASSERT_TRUE(sizes[0] * 8 < stored);
+    TEST_ASSERT_TRUE(sizes[1] * 8 < stored);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_png_checksums);
+    RUN_TEST(test_png_deflate_codes);
+    RUN_TEST(test_png_deflate_round_trip);
+    RUN_TEST(test_png_deflate_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -0,0 +1,150 @@
+// Checks that streaming SAM's output in chunks gives the same samples as
+// rendering the whole utterance into the buffer, and that a long text is
+// streamed without the buffer and without waiting for the end of the text.
+
+#include "unity.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../lib/sam/reciter.c"
+#include "../lib/sam/render.c"
+#include "../lib/sam/sam.c"
+#include "../lib/sam/samlib.cpp"
+
+// Only called with -debug
+void PrintPhonemes(unsigned char *phonemeindex, unsigned char *phonemeLength, unsigned char *stress) {}
+void PrintOutput(unsigned char *flag, unsigned char *f1, unsigned char *f2, unsigned char *f3,
+                 unsigned char *a1, unsigned char *a2, unsigned char *a3, unsigned char *p) {}
+void PrintRule(int offset) {}
+
+#define SHORT_TEXT "HELLO, MY NAME IS SAM. I LIVE IN YOUR DISK DRIVE."
+#define LONG_TEXT "FOUR SCORE AND SEVEN YEARS AGO OUR FATHERS BROUGHT FORTH ON THIS CONTINENT, " \
+                  "A NEW NATION, CONCEIVED IN LIBERTY, AND DEDICATED TO THE PROPOSITION THAT " \
+                  "ALL MEN ARE CREATED EQUAL."
+
+struct Stream
+{
+    std::vector<unsigned char> samples;
+    std::vector<int> chunks;
+    int rendered_at_first = -1; // where the renderer was when the first chunk came out
+};
+
+static void collect(void *user, const unsigned char *s, int count)
+{
+    Stream *stream = (Stream *)user;
+    if (stream->chunks.empty())
+        stream->rendered_at_first = bufferpos / 50;
+    stream->samples.insert(stream->samples.end(), s, s + count);
+    stream->chunks.push_back(count);
+}
+
+static void speak(const char *text)
+{
+    // As sam() passes it on
+    char phonemes[256];
+    snprintf(phonemes, sizeof(phonemes), "%s [", text);
+    TEST_ASSERT_TRUE(TextToPhonemes((unsigned char *)phonemes));
+    SetInput(phonemes);
+    TEST_ASSERT_TRUE(SAMMain());
+}
+
+static std::vector<unsigned char> render_buffered(const char *text)
+{
+    SetOutputSink(NULL, NULL);
+    speak(text);
+    std::vector<unsigned char> samples(buffer, buffer + bufferpos / 50);
+    FreeBuffer();
+    return samples;
+}
+
+static Stream render_streamed(const char *text)
+{
+    Stream stream;
+    SetOutputSink(collect, &stream);
+    speak(text);
+    SetOutputSink(NULL, NULL);
+    return stream;
+}
+
+void setUp(void)
+{
+    // The renderer carries its timing from one utterance to the next, start
+    // each test from the same place
+    render_buffered(SHORT_TEXT);
+}
+
+void tearDown(void)
+{
+}
+
+void test_sam_stream_matches_buffer(void)
+{
+    auto expected = render_buffered(SHORT_TEXT);
+    auto stream = render_streamed(SHORT_TEXT);
+
+    TEST_ASSERT_TRUE(expected.size() > SAM_CHUNK * 4);
+    TEST_ASSERT_EQUAL(expected.size(), stream.samples.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), stream.samples.data(), expected.size());
+
+    for (size_t i = 0; i + 1 < stream.chunks.size(); i++)
+        TEST_ASSERT_EQUAL(SAM_CHUNK, stream.chunks[i]);
+    TEST_ASSERT_TRUE(stream.chunks.back() > 0 && stream.chunks.back() <= SAM_CHUNK);
+}
+
+void test_sam_stream_long_text(void)
+{
+    auto expected = render_buffered(LONG_TEXT);
+    auto stream = render_streamed(LONG_TEXT);
+
+    TEST_ASSERT_EQUAL(expected.size(), stream.samples.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), stream.samples.data(), expected.size());
+
+    // Nothing collected the utterance, and the first chunk went out long
+    // before the end of it
+    TEST_ASSERT_NULL(buffer);
+    TEST_ASSERT_TRUE(stream.rendered_at_first < SAM_CHUNK * 2);
+    TEST_ASSERT_TRUE(stream.samples.size() > 22050 * 3);
+}
+
+void test_sam_wav(void)
+{
+    auto expected = render_buffered(SHORT_TEXT);
+
+    char filename[] = "/tmp/test_sam.wav";
+    char *argv[] = { (char *)"sam", (char *)"-wav", filename, (char *)SHORT_TEXT };
+    TEST_ASSERT_EQUAL(0, sam(4, argv));
+
+    FILE *file = fopen(filename, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    std::vector<unsigned char> wav(44 + expected.size() + 1);
+    size_t length = fread(wav.data(), 1, wav.size(), file);
+    fclose(file);
+    remove(filename);
+
+    unsigned int filesize, datalength;
+    memcpy(&filesize, wav.data() + 4, 4);
+    memcpy(&datalength, wav.data() + 40, 4);
+    TEST_ASSERT_EQUAL(44 + expected.size(), length);
+    TEST_ASSERT_EQUAL(length - 8, filesize);
+    TEST_ASSERT_EQUAL(expected.size(), datalength);
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), wav.data() + 44, expected.size());
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_sam_stream_matches_buffer);
+    RUN_TEST(test_sam_stream_long_text);
+    RUN_TEST(test_sam_wav);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -1,9 +1,39 @@
 #include "unity.h"
 
 #include "punycode.h"
+#include <chrono>
 #include <string>
 #include "../lib/utils/string_utils.cpp"
 
+// The character at a time conversions the bulk ones replaced
+static std::string oldToUTF8(const std::string &petsciiInput)
+{
+    std::string utf8string;
+    for(char petscii : petsciiInput) {
+        if(petscii != 0)
+        {
+            U8Char u8char(petscii);
+            utf8string+=u8char.toUtf8();
+        }
+    }
+    return utf8string;
+}
+
+static std::string oldToPETSCII2(const std::string &utfInputString)
+{
+    std::string petsciiString;
+    char* utfInput = (char*)utfInputString.c_str();
+    auto end = utfInput + utfInputString.length();
+
+    while(utfInput<end) {
+        U8Char u8char(' ');
+        size_t skip = u8char.fromCharArray(utfInput);
+        petsciiString+=(char)u8char.toPetscii();
+        utfInput+=skip;
+    }
+    return petsciiString;
+}
+
 void setUp(void)
 {
 }
@@ -27,12 +57,83 @@ void test_PetsciiUtf() {
     std::string utf8 = mstr::toUTF8(petscii);
     std::string petscii2 = mstr::toPETSCII2(utf8);
     std::string utf8again = mstr::toUTF8(petscii2);
+
+    TEST_ASSERT_EQUAL_STRING("\xe2\x94\x8c", utf8char.c_str());
+    TEST_ASSERT_EQUAL_STRING("FB64", utf8.c_str());
+    TEST_ASSERT_EQUAL_STRING(petscii.c_str(), petscii2.c_str());
+    TEST_ASSERT_EQUAL_STRING(utf8.c_str(), utf8again.c_str());
     // Debug_printv("Petscii: [%s]\r\n", petscii.c_str());
     // Debug_printv("UTF8: [%s] - should be: [\u250c\u2534\u252c\u2524]\r\n", utf8.c_str());
     // Debug_printv("And back to petscii: [%s]\r\n", petscii2.c_str());
     // Debug_printv("And back to utf8: [%s]\r\n", utf8again.c_str());
 }
 
+void test_PetsciiUtfTables() {
+    // Every PETSCII code, NUL dropped, matches U8Char one character at a time
+    std::string all;
+    for (int p = 1; p < 256; p++)
+        all += (char)p;
+    std::string utf8 = mstr::toUTF8(all);
+    TEST_ASSERT_EQUAL_STRING(oldToUTF8(all).c_str(), utf8.c_str());
+    TEST_ASSERT_EQUAL(0, mstr::toUTF8(std::string("\0", 1)).size());
+
+    // And back, characters PETSCII has twice come back as the lower code
+    std::string back = mstr::toPETSCII2(utf8);
+    TEST_ASSERT_EQUAL(255, back.size());
+    for (int p = 1; p < 256; p++)
+    {
+        uint8_t b = back[p - 1];
+        TEST_ASSERT_TRUE(b <= p);
+        TEST_ASSERT_EQUAL_STRING(mstr::toUTF8(std::string(1, (char)p)).c_str(), mstr::toUTF8(std::string(1, (char)b)).c_str());
+    }
+
+    // Graphics and Private Use Area glyphs, no longer "missing"
+    TEST_ASSERT_EQUAL_STRING("\xb0\xdd\xa0\xc0", mstr::toPETSCII2("\u250c\u2502\u00a0\u2500").c_str());
+    TEST_ASSERT_EQUAL_STRING("\x80\x8d", mstr::toPETSCII2("\ue015\u2028").c_str());
+    TEST_ASSERT_EQUAL_STRING("aBC", mstr::toPETSCII2("Abc").c_str());
+
+    // Not in PETSCII, cut off or broken sequences
+    TEST_ASSERT_EQUAL_STRING("?a?b?", mstr::toPETSCII2("\u00e9A\xf0\x9f\x98\x80" "B\xe2\x94").c_str());
+    TEST_ASSERT_EQUAL_STRING("?A", mstr::toPETSCII2("\x80" "a").c_str());
+
+    // In place, the way the listing converts a directory entry
+    char name[] = "\u250c\u2502 Abc \ue015";
+    size_t length = U8Char::utf8ToPetscii(name, name);
+    TEST_ASSERT_EQUAL_STRING("\xb0\xdd aBC \x80", std::string(name, length).c_str());
+}
+
+void test_PetsciiUtfBenchmark() {
+    // A directory listing worth of names, mostly ASCII with some graphics
+    std::vector<std::string> names;
+    for (int i = 0; i < 144; i++)
+    {
+        std::string name = mstr::format("GAME %03d", i);
+        if (i % 4 == 0)
+            name += "\xb0\xae\xa0\xc1";
+        names.push_back(name);
+    }
+
+    const int rounds = 200;
+    size_t old_size = 0, new_size = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (auto &name : names)
+            old_size += oldToPETSCII2(oldToUTF8(name)).size();
+    auto old_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        for (auto &name : names)
+            new_size += mstr::toPETSCII2(mstr::toUTF8(name)).size();
+    auto new_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("petscii -> utf8 -> petscii: per character %8.0f names/sec  tables %8.0f names/sec\r\n",
+        rounds * names.size() / old_time, rounds * names.size() / new_time);
+
+    TEST_ASSERT_EQUAL(old_size, new_size);
+}
+
 void test_Punycode() {
     // https://www.name.com/punycode-converter
     // https://r12a.github.io/app-conversion/
@@ -66,12 +167,22 @@ void test_Punycode() {
 
 }
 
+void test_Format() {
+    // Long enough that the size pass and the formatting pass both walk all the arguments
+    std::string name(100, 'x');
+    std::string text = mstr::format("%s:%d:%s:%u", name.c_str(), -42, "end", 7u);
+    TEST_ASSERT_EQUAL_STRING((name + ":-42:end:7").c_str(), text.c_str());
+}
+
 void process()
 {
     UNITY_BEGIN();
 
     RUN_TEST(test_PetsciiUtf);
+    RUN_TEST(test_PetsciiUtfTables);
+    RUN_TEST(test_PetsciiUtfBenchmark);
     RUN_TEST(test_Punycode);
+    RUN_TEST(test_Format);
 
     UNITY_END();
 }
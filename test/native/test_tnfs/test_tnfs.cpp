@@ -0,0 +1,387 @@
+// Reads a file through tnfslib from a stand-in TNFS server over a simulated
+// UDP link, checks the read window brings back the right data when datagrams
+// are lost, reordered or duplicated, and times it against one READ at a time.
+
+#include "unity.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Simulated clock, moved on by every wait tnfslib makes through fnSystem, so
+// latency and timeouts cost nothing but the polling around them
+static uint64_t now_us = 0;
+
+// Nothing here ever shuts down
+struct StandInBus
+{
+    bool getShuttingDown() { return false; }
+} TestBus;
+#define SYSTEM_BUS TestBus
+
+// _tnfs_udp_send() and _tnfs_udp_recv() come from here instead of fnUDP, see
+// tnfslib_udp.h, and go to the stand-in server below
+#define TNFS_UDP_SIMULATE_POOR_CONNECTION
+
+#include "../lib/TNFSlib/tnfslib.cpp"
+#include "../lib/TNFSlib/tnfslibMountInfo.cpp"
+#include "../lib/tcpip/fnUDP.cpp"
+#include "../lib/tcpip/fnTcpClient.cpp"
+#include "../lib/tcpip/fnDNS.cpp"
+#include "../lib/utils/cbuf.cpp"
+#include "../lib/compat/strlcpy.c"
+
+SystemManager::SystemManager() {}
+uint64_t SystemManager::millis() { return now_us / 1000; }
+void SystemManager::delay_microseconds(uint32_t us) { now_us += us; }
+void SystemManager::delay(uint32_t ms) { now_us += ms * 1000ULL; }
+SystemManager fnSystem;
+
+#define FILE_SIZE 174848    // a D64
+#define SESSION 0x1234
+#define HANDLE 7
+
+// Stands in for a TNFS server at the other end of a UDP link with latency,
+// loss, reordering and duplicates. Datagrams reach the server, and the
+// replies the client, once their time on the link is up. Like tnfsd it
+// serves every READ it gets from the file position, except that a request
+// with the same sequence number as the one before gets the same reply again.
+class StandInServer
+{
+    struct Datagram {
+        uint64_t at;
+        uint32_t order;
+        std::vector<uint8_t> data;
+    };
+
+    std::vector<uint8_t> _data;
+    uint32_t _position = 0;
+    std::vector<uint8_t> _last_reply;
+
+    std::vector<Datagram> _to_server;
+    std::vector<Datagram> _to_client;
+    uint32_t _order = 0;
+    std::mt19937 _random;
+
+    bool chance(double p)
+    {
+        return p > 0 && std::uniform_real_distribution<double>(0, 1)(_random) < p;
+    }
+
+    void transmit(std::vector<Datagram> &queue, const uint8_t *data, size_t length)
+    {
+        if (chance(loss))
+            return;
+
+        int copies = chance(duplicate) ? 2 : 1;
+        for (int i = 0; i < copies; i++)
+        {
+            // Held back long enough for later datagrams to overtake it
+            uint64_t delay = latency_us;
+            if (chance(reorder))
+                delay += latency_us * 2;
+            queue.push_back({ now_us + delay, _order++, std::vector<uint8_t>(data, data + length) });
+        }
+    }
+
+    // Takes the first datagram whose time on the link is up
+    bool arrived(std::vector<Datagram> &queue, std::vector<uint8_t> &data)
+    {
+        auto first = queue.end();
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+            if (it->at <= now_us && (first == queue.end() || it->at < first->at || (it->at == first->at && it->order < first->order)))
+                first = it;
+        if (first == queue.end())
+            return false;
+
+        data = first->data;
+        queue.erase(first);
+        return true;
+    }
+
+    void serve(const std::vector<uint8_t> &request)
+    {
+        requests++;
+
+        if (!_last_reply.empty() && _last_reply[2] == request[2])
+        {
+            transmit(_to_client, _last_reply.data(), _last_reply.size());
+            return;
+        }
+
+        uint8_t reply[TNFS_HEADER_SIZE + TNFS_PAYLOAD_SIZE];
+        memcpy(reply, request.data(), TNFS_HEADER_SIZE);
+        const uint8_t *payload = request.data() + TNFS_HEADER_SIZE;
+        uint8_t *out = reply + TNFS_HEADER_SIZE;
+        size_t length = 1;
+        out[0] = TNFS_RESULT_SUCCESS;
+
+        switch (request[3])
+        {
+        case TNFS_CMD_MOUNT:
+            reply[0] = TNFS_LOBYTE_FROM_UINT16(SESSION);
+            reply[1] = TNFS_HIBYTE_FROM_UINT16(SESSION);
+            out[1] = 0x02;  // version 1.2
+            out[2] = 0x01;
+            out[3] = 10;    // least retry delay in ms
+            out[4] = 0;
+            length = 5;
+            break;
+
+        case TNFS_CMD_STAT:
+            memset(out + 1, 0, 22);
+            TNFS_UINT32_TO_LOHI_BYTEPTR(_data.size(), out + OFFSET_STAT_FILESIZE);
+            length = 23;
+            break;
+
+        case TNFS_CMD_OPEN:
+            _position = 0;
+            out[1] = HANDLE;
+            length = 2;
+            break;
+
+        case TNFS_CMD_READ:
+        {
+            reads++;
+            uint32_t count = std::min<uint32_t>(TNFS_UINT16_FROM_LOHI_BYTEPTR(payload + 1), _data.size() - _position);
+            if (count == 0)
+            {
+                out[0] = TNFS_RESULT_END_OF_FILE;
+                break;
+            }
+            out[1] = TNFS_LOBYTE_FROM_UINT16(count);
+            out[2] = TNFS_HIBYTE_FROM_UINT16(count);
+            memcpy(out + 3, _data.data() + _position, count);
+            _position += count;
+            length = 3 + count;
+            break;
+        }
+
+        case TNFS_CMD_LSEEK:
+        {
+            int32_t offset = TNFS_UINT32_FROM_LOHI_BYTEPTR(payload + 2);
+            if (payload[1] == SEEK_SET)
+                _position = offset;
+            else if (payload[1] == SEEK_CUR)
+                _position += offset;
+            else
+                _position = _data.size() + offset;
+
+            // From 1.2 on the reply carries where the file position ended up
+            if (reports_position)
+            {
+                TNFS_UINT32_TO_LOHI_BYTEPTR(_position, out + 1);
+                length = 5;
+            }
+            break;
+        }
+        }
+
+        _last_reply.assign(reply, reply + TNFS_HEADER_SIZE + length);
+        transmit(_to_client, reply, TNFS_HEADER_SIZE + length);
+    }
+
+public:
+    uint32_t latency_us = 2000; // one way
+    double loss = 0;            // each datagram, either way
+    double reorder = 0;
+    double duplicate = 0;
+    bool reports_position = true;
+
+    uint32_t datagrams = 0;     // sent by the client
+    uint32_t requests = 0;      // that reached the server
+    uint32_t reads = 0;
+
+    StandInServer(size_t size, uint32_t seed = 1) : _random(seed)
+    {
+        for (size_t i = 0; i < size; i++)
+            _data.push_back((uint8_t)(i * 11 + (i >> 9)));
+    }
+
+    const std::vector<uint8_t> &data() { return _data; }
+
+    void send(const uint8_t *data, size_t length)
+    {
+        datagrams++;
+        transmit(_to_server, data, length);
+    }
+
+    int receive(uint8_t *data, size_t size)
+    {
+        // Whatever has reached the server by now gets served first
+        std::vector<uint8_t> datagram;
+        while (arrived(_to_server, datagram))
+            serve(datagram);
+
+        if (!arrived(_to_client, datagram))
+            return -1;
+
+        size_t length = std::min(size, datagram.size());
+        memcpy(data, datagram.data(), length);
+        return length;
+    }
+};
+
+static StandInServer *server = nullptr;
+
+bool _tnfs_udp_send(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_size)
+{
+    server->send(pkt.rawData, TNFS_HEADER_SIZE + payload_size);
+    return true;
+}
+
+int _tnfs_udp_recv(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt)
+{
+    return server->receive(pkt.rawData, sizeof(pkt.rawData));
+}
+
+struct Transfer
+{
+    std::vector<uint8_t> data;
+    double seconds;     // simulated
+    bool read_window;   // still on at the end
+};
+
+// Mounts, reads the whole file the way TNFSIStream does and unmounts
+static Transfer readFile(StandInServer &stand_in, bool read_window, uint16_t chunk = 256)
+{
+    server = &stand_in;
+    now_us = 0;
+
+    tnfsMountInfo m("stand-in");
+    m.protocol = TNFS_PROTOCOL_UDP;
+    m.read_window = read_window;
+    TEST_ASSERT_EQUAL(TNFS_RESULT_SUCCESS, tnfs_mount(&m));
+
+    int16_t handle;
+    TEST_ASSERT_EQUAL(TNFS_RESULT_SUCCESS, tnfs_open(&m, "/file.d64", TNFS_OPENMODE_READ, 0, &handle));
+
+    Transfer transfer;
+    std::vector<uint8_t> buf(chunk);
+    int result;
+    do
+    {
+        // The last chunk can come with END_OF_FILE
+        uint16_t got = 0;
+        result = tnfs_read(&m, handle, buf.data(), chunk, &got);
+        transfer.data.insert(transfer.data.end(), buf.data(), buf.data() + got);
+    } while (result == TNFS_RESULT_SUCCESS);
+    TEST_ASSERT_EQUAL(TNFS_RESULT_END_OF_FILE, result);
+
+    tnfs_close(&m, handle);
+    tnfs_umount(&m);
+
+    transfer.seconds = now_us / 1000000.0;
+    transfer.read_window = m.read_window;
+    return transfer;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_tnfs_read_window(void)
+{
+    StandInServer stop_and_wait(FILE_SIZE);
+    auto slow = readFile(stop_and_wait, false);
+    TEST_ASSERT_TRUE(slow.data == stop_and_wait.data());
+
+    StandInServer windowed(FILE_SIZE);
+    auto fast = readFile(windowed, true);
+    TEST_ASSERT_TRUE(fast.data == windowed.data());
+    TEST_ASSERT_TRUE(fast.read_window);
+
+    // Same READs, far fewer round trips
+    TEST_ASSERT_EQUAL(stop_and_wait.reads, windowed.reads);
+    TEST_ASSERT_TRUE(fast.seconds * 4 < slow.seconds);
+}
+
+void test_tnfs_read_window_poor_link(void)
+{
+    // Each on its own, then all at once, a few runs each
+    struct { double loss, reorder, duplicate; } links[] = {
+        { 0.02, 0, 0 }, { 0, 0.05, 0 }, { 0, 0, 0.05 }, { 0.02, 0.05, 0.05 },
+    };
+
+    for (auto &link : links)
+    {
+        for (uint32_t seed = 1; seed <= 3; seed++)
+        {
+            StandInServer stand_in(FILE_SIZE / 4, seed);
+            stand_in.loss = link.loss;
+            stand_in.reorder = link.reorder;
+            stand_in.duplicate = link.duplicate;
+
+            auto transfer = readFile(stand_in, true, 254);
+            TEST_ASSERT_TRUE(transfer.data == stand_in.data());
+        }
+    }
+}
+
+void test_tnfs_read_window_needs_position(void)
+{
+    // A server from before 1.2 doesn't say where LSEEK left it
+    StandInServer stand_in(FILE_SIZE / 8);
+    stand_in.reports_position = false;
+
+    auto transfer = readFile(stand_in, true);
+    TEST_ASSERT_TRUE(transfer.data == stand_in.data());
+    TEST_ASSERT_FALSE(transfer.read_window);
+}
+
+void test_tnfs_benchmark(void)
+{
+    struct { const char *name; double loss, reorder, duplicate; } links[] = {
+        { "clean", 0, 0, 0 },
+        { "1% loss", 0.01, 0, 0 },
+        { "5% reorder", 0, 0.05, 0 },
+        { "5% duplicate", 0, 0, 0.05 },
+    };
+
+    printf("%d bytes, 2ms each way, %dms timeout, simulated time\r\n", FILE_SIZE, TNFS_TIMEOUT);
+    for (auto &link : links)
+    {
+        double seconds[2];
+        uint32_t datagrams[2];
+        for (int window = 0; window < 2; window++)
+        {
+            StandInServer stand_in(FILE_SIZE);
+            stand_in.loss = link.loss;
+            stand_in.reorder = link.reorder;
+            stand_in.duplicate = link.duplicate;
+
+            auto transfer = readFile(stand_in, window);
+            TEST_ASSERT_TRUE(transfer.data == stand_in.data());
+            seconds[window] = transfer.seconds;
+            datagrams[window] = stand_in.datagrams;
+        }
+        printf("%-14s stop and wait %6.2fs (%4u sent)  windowed %6.2fs (%4u sent)\r\n",
+               link.name, seconds[0], datagrams[0], seconds[1], datagrams[1]);
+
+        // A window that goes wrong mustn't cost more than it saves
+        TEST_ASSERT_TRUE(seconds[1] < seconds[0]);
+    }
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_tnfs_read_window);
+    RUN_TEST(test_tnfs_read_window_poor_link);
+    RUN_TEST(test_tnfs_read_window_needs_position);
+    RUN_TEST(test_tnfs_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
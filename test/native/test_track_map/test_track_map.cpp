@@ -0,0 +1,226 @@
+#include "unity.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "../lib/meatloaf/disk/track_map.h"
+
+// Sector counts per track, as the D64MStream family works them out
+struct Geometry
+{
+    const char *name;
+    uint8_t end_track;
+    std::vector<uint16_t> sectorsPerTrack;
+    std::function<uint8_t(uint8_t)> speedZone;
+
+    uint16_t getSectorCount(uint8_t track)
+    {
+        return sectorsPerTrack[speedZone(track)];
+    }
+};
+
+static std::vector<Geometry> geometries {
+    { "d64", 35, { 17, 18, 19, 21 }, [](uint8_t track) { return (track < 18) + (track < 25) + (track < 31); } },
+    { "d64/42", 42, { 17, 18, 19, 21 }, [](uint8_t track) { return (track < 18) + (track < 25) + (track < 31); } },
+    { "d71", 70, { 17, 18, 19, 21 }, [](uint8_t track) {
+        if (track <= 35)
+            return (track < 18) + (track < 25) + (track < 31);
+        else
+            return (track < 53) + (track < 60) + (track < 66);
+    } },
+    { "d80", 77, { 23, 25, 27, 29 }, [](uint8_t track) { return (track < 40) + (track < 54) + (track < 65); } },
+    { "d81", 80, { 40 }, [](uint8_t track) { return 0; } },
+    { "d82", 154, { 23, 25, 27, 29 }, [](uint8_t track) {
+        if (track < 78)
+            return (track < 40) + (track < 54) + (track < 65);
+        else
+            return (track < 117) + (track < 131) + (track < 142);
+    } },
+    { "dnp", 255, { 256 }, [](uint8_t track) { return 0; } },
+};
+
+// The old D64MStream::seekSector loop
+static uint32_t loopBlock(Geometry &g, uint8_t track, uint8_t sector)
+{
+    uint32_t sectorOffset = 0;
+
+    track--;
+    for (uint8_t index = 0; index < track; ++index)
+        sectorOffset += g.getSectorCount(index + 1);
+
+    return sectorOffset + sector;
+}
+
+static TrackMap buildMap(Geometry &g)
+{
+    TrackMap map;
+    map.build(g.end_track, [&g](uint8_t track) { return g.getSectorCount(track); });
+    return map;
+}
+
+// A 35 track D64 with a full directory (144 entries over 18 sectors)
+// and one file chained through every other free block
+struct Image
+{
+    std::vector<uint8_t> data;
+    std::vector<std::pair<uint8_t, uint8_t>> directory;
+    std::vector<std::pair<uint8_t, uint8_t>> file;
+
+    Image(Geometry &g, TrackMap &map) : data(map.blocks() * 256, 0)
+    {
+        // Directory, interleave 3 on track 18
+        for (uint8_t s : { 1, 4, 7, 10, 13, 16, 2, 5, 8, 11, 14, 17, 3, 6, 9, 12, 15, 18 })
+            directory.push_back({ 18, s });
+        link(map, directory);
+
+        // File, interleave 10 on every other track
+        for (uint8_t t = 1; t <= g.end_track; t++)
+        {
+            if (t == 18)
+                continue;
+
+            uint16_t count = g.getSectorCount(t);
+            std::vector<bool> used(count, false);
+            for (uint16_t i = 0, s = 0; i < count; i++, s = (s + 10) % count)
+            {
+                while (used[s])
+                    s = (s + 1) % count;
+                used[s] = true;
+                file.push_back({ t, (uint8_t)s });
+            }
+        }
+        link(map, file);
+    }
+
+    void link(TrackMap &map, std::vector<std::pair<uint8_t, uint8_t>> &chain)
+    {
+        for (size_t i = 0; i < chain.size(); i++)
+        {
+            uint8_t *block = &data[map.block(chain[i].first, chain[i].second) * 256];
+            block[0] = (i + 1 < chain.size()) ? chain[i + 1].first : 0;
+            block[1] = (i + 1 < chain.size()) ? chain[i + 1].second : 0xFF;
+            for (int b = 2; b < 256; b++)
+                block[b] = (uint8_t)(i + b);
+        }
+    }
+};
+
+// Follow a sector chain the way seekEntry()/readFile() do, one seek per block
+// (and one per entry for the directory), and sum what was read
+template<typename F>
+static uint32_t walk(Image &image, uint8_t track, uint8_t sector, uint8_t entries, F seek)
+{
+    uint32_t sum = 0;
+
+    while (track)
+    {
+        for (uint8_t e = 0; e < entries; e++)
+        {
+            const uint8_t *block = &image.data[seek(track, sector) * 256];
+            for (int b = 2 + e * 32; b < (entries == 1 ? 256 : 32 + e * 32); b++)
+                sum += block[b];
+        }
+
+        const uint8_t *block = &image.data[seek(track, sector) * 256];
+        track = block[0];
+        sector = block[1];
+    }
+
+    return sum;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_track_map_matches_loop(void)
+{
+    for (auto &g : geometries)
+    {
+        auto map = buildMap(g);
+
+        TEST_ASSERT_EQUAL(g.end_track, map.endTrack());
+        TEST_ASSERT_EQUAL(loopBlock(g, g.end_track + 1, 0), map.blocks());
+
+        for (uint16_t track = 1; track <= g.end_track; track++)
+        {
+            TEST_ASSERT_EQUAL(g.getSectorCount(track), map.sectors(track));
+            for (uint16_t sector = 0; sector < g.getSectorCount(track); sector++)
+            {
+                uint32_t block = loopBlock(g, track, sector);
+                TEST_ASSERT_EQUAL(block, map.block(track, sector));
+                TEST_ASSERT_EQUAL(track, map.track(block));
+            }
+        }
+
+        // Past the end stays on the last track
+        TEST_ASSERT_EQUAL(g.end_track, map.track(map.blocks() + 100));
+    }
+}
+
+void test_track_map_benchmark(void)
+{
+    const int rounds = 200;
+
+    auto &g = geometries[0];
+    auto map = buildMap(g);
+    Image image(g, map);
+
+    auto loop_seek = [&g](uint8_t t, uint8_t s) { return loopBlock(g, t, s); };
+    auto map_seek = [&map](uint8_t t, uint8_t s) { return map.block(t, s); };
+
+    // Directory walk
+    auto start = std::chrono::steady_clock::now();
+    uint32_t loop_dir = 0;
+    for (int i = 0; i < rounds; i++)
+        loop_dir += walk(image, 18, 1, 8, loop_seek);
+    auto loop_dir_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    uint32_t map_dir = 0;
+    for (int i = 0; i < rounds; i++)
+        map_dir += walk(image, 18, 1, 8, map_seek);
+    auto map_dir_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Full disk file read
+    start = std::chrono::steady_clock::now();
+    uint32_t loop_file = 0;
+    for (int i = 0; i < rounds; i++)
+        loop_file += walk(image, image.file[0].first, image.file[0].second, 1, loop_seek);
+    auto loop_file_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    uint32_t map_file = 0;
+    for (int i = 0; i < rounds; i++)
+        map_file += walk(image, image.file[0].first, image.file[0].second, 1, map_seek);
+    auto map_file_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("directory walk (%d entries): loop %8.0f/sec  table %8.0f/sec\r\n", (int)image.directory.size() * 8, rounds / loop_dir_time, rounds / map_dir_time);
+    printf("file read (%d blocks)      : loop %8.0f/sec  table %8.0f/sec\r\n", (int)image.file.size(), rounds / loop_file_time, rounds / map_file_time);
+
+    TEST_ASSERT_EQUAL(loop_dir, map_dir);
+    TEST_ASSERT_EQUAL(loop_file, map_file);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_track_map_matches_loop);
+    RUN_TEST(test_track_map_benchmark);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}
@@ -0,0 +1,291 @@
+// Checks the threaded Z80 core (Z80_THREADED) against the switch core it is
+// built from: every opcode, with and without prefixes, is run from the same
+// random registers and memory on both and the results compared. Then both
+// run the same loop and their speed is printed in MIPS.
+
+#include "unity.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <csignal>
+#include <unistd.h>
+
+#include "../lib/runcpm/globals.h"
+
+// Both cores are built here, each in its own namespace with its own
+// registers, memory and stand-ins for the BIOS, BDOS and ports
+#define Z80_CORE_STUBS                                                          \
+    static uint8 *RAM;                                                          \
+    static uint32 io_log = 0;                                                   \
+    void _Bios(void) { io_log = io_log * 31 + 1; }                              \
+    void _Bdos(void) { io_log = io_log * 31 + 2; }                              \
+    void _HardwareOut(const uint32 Port, const uint32 Value) { io_log = io_log * 31 + Port * 7 + Value; } \
+    uint32 _HardwareIn(const uint32 Port) { return (Port * 13) & 0xff; }
+
+#undef Z80_THREADED
+
+namespace switch_core {
+    Z80_CORE_STUBS
+#include "../lib/runcpm/cpu.h"
+}
+
+#undef CPU_H
+#define Z80_THREADED
+
+namespace threaded_core {
+    Z80_CORE_STUBS
+#include "../lib/runcpm/cpu.h"
+}
+
+struct z80_state {
+    int32 AF, BC, DE, HL, IX, IY, PC, SP, AF1, BC1, DE1, HL1, IFF, IR, PCX;
+};
+
+#define CORE_STATE(core)                                                        \
+    static z80_state core##_get() {                                             \
+        using namespace core;                                                   \
+        return { AF, BC, DE, HL, IX, IY, PC, SP, AF1, BC1, DE1, HL1, IFF, IR, PCX }; \
+    }                                                                           \
+    static void core##_set(const z80_state &s) {                                \
+        using namespace core;                                                   \
+        AF = s.AF; BC = s.BC; DE = s.DE; HL = s.HL; IX = s.IX; IY = s.IY;       \
+        PC = s.PC; SP = s.SP; AF1 = s.AF1; BC1 = s.BC1; DE1 = s.DE1; HL1 = s.HL1; \
+        IFF = s.IFF; IR = s.IR; PCX = s.PCX;                                    \
+        Status = 0;                                                             \
+    }
+
+CORE_STATE(switch_core)
+CORE_STATE(threaded_core)
+
+static uint8 switch_ram[MEMSIZE];
+static uint8 threaded_ram[MEMSIZE];
+
+static std::mt19937 rng(0x2a80);
+
+static void random_state(z80_state &s)
+{
+    s.AF = rng() & 0xffff; s.BC = rng() & 0xffff; s.DE = rng() & 0xffff; s.HL = rng() & 0xffff;
+    s.IX = rng() & 0xffff; s.IY = rng() & 0xffff; s.SP = rng() & 0xffff;
+    s.AF1 = rng() & 0xffff; s.BC1 = rng() & 0xffff; s.DE1 = rng() & 0xffff; s.HL1 = rng() & 0xffff;
+    s.IFF = rng() & 3; s.IR = rng() & 0xffff; s.PCX = 0;
+    s.PC = 0x1000 + (rng() & 0x7fff);
+}
+
+// Code that jumps back to itself would never get to a HALT. Should it
+// happen anyway, the memory is filled with HALT under it.
+static volatile sig_atomic_t stuck = 0;
+
+static void unstick(int)
+{
+    stuck = 1;
+    memset(switch_ram, 0x76, MEMSIZE);
+    memset(threaded_ram, 0x76, MEMSIZE);
+}
+
+static void no_loops(uint8 *code, size_t length)
+{
+    for (size_t i = 0; i + 1 < length; i++)
+    {
+        switch (code[i])
+        {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:     // JR
+            code[i + 1] &= 0x7f;
+            break;
+        }
+    }
+}
+
+// Runs code at a random PC with HALT everywhere else, so it stops after the
+// instruction (or after wherever it jumped to). Returns false on a mismatch.
+static bool run_both(uint8 *code, size_t length)
+{
+    z80_state state;
+    random_state(state);
+    no_loops(code, length);
+
+    memset(switch_ram, 0x76, MEMSIZE);
+
+    // Something to read where the registers point
+    const int32 pointers[] = { state.BC, state.DE, state.HL, state.SP, state.SP + 1, state.IX + (int8)code[2], state.IY + (int8)code[2] };
+    for (int32 pointer : pointers)
+        switch_ram[pointer & 0xffff] = rng();
+
+    memcpy(&switch_ram[state.PC], code, length);
+    memcpy(threaded_ram, switch_ram, MEMSIZE);
+
+    stuck = 0;
+    alarm(1);
+
+    switch_core::RAM = switch_ram;
+    switch_core::io_log = 0;
+    switch_core_set(state);
+    switch_core::Z80run();
+
+    threaded_core::RAM = threaded_ram;
+    threaded_core::io_log = 0;
+    threaded_core_set(state);
+    threaded_core::Z80run();
+
+    alarm(0);
+    if (stuck)
+        return true;
+
+    z80_state a = switch_core_get();
+    z80_state b = threaded_core_get();
+    if (memcmp(&a, &b, sizeof(a)) || memcmp(switch_ram, threaded_ram, MEMSIZE) ||
+        switch_core::io_log != threaded_core::io_log)
+    {
+        printf("mismatch running %02x %02x %02x %02x: AF %04x/%04x PC %04x/%04x\n",
+               code[0], code[1], code[2], code[3], a.AF, b.AF, a.PC, b.PC);
+        return false;
+    }
+    return true;
+}
+
+void setUp(void)
+{
+    signal(SIGALRM, unstick);
+}
+
+void tearDown(void)
+{
+}
+
+void test_z80_opcodes(void)
+{
+    int mismatches = 0;
+
+    for (int op = 0; op < 256; op++)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            uint8 code[4] = { (uint8)op, (uint8)rng(), (uint8)rng(), (uint8)rng() };
+            mismatches += !run_both(code, sizeof(code));
+
+            // Prefixed
+            const uint8 prefixes[] = { 0xcb, 0xed, 0xdd, 0xfd };
+            for (uint8 prefix : prefixes)
+            {
+                uint8 prefixed[4] = { prefix, (uint8)op, (uint8)rng(), (uint8)rng() };
+                mismatches += !run_both(prefixed, sizeof(prefixed));
+            }
+
+            // DD CB d op and FD CB d op
+            uint8 indexed[4] = { 0xdd, 0xcb, (uint8)rng(), (uint8)op };
+            mismatches += !run_both(indexed, sizeof(indexed));
+            indexed[0] = 0xfd;
+            mismatches += !run_both(indexed, sizeof(indexed));
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+void test_z80_daa(void)
+{
+    // Every A with every combination of C, H and N
+    int mismatches = 0;
+    for (int i = 0; i < 2048; i++)
+    {
+        uint8 code[4] = { 0x27, 0x76, 0, 0 };
+        z80_state state;
+        random_state(state);
+        state.AF = ((i & 0xff) << 8) | ((i >> 8) & 1) | (((i >> 9) & 1) << 4) | (((i >> 10) & 1) << 1);
+
+        memset(switch_ram, 0x76, MEMSIZE);
+        memcpy(&switch_ram[state.PC], code, sizeof(code));
+        memcpy(threaded_ram, switch_ram, MEMSIZE);
+
+        switch_core::RAM = switch_ram;
+        switch_core_set(state);
+        switch_core::Z80run();
+        threaded_core::RAM = threaded_ram;
+        threaded_core_set(state);
+        threaded_core::Z80run();
+
+        mismatches += switch_core::AF != threaded_core::AF;
+    }
+    TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+// BCD adds, rotates, bit tests and prefixed instructions over one page,
+// OUTER times round 256 iterations of 12 instructions
+static const uint8 bench_code[] = {
+    0x21, 0x00, 0x40,       // 0100 LD HL,4000h
+    0x11, 0x00, 0x08,       // 0103 LD DE,OUTER
+    0x3e, 0x00,             // 0106 LD A,0
+    0x06, 0x00,             // 0108 LD B,0
+    0x86,                   // 010a ADD A,(HL)
+    0x27,                   // 010b DAA
+    0x4f,                   // 010c LD C,A
+    0xae,                   // 010d XOR (HL)
+    0x07,                   // 010e RLCA
+    0x77,                   // 010f LD (HL),A
+    0x2c,                   // 0110 INC L
+    0xcb, 0x41,             // 0111 BIT 0,C
+    0xdd, 0x23,             // 0113 INC IX
+    0xed, 0x44,             // 0115 NEG
+    0x79,                   // 0117 LD A,C
+    0x10, 0xf0,             // 0118 DJNZ 010a
+    0x1b,                   // 011a DEC DE
+    0x7a,                   // 011b LD A,D
+    0xb3,                   // 011c OR E
+    0x20, 0xe9,             // 011d JR NZ,0108
+    0x76,                   // 011f HALT
+};
+#define BENCH_OUTER 0x0800
+#define BENCH_INSTRUCTIONS (3 + BENCH_OUTER * (1 + 256 * 12 + 4) + 1)
+
+template <typename S, typename R>
+static double bench(uint8 *ram, S set, R run)
+{
+    z80_state state = {};
+    state.PC = 0x0100;
+    state.SP = 0xf000;
+
+    memset(ram, 0, MEMSIZE);
+    memcpy(&ram[0x0100], bench_code, sizeof(bench_code));
+    set(state);
+
+    auto start = std::chrono::steady_clock::now();
+    run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return BENCH_INSTRUCTIONS / seconds / 1e6;
+}
+
+void test_z80_mips(void)
+{
+    switch_core::RAM = switch_ram;
+    double switch_mips = bench(switch_ram, switch_core_set, switch_core::Z80run);
+    threaded_core::RAM = threaded_ram;
+    double threaded_mips = bench(threaded_ram, threaded_core_set, threaded_core::Z80run);
+
+    // Same work done
+    z80_state a = switch_core_get();
+    z80_state b = threaded_core_get();
+    TEST_ASSERT_EQUAL(0, memcmp(&a, &b, sizeof(a)));
+    TEST_ASSERT_EQUAL(0x011f, a.PC);
+    TEST_ASSERT_EQUAL(0, memcmp(switch_ram, threaded_ram, MEMSIZE));
+
+    printf("switch   %.1f MIPS\n", switch_mips);
+    printf("threaded %.1f MIPS, %.2fx\n", threaded_mips, threaded_mips / switch_mips);
+}
+
+
+void process()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_z80_opcodes);
+    RUN_TEST(test_z80_daa);
+    RUN_TEST(test_z80_mips);
+
+    UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    process();
+}